@@ -0,0 +1,414 @@
+/*!
+ * \file      aes-bench.c
+ *
+ * \brief     AES and AES-CMAC benchmark of the AES selected at build time
+ *            ( AES_TTABLE ) and of the secure element crypto backends.
+ *
+ * \remark    Checks the AES against the FIPS-197 and RFC 4493 known answers
+ *            and against a LoRaWAN 1.0 uplink (FRMPayload encryption and
+ *            MIC), then reports the cost per byte of the block cipher, of the
+ *            payload encryption and of the CMAC, with and without the secure
+ *            element key schedule cache.
+ *
+ *            The ESP32 accelerator backend runs on a host stand-in of the
+ *            esp_aes driver ( bench/esp ). It is checked against the software
+ *            backend, with and without injected accelerator failures. Its
+ *            cost on the host is the one of the driver glue, not of the
+ *            peripheral.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "system/crypto/aes.h"
+#include "system/crypto/cmac.h"
+#include "mac/LoRaMacCrypto.h"
+#include "mac/secure-element.h"
+#include "mac/secure-element-nvm.h"
+#include "system/crypto/soft-se-hal.h"
+#include "aes/esp_aes.h"
+
+/*!
+ * Declared by soft-se-hal.h on ESP32 builds only
+ */
+extern const SoftSeCryptoBackend_t SoftSeCryptoEsp32;
+
+static const SoftSeCryptoBackend_t *const Backends[] = { &SoftSeCryptoSoftware, &SoftSeCryptoEsp32 };
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint64_t Cycles( void )
+{
+#if defined( BENCH_HAVE_TSC )
+    return __rdtsc( );
+#else
+    return 0;
+#endif
+}
+
+static void BenchCheck( const char *name, const uint8_t *out, const uint8_t *expected, size_t size )
+{
+    if( memcmp( out, expected, size ) != 0 )
+    {
+        printf( "FAIL %s\n", name );
+        Errors++;
+    }
+}
+
+/*!
+ * FIPS-197 appendix C
+ */
+static void BenchCheckAes( void )
+{
+    static const uint8_t plain[16] =
+    {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF
+    };
+    static const uint8_t cipher[3][16] =
+    {
+        { 0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A },
+        { 0xDD, 0xA9, 0x7C, 0xA4, 0x86, 0x4C, 0xDF, 0xE0, 0x6E, 0xAF, 0x70, 0xA0, 0xEC, 0x0D, 0x71, 0x91 },
+        { 0x8E, 0xA2, 0xB7, 0xCA, 0x51, 0x67, 0x45, 0xBF, 0xEA, 0xFC, 0x49, 0x90, 0x4B, 0x49, 0x60, 0x89 },
+    };
+    static const char *names[3] = { "aes-128", "aes-192", "aes-256" };
+    uint8_t key[32];
+    uint8_t out[16];
+    aes_context ctx;
+
+    for( uint8_t i = 0; i < sizeof( key ); i++ )
+    {
+        key[i] = i;
+    }
+    for( uint8_t i = 0; i < 3; i++ )
+    {
+        aes_set_key( key, 16 + 8 * i, &ctx );
+        lora_aes_encrypt( plain, out, &ctx );
+        BenchCheck( names[i], out, cipher[i], 16 );
+        // In place
+        memcpy( out, plain, 16 );
+        lora_aes_encrypt( out, out, &ctx );
+        BenchCheck( names[i], out, cipher[i], 16 );
+    }
+}
+
+/*!
+ * RFC 4493 section 4
+ */
+static uint8_t CmacKey[16] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+static uint8_t CmacMsg[64] =
+{
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+static const uint16_t CmacSizes[4] = { 0, 16, 40, 64 };
+static const uint8_t CmacMacs[4][16] =
+{
+    { 0xBB, 0x1D, 0x69, 0x29, 0xE9, 0x59, 0x37, 0x28, 0x7F, 0xA3, 0x7D, 0x12, 0x9B, 0x75, 0x67, 0x46 },
+    { 0x07, 0x0A, 0x16, 0xB4, 0x6B, 0x4D, 0x41, 0x44, 0xF7, 0x9B, 0xDD, 0x9D, 0xD0, 0x4A, 0x28, 0x7C },
+    { 0xDF, 0xA6, 0x67, 0x47, 0xDE, 0x9A, 0xE6, 0x30, 0x30, 0xCA, 0x32, 0x61, 0x14, 0x97, 0xC8, 0x27 },
+    { 0x51, 0xF0, 0xBE, 0xBF, 0x7E, 0x3B, 0x9D, 0x92, 0xFC, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3C, 0xFE },
+};
+
+static void BenchCheckCmac( void )
+{
+    AES_CMAC_CTX ctx;
+    uint8_t mac[16];
+
+    for( uint8_t i = 0; i < 4; i++ )
+    {
+        AES_CMAC_Init( &ctx );
+        AES_CMAC_SetKey( &ctx, CmacKey );
+        AES_CMAC_Update( &ctx, CmacMsg, CmacSizes[i] );
+        AES_CMAC_Final( mac, &ctx );
+        BenchCheck( "cmac", mac, CmacMacs[i], 16 );
+    }
+}
+
+/*!
+ * LoRaWAN 1.0 unconfirmed uplink 40F17DBE4900020001954378762B11FF0D:
+ * DevAddr 49BE7DF1, FCnt 2, FPort 1, FRMPayload "test"
+ */
+static uint8_t NwkSKey[16] =
+{
+    0x44, 0x02, 0x42, 0x41, 0xED, 0x4C, 0xE9, 0xA6, 0x8C, 0x6A, 0x8B, 0xC0, 0x55, 0x23, 0x3F, 0xD3
+};
+static uint8_t AppSKey[16] =
+{
+    0xEC, 0x92, 0x58, 0x02, 0xAE, 0x43, 0x0C, 0xA7, 0x7F, 0xD3, 0xDD, 0x73, 0xCB, 0x2C, 0xC5, 0x88
+};
+static uint8_t Frame[17] =
+{
+    0x40, 0xF1, 0x7D, 0xBE, 0x49, 0x00, 0x02, 0x00, 0x01, 0x95, 0x43, 0x78, 0x76, 0x2B, 0x11, 0xFF, 0x0D
+};
+#define FRAME_DEV_ADDR                              0x49BE7DF1
+#define FRAME_FCNT                                  2
+#define FRAME_PAYLOAD_OFFSET                        9
+#define FRAME_PAYLOAD_SIZE                          4
+
+/*!
+ * \brief Builds the B0 block of an uplink MIC
+ */
+static void BenchMicB0( uint8_t *b0, uint8_t size )
+{
+    memset( b0, 0, 16 );
+    b0[0] = 0x49;
+    b0[6] = FRAME_DEV_ADDR & 0xFF;
+    b0[7] = ( FRAME_DEV_ADDR >> 8 ) & 0xFF;
+    b0[8] = ( FRAME_DEV_ADDR >> 16 ) & 0xFF;
+    b0[9] = ( FRAME_DEV_ADDR >> 24 ) & 0xFF;
+    b0[10] = FRAME_FCNT;
+    b0[15] = size;
+}
+
+static void BenchCheckLoRaWan( void )
+{
+    uint8_t b0[16];
+    uint8_t plain[FRAME_PAYLOAD_SIZE];
+    uint32_t mic = 0;
+
+    LoRaMacPayloadDecrypt( &Frame[FRAME_PAYLOAD_OFFSET], FRAME_PAYLOAD_SIZE, AppSKey, FRAME_DEV_ADDR, 0, FRAME_FCNT,
+                           plain );
+    BenchCheck( "lorawan payload", plain, ( const uint8_t* )"test", FRAME_PAYLOAD_SIZE );
+
+    BenchMicB0( b0, sizeof( Frame ) - 4 );
+    SecureElementComputeAesCmac( b0, Frame, sizeof( Frame ) - 4, F_NWK_S_INT_KEY, &mic );
+    if( mic != 0x0DFF112B )
+    {
+        printf( "FAIL lorawan mic %08X\n", mic );
+        Errors++;
+    }
+}
+
+/*!
+ * \brief Checks a secure element backend against the RFC 4493 known answers,
+ *        the whole message or its first block passed as the Bx block
+ */
+static void BenchCheckBackendCmac( const SoftSeCryptoBackend_t *backend )
+{
+    Key_t key = { .KeyID = NWK_S_ENC_KEY };
+    uint8_t mac[16];
+
+    memcpy( key.KeyValue, CmacKey, 16 );
+    for( uint8_t i = 0; i < 4; i++ )
+    {
+        if( ( backend->AesCmac( &key, NULL, CmacMsg, CmacSizes[i], mac ) != SECURE_ELEMENT_SUCCESS ) ||
+            ( memcmp( mac, CmacMacs[i], 16 ) != 0 ) )
+        {
+            printf( "FAIL %s cmac %u\n", backend->Name, CmacSizes[i] );
+            Errors++;
+        }
+        if( CmacSizes[i] < 16 )
+        {
+            continue;
+        }
+        if( ( backend->AesCmac( &key, CmacMsg, &CmacMsg[16], CmacSizes[i] - 16, mac ) != SECURE_ELEMENT_SUCCESS ) ||
+            ( memcmp( mac, CmacMacs[i], 16 ) != 0 ) )
+        {
+            printf( "FAIL %s cmac bx %u\n", backend->Name, CmacSizes[i] );
+            Errors++;
+        }
+    }
+}
+
+/*!
+ * \brief Checks the ESP32 backend against the software one on every message
+ *        size, then with an accelerator failure injected at each operation
+ */
+static void BenchCheckEsp32Backend( const uint8_t *data, uint8_t *b0 )
+{
+    Key_t key = { .KeyID = APP_S_KEY };
+    uint8_t ref[256];
+    uint8_t out[256];
+
+    memcpy( key.KeyValue, AppSKey, 16 );
+    for( uint16_t size = 0; size <= 255; size++ )
+    {
+        const uint8_t *bx = ( ( size & 1 ) != 0 ) ? b0 : NULL;
+
+        SoftSeCryptoSoftware.AesCmac( &key, bx, data, size, ref );
+        SoftSeCryptoEsp32.AesCmac( &key, bx, data, size, out );
+        BenchCheck( "esp32 cmac", out, ref, 16 );
+    }
+    for( uint16_t size = 16; size <= 240; size += 16 )
+    {
+        SoftSeCryptoSoftware.AesEncrypt( &key, data, size, ref );
+        SoftSeCryptoEsp32.AesEncrypt( &key, data, size, out );
+        BenchCheck( "esp32 encrypt", out, ref, size );
+    }
+
+    // Every accelerator operation of a 100 byte MIC and of an in place 64 byte
+    // encryption fails once
+    SoftSeCryptoSoftware.AesCmac( &key, b0, data, 100, ref );
+    for( uint32_t failAt = 1; failAt <= 8; failAt++ )
+    {
+        EspAesHostFailAt = failAt;
+        SoftSeCryptoEsp32.AesCmac( &key, b0, data, 100, out );
+        BenchCheck( "esp32 cmac fallback", out, ref, 16 );
+    }
+    SoftSeCryptoSoftware.AesEncrypt( &key, data, 64, ref );
+    for( uint32_t failAt = 1; failAt <= 6; failAt++ )
+    {
+        memcpy( out, data, 64 );
+        EspAesHostFailAt = failAt;
+        SoftSeCryptoEsp32.AesEncrypt( &key, out, 64, out );
+        BenchCheck( "esp32 encrypt fallback", out, ref, 64 );
+    }
+    EspAesHostFailAt = 0;
+}
+
+/*!
+ * \brief Prints the cost of a run on size bytes
+ */
+static void BenchReport( const char *name, double ns, uint64_t cycles, double bytes )
+{
+#if defined( BENCH_HAVE_TSC )
+    printf( "%-28s %8.2f %8.2f\n", name, ns / bytes, ( double )cycles / bytes );
+#else
+    printf( "%-28s %8.2f %8s\n", name, ns / bytes, "-" );
+#endif
+}
+
+int main( int argc, char **argv )
+{
+    static SecureElementNvmData_t seNvm;
+    static uint8_t data[256];
+    int rounds = ( argc > 1 ) ? atoi( argv[1] ) : 20000;
+    volatile uint32_t sink = 0;
+    aes_context ctx;
+    AES_CMAC_CTX cmacCtx;
+    uint8_t block[16] = { 0 };
+    uint8_t b0[16];
+    double start;
+    uint64_t cycles;
+
+    for( size_t i = 0; i < sizeof( data ); i++ )
+    {
+        data[i] = ( uint8_t )( i * 7 + 1 );
+    }
+    SecureElementInit( &seNvm );
+    SecureElementSetKey( F_NWK_S_INT_KEY, NwkSKey );
+    SecureElementSetKey( APP_S_KEY, AppSKey );
+
+    BenchCheckAes( );
+    BenchCheckCmac( );
+    for( size_t i = 0; i < sizeof( Backends ) / sizeof( Backends[0] ); i++ )
+    {
+        SoftSeHalSetCryptoBackend( Backends[i] );
+        BenchCheckBackendCmac( Backends[i] );
+        BenchCheckLoRaWan( );
+    }
+    BenchMicB0( b0, 64 );
+    BenchCheckEsp32Backend( data, b0 );
+    SoftSeHalSetCryptoBackend( NULL );
+
+    printf( "aes backend: %s\n", ( AES_TTABLE == 1 ) ? "32-bit T-table" : "byte oriented" );
+#if defined( BENCH_HAVE_TSC )
+    printf( "%-28s %8s %8s\n", "", "ns/B", "cyc/B" );
+#else
+    printf( "%-28s %8s %8s\n", "", "ns/B", "" );
+#endif
+
+    // Key expansion, reported per key byte
+    start = WallNs( );
+    cycles = Cycles( );
+    for( int r = 0; r < rounds; r++ )
+    {
+        block[0] = ( uint8_t )r;
+        aes_set_key( block, 16, &ctx );
+        sink += ctx.ksch[4];
+    }
+    BenchReport( "set key", WallNs( ) - start, Cycles( ) - cycles, 16.0 * rounds );
+
+    // Block cipher with an expanded key
+    aes_set_key( NwkSKey, 16, &ctx );
+    start = WallNs( );
+    cycles = Cycles( );
+    for( int r = 0; r < rounds; r++ )
+    {
+        for( int b = 0; b < 16; b++ )
+        {
+            lora_aes_encrypt( block, block, &ctx );
+        }
+    }
+    sink += block[0];
+    BenchReport( "encrypt block", WallNs( ) - start, Cycles( ) - cycles, 256.0 * rounds );
+
+    // Payload encryption of a 51 byte application payload, key expanded for
+    // each payload
+    start = WallNs( );
+    cycles = Cycles( );
+    for( int r = 0; r < rounds; r++ )
+    {
+        LoRaMacPayloadEncrypt( data, 51, AppSKey, FRAME_DEV_ADDR, 0, r, data );
+    }
+    sink += data[0];
+    BenchReport( "payload encrypt 51 B", WallNs( ) - start, Cycles( ) - cycles, 51.0 * rounds );
+
+    // MIC of a 64 byte frame, key expanded for each message
+    start = WallNs( );
+    cycles = Cycles( );
+    for( int r = 0; r < rounds; r++ )
+    {
+        AES_CMAC_Init( &cmacCtx );
+        AES_CMAC_SetKey( &cmacCtx, NwkSKey );
+        AES_CMAC_Update( &cmacCtx, b0, 16 );
+        AES_CMAC_Update( &cmacCtx, data, 64 );
+        AES_CMAC_Final( block, &cmacCtx );
+    }
+    sink += block[0];
+    BenchReport( "cmac 64 B", WallNs( ) - start, Cycles( ) - cycles, 64.0 * rounds );
+
+    // Same MIC and session key derivation sized encryption through the
+    // secure element backends, the software one caches the key schedules
+    for( size_t i = 0; i < sizeof( Backends ) / sizeof( Backends[0] ); i++ )
+    {
+        char name[32];
+
+        SoftSeHalSetCryptoBackend( Backends[i] );
+        start = WallNs( );
+        cycles = Cycles( );
+        for( int r = 0; r < rounds; r++ )
+        {
+            uint32_t mic;
+
+            SecureElementComputeAesCmac( b0, data, 64, F_NWK_S_INT_KEY, &mic );
+            sink += mic;
+        }
+        snprintf( name, sizeof( name ), "se cmac 64 B %s", Backends[i]->Name );
+        BenchReport( name, WallNs( ) - start, Cycles( ) - cycles, 64.0 * rounds );
+
+        start = WallNs( );
+        cycles = Cycles( );
+        for( int r = 0; r < rounds; r++ )
+        {
+            SecureElementAesEncrypt( block, 16, APP_S_KEY, block );
+        }
+        sink += block[0];
+        snprintf( name, sizeof( name ), "se encrypt 16 B %s", Backends[i]->Name );
+        BenchReport( name, WallNs( ) - start, Cycles( ) - cycles, 16.0 * rounds );
+    }
+    SoftSeHalSetCryptoBackend( NULL );
+
+    ( void )sink;
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
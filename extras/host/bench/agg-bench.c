@@ -0,0 +1,261 @@
+/*!
+ * \file      agg-bench.c
+ *
+ * \brief     Uplink aggregation benchmark ( UplinkAggregate.c ).
+ *
+ * \remark    Packs random records into frames of random sizes and checks that
+ *            the decoder returns them unchanged and rejects every truncated
+ *            frame, then reports the codec cost and the frames and airtime
+ *            per reading with and without aggregation, for each datarate of
+ *            EU868 and US915, from the regional payload limits and the radio
+ *            time on air.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "radio/radio.h"
+#include "mac/region/Region.h"
+#include "apps/LoRaMac/common/UplinkAggregate.h"
+
+/*!
+ * MHDR, FHDR without FOpts, FPort and MIC
+ */
+#define BENCH_FRAME_OVERHEAD                        13
+
+typedef struct BenchRecord_s
+{
+    uint8_t Data[64];
+    uint8_t Size;
+    uint32_t Age;
+}BenchRecord_t;
+
+typedef struct BenchDecode_s
+{
+    const BenchRecord_t *Records;
+    uint16_t Count;
+}BenchDecode_t;
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void OnRecordCheck( const uint8_t *data, uint8_t size, uint32_t age, void *context )
+{
+    BenchDecode_t *decode = context;
+    const BenchRecord_t *record = &decode->Records[decode->Count++];
+    uint32_t expected = ( record->Age > UPLINK_AGGREGATE_MAX_AGE ) ? UPLINK_AGGREGATE_MAX_AGE : record->Age;
+
+    if( ( size != record->Size ) || ( age != expected ) || ( memcmp( data, record->Data, size ) != 0 ) )
+    {
+        printf( "FAIL record %u: %u bytes age %u, expected %u bytes age %u\n", decode->Count - 1, size, age,
+                record->Size, expected );
+        Errors++;
+    }
+}
+
+static void OnRecordCount( const uint8_t *data, uint8_t size, uint32_t age, void *context )
+{
+    ( *( uint32_t* )context )++;
+}
+
+static void BenchCheck( uint32_t frames )
+{
+    uint32_t rand = 0x12345678;
+
+    for( uint32_t f = 0; f < frames; f++ )
+    {
+        BenchRecord_t records[128];
+        uint16_t ends[128];
+        uint8_t frame[255];
+        uint8_t maxSize = 11 + BenchRand( &rand ) % 232;
+        uint8_t size = 0;
+        uint16_t count = 0;
+        BenchDecode_t decode = { .Records = records, .Count = 0 };
+        int16_t decoded;
+
+        for( ;; )
+        {
+            BenchRecord_t *record = &records[count];
+
+            record->Size = BenchRand( &rand ) % 40;
+            switch( BenchRand( &rand ) % 4 )
+            {
+            case 0:
+                record->Age = BenchRand( &rand ) % 128;
+                break;
+            case 1:
+                record->Age = BenchRand( &rand ) % 16384;
+                break;
+            case 2:
+                record->Age = BenchRand( &rand ) % ( UPLINK_AGGREGATE_MAX_AGE + 1 );
+                break;
+            default:
+                record->Age = BenchRand( &rand );
+                break;
+            }
+            for( uint8_t i = 0; i < record->Size; i++ )
+            {
+                record->Data[i] = ( uint8_t )BenchRand( &rand );
+            }
+            if( UplinkAggregateAppend( frame, &size, maxSize, record->Data, record->Size, record->Age ) == false )
+            {
+                if( ( size + UplinkAggregateRecordSize( record->Size, record->Age ) ) <= maxSize )
+                {
+                    printf( "FAIL frame %u: record of %u bytes refused with %u of %u bytes used\n", f, record->Size,
+                            size, maxSize );
+                    Errors++;
+                }
+                break;
+            }
+            ends[count++] = size;
+        }
+
+        decoded = UplinkAggregateDecode( frame, size, OnRecordCheck, &decode );
+        if( ( decoded != count ) || ( decode.Count != count ) )
+        {
+            printf( "FAIL frame %u: %d records decoded, %u packed\n", f, decoded, count );
+            Errors++;
+        }
+
+        // A frame cut at a record boundary holds the records before it, any
+        // other cut is malformed
+        for( uint16_t cut = 0, next = 0; cut < size; cut++ )
+        {
+            int16_t expected = -1;
+
+            if( ( next < count ) && ( cut == ends[next] ) )
+            {
+                next++;
+            }
+            if( ( cut == 0 ) || ( ( next > 0 ) && ( cut == ends[next - 1] ) ) )
+            {
+                expected = ( int16_t )next;
+            }
+            if( UplinkAggregateDecode( frame, ( uint8_t )cut, NULL, NULL ) != expected )
+            {
+                printf( "FAIL frame %u cut at %u of %u bytes: expected %d\n", f, cut, size, expected );
+                Errors++;
+            }
+        }
+    }
+}
+
+static void BenchCodec( uint32_t rounds )
+{
+    uint8_t frame[242];
+    uint8_t data[8] = { 0x01, 0x67, 0x00, 0xE1, 0x02, 0x68, 0x64, 0x00 };
+    uint32_t records = 0;
+    uint8_t size = 0;
+    double start;
+    double encodeNs;
+    double decodeNs;
+
+    start = WallNs( );
+    for( uint32_t r = 0; r < rounds; r++ )
+    {
+        size = 0;
+        while( UplinkAggregateAppend( frame, &size, sizeof( frame ), data, sizeof( data ), r & 0x3FFF ) == true )
+        {
+            records++;
+        }
+    }
+    encodeNs = ( WallNs( ) - start ) / records;
+
+    records = 0;
+    start = WallNs( );
+    for( uint32_t r = 0; r < rounds; r++ )
+    {
+        UplinkAggregateDecode( frame, size, OnRecordCount, &records );
+    }
+    decodeNs = ( WallNs( ) - start ) / records;
+
+    printf( "%u B records         %6.1f ns encode, %6.1f ns decode per record\n", ( unsigned )sizeof( data ), encodeNs,
+            decodeNs );
+}
+
+/*!
+ * \brief Frames and airtime of readings sent alone and aggregated, for each
+ *        datarate of a region
+ */
+static void BenchAirtime( const char *name, LoRaMacRegion_t region, int8_t minDr, int8_t maxDr, uint8_t recordSize,
+                          uint32_t readings )
+{
+    printf( "\n%s, %u readings of %u B      alone            aggregated\n", name, readings, recordSize );
+    printf( "dr  sf  bw  max    frames  ms/reading   rec/frame  frames  ms/reading  airtime\n" );
+    for( int8_t dr = minDr; dr <= maxDr; dr++ )
+    {
+        GetPhyParams_t getPhy = { .Datarate = dr, .UplinkDwellTime = 0, .DownlinkDwellTime = 0 };
+        uint32_t maxPayload;
+        uint32_t sf;
+        uint32_t bw;
+        uint32_t perFrame;
+        uint32_t frames;
+        uint32_t last;
+        double alone;
+        double aggregated;
+
+        getPhy.Attribute = PHY_MAX_PAYLOAD;
+        maxPayload = RegionGetPhyParam( region, &getPhy ).Value;
+        getPhy.Attribute = PHY_SF_FROM_DR;
+        sf = RegionGetPhyParam( region, &getPhy ).Value;
+        getPhy.Attribute = PHY_BW_FROM_DR;
+        bw = RegionGetPhyParam( region, &getPhy ).Value;
+        if( recordSize > maxPayload )
+        {
+            continue;
+        }
+
+        alone = ( double )readings *
+                Radio.TimeOnAir( MODEM_LORA, bw, sf, 1, 8, false, BENCH_FRAME_OVERHEAD + recordSize, true );
+
+        perFrame = maxPayload / UplinkAggregateRecordSize( recordSize, 0 );
+        if( perFrame == 0 )
+        {
+            printf( "%2d  %2u  %3u  %3u    %6u  %10.1f   record does not fit\n", dr, sf, 125 << bw, maxPayload,
+                    readings, alone / readings );
+            continue;
+        }
+        frames = ( readings + perFrame - 1 ) / perFrame;
+        last = readings - ( frames - 1 ) * perFrame;
+        aggregated = ( double )( frames - 1 ) *
+                     Radio.TimeOnAir( MODEM_LORA, bw, sf, 1, 8, false,
+                                      BENCH_FRAME_OVERHEAD + perFrame * UplinkAggregateRecordSize( recordSize, 0 ), true ) +
+                     Radio.TimeOnAir( MODEM_LORA, bw, sf, 1, 8, false,
+                                      BENCH_FRAME_OVERHEAD + last * UplinkAggregateRecordSize( recordSize, 0 ), true );
+
+        printf( "%2d  %2u  %3u  %3u    %6u  %10.1f   %9u  %6u  %10.1f  %6.1f%%\n", dr, sf, 125 << bw, maxPayload,
+                readings, alone / readings, perFrame, frames, aggregated / readings, 100.0 * aggregated / alone );
+    }
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t rounds = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 200000;
+
+    BenchCheck( 2000 );
+
+    BenchCodec( rounds );
+    BenchAirtime( "eu868", LORAMAC_REGION_EU868, DR_0, DR_5, 8, 1000 );
+    BenchAirtime( "us915", LORAMAC_REGION_US915, DR_0, DR_4, 8, 1000 );
+    BenchAirtime( "eu868", LORAMAC_REGION_EU868, DR_0, DR_5, 20, 1000 );
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,387 @@
+/*!
+ * \file      chan-bench.c
+ *
+ * \brief     Channel selection benchmark of the region layer: enabled channels
+ *            counted into a channels mask ( RegionCommonCountNbOfEnabledChannelsMask )
+ *            and the channel picked by its rank ( RegionCommonChanMaskSelect ).
+ *
+ * \remark    Checks both against the former scan of every channel into an
+ *            array on random masks, join masks, datarates, disabled channels
+ *            and band states of the US915/AU915 (72 channels) and CN470 (96
+ *            channels) plans, with the same random rank, and that the picks
+ *            are spread evenly over the enabled channels. Then reports the
+ *            cost of a selection with both.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "mac/region/RegionCommon.h"
+
+#define BENCH_MAX_NB_CHANNELS                       96
+#define BENCH_MASK_WORDS                            6
+#define BENCH_NB_BANDS                              4
+
+typedef struct BenchPlan_s
+{
+    const char *Name;
+    uint16_t NbChannels;
+    ChannelParams_t Channels[BENCH_MAX_NB_CHANNELS];
+    Band_t Bands[BENCH_NB_BANDS];
+    uint16_t ChannelsMask[BENCH_MASK_WORDS];
+    uint16_t JoinChannels[BENCH_MASK_WORDS];
+}BenchPlan_t;
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/*!
+ * \brief The former RegionCommonCountNbOfEnabledChannels, visiting every
+ *        channel of the region
+ */
+static void ReferenceCount( RegionCommonCountNbOfEnabledChannelsParams_t *params, uint8_t *enabledChannels,
+                            uint8_t *nbEnabledChannels, uint8_t *nbRestrictedChannels )
+{
+    uint8_t nbChannelCount = 0;
+    uint8_t nbRestrictedChannelsCount = 0;
+
+    for( uint8_t i = 0, k = 0; i < params->MaxNbChannels; i += 16, k++ )
+    {
+        for( uint8_t j = 0; j < 16; j++ )
+        {
+            if( ( params->ChannelsMask[k] & ( 1 << j ) ) != 0 )
+            {
+                if( params->Channels[i + j].Frequency == 0 )
+                {
+                    continue;
+                }
+                if( ( params->Joined == false ) && ( params->JoinChannels != NULL ) )
+                {
+                    if( ( params->JoinChannels[k] & ( 1 << j ) ) == 0 )
+                    {
+                        continue;
+                    }
+                }
+                if( RegionCommonValueInRange( params->Datarate, params->Channels[i + j].DrRange.Fields.Min,
+                                              params->Channels[i + j].DrRange.Fields.Max ) == 0 )
+                {
+                    continue;
+                }
+                if( params->Bands[params->Channels[i + j].Band].ReadyForTransmission == false )
+                {
+                    nbRestrictedChannelsCount++;
+                    continue;
+                }
+                enabledChannels[nbChannelCount++] = i + j;
+            }
+        }
+    }
+    *nbEnabledChannels = nbChannelCount;
+    *nbRestrictedChannels = nbRestrictedChannelsCount;
+}
+
+/*!
+ * \brief US915/AU915 like plan: 64 channels of 125 kHz ( DR0 to DR3 ) and 8 of
+ *        500 kHz ( DR4 ). CN470 like plan: 96 channels, DR0 to DR5.
+ */
+static void PlanInit( BenchPlan_t *plan, const char *name, uint16_t nbChannels )
+{
+    memset( plan, 0, sizeof( BenchPlan_t ) );
+    plan->Name = name;
+    plan->NbChannels = nbChannels;
+    for( uint16_t i = 0; i < nbChannels; i++ )
+    {
+        ChannelParams_t *channel = &plan->Channels[i];
+
+        channel->Frequency = 470300000 + i * 200000;
+        if( nbChannels == 96 )
+        {
+            channel->DrRange.Value = ( DR_5 << 4 ) | DR_0;
+        }
+        else if( i < 64 )
+        {
+            channel->DrRange.Value = ( DR_3 << 4 ) | DR_0;
+        }
+        else
+        {
+            channel->DrRange.Value = ( DR_4 << 4 ) | DR_4;
+        }
+        channel->Band = i % BENCH_NB_BANDS;
+    }
+}
+
+/*!
+ * \brief Random state of the channels: mask, join mask, disabled channels
+ *        and bands
+ */
+static void PlanRandom( BenchPlan_t *plan, uint32_t *rand )
+{
+    uint8_t density = BenchRand( rand ) % 4;
+
+    for( uint8_t k = 0; k < BENCH_MASK_WORDS; k++ )
+    {
+        uint16_t mask = ( uint16_t )BenchRand( rand );
+
+        // From a few channels to all of them
+        for( uint8_t d = 0; d < density; d++ )
+        {
+            mask |= ( uint16_t )BenchRand( rand );
+        }
+        if( density == 0 )
+        {
+            mask &= ( uint16_t )BenchRand( rand );
+        }
+        plan->ChannelsMask[k] = ( ( k * 16 ) < plan->NbChannels ) ? mask : 0;
+        plan->JoinChannels[k] = ( uint16_t )BenchRand( rand );
+    }
+    if( plan->NbChannels == 72 )
+    {
+        // No channel above 71
+        plan->ChannelsMask[4] &= 0x00FF;
+    }
+    for( uint16_t i = 0; i < plan->NbChannels; i++ )
+    {
+        plan->Channels[i].Frequency = ( ( BenchRand( rand ) % 32 ) == 0 ) ? 0 : 470300000 + i * 200000;
+    }
+    for( uint8_t b = 0; b < BENCH_NB_BANDS; b++ )
+    {
+        plan->Bands[b].ReadyForTransmission = ( BenchRand( rand ) % 4 ) != 0;
+    }
+}
+
+static void CountParams( BenchPlan_t *plan, RegionCommonCountNbOfEnabledChannelsParams_t *params, uint32_t *rand )
+{
+    params->Joined = ( BenchRand( rand ) % 4 ) != 0;
+    params->Datarate = BenchRand( rand ) % 6;
+    params->ChannelsMask = plan->ChannelsMask;
+    params->Channels = plan->Channels;
+    params->Bands = plan->Bands;
+    params->MaxNbChannels = plan->NbChannels;
+    params->JoinChannels = ( ( BenchRand( rand ) % 2 ) == 0 ) ? plan->JoinChannels : NULL;
+}
+
+static void BenchCheck( BenchPlan_t *plan, uint32_t rounds )
+{
+    uint32_t rand = 0x0BADCAFE ^ plan->NbChannels;
+
+    for( uint32_t r = 0; r < rounds; r++ )
+    {
+        RegionCommonCountNbOfEnabledChannelsParams_t params;
+        uint8_t expected[BENCH_MAX_NB_CHANNELS];
+        uint8_t enabledChannels[BENCH_MAX_NB_CHANNELS];
+        uint16_t enabledChannelsMask[BENCH_MASK_WORDS];
+        uint8_t nbExpected;
+        uint8_t nbRestrictedExpected;
+        uint8_t nbEnabled;
+        uint8_t nbRestricted;
+
+        PlanRandom( plan, &rand );
+        CountParams( plan, &params, &rand );
+
+        ReferenceCount( &params, expected, &nbExpected, &nbRestrictedExpected );
+        RegionCommonCountNbOfEnabledChannels( &params, enabledChannels, &nbEnabled, &nbRestricted );
+        if( ( nbEnabled != nbExpected ) || ( nbRestricted != nbRestrictedExpected ) ||
+            ( memcmp( enabledChannels, expected, nbExpected ) != 0 ) )
+        {
+            printf( "FAIL %s round %u: %u enabled %u restricted, expected %u and %u\n", plan->Name, r, nbEnabled,
+                    nbRestricted, nbExpected, nbRestrictedExpected );
+            Errors++;
+            continue;
+        }
+
+        RegionCommonCountNbOfEnabledChannelsMask( &params, enabledChannelsMask, &nbEnabled, &nbRestricted );
+        if( ( nbEnabled != nbExpected ) || ( nbRestricted != nbRestrictedExpected ) )
+        {
+            printf( "FAIL %s round %u: mask count %u enabled %u restricted, expected %u and %u\n", plan->Name, r,
+                    nbEnabled, nbRestricted, nbExpected, nbRestrictedExpected );
+            Errors++;
+            continue;
+        }
+        // Every rank gives the channel of the array
+        for( uint8_t index = 0; index < nbExpected; index++ )
+        {
+            uint8_t channel = RegionCommonChanMaskSelect( enabledChannelsMask, BENCH_MASK_WORDS, index );
+
+            if( channel != expected[index] )
+            {
+                printf( "FAIL %s round %u: rank %u selects channel %u, expected %u\n", plan->Name, r, index, channel,
+                        expected[index] );
+                Errors++;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Picks channels at random out of one state and checks each enabled
+ *        channel comes up within 5 % of its share
+ */
+static void BenchDistribution( BenchPlan_t *plan, uint32_t picks )
+{
+    RegionCommonCountNbOfEnabledChannelsParams_t params;
+    uint16_t enabledChannelsMask[BENCH_MASK_WORDS];
+    uint32_t histogram[BENCH_MAX_NB_CHANNELS] = { 0 };
+    uint32_t rand = 0x600DF00D;
+    uint8_t nbEnabled;
+    uint8_t nbRestricted;
+    double expected;
+    double chi2 = 0;
+
+    // Joined at DR0, a few channels disabled
+    PlanRandom( plan, &rand );
+    for( uint8_t k = 0; k < BENCH_MASK_WORDS; k++ )
+    {
+        plan->ChannelsMask[k] = ( ( k * 16 ) < plan->NbChannels ) ? 0xFFFF : 0;
+    }
+    if( plan->NbChannels == 72 )
+    {
+        plan->ChannelsMask[4] = 0x00FF;
+    }
+    for( uint8_t b = 0; b < BENCH_NB_BANDS; b++ )
+    {
+        plan->Bands[b].ReadyForTransmission = true;
+    }
+    CountParams( plan, &params, &rand );
+    params.Joined = true;
+    params.Datarate = DR_0;
+
+    RegionCommonCountNbOfEnabledChannelsMask( &params, enabledChannelsMask, &nbEnabled, &nbRestricted );
+    for( uint32_t i = 0; i < picks; i++ )
+    {
+        histogram[RegionCommonChanMaskSelect( enabledChannelsMask, BENCH_MASK_WORDS,
+                                              BenchRand( &rand ) % nbEnabled )]++;
+    }
+
+    expected = ( double )picks / nbEnabled;
+    for( uint8_t i = 0; i < plan->NbChannels; i++ )
+    {
+        bool enabled = ( enabledChannelsMask[i / 16] & ( 1 << ( i % 16 ) ) ) != 0;
+
+        if( enabled == false )
+        {
+            if( histogram[i] != 0 )
+            {
+                printf( "FAIL %s: channel %u disabled, picked %u times\n", plan->Name, i, histogram[i] );
+                Errors++;
+            }
+            continue;
+        }
+        chi2 += ( ( double )histogram[i] - expected ) * ( ( double )histogram[i] - expected ) / expected;
+        if( ( histogram[i] < expected * 0.95 ) || ( histogram[i] > expected * 1.05 ) )
+        {
+            printf( "FAIL %s: channel %u picked %u times, expected %.0f\n", plan->Name, i, histogram[i], expected );
+            Errors++;
+        }
+    }
+    printf( "%-6s %2u enabled channels, %u picks, chi2 %.1f for %u degrees of freedom\n", plan->Name, nbEnabled,
+            picks, chi2, nbEnabled - 1 );
+}
+
+/*!
+ * \brief Cost of a selection on random channels masks, or on the one of a
+ *        network using a single sub-band ( 8 channels of 125 kHz and one of
+ *        500 kHz, channels 8 to 15 and 65 for US915 sub-band 2 )
+ */
+static void BenchRun( BenchPlan_t *plan, bool subBand, bool mask, uint32_t rounds )
+{
+    static RegionCommonCountNbOfEnabledChannelsParams_t params[64];
+    static BenchPlan_t plans[64];
+    uint32_t rand = 0xFEEDBEEF;
+    volatile uint32_t sink = 0;
+    double start;
+
+    // A few states prepared beforehand, joined at DR0
+    for( uint8_t s = 0; s < 64; s++ )
+    {
+        plans[s] = *plan;
+        PlanRandom( &plans[s], &rand );
+        CountParams( &plans[s], &params[s], &rand );
+        params[s].ChannelsMask = plans[s].ChannelsMask;
+        params[s].Channels = plans[s].Channels;
+        params[s].Bands = plans[s].Bands;
+        params[s].Joined = true;
+        params[s].Datarate = DR_0;
+        if( subBand == true )
+        {
+            memset( plans[s].ChannelsMask, 0, sizeof( plans[s].ChannelsMask ) );
+            plans[s].ChannelsMask[0] = 0xFF00;
+            plans[s].ChannelsMask[4] = 0x0002;
+        }
+    }
+
+    start = WallNs( );
+    for( uint32_t i = 0; i < rounds; i++ )
+    {
+        RegionCommonCountNbOfEnabledChannelsParams_t *p = &params[i & 63];
+        uint8_t nbEnabled;
+        uint8_t nbRestricted;
+
+        if( mask == true )
+        {
+            uint16_t enabledChannelsMask[BENCH_MASK_WORDS];
+
+            RegionCommonCountNbOfEnabledChannelsMask( p, enabledChannelsMask, &nbEnabled, &nbRestricted );
+            if( nbEnabled > 0 )
+            {
+                sink += RegionCommonChanMaskSelect( enabledChannelsMask, BENCH_MASK_WORDS,
+                                                    BenchRand( &rand ) % nbEnabled );
+            }
+        }
+        else
+        {
+            uint8_t enabledChannels[BENCH_MAX_NB_CHANNELS] = { 0 };
+
+            ReferenceCount( p, enabledChannels, &nbEnabled, &nbRestricted );
+            if( nbEnabled > 0 )
+            {
+                sink += enabledChannels[BenchRand( &rand ) % nbEnabled];
+            }
+        }
+    }
+    printf( "%-6s %-10s %-18s %8.1f\n", plan->Name, ( subBand == true ) ? "sub-band" : "random",
+            ( mask == true ) ? "mask, rank select" : "scan, array", ( WallNs( ) - start ) / rounds );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t rounds = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 2000000;
+    static BenchPlan_t us915;
+    static BenchPlan_t cn470;
+
+    PlanInit( &us915, "us915", 72 );
+    PlanInit( &cn470, "cn470", 96 );
+
+    BenchCheck( &us915, 200000 );
+    BenchCheck( &cn470, 200000 );
+    BenchDistribution( &us915, 4000000 );
+    BenchDistribution( &cn470, 4000000 );
+
+    printf( "%-36s %8s\n", "", "ns/selection" );
+    for( uint8_t subBand = 0; subBand < 2; subBand++ )
+    {
+        BenchRun( &us915, subBand, false, rounds );
+        BenchRun( &us915, subBand, true, rounds );
+        BenchRun( &cn470, subBand, false, rounds );
+        BenchRun( &cn470, subBand, true, rounds );
+    }
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
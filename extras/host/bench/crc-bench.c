@@ -0,0 +1,205 @@
+/*!
+ * \file      crc-bench.c
+ *
+ * \brief     CRC32 benchmark of the table driven implementation selected at
+ *            build time ( CRC32_SLICES ).
+ *
+ * \remark    Checks Crc32 and Crc32Update against the bit wise reference on
+ *            every length and alignment, then reports the throughput of both
+ *            on buffers and on the LoRaMac NVM groups, all of them and only
+ *            the ones a transmission or a reception may change.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "system/utilities.h"
+#include "mac/LoRaMac.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint64_t Cycles( void )
+{
+#if defined( BENCH_HAVE_TSC )
+    return __rdtsc( );
+#else
+    return 0;
+#endif
+}
+
+/*!
+ * \brief Bit wise CRC32, the implementation the tables replace
+ */
+static uint32_t Crc32Reference( const uint8_t *buffer, uint16_t length )
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for( uint16_t i = 0; i < length; ++i )
+    {
+        crc ^= ( uint32_t )buffer[i];
+        for( uint16_t j = 0; j < 8; j++ )
+        {
+            crc = ( crc >> 1 ) ^ ( 0xEDB88320 & ~( ( crc & 0x01 ) - 1 ) );
+        }
+    }
+    return ~crc;
+}
+
+static void BenchCheck( uint8_t *data )
+{
+    if( Crc32( ( uint8_t* )"123456789", 9 ) != 0xCBF43926 )
+    {
+        printf( "FAIL check value\n" );
+        Errors++;
+    }
+    for( uint16_t offset = 0; offset < 8; offset++ )
+    {
+        for( uint16_t length = 0; length <= 600; length++ )
+        {
+            uint32_t expected = Crc32Reference( &data[offset], length );
+            uint16_t split = length / 3;
+            uint32_t crc;
+
+            if( Crc32( &data[offset], length ) != expected )
+            {
+                printf( "FAIL crc32 offset %u length %u\n", offset, length );
+                Errors++;
+            }
+            crc = Crc32Init( );
+            crc = Crc32Update( crc, &data[offset], split );
+            crc = Crc32Update( crc, &data[offset + split], length - split );
+            if( Crc32Finalize( crc ) != expected )
+            {
+                printf( "FAIL crc32 update offset %u length %u\n", offset, length );
+                Errors++;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Prints the throughput of a run on bytes bytes
+ */
+static void BenchReport( const char *name, double ns, uint64_t cycles, double bytes )
+{
+#if defined( BENCH_HAVE_TSC )
+    printf( "%-28s %8.2f %8.3f\n", name, ns / bytes, bytes / ( double )cycles );
+#else
+    printf( "%-28s %8.2f %8s\n", name, ns / bytes, "-" );
+#endif
+}
+
+/*!
+ * \brief Measures a CRC function on a buffer
+ */
+static void BenchRun( const char *name, uint32_t ( *crc32 )( const uint8_t*, uint16_t ), const uint8_t *data,
+                      uint16_t length, int rounds )
+{
+    volatile uint32_t sink = 0;
+    double start = WallNs( );
+    uint64_t cycles = Cycles( );
+
+    for( int r = 0; r < rounds; r++ )
+    {
+        sink += crc32( data, length );
+    }
+    BenchReport( name, WallNs( ) - start, Cycles( ) - cycles, ( double )length * rounds );
+    ( void )sink;
+}
+
+static uint32_t Crc32Table( const uint8_t *buffer, uint16_t length )
+{
+    return Crc32( ( uint8_t* )buffer, length );
+}
+
+/*!
+ * \brief Hashes the NVM groups selected by flags, as LoRaMacHandleNvm does
+ */
+static uint32_t BenchNvmGroups( LoRaMacNvmData_t *nvm, uint16_t flags )
+{
+    uint32_t crc = 0;
+
+#define BENCH_NVM_GROUP( flag, group ) \
+    if( ( flags & flag ) != 0 ) \
+    { \
+        crc ^= Crc32( ( uint8_t* )&nvm->group, sizeof( nvm->group ) - sizeof( nvm->group.Crc32 ) ); \
+    }
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO, Crypto )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1, MacGroup1 )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2, MacGroup2 )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT, SecureElement )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1, RegionGroup1 )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2, RegionGroup2 )
+    BENCH_NVM_GROUP( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B, ClassB )
+#undef BENCH_NVM_GROUP
+    return crc;
+}
+
+static void BenchNvm( const char *name, LoRaMacNvmData_t *nvm, uint16_t flags, int rounds )
+{
+    volatile uint32_t sink = 0;
+    double start = WallNs( );
+    uint64_t cycles = Cycles( );
+
+    for( int r = 0; r < rounds; r++ )
+    {
+        sink += BenchNvmGroups( nvm, flags );
+    }
+    printf( "%-28s %8.0f %8.0f\n", name, ( WallNs( ) - start ) / rounds, ( double )( Cycles( ) - cycles ) / rounds );
+    ( void )sink;
+}
+
+int main( int argc, char **argv )
+{
+    static const uint16_t sizes[] = { 16, 64, 256, 1024, 4096 };
+    static uint8_t data[4096 + 8];
+    static LoRaMacNvmData_t nvm;
+    int rounds = ( argc > 1 ) ? atoi( argv[1] ) : 2000;
+
+    for( size_t i = 0; i < sizeof( data ); i++ )
+    {
+        data[i] = ( uint8_t )( i * 13 + 7 );
+    }
+    memcpy( &nvm, data, sizeof( nvm ) < sizeof( data ) ? sizeof( nvm ) : sizeof( data ) );
+
+    BenchCheck( data );
+
+#if ( CRC32_ROM == 1 )
+    printf( "crc32: ROM\n" );
+#else
+    printf( "crc32: slice by %d\n", CRC32_SLICES );
+#endif
+    printf( "%-28s %8s %8s\n", "", "ns/B", "B/cyc" );
+    for( size_t s = 0; s < sizeof( sizes ) / sizeof( sizes[0] ); s++ )
+    {
+        char name[32];
+
+        snprintf( name, sizeof( name ), "bit wise %u B", sizes[s] );
+        BenchRun( name, Crc32Reference, data, sizes[s], rounds );
+        snprintf( name, sizeof( name ), "table %u B", sizes[s] );
+        BenchRun( name, Crc32Table, &data[1], sizes[s], rounds * 8 );
+    }
+
+    printf( "\nnvm groups, %u B                 ns      cyc\n", ( unsigned )sizeof( nvm ) );
+    BenchNvm( "all groups", &nvm, 0x7F, rounds * 8 );
+    BenchNvm( "tx/rx groups",  &nvm,
+              LORAMAC_NVM_NOTIFY_FLAG_CRYPTO | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 |
+              LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2, rounds * 8 );
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/*!
+ * \file      eirp-bench.c
+ *
+ * \brief     TX power / EIRP mapping check of LmHandler against the EU868 and
+ *            US915 tables the node shipped with.
+ *
+ * \remark    For every EIRP of the tables, LmHandlerInit must select the TX
+ *            power of the table, and LmHandlerGetTxEirp must report the EIRP
+ *            of the table for it. An EIRP out of the table falls back to
+ *            TX_POWER_0. The US915 TX powers above 22 dBm report 22 dBm.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "mac/LoRaMac.h"
+#include "mac/region/Region.h"
+#include "apps/LoRaMac/common/LmHandler/LmHandler.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+typedef struct BenchEirp_s
+{
+    uint8_t TxPower;
+    uint8_t Eirp;
+}BenchEirp_t;
+
+/*!
+ * Tables of the node before the TX power mapping followed the region
+ */
+static const BenchEirp_t TxpowerEirpEU868[] =
+{
+    { TX_POWER_0, 16 }, { TX_POWER_1, 14 }, { TX_POWER_2, 12 }, { TX_POWER_3, 10 },
+    { TX_POWER_4, 8 }, { TX_POWER_5, 6 }, { TX_POWER_6, 4 }, { TX_POWER_7, 2 },
+};
+
+static const BenchEirp_t TxpowerEirpUS915[] =
+{
+    { TX_POWER_4, 22 }, { TX_POWER_5, 20 }, { TX_POWER_6, 18 }, { TX_POWER_7, 16 },
+    { TX_POWER_8, 14 }, { TX_POWER_9, 12 }, { TX_POWER_10, 10 }, { TX_POWER_11, 8 },
+    { TX_POWER_12, 6 }, { TX_POWER_13, 4 }, { TX_POWER_14, 2 },
+};
+
+/*!
+ * EIRPs out of both tables
+ */
+static const uint8_t InvalidEirps[] = { 0, 1, 3, 15, 17, 23, 24, 30 };
+
+static uint8_t DevEui[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x03 };
+static uint8_t JoinEui[8] = { 0 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppDataBuffer[242];
+
+static LmHandlerParams_t HandlerParams =
+{
+    .Region = LORAMAC_REGION_EU868,
+    .AdrEnable = false,
+    .TxDatarate = DR_3,
+    .PublicNetworkEnable = true,
+    .DutyCycleEnabled = false,
+    .DataBufferMaxSize = sizeof( AppDataBuffer ),
+    .DataBuffer = AppDataBuffer,
+    .TxEirp = 16,
+    .joinType = ACTIVATION_TYPE_OTAA,
+    .DevEui = DevEui,
+    .JoinEui = JoinEui,
+    .AppKey = AppKey,
+    .NbTrials = 1,
+    .Class = CLASS_A,
+};
+
+static uint32_t Errors;
+
+static void OnNetworkParametersChange( CommissioningParams_t *params )
+{
+}
+
+static LmHandlerCallbacks_t HandlerCallbacks =
+{
+    .GetBatteryLevel = BoardGetBatteryLevel,
+    .GetTemperature = NULL,
+    .GetRandomSeed = BoardGetRandomSeed,
+    .OnMacProcess = NULL,
+    .OnNvmDataChange = NULL,
+    .OnNetworkParametersChange = OnNetworkParametersChange,
+    .OnMacMcpsRequest = NULL,
+    .OnMacMlmeRequest = NULL,
+    .OnJoinRequest = NULL,
+    .OnTxData = NULL,
+    .OnRxData = NULL,
+    .OnClassChange = NULL,
+    .OnBeaconStatusChange = NULL,
+    .OnSysTimeUpdate = NULL,
+};
+
+static void BenchCheck( bool ok, const char *region, const char *what, int value )
+{
+    if( ok == false )
+    {
+        if( Errors < 20 )
+        {
+            printf( "%s: %s %d\n", region, what, value );
+        }
+        Errors++;
+    }
+}
+
+/*!
+ * \brief Initializes the node with the EIRP and returns the TX power selected
+ */
+static uint8_t BenchInit( LoRaMacRegion_t region, uint8_t eirp )
+{
+    MibRequestConfirm_t mibReq;
+
+    HandlerParams.Region = region;
+    HandlerParams.TxEirp = eirp;
+    if( LmHandlerInit( &HandlerCallbacks, &HandlerParams ) != LORAMAC_HANDLER_SUCCESS )
+    {
+        return 0xFF;
+    }
+    mibReq.Type = MIB_CHANNELS_TX_POWER;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    return ( uint8_t )mibReq.Param.ChannelsTxPower;
+}
+
+static void BenchRegion( LoRaMacRegion_t region, const char *name, const BenchEirp_t *table, uint8_t size )
+{
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        BenchCheck( BenchInit( region, table[i].Eirp ) == table[i].TxPower, name, "wrong TX power for EIRP",
+                    table[i].Eirp );
+        BenchCheck( LmHandlerGetTxEirp( table[i].TxPower ) == table[i].Eirp, name, "wrong EIRP for TX power",
+                    table[i].TxPower );
+    }
+    for( uint8_t i = 0; i < sizeof( InvalidEirps ); i++ )
+    {
+        bool inTable = false;
+
+        for( uint8_t j = 0; j < size; j++ )
+        {
+            inTable |= table[j].Eirp == InvalidEirps[i];
+        }
+        if( inTable == false )
+        {
+            BenchCheck( BenchInit( region, InvalidEirps[i] ) == TX_POWER_0, name, "no fallback for EIRP",
+                        InvalidEirps[i] );
+        }
+    }
+    // The TX powers above the table report its highest EIRP
+    for( uint8_t txPower = TX_POWER_0; txPower < table[0].TxPower; txPower++ )
+    {
+        BenchCheck( LmHandlerGetTxEirp( txPower ) == table[0].Eirp, name, "wrong EIRP for TX power", txPower );
+    }
+}
+
+int main( void )
+{
+    HostClockReset( );
+    Sx126xSimReset( );
+
+    BenchRegion( LORAMAC_REGION_EU868, "eu868", TxpowerEirpEU868,
+                 sizeof( TxpowerEirpEU868 ) / sizeof( TxpowerEirpEU868[0] ) );
+    BenchRegion( LORAMAC_REGION_US915, "us915", TxpowerEirpUS915,
+                 sizeof( TxpowerEirpUS915 ) / sizeof( TxpowerEirpUS915[0] ) );
+
+    printf( "%u EU868 and %u US915 TX powers checked\n",
+            ( unsigned )( sizeof( TxpowerEirpEU868 ) / sizeof( TxpowerEirpEU868[0] ) ),
+            ( unsigned )( sizeof( TxpowerEirpUS915 ) / sizeof( TxpowerEirpUS915[0] ) ) );
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+/*!
+ * \file      esp_aes.h
+ *
+ * \brief     Host stand-in of the ESP-IDF AES accelerator driver, on top of
+ *            the software AES. Lets aes-bench run the ESP32 crypto backend
+ *            ( src/boards/mcu/espressif/crypto_board.c ) on the host.
+ *
+ * \remark    Only encryption is supported. Accelerator failures are injected
+ *            with EspAesHostFailAt.
+ */
+#ifndef __ESP_AES_H__
+#define __ESP_AES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "system/crypto/aes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ESP_AES_ENCRYPT                             1
+#define ESP_AES_DECRYPT                             0
+
+typedef struct
+{
+    aes_context Aes;
+}esp_aes_context;
+
+/*!
+ * Number of accelerator operations that succeed before one fails, 0 disables
+ */
+extern uint32_t EspAesHostFailAt;
+
+void esp_aes_init( esp_aes_context *ctx );
+void esp_aes_free( esp_aes_context *ctx );
+int esp_aes_setkey( esp_aes_context *ctx, const unsigned char *key, unsigned int keybits );
+int esp_aes_crypt_ecb( esp_aes_context *ctx, int mode, const unsigned char input[16], unsigned char output[16] );
+int esp_aes_crypt_cbc( esp_aes_context *ctx, int mode, size_t length, unsigned char iv[16],
+                       const unsigned char *input, unsigned char *output );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __ESP_AES_H__
@@ -0,0 +1,75 @@
+/*!
+ * \file      esp-aes-host.c
+ *
+ * \brief     Host stand-in of the ESP-IDF AES accelerator driver
+ */
+#include <string.h>
+#include "aes/esp_aes.h"
+
+#define ESP_AES_HOST_ERR                            ( -0x0021 )
+
+uint32_t EspAesHostFailAt = 0;
+
+/*!
+ * \brief Counts an accelerator operation
+ *
+ * \retval failed true if the operation is the injected failure
+ */
+static int EspAesHostFail( void )
+{
+    if( EspAesHostFailAt != 0 )
+    {
+        EspAesHostFailAt--;
+        return ( EspAesHostFailAt == 0 ) ? 1 : 0;
+    }
+    return 0;
+}
+
+void esp_aes_init( esp_aes_context *ctx )
+{
+    memset( ctx, 0, sizeof( *ctx ) );
+}
+
+void esp_aes_free( esp_aes_context *ctx )
+{
+    memset( ctx, 0, sizeof( *ctx ) );
+}
+
+int esp_aes_setkey( esp_aes_context *ctx, const unsigned char *key, unsigned int keybits )
+{
+    if( ( EspAesHostFail( ) != 0 ) ||
+        ( aes_set_key( key, ( length_type )( keybits / 8 ), &ctx->Aes ) != 0 ) )
+    {
+        return ESP_AES_HOST_ERR;
+    }
+    return 0;
+}
+
+int esp_aes_crypt_ecb( esp_aes_context *ctx, int mode, const unsigned char input[16], unsigned char output[16] )
+{
+    if( ( mode != ESP_AES_ENCRYPT ) || ( EspAesHostFail( ) != 0 ) )
+    {
+        return ESP_AES_HOST_ERR;
+    }
+    lora_aes_encrypt( input, output, &ctx->Aes );
+    return 0;
+}
+
+int esp_aes_crypt_cbc( esp_aes_context *ctx, int mode, size_t length, unsigned char iv[16],
+                       const unsigned char *input, unsigned char *output )
+{
+    if( ( mode != ESP_AES_ENCRYPT ) || ( ( length % 16 ) != 0 ) || ( EspAesHostFail( ) != 0 ) )
+    {
+        return ESP_AES_HOST_ERR;
+    }
+    for( size_t i = 0; i < length; i += 16 )
+    {
+        for( uint8_t j = 0; j < 16; j++ )
+        {
+            iv[j] ^= input[i + j];
+        }
+        lora_aes_encrypt( iv, iv, &ctx->Aes );
+        memcpy( &output[i], iv, 16 );
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*!
+ * \file      imgcal-bench.c
+ *
+ * \brief     Image calibration benchmark of SX126xSetRfFrequency on the
+ *            simulated radio.
+ *
+ * \remark    A receiver hops between frequencies of the five image
+ *            calibration bands, staying a few hops on each band as a
+ *            DFRobot_LoRaRadio application sending on several bands would,
+ *            and goes to warm start sleep, and now and then to cold start
+ *            sleep, between hops. The driver must calibrate the image exactly
+ *            when the frequency leaves the calibrated band or after a cold
+ *            start, and never receive out of the calibrated band. Reports the
+ *            calibrations, the time spent calibrating and the receptions out
+ *            of the calibrated band of the former single calibration, of a
+ *            calibration on every frequency change and of the calibration per
+ *            band.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "boards/sx126x-board.h"
+#include "radio/radio.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+/*!
+ * Hops on a band before moving to another one, at most
+ */
+#define BENCH_DWELL_MAX                             8
+
+/*!
+ * One hop out of BENCH_COLD_PERIOD is preceded by a cold start sleep, the
+ * others by a warm start sleep
+ */
+#define BENCH_COLD_PERIOD                           64
+
+static const struct
+{
+    uint32_t Frequency;
+    RadioImageCalBands_t Band;
+}BenchChannels[] =
+{
+    { 433175000, IMAGE_CAL_BAND_430_440 },
+    { 434665000, IMAGE_CAL_BAND_430_440 },
+    { 470300000, IMAGE_CAL_BAND_470_510 },
+    { 505300000, IMAGE_CAL_BAND_470_510 },
+    { 779500000, IMAGE_CAL_BAND_779_787 },
+    { 786500000, IMAGE_CAL_BAND_779_787 },
+    { 868100000, IMAGE_CAL_BAND_863_870 },
+    { 869525000, IMAGE_CAL_BAND_863_870 },
+    { 902300000, IMAGE_CAL_BAND_902_928 },
+    { 923300000, IMAGE_CAL_BAND_902_928 },
+};
+
+#define BENCH_CHANNELS                              ( sizeof( BenchChannels ) / sizeof( BenchChannels[0] ) )
+
+static uint32_t Errors;
+
+static RadioEvents_t RadioEvents;
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void BenchCheck( bool ok, const char *what, uint32_t hop )
+{
+    if( ok == false )
+    {
+        if( Errors < 10 )
+        {
+            printf( "hop %u: %s\n", hop, what );
+        }
+        Errors++;
+    }
+}
+
+static void BenchPrint( const char *name, uint32_t calibrations, double calUs, uint32_t uncalibrated )
+{
+    printf( "%-10s %12u %10.1f %14u\n", name, calibrations, calibrations * calUs / 1e3, uncalibrated );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t hops = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 10000;
+    uint32_t seed = 0x1D5EED;
+    uint32_t channel = 0;
+    uint32_t dwell = 0;
+    RadioImageCalBands_t calibrated = IMAGE_CAL_BAND_NONE;
+    RadioImageCalBands_t first = IMAGE_CAL_BAND_NONE;
+    uint32_t bandChanges = 0;
+    uint32_t onceCalibrations = 0;
+    uint32_t onceUncalibrated = 0;
+    SX126xImageCalStats_t stats;
+    SleepParams_t cold = { 0 };
+    double calUs;
+
+    HostClockReset( );
+    Sx126xSimReset( );
+    Radio.Init( &RadioEvents );
+    Radio.SetRxConfig( MODEM_LORA, 0, 7, 1, 0, 8, 0, false, 0, true, 0, 0, true, false );
+    SX126xResetImageCalStats( );
+
+    for( uint32_t hop = 0; hop < hops; hop++ )
+    {
+        uint32_t uncalibrated = Sx126xSimGetStats( )->Uncalibrated;
+        uint32_t calibrations;
+        RadioImageCalBands_t band;
+
+        if( dwell == 0 )
+        {
+            channel = BenchRand( &seed ) % BENCH_CHANNELS;
+            dwell = 1 + BenchRand( &seed ) % BENCH_DWELL_MAX;
+        }
+        dwell--;
+        band = BenchChannels[channel].Band;
+
+        if( ( hop % BENCH_COLD_PERIOD ) == ( BENCH_COLD_PERIOD - 1 ) )
+        {
+            SX126xSetSleep( cold );
+            calibrated = IMAGE_CAL_BAND_NONE;
+            first = IMAGE_CAL_BAND_NONE;
+        }
+        else
+        {
+            Radio.Sleep( );
+        }
+
+        // Former driver: one calibration after each reset or cold start
+        if( first == IMAGE_CAL_BAND_NONE )
+        {
+            first = band;
+            onceCalibrations++;
+        }
+        if( band != first )
+        {
+            onceUncalibrated++;
+        }
+
+        SX126xGetImageCalStats( &stats );
+        calibrations = stats.Calibrations;
+        Radio.SetChannel( BenchChannels[channel].Frequency );
+        Radio.Rx( 0 );
+        Radio.Standby( );
+
+        SX126xGetImageCalStats( &stats );
+        BenchCheck( stats.Calibrations == ( calibrations + ( ( band != calibrated ) ? 1 : 0 ) ),
+                    "calibration not run on a band change or run within the band", hop );
+        BenchCheck( stats.Band == band, "wrong calibrated band", hop );
+        BenchCheck( Sx126xSimGetStats( )->Uncalibrated == uncalibrated, "received out of the calibrated band", hop );
+        if( band != calibrated )
+        {
+            bandChanges++;
+            calibrated = band;
+        }
+    }
+
+    SX126xGetImageCalStats( &stats );
+    BenchCheck( stats.Calibrations == bandChanges, "calibrations count", hops );
+    BenchCheck( stats.Skipped == ( hops - bandChanges ), "skipped calibrations count", hops );
+    BenchCheck( Sx126xSimGetStats( )->Uncalibrated == 0, "receptions out of the calibrated band", hops );
+    calUs = ( stats.Calibrations != 0 ) ? ( double )stats.TotalUs / stats.Calibrations : 0.0;
+
+    printf( "%u hops on %u channels of 5 bands, up to %u hops per band, cold start every %u hops\n",
+            hops, ( uint32_t )BENCH_CHANNELS, BENCH_DWELL_MAX, BENCH_COLD_PERIOD );
+    printf( "calibration %.1f us avg, %u us max\n", calUs, stats.MaxUs );
+    printf( "%-10s %12s %10s %14s\n", "", "calibrations", "time ms", "uncalibrated rx" );
+    BenchPrint( "once", onceCalibrations, calUs, onceUncalibrated );
+    BenchPrint( "every hop", hops, calUs, 0 );
+    BenchPrint( "per band", stats.Calibrations, calUs, Sx126xSimGetStats( )->Uncalibrated );
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*!
+ * \file      lpp-bench.cpp
+ *
+ * \brief     Compact telemetry encoder benchmark ( CayenneLppDelta.h ).
+ *
+ * \remark    Encodes random walk sensor traces of two schemas, a weather
+ *            station and a tracker, with frames and acknowledgements lost at
+ *            random. Checks that the full frames are the ones CayenneLpp.c
+ *            writes and that a receiver keeping the readings of its frames
+ *            by uplink counter decodes every received frame exactly, then
+ *            reports the bytes per record, the encode time and the DR0
+ *            (SF12) airtime of CayenneLPP and of the delta frames.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+extern "C"
+{
+#include <Arduino.h>
+#include "radio/radio.h"
+#include "apps/LoRaMac/common/CayenneLpp.h"
+}
+#include "apps/LoRaMac/common/CayenneLppDelta.h"
+
+/*!
+ * MHDR, FHDR without FOpts, FPort and MIC
+ */
+#define BENCH_FRAME_OVERHEAD                        13
+
+typedef CayenneLppSchema<
+    CayenneLppField<1, LPP_TEMPERATURE>,
+    CayenneLppField<2, LPP_RELATIVE_HUMIDITY>,
+    CayenneLppField<3, LPP_BAROMETRIC_PRESSURE>,
+    CayenneLppField<4, LPP_LUMINOSITY>,
+    CayenneLppField<5, LPP_ANALOG_INPUT> > WeatherSchema;
+
+typedef CayenneLppSchema<
+    CayenneLppField<1, LPP_GPS>,
+    CayenneLppField<2, LPP_ACCELEROMETER>,
+    CayenneLppField<3, LPP_DIGITAL_INPUT> > TrackerSchema;
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/*!
+ * \brief Float argument of CayenneLpp.c giving back an integer reading after
+ *        its scaling and truncation
+ */
+static float Unscale( int32_t value, float scale )
+{
+    return ( ( float )value + ( ( value < 0 ) ? -0.5f : 0.5f ) ) / scale;
+}
+
+static uint8_t WeatherLpp( const int32_t *r )
+{
+    CayenneLppReset( );
+    CayenneLppAddTemperature( 1, Unscale( r[0], 10 ) );
+    CayenneLppAddRelativeHumidity( 2, Unscale( r[1], 2 ) );
+    CayenneLppAddBarometricPressure( 3, Unscale( r[2], 10 ) );
+    CayenneLppAddLuminosity( 4, ( uint16_t )r[3] );
+    return CayenneLppAddAnalogInput( 5, Unscale( r[4], 100 ) );
+}
+
+static void WeatherStep( int32_t *r, uint32_t *rand, bool init )
+{
+    if( init == true )
+    {
+        r[0] = 215;     // 21.5 °C
+        r[1] = 90;      // 45 %
+        r[2] = 10132;   // 1013.2 hPa
+        r[3] = 300;     // lux
+        r[4] = 330;     // 3.30 V
+        return;
+    }
+    r[0] += ( int32_t )( BenchRand( rand ) % 5 ) - 2;
+    r[1] += ( int32_t )( BenchRand( rand ) % 3 ) - 1;
+    r[1] = ( r[1] < 0 ) ? 0 : ( ( r[1] > 200 ) ? 200 : r[1] );
+    r[2] += ( int32_t )( BenchRand( rand ) % 3 ) - 1;
+    r[3] += ( int32_t )( BenchRand( rand ) % 41 ) - 20;
+    r[3] = ( r[3] < 0 ) ? 0 : r[3];
+    r[4] -= ( BenchRand( rand ) % 16 ) == 0;
+}
+
+static uint8_t TrackerLpp( const int32_t *r )
+{
+    CayenneLppReset( );
+    CayenneLppAddGps( 1, Unscale( r[0], 10000 ), Unscale( r[1], 10000 ), Unscale( r[2], 100 ) );
+    CayenneLppAddAccelerometer( 2, Unscale( r[3], 1000 ), Unscale( r[4], 1000 ), Unscale( r[5], 1000 ) );
+    return CayenneLppAddDigitalInput( 3, ( uint8_t )r[6] );
+}
+
+static void TrackerStep( int32_t *r, uint32_t *rand, bool init )
+{
+    if( init == true )
+    {
+        r[0] = 312304;  // 31.2304 °
+        r[1] = 1214737; // 121.4737 °
+        r[2] = 450;     // 4.5 m
+        r[3] = 0;
+        r[4] = 0;
+        r[5] = 1000;    // 1 G
+        r[6] = 0;
+        return;
+    }
+    r[0] += ( int32_t )( BenchRand( rand ) % 21 ) - 10;
+    r[1] += ( int32_t )( BenchRand( rand ) % 21 ) - 10;
+    r[2] += ( int32_t )( BenchRand( rand ) % 11 ) - 5;
+    r[3] = ( int32_t )( BenchRand( rand ) % 61 ) - 30;
+    r[4] = ( int32_t )( BenchRand( rand ) % 61 ) - 30;
+    r[5] = 1000 + ( int32_t )( BenchRand( rand ) % 61 ) - 30;
+    r[6] ^= ( BenchRand( rand ) % 32 ) == 0;
+}
+
+/*!
+ * \brief Runs a trace through the encoder and a receiver
+ *
+ * \param [IN] lossPercent Frames lost and acknowledgements lost, each one
+ */
+template<typename Schema>
+static void BenchSchema( const char *name, uint8_t ( *lpp )( const int32_t* ),
+                         void ( *step )( int32_t*, uint32_t*, bool ), uint32_t records, uint32_t lossPercent )
+{
+    typedef CayenneLppDelta<Schema> Encoder;
+    Encoder encoder;
+    static int32_t received[256][Encoder::Readings];
+    static bool receivedValid[256];
+    int32_t readings[Encoder::Readings];
+    int32_t clamped[Encoder::Readings];
+    int32_t decoded[Encoder::Readings];
+    uint8_t frame[Encoder::MaxSize];
+    uint32_t rand = 0xC0FFEE ^ lossPercent;
+    uint32_t lppBytes = 0;
+    uint32_t deltaBytes = 0;
+    uint32_t fullFrames = 0;
+    uint32_t lppAir = 0;
+    uint32_t deltaAir = 0;
+    double lppNs;
+    double deltaNs;
+    double start;
+
+    memset( receivedValid, 0, sizeof( receivedValid ) );
+    step( readings, &rand, true );
+    for( uint32_t fcnt = 0; fcnt < records; fcnt++ )
+    {
+        uint8_t size = encoder.Encode( readings, frame, sizeof( frame ) );
+        uint8_t lppSize = lpp( readings );
+        bool lost = ( BenchRand( &rand ) % 100 ) < lossPercent;
+
+        Schema::Clamp( readings, clamped );
+        if( encoder.IsDelta( ) == false )
+        {
+            fullFrames++;
+            if( ( size != lppSize ) || ( memcmp( frame, CayenneLppGetBuffer( ), size ) != 0 ) )
+            {
+                printf( "FAIL %s record %u: full frame differs from CayenneLpp.c\n", name, fcnt );
+                Errors++;
+            }
+        }
+        lppBytes += lppSize;
+        deltaBytes += size;
+        lppAir += Radio.TimeOnAir( MODEM_LORA, 0, 12, 1, 8, false, BENCH_FRAME_OVERHEAD + lppSize, true );
+        deltaAir += Radio.TimeOnAir( MODEM_LORA, 0, 12, 1, 8, false, BENCH_FRAME_OVERHEAD + size, true );
+
+        if( lost == false )
+        {
+            bool ok;
+
+            if( encoder.IsDelta( ) == false )
+            {
+                ok = Encoder::DecodeFull( frame, size, decoded );
+            }
+            else
+            {
+                uint8_t reference = Encoder::ReferenceOf( frame );
+
+                ok = ( receivedValid[reference] == true ) &&
+                     ( Encoder::DecodeDelta( frame, size, received[reference], decoded ) == true );
+            }
+            if( ( ok == false ) || ( memcmp( decoded, clamped, sizeof( clamped ) ) != 0 ) )
+            {
+                printf( "FAIL %s record %u: %s frame decoded wrong\n", name, fcnt,
+                        ( encoder.IsDelta( ) == true ) ? "delta" : "full" );
+                Errors++;
+            }
+            memcpy( received[fcnt & 0xFF], decoded, sizeof( decoded ) );
+            receivedValid[fcnt & 0xFF] = true;
+            if( ( BenchRand( &rand ) % 100 ) >= lossPercent )
+            {
+                encoder.Acknowledge( fcnt );
+            }
+        }
+        else
+        {
+            receivedValid[fcnt & 0xFF] = false;
+        }
+        step( readings, &rand, false );
+        if( ( fcnt % 1000 ) == 999 )
+        {
+            // Rejoin
+            encoder.Resync( );
+        }
+    }
+
+    // Encode time of the same readings, the receiver acknowledging every frame
+    step( readings, &rand, true );
+    start = WallNs( );
+    for( uint32_t i = 0; i < records; i++ )
+    {
+        lpp( readings );
+        readings[0] ^= i & 1;
+    }
+    lppNs = ( WallNs( ) - start ) / records;
+    start = WallNs( );
+    for( uint32_t i = 0; i < records; i++ )
+    {
+        encoder.Encode( readings, frame, sizeof( frame ) );
+        encoder.Acknowledge( i );
+        readings[0] ^= i & 1;
+    }
+    deltaNs = ( WallNs( ) - start ) / records;
+
+    printf( "%-8s %3u%% loss  lpp %5.2f B %6.1f ms %5.1f ns   delta %5.2f B %6.1f ms %5.1f ns  %4.1f%% full  airtime %5.1f%%\n",
+            name, lossPercent, ( double )lppBytes / records, ( double )lppAir / records, lppNs,
+            ( double )deltaBytes / records, ( double )deltaAir / records, deltaNs, 100.0 * fullFrames / records,
+            100.0 * deltaAir / lppAir );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t records = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 100000;
+
+    printf( "per record: payload bytes, SF12/125 kHz time on air, encode time\n" );
+    for( uint32_t loss = 0; loss <= 20; loss += 10 )
+    {
+        BenchSchema<WeatherSchema>( "weather", WeatherLpp, WeatherStep, records, loss );
+        BenchSchema<TrackerSchema>( "tracker", TrackerLpp, TrackerStep, records, loss );
+    }
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+/*!
+ * \file      nvm-bench.c
+ *
+ * \brief     NVM log benchmark and power cut test on the simulated flash.
+ *
+ * \remark    The workload updates the LoRaMac NVM groups as an uplink does
+ *            (frame counter, MAC group 1, band timing, with their CRC) and
+ *            commits one transaction per uplink.
+ *
+ *            The power cut test replays the workload from an erased flash and
+ *            cuts the power at every programmed byte and erased sector of the
+ *            first transactions, past the first block compaction. After each
+ *            cut the log is mounted again: the image must be the one of the
+ *            last commit, or of the transaction in progress if its commit
+ *            record made it. A few more transactions are then committed and
+ *            checked. The long run cuts the power at random points while the
+ *            ring wraps around several times.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "system/utilities.h"
+#include "system/nvmm.h"
+#include "mac/LoRaMac.h"
+#include "host-board.h"
+
+#define BENCH_FLASH_SIZE                            ( 8 * FLASH_MCU_SECTOR_SIZE )
+
+/*!
+ * Transactions of the power cut test
+ */
+#define BENCH_CUT_TRANSACTIONS                      64
+
+/*!
+ * Transactions committed after a power cut before checking the log again
+ */
+#define BENCH_CUT_RESUME                            3
+
+/*!
+ * Erase cycles of the ESP32 SPI flash
+ */
+#define BENCH_FLASH_ENDURANCE                       100000
+
+#define BENCH_IMAGE_SIZE                            sizeof( LoRaMacNvmData_t )
+
+typedef struct BenchGroup_s
+{
+    uint16_t Offset;
+    uint16_t Size;
+}BenchGroup_t;
+
+/*!
+ * Groups written by an uplink
+ */
+static const BenchGroup_t Groups[] =
+{
+    { offsetof( LoRaMacNvmData_t, Crypto ), sizeof( LoRaMacCryptoNvmData_t ) },
+    { offsetof( LoRaMacNvmData_t, MacGroup1 ), sizeof( LoRaMacNvmDataGroup1_t ) },
+    { offsetof( LoRaMacNvmData_t, RegionGroup1 ), sizeof( RegionNvmDataGroup1_t ) },
+};
+
+static uint8_t Live[BENCH_IMAGE_SIZE];
+static uint8_t Image[BENCH_IMAGE_SIZE];
+static uint8_t Committed[BENCH_IMAGE_SIZE];
+static uint8_t Pending[BENCH_IMAGE_SIZE];
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/*!
+ * \brief Applies the changes of an uplink to the live contexts
+ *
+ * \param [IN] txn Transaction number, the changes only depend on it
+ */
+static void BenchUplink( uint32_t txn )
+{
+    uint32_t rand = 0x9E3779B9 ^ ( txn * 2654435761u );
+
+    for( size_t g = 0; g < sizeof( Groups ) / sizeof( Groups[0] ); g++ )
+    {
+        uint8_t* group = &Live[Groups[g].Offset];
+        uint16_t dataSize = Groups[g].Size - sizeof( uint32_t );
+        uint32_t crc;
+
+        // A counter and a couple of fields
+        memcpy( group, &txn, sizeof( txn ) );
+        for( int i = 0; i < 2; i++ )
+        {
+            group[BenchRand( &rand ) % dataSize] = ( uint8_t )BenchRand( &rand );
+        }
+        crc = Crc32( group, dataSize );
+        memcpy( &group[dataSize], &crc, sizeof( crc ) );
+    }
+}
+
+/*!
+ * \brief Stores the live contexts as NvmDataMgmtStore does
+ *
+ * \retval status false if the commit failed
+ */
+static bool BenchStore( void )
+{
+    for( size_t g = 0; g < sizeof( Groups ) / sizeof( Groups[0] ); g++ )
+    {
+        NvmmWrite( &Live[Groups[g].Offset], Groups[g].Size, Groups[g].Offset );
+    }
+    return NvmmCommit( );
+}
+
+/*!
+ * \brief Mounts the log as after a reset
+ */
+static void BenchMount( void )
+{
+    if( NvmmInit( Image, sizeof( Image ) ) == false )
+    {
+        Errors++;
+    }
+}
+
+/*!
+ * \brief Runs the workload from an erased flash with a power cut
+ *
+ * \param [IN] cut Flash operations before the cut
+ * \retval cut false if the workload completed before the cut
+ */
+static bool BenchCutRun( uint32_t cut )
+{
+    uint32_t txn;
+
+    HostFlashOpen( NULL, BENCH_FLASH_SIZE );
+    memset( Live, 0, sizeof( Live ) );
+    BenchMount( );
+    memset( Committed, 0, sizeof( Committed ) );
+    HostFlashSetPowerCut( cut );
+
+    for( txn = 0; txn < BENCH_CUT_TRANSACTIONS; txn++ )
+    {
+        BenchUplink( txn );
+        memcpy( Pending, Live, sizeof( Pending ) );
+        BenchStore( );
+        if( HostFlashIsPoweredOff( ) == true )
+        {
+            break;
+        }
+        memcpy( Committed, Live, sizeof( Committed ) );
+    }
+    if( txn == BENCH_CUT_TRANSACTIONS )
+    {
+        HostFlashSetPowerCut( 0 );
+        return false;
+    }
+
+    HostFlashPowerOn( );
+    BenchMount( );
+    if( ( memcmp( Image, Committed, sizeof( Image ) ) != 0 ) && ( memcmp( Image, Pending, sizeof( Image ) ) != 0 ) )
+    {
+        printf( "cut %u in transaction %u: image is neither the committed nor the pending one\n", cut, txn );
+        Errors++;
+    }
+
+    // The device goes on from the restored contexts
+    memcpy( Live, Image, sizeof( Live ) );
+    for( uint32_t i = 1; i <= BENCH_CUT_RESUME; i++ )
+    {
+        BenchUplink( txn + i );
+        if( BenchStore( ) == false )
+        {
+            Errors++;
+        }
+    }
+    BenchMount( );
+    if( memcmp( Image, Live, sizeof( Image ) ) != 0 )
+    {
+        printf( "cut %u in transaction %u: log not usable after the cut\n", cut, txn );
+        Errors++;
+    }
+    return true;
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t txns = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 200000;
+    uint32_t rand = 0x12345678;
+    uint32_t cuts = 0;
+    uint32_t randomCuts = 0;
+    NvmmStats_t nvmm;
+    HostFlashStats_t flash;
+    double start;
+    double elapsed;
+
+    // Throughput and wear
+    HostFlashOpen( NULL, BENCH_FLASH_SIZE );
+    memset( Live, 0, sizeof( Live ) );
+    BenchMount( );
+    NvmmGetStats( &nvmm );
+    start = WallNs( );
+    for( uint32_t txn = 0; txn < txns; txn++ )
+    {
+        BenchUplink( txn );
+        if( BenchStore( ) == false )
+        {
+            Errors++;
+        }
+    }
+    elapsed = WallNs( ) - start;
+    {
+        NvmmStats_t end;
+
+        NvmmGetStats( &end );
+        nvmm.Commits = end.Commits - nvmm.Commits;
+        nvmm.Compactions = end.Compactions - nvmm.Compactions;
+        nvmm.DataBytes = end.DataBytes - nvmm.DataBytes;
+        nvmm.FlashBytes = end.FlashBytes - nvmm.FlashBytes;
+    }
+    HostFlashGetStats( &flash );
+    BenchMount( );
+    if( memcmp( Image, Live, sizeof( Image ) ) != 0 )
+    {
+        Errors++;
+    }
+
+    printf( "image               %u bytes, flash %u KiB, block %u KiB\n", ( unsigned )BENCH_IMAGE_SIZE,
+            BENCH_FLASH_SIZE / 1024, NVMM_BLOCK_SIZE / 1024 );
+    printf( "uplinks             %u commits, %.1f us/commit\n", nvmm.Commits, elapsed / 1000.0 / txns );
+    printf( "bytes/commit        %.1f changed, %.1f programmed (%u bytes rewriting the groups)\n",
+            ( double )nvmm.DataBytes / txns, ( double )nvmm.FlashBytes / txns,
+            ( unsigned )( sizeof( LoRaMacCryptoNvmData_t ) + sizeof( LoRaMacNvmDataGroup1_t ) +
+                          sizeof( RegionNvmDataGroup1_t ) ) );
+    printf( "compactions         %u, one per %.0f commits\n", nvmm.Compactions,
+            ( nvmm.Compactions != 0 ) ? ( double )txns / nvmm.Compactions : 0.0 );
+    printf( "sector erases       %u total, %u min, %u max\n", flash.Erases, flash.SectorErasesMin,
+            flash.SectorErasesMax );
+    if( flash.SectorErasesMax != 0 )
+    {
+        printf( "endurance           %.0f million uplinks at %u erase cycles\n",
+                ( double )txns * BENCH_FLASH_ENDURANCE / flash.SectorErasesMax / 1e6, BENCH_FLASH_ENDURANCE );
+    }
+    if( flash.Overwrites != 0 )
+    {
+        Errors++;
+    }
+
+    // Power cut at every flash operation of the first transactions
+    start = WallNs( );
+    for( uint32_t cut = 1; BenchCutRun( cut ) == true; cut++ )
+    {
+        cuts++;
+    }
+
+    // Power cuts at random points of a long run
+    HostFlashOpen( NULL, BENCH_FLASH_SIZE );
+    memset( Live, 0, sizeof( Live ) );
+    BenchMount( );
+    memset( Committed, 0, sizeof( Committed ) );
+    HostFlashSetPowerCut( 1 + BenchRand( &rand ) % 20000 );
+    for( uint32_t txn = 0; txn < ( txns / 4 ); txn++ )
+    {
+        BenchUplink( txn );
+        memcpy( Pending, Live, sizeof( Pending ) );
+        BenchStore( );
+        if( HostFlashIsPoweredOff( ) == false )
+        {
+            memcpy( Committed, Live, sizeof( Committed ) );
+            continue;
+        }
+        randomCuts++;
+        HostFlashPowerOn( );
+        BenchMount( );
+        if( ( memcmp( Image, Committed, sizeof( Image ) ) != 0 ) &&
+            ( memcmp( Image, Pending, sizeof( Image ) ) != 0 ) )
+        {
+            printf( "random cut in transaction %u: image is neither the committed nor the pending one\n", txn );
+            Errors++;
+        }
+        memcpy( Live, Image, sizeof( Live ) );
+        memcpy( Committed, Image, sizeof( Committed ) );
+        HostFlashSetPowerCut( 1 + BenchRand( &rand ) % 20000 );
+    }
+    HostFlashGetStats( &flash );
+    if( flash.Overwrites != 0 )
+    {
+        Errors++;
+    }
+    elapsed = WallNs( ) - start;
+    printf( "power cuts          %u at every operation of %u commits, %u at random points, %.1f s\n", cuts,
+            BENCH_CUT_TRANSACTIONS, randomCuts, elapsed / 1e9 );
+
+    HostFlashClose( );
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,425 @@
+/*!
+ * \file      resume-bench.c
+ *
+ * \brief     Session resume benchmark of LmHandlerResume against the cold
+ *            LmHandlerInit on the simulated radio.
+ *
+ * \remark    An ABP node wakes up from deep sleep, initializes the stack and
+ *            sends one unconfirmed uplink, then goes back to deep sleep. The
+ *            wake ups run the cold init of a node which lost its RTC memory,
+ *            the former init with the session kept in the RTC memory and the
+ *            resume of the session sealed by LmHandlerSuspend. Reports the
+ *            wall time of the init on the host, the simulated time of the init
+ *            and from the wake up to the start of the uplink, and the SPI
+ *            transactions of the init. The resumed sessions must carry on the
+ *            frame counter. A resume must be refused without a seal, and must
+ *            forget the session when a NVM group or the region differ. An
+ *            AS923 session must resume with the region bound to stale NVM
+ *            groups, as the region pointers lost in a deep sleep would be.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "boards/mcu/timer.h"
+#include "boards/sx126x-board.h"
+#include "mac/LoRaMac.h"
+#include "mac/region/Region.h"
+#include "apps/LoRaMac/common/LmHandler/LmHandler.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+/*!
+ * Deep sleep between two uplinks [us]
+ */
+#define BENCH_SLEEP_US                              ( 60ULL * 1000000ULL )
+
+/*!
+ * Upper bound of simulated time spent waiting for an uplink [us]
+ */
+#define BENCH_UPLINK_TIMEOUT_US                     ( 60ULL * 1000000ULL )
+
+#define BENCH_PAYLOAD_SIZE                          16
+
+typedef enum
+{
+    BENCH_COLD,
+    BENCH_RTC,
+    BENCH_RESUME,
+    BENCH_MODES,
+}BenchMode_t;
+
+static const char *BenchModeNames[BENCH_MODES] = { "cold", "rtc", "resume" };
+
+typedef struct
+{
+    uint32_t Inits;
+    double WallUs;
+    uint64_t InitUs;
+    uint64_t WakeToTxUs;
+    uint32_t Transactions;
+}BenchStats_t;
+
+extern SemaphoreHandle_t loraIntSem;
+
+static uint8_t DevEui[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x02 };
+static uint8_t JoinEui[8] = { 0 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                               0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10 };
+static uint8_t NwkSKey[16] = { 0x10, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09,
+                               0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 };
+static uint8_t AppDataBuffer[242];
+
+static LmHandlerParams_t HandlerParams =
+{
+    .Region = LORAMAC_REGION_EU868,
+    .AdrEnable = false,
+    .TxDatarate = DR_5,
+    .PublicNetworkEnable = true,
+    .DutyCycleEnabled = false,
+    .DataBufferMaxSize = sizeof( AppDataBuffer ),
+    .DataBuffer = AppDataBuffer,
+    .TxEirp = 16,
+    .joinType = ACTIVATION_TYPE_ABP,
+    .DevEui = DevEui,
+    .JoinEui = JoinEui,
+    .AppKey = AppKey,
+    .DevAddr = 0x26011BDB,
+    .AppSKey = AppSKey,
+    .NwkSKey = NwkSKey,
+    .NbTrials = 1,
+    .Class = CLASS_A,
+};
+
+static uint32_t Errors;
+static bool TxDone;
+static uint64_t TxStartUs;
+
+static void OnMacProcess( void )
+{
+    xSemaphoreGiveFromISR( loraIntSem, NULL );
+}
+
+static void OnNetworkParametersChange( CommissioningParams_t *params )
+{
+}
+
+static void OnTxData( LmHandlerTxParams_t *params )
+{
+    if( params->IsMcpsConfirm != 0 )
+    {
+        TxDone = true;
+    }
+}
+
+static LmHandlerCallbacks_t HandlerCallbacks =
+{
+    .GetBatteryLevel = BoardGetBatteryLevel,
+    .GetTemperature = NULL,
+    .GetRandomSeed = BoardGetRandomSeed,
+    .OnMacProcess = OnMacProcess,
+    .OnNvmDataChange = NULL,
+    .OnNetworkParametersChange = OnNetworkParametersChange,
+    .OnMacMcpsRequest = NULL,
+    .OnMacMlmeRequest = NULL,
+    .OnJoinRequest = NULL,
+    .OnTxData = OnTxData,
+    .OnRxData = NULL,
+    .OnClassChange = NULL,
+    .OnBeaconStatusChange = NULL,
+    .OnSysTimeUpdate = NULL,
+};
+
+static void BenchTxHook( const Sx126xSimFrame_t *frame )
+{
+    TxStartUs = frame->StartUs;
+}
+
+static void BenchCheck( bool ok, const char *what, uint32_t cycle )
+{
+    if( ok == false )
+    {
+        if( Errors < 10 )
+        {
+            printf( "cycle %u: %s\n", cycle, what );
+        }
+        Errors++;
+    }
+}
+
+static double BenchWallUs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e6 + ( double )ts.tv_nsec * 1e-3;
+}
+
+static ActivationType_t BenchActivation( void )
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    return mibReq.Param.NetworkActivation;
+}
+
+static void BenchSetActivation( ActivationType_t activation )
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    mibReq.Param.NetworkActivation = activation;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+}
+
+/*!
+ * \brief Cold init, as LoRaWAN_Node::init does for an ABP node
+ */
+static bool BenchInit( void )
+{
+    if( LmHandlerInit( &HandlerCallbacks, &HandlerParams ) != LORAMAC_HANDLER_SUCCESS )
+    {
+        return false;
+    }
+    BenchSetActivation( ACTIVATION_TYPE_ABP );
+    return true;
+}
+
+/*!
+ * \brief Runs the MAC on the simulated clock until the uplink completes
+ */
+static bool BenchUplink( void )
+{
+    uint64_t limit = HostClockGetUs( ) + BENCH_UPLINK_TIMEOUT_US;
+    McpsReq_t mcpsReq;
+
+    memset( AppDataBuffer, 0xA5, BENCH_PAYLOAD_SIZE );
+    mcpsReq.Type = MCPS_UNCONFIRMED;
+    mcpsReq.Req.Unconfirmed.fPort = 2;
+    mcpsReq.Req.Unconfirmed.fBuffer = AppDataBuffer;
+    mcpsReq.Req.Unconfirmed.fBufferSize = BENCH_PAYLOAD_SIZE;
+    mcpsReq.Req.Unconfirmed.Datarate = HandlerParams.TxDatarate;
+    TxDone = false;
+    if( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK )
+    {
+        return false;
+    }
+    for( ;; )
+    {
+        uint64_t next = UINT64_MAX;
+        uint64_t t;
+
+        while( HostLoRaSemTake( ) == true )
+        {
+            TimerProcess( );
+            LmHandlerProcess( );
+        }
+        if( ( TxDone == true ) && ( LoRaMacIsBusy( ) == false ) )
+        {
+            return true;
+        }
+        if( HostRtcGetAlarm( &t ) == true )
+        {
+            next = t;
+        }
+        if( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t < next ) )
+        {
+            next = t;
+        }
+        if( ( next == UINT64_MAX ) || ( next > limit ) )
+        {
+            return false;
+        }
+        HostClockAdvanceTo( next );
+        Sx126xSimProcess( );
+        HostRtcAlarmProcess( );
+    }
+}
+
+/*!
+ * \brief Deep sleep of the node, the radio in warm start sleep
+ *
+ * \param [IN] next Mode of the next wake up, a resume needs a sealed session
+ */
+static void BenchSleep( BenchMode_t next )
+{
+    Radio.Sleep( );
+    if( next == BENCH_RESUME )
+    {
+        LmHandlerSuspend( );
+    }
+    HostClockAdvanceUs( BENCH_SLEEP_US );
+}
+
+/*!
+ * \brief Wakes the node up, initializes the stack and sends one uplink
+ */
+static void BenchCycle( BenchMode_t mode, BenchMode_t next, BenchStats_t *stats, uint32_t cycle )
+{
+    uint32_t transactions = Sx126xSimGetStats( )->Transactions;
+    uint32_t fCntUp = GetUplinkCounter( );
+    uint64_t wakeUs = HostClockGetUs( );
+    double wallUs = BenchWallUs( );
+    bool ok;
+
+    if( mode == BENCH_COLD )
+    {
+        // Power on: the RTC memory lost the session and the radio its
+        // configuration
+        BenchSetActivation( ACTIVATION_TYPE_NONE );
+        SX126xShadowInvalidate( );
+        ok = BenchInit( );
+    }
+    else if( mode == BENCH_RTC )
+    {
+        ok = BenchInit( );
+    }
+    else
+    {
+        ok = LmHandlerResume( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_SUCCESS;
+    }
+    stats->WallUs += BenchWallUs( ) - wallUs;
+    stats->InitUs += HostClockGetUs( ) - wakeUs;
+    stats->Transactions += Sx126xSimGetStats( )->Transactions - transactions;
+    stats->Inits++;
+    BenchCheck( ok, "init failed", cycle );
+
+    TxStartUs = 0;
+    BenchCheck( BenchUplink( ) == true, "uplink failed", cycle );
+    BenchCheck( TxStartUs > wakeUs, "no uplink sent", cycle );
+    stats->WakeToTxUs += TxStartUs - wakeUs;
+    if( mode != BENCH_COLD )
+    {
+        BenchCheck( GetUplinkCounter( ) == ( fCntUp + 1 ), "frame counter not carried on", cycle );
+    }
+    BenchSleep( next );
+}
+
+/*!
+ * \brief Corrupts the session kept in the RTC memory and checks the resume
+ *        refuses it
+ */
+static void BenchCorruption( uint32_t cycle )
+{
+    MibRequestConfirm_t mibReq;
+    LmHandlerParams_t otherRegion = HandlerParams;
+
+    // Not sealed: refused, the session is kept for LmHandlerInit
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_ERROR,
+                "unsealed session resumed", cycle );
+    BenchCheck( BenchActivation( ) == ACTIVATION_TYPE_ABP, "unsealed session forgotten", cycle );
+
+    // A seal is used once
+    BenchCheck( LmHandlerSuspend( ) == LORAMAC_HANDLER_SUCCESS, "suspend failed", cycle );
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_SUCCESS,
+                "sealed session not resumed", cycle );
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_ERROR,
+                "seal used twice", cycle );
+
+    // Bit flip in the MAC group 1
+    BenchCheck( LmHandlerSuspend( ) == LORAMAC_HANDLER_SUCCESS, "suspend failed", cycle );
+    mibReq.Type = MIB_NVM_CTXS;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    ( ( uint8_t* )&mibReq.Param.Contexts->MacGroup1 )[1] ^= 0x10;
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_ERROR,
+                "corrupted session resumed", cycle );
+    BenchCheck( BenchActivation( ) == ACTIVATION_TYPE_NONE, "corrupted session kept", cycle );
+    BenchCheck( BenchInit( ) == true, "init after corruption failed", cycle );
+
+    // Session of another region
+    otherRegion.Region = LORAMAC_REGION_US915;
+    BenchCheck( LmHandlerSuspend( ) == LORAMAC_HANDLER_SUCCESS, "suspend failed", cycle );
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &otherRegion ) == LORAMAC_HANDLER_ERROR,
+                "session of another region resumed", cycle );
+    BenchCheck( BenchActivation( ) == ACTIVATION_TYPE_NONE, "session of another region kept", cycle );
+    BenchCheck( BenchInit( ) == true, "init after region change failed", cycle );
+    BenchCheck( BenchUplink( ) == true, "uplink after corruption failed", cycle );
+    BenchSleep( BENCH_RTC );
+}
+
+/*!
+ * \brief Resumes an AS923 session after binding the region to other NVM
+ *        groups, the resume must bind it to the sealed ones again
+ */
+static void BenchRegionResume( uint32_t cycle )
+{
+    static RegionNvmDataGroup1_t staleGroup1;
+    static RegionNvmDataGroup2_t staleGroup2;
+    LmHandlerParams_t as923 = HandlerParams;
+    InitDefaultsParams_t params;
+    uint32_t fCntUp;
+
+    as923.Region = LORAMAC_REGION_AS923;
+    BenchSetActivation( ACTIVATION_TYPE_NONE );
+    BenchCheck( LmHandlerInit( &HandlerCallbacks, &as923 ) == LORAMAC_HANDLER_SUCCESS, "AS923 init failed", cycle );
+    BenchSetActivation( ACTIVATION_TYPE_ABP );
+    BenchCheck( BenchUplink( ) == true, "AS923 uplink failed", cycle );
+    BenchCheck( LmHandlerSuspend( ) == LORAMAC_HANDLER_SUCCESS, "AS923 suspend failed", cycle );
+    BenchSleep( BENCH_RTC );
+
+    // Empty groups: no channel enabled
+    params.Type = INIT_TYPE_RESTORE_NVM;
+    params.NvmGroup1 = &staleGroup1;
+    params.NvmGroup2 = &staleGroup2;
+    RegionInitDefaults( LORAMAC_REGION_AS923, &params );
+
+    fCntUp = GetUplinkCounter( );
+    BenchCheck( LmHandlerResume( &HandlerCallbacks, &as923 ) == LORAMAC_HANDLER_SUCCESS,
+                "AS923 session not resumed", cycle );
+    BenchCheck( BenchUplink( ) == true, "AS923 uplink after resume failed", cycle );
+    BenchCheck( GetUplinkCounter( ) == ( fCntUp + 1 ), "AS923 frame counter not carried on", cycle );
+}
+
+static void BenchPrint( BenchMode_t mode, const BenchStats_t *stats )
+{
+    double inits = ( stats->Inits != 0 ) ? stats->Inits : 1;
+
+    printf( "%-8s %6u %14.1f %14.2f %16.2f %14.1f\n", BenchModeNames[mode], stats->Inits, stats->WallUs / inits,
+            stats->InitUs / inits / 1e3, stats->WakeToTxUs / inits / 1e3, stats->Transactions / inits );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t cycles = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 200;
+    BenchStats_t stats[BENCH_MODES];
+    uint32_t cycle = 0;
+
+    memset( stats, 0, sizeof( stats ) );
+    HostClockReset( );
+    Sx126xSimReset( );
+    Sx126xSimSetTxHook( BenchTxHook );
+
+    // First boot
+    BenchCheck( BenchInit( ) == true, "first init failed", cycle );
+    BenchCheck( BenchUplink( ) == true, "first uplink failed", cycle );
+    BenchSleep( BENCH_RTC );
+
+    for( BenchMode_t mode = BENCH_COLD; mode < BENCH_MODES; mode++ )
+    {
+        for( uint32_t i = 0; i < cycles; i++ )
+        {
+            BenchMode_t next = ( i < ( cycles - 1 ) ) ? mode : ( BenchMode_t )( mode + 1 );
+
+            // The corruption test starts from an unsealed session
+            BenchCycle( mode, ( next < BENCH_MODES ) ? next : BENCH_RTC, &stats[mode], cycle++ );
+        }
+    }
+    BenchCorruption( cycle );
+    BenchRegionResume( cycle );
+
+    printf( "%u wake ups per mode, ABP, one unconfirmed uplink per wake up\n", cycles );
+    printf( "%-8s %6s %14s %14s %16s %14s\n", "", "inits", "init wall us", "init sim ms", "wake to tx ms",
+            "spi/init" );
+    for( BenchMode_t mode = BENCH_COLD; mode < BENCH_MODES; mode++ )
+    {
+        BenchPrint( mode, &stats[mode] );
+    }
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
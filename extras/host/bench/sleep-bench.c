@@ -0,0 +1,354 @@
+/*!
+ * \file      sleep-bench.c
+ *
+ * \brief     Light sleep benchmark of the MAC task between an uplink and its
+ *            RX windows on the simulated radio.
+ *
+ * \remark    An ABP node sends unconfirmed uplinks at DR_5 and DR_0, the MCU
+ *            awake between the transmission and the RX windows, then light
+ *            sleeping ( LoRaTaskLightSleep ) and woken up by DIO1 or by the
+ *            timer of the next window. The windows of the sleeping node must
+ *            open no later than the ones of the awake node, at most the wake
+ *            up compensation earlier, and catch a downlink sent at the RX1 and
+ *            RX2 delays. Reports the energy per uplink of the accounting
+ *            module ( lora-energy.c ), the MCU active and light sleep time per
+ *            uplink and the windows opening after the end of the uplink.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "boards/mcu/timer.h"
+#include "boards/lora-energy.h"
+#include "boards/lora-task.h"
+#include "mac/LoRaMac.h"
+#include "apps/LoRaMac/common/LmHandler/LmHandler.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+/*!
+ * Upper bound of simulated time spent waiting for an uplink [us]
+ */
+#define BENCH_UPLINK_TIMEOUT_US                     ( 60ULL * 1000000ULL )
+
+/*!
+ * RX1 and RX2 delays of EU868 [us]
+ */
+#define BENCH_RX1_DELAY_US                          1000000ULL
+#define BENCH_RX2_DELAY_US                          2000000ULL
+
+/*!
+ * Largest advance of the windows of the sleeping node, the wake up
+ * compensation is rounded up to the millisecond [us]
+ */
+#define BENCH_MAX_ADVANCE_US                        1000
+
+#define BENCH_PAYLOAD_SIZE                          16
+
+typedef enum
+{
+    BENCH_AWAKE,
+    BENCH_SLEEP,
+    BENCH_MODES,
+}BenchMode_t;
+
+static const char *BenchModeNames[BENCH_MODES] = { "awake", "sleep" };
+
+static const int8_t BenchDatarates[] = { DR_5, DR_0 };
+
+#define BENCH_DATARATES                             ( sizeof( BenchDatarates ) / sizeof( BenchDatarates[0] ) )
+
+typedef struct
+{
+    uint32_t Uplinks;
+    uint32_t Windows[2];
+    uint64_t OpenUs[2];
+    uint32_t Missed;
+    uint32_t UplinkAvgUj;
+    uint32_t ActiveMs;
+    uint32_t SleepMs;
+    uint32_t LightSleeps;
+}BenchStats_t;
+
+extern SemaphoreHandle_t loraIntSem;
+
+static uint8_t DevEui[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x03 };
+static uint8_t JoinEui[8] = { 0 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                               0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10 };
+static uint8_t NwkSKey[16] = { 0x10, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09,
+                               0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 };
+static uint8_t AppDataBuffer[242];
+
+static LmHandlerParams_t HandlerParams =
+{
+    .Region = LORAMAC_REGION_EU868,
+    .AdrEnable = false,
+    .TxDatarate = DR_5,
+    .PublicNetworkEnable = true,
+    .DutyCycleEnabled = false,
+    .DataBufferMaxSize = sizeof( AppDataBuffer ),
+    .DataBuffer = AppDataBuffer,
+    .TxEirp = 16,
+    .joinType = ACTIVATION_TYPE_ABP,
+    .DevEui = DevEui,
+    .JoinEui = JoinEui,
+    .AppKey = AppKey,
+    .DevAddr = 0x26011BDC,
+    .AppSKey = AppSKey,
+    .NwkSKey = NwkSKey,
+    .NbTrials = 1,
+    .Class = CLASS_A,
+};
+
+static uint32_t Errors;
+static bool TxDone;
+static uint64_t TxEndUs;
+static uint8_t RxWindow;
+static BenchStats_t *Stats;
+
+static void OnMacProcess( void )
+{
+    xSemaphoreGiveFromISR( loraIntSem, NULL );
+}
+
+static void OnNetworkParametersChange( CommissioningParams_t *params )
+{
+}
+
+static void OnTxData( LmHandlerTxParams_t *params )
+{
+    if( params->IsMcpsConfirm != 0 )
+    {
+        TxDone = true;
+    }
+}
+
+static LmHandlerCallbacks_t HandlerCallbacks =
+{
+    .GetBatteryLevel = BoardGetBatteryLevel,
+    .GetTemperature = NULL,
+    .GetRandomSeed = BoardGetRandomSeed,
+    .OnMacProcess = OnMacProcess,
+    .OnNvmDataChange = NULL,
+    .OnNetworkParametersChange = OnNetworkParametersChange,
+    .OnMacMcpsRequest = NULL,
+    .OnMacMlmeRequest = NULL,
+    .OnJoinRequest = NULL,
+    .OnTxData = OnTxData,
+    .OnRxData = NULL,
+    .OnClassChange = NULL,
+    .OnBeaconStatusChange = NULL,
+    .OnSysTimeUpdate = NULL,
+};
+
+static void BenchCheck( bool ok, const char *what, uint32_t uplink )
+{
+    if( ok == false )
+    {
+        if( Errors < 10 )
+        {
+            printf( "uplink %u: %s\n", uplink, what );
+        }
+        Errors++;
+    }
+}
+
+static void BenchTxHook( const Sx126xSimFrame_t *frame )
+{
+    TxEndUs = frame->EndUs;
+    RxWindow = 0;
+}
+
+/*!
+ * \brief Accounts the opening of the window after the end of the uplink and
+ *        checks it catches a downlink sent at the window delay
+ */
+static void BenchRxHook( const Sx126xSimRxWindow_t *window )
+{
+    Sx126xSimFrame_t downlink;
+
+    if( ( Stats == NULL ) || ( RxWindow >= 2 ) )
+    {
+        return;
+    }
+    memset( &downlink, 0, sizeof( downlink ) );
+    downlink.StartUs = TxEndUs + ( ( RxWindow == 0 ) ? BENCH_RX1_DELAY_US : BENCH_RX2_DELAY_US );
+    downlink.Frequency = window->Frequency;
+    downlink.Sf = window->Sf;
+    downlink.Bw = window->Bw;
+    downlink.Cr = 1;
+    downlink.Preamble = 8;
+    downlink.CrcOn = false;
+    downlink.IqInverted = true;
+    if( Sx126xSimRxWindowCatches( window, &downlink ) == false )
+    {
+        Stats->Missed++;
+    }
+    Stats->Windows[RxWindow]++;
+    Stats->OpenUs[RxWindow] += window->StartUs - TxEndUs;
+    RxWindow++;
+}
+
+/*!
+ * \brief Runs the MAC on the simulated clock until the uplink completes, the
+ *        MAC task light sleeping when enabled
+ */
+static bool BenchUplink( int8_t datarate )
+{
+    uint64_t limit = HostClockGetUs( ) + BENCH_UPLINK_TIMEOUT_US;
+    McpsReq_t mcpsReq;
+
+    memset( AppDataBuffer, 0xA5, BENCH_PAYLOAD_SIZE );
+    mcpsReq.Type = MCPS_UNCONFIRMED;
+    mcpsReq.Req.Unconfirmed.fPort = 2;
+    mcpsReq.Req.Unconfirmed.fBuffer = AppDataBuffer;
+    mcpsReq.Req.Unconfirmed.fBufferSize = BENCH_PAYLOAD_SIZE;
+    mcpsReq.Req.Unconfirmed.Datarate = datarate;
+    TxDone = false;
+    if( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK )
+    {
+        return false;
+    }
+    for( ;; )
+    {
+        uint64_t next = UINT64_MAX;
+        uint64_t t;
+
+        while( HostLoRaSemTake( ) == true )
+        {
+            TimerProcess( );
+            LmHandlerProcess( );
+        }
+        if( ( TxDone == true ) && ( LoRaMacIsBusy( ) == false ) )
+        {
+            return true;
+        }
+        if( LoRaTaskLightSleep( ) == true )
+        {
+            HostRtcAlarmProcess( );
+            continue;
+        }
+        if( HostRtcGetAlarm( &t ) == true )
+        {
+            next = t;
+        }
+        if( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t < next ) )
+        {
+            next = t;
+        }
+        if( ( next == UINT64_MAX ) || ( next > limit ) )
+        {
+            return false;
+        }
+        HostClockAdvanceTo( next );
+        Sx126xSimProcess( );
+        HostRtcAlarmProcess( );
+    }
+}
+
+static void BenchRun( BenchMode_t mode, int8_t datarate, uint32_t uplinks, BenchStats_t *stats, uint32_t *uplink )
+{
+    LoRaTaskStats_t task;
+    LoRaEnergyStats_t energy;
+
+    LoRaTaskSetLightSleep( ( mode == BENCH_SLEEP ) ? LoRaMacIsUplinkRunning : NULL );
+    LoRaTaskResetStats( );
+    LoRaEnergyResetStats( );
+    Stats = stats;
+    for( uint32_t i = 0; i < uplinks; i++ )
+    {
+        uint32_t windows = stats->Windows[0] + stats->Windows[1];
+
+        BenchCheck( BenchUplink( datarate ) == true, "uplink failed", *uplink );
+        BenchCheck( ( stats->Windows[0] + stats->Windows[1] ) == ( windows + 2 ), "rx windows not opened", *uplink );
+        stats->Uplinks++;
+        ( *uplink )++;
+    }
+    Stats = NULL;
+
+    LoRaTaskGetStats( &task );
+    LoRaEnergyGetStats( &energy );
+    stats->LightSleeps = task.LightSleeps;
+    stats->UplinkAvgUj = energy.UplinkAvgUj;
+    stats->ActiveMs = energy.StateMs[LORA_ENERGY_MCU_ACTIVE];
+    stats->SleepMs = energy.StateMs[LORA_ENERGY_MCU_LIGHT_SLEEP];
+    BenchCheck( energy.Uplinks == uplinks, "uplinks not accounted", *uplink );
+    BenchCheck( stats->Missed == 0, "downlink missed", *uplink );
+    if( mode == BENCH_AWAKE )
+    {
+        BenchCheck( task.LightSleeps == 0, "light sleep while disabled", *uplink );
+    }
+    else
+    {
+        BenchCheck( task.LightSleeps >= uplinks, "no light sleep", *uplink );
+    }
+}
+
+static double BenchOpenUs( const BenchStats_t *stats, uint8_t window )
+{
+    return ( stats->Windows[window] != 0 ) ? ( double )stats->OpenUs[window] / stats->Windows[window] : 0.0;
+}
+
+static void BenchPrint( BenchMode_t mode, int8_t datarate, const BenchStats_t *stats )
+{
+    double uplinks = ( stats->Uplinks != 0 ) ? stats->Uplinks : 1;
+
+    printf( "%-6s DR_%u %8u %12.1f %10.1f %10.1f %8u %12.1f %12.1f\n", BenchModeNames[mode], datarate,
+            stats->Uplinks, stats->UplinkAvgUj / 1e3, stats->ActiveMs / uplinks, stats->SleepMs / uplinks,
+            stats->LightSleeps, BenchOpenUs( stats, 0 ), BenchOpenUs( stats, 1 ) );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t uplinks = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 100;
+    BenchStats_t stats[BENCH_DATARATES][BENCH_MODES];
+    uint32_t uplink = 0;
+    MibRequestConfirm_t mibReq;
+
+    memset( stats, 0, sizeof( stats ) );
+    HostClockReset( );
+    Sx126xSimReset( );
+    Sx126xSimSetTxHook( BenchTxHook );
+    Sx126xSimSetRxHook( BenchRxHook );
+
+    BenchCheck( LmHandlerInit( &HandlerCallbacks, &HandlerParams ) == LORAMAC_HANDLER_SUCCESS, "init failed", 0 );
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    mibReq.Param.NetworkActivation = ACTIVATION_TYPE_ABP;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    for( uint8_t i = 0; i < BENCH_DATARATES; i++ )
+    {
+        for( BenchMode_t mode = BENCH_AWAKE; mode < BENCH_MODES; mode++ )
+        {
+            BenchRun( mode, BenchDatarates[i], uplinks, &stats[i][mode], &uplink );
+        }
+        BenchCheck( stats[i][BENCH_SLEEP].UplinkAvgUj < stats[i][BENCH_AWAKE].UplinkAvgUj,
+                    "light sleep does not save energy", uplink );
+        for( uint8_t w = 0; w < 2; w++ )
+        {
+            double advance = BenchOpenUs( &stats[i][BENCH_AWAKE], w ) - BenchOpenUs( &stats[i][BENCH_SLEEP], w );
+
+            BenchCheck( advance >= 0.0, "rx window of the sleeping node opened later", uplink );
+            BenchCheck( advance <= BENCH_MAX_ADVANCE_US, "rx window of the sleeping node opened too early", uplink );
+        }
+    }
+    LoRaTaskSetLightSleep( NULL );
+
+    printf( "%u unconfirmed uplinks per datarate and mode, ABP EU868, no downlink\n", uplinks );
+    printf( "%-11s %8s %12s %10s %10s %8s %12s %12s\n", "", "uplinks", "mJ/uplink", "active ms", "sleep ms",
+            "sleeps", "rx1 open us", "rx2 open us" );
+    for( uint8_t i = 0; i < BENCH_DATARATES; i++ )
+    {
+        for( BenchMode_t mode = BENCH_AWAKE; mode < BENCH_MODES; mode++ )
+        {
+            BenchPrint( mode, BenchDatarates[i], &stats[i][mode] );
+        }
+    }
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,643 @@
+/*!
+ * \file      task-bench.c
+ *
+ * \brief     LoRa tasks benchmark ( lora-task.h ) on the simulated radio,
+ *            the tasks running as threads on a simulated core.
+ *
+ * \remark    The main thread stands for the hardware: it moves the simulated
+ *            clock from event to event, puts bursts of back to back class C
+ *            downlinks on the air for an ABP node and runs the tasks by
+ *            priority ( HostTasksRun ) between the events, so the runs are
+ *            deterministic. The node is the real MAC ( LmHandlerProcess ).
+ *            Each frame delivered costs the package processing after the MAC
+ *            a fixed busy time on the simulated clock, longer than the rest
+ *            of the burst, as a fragments decoding would. Runs the former
+ *            single LoRa task, which drains the radio IRQs and runs the MAC
+ *            in turn, then the radio service and MAC tasks, and reports the
+ *            frames lost, the DIO1 IRQ to IRQ drain and IRQ drain to MAC
+ *            latencies and the stack used by the tasks, above the thread
+ *            overhead of an idle task. With the split tasks the MAC must
+ *            deliver every frame received meanwhile, intact and in order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "boards/rtc-board.h"
+#include "boards/sx126x-board.h"
+#include "boards/lora-task.h"
+#include "boards/mcu/timer.h"
+#include "radio/radio.h"
+#include "mac/LoRaMac.h"
+#include "apps/LoRaMac/common/LmHandler/LmHandler.h"
+#include "system/crypto/aes.h"
+#include "system/crypto/cmac.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+extern SemaphoreHandle_t loraIntSem;
+
+/*!
+ * EU868 RX2 channel, class C window at DR_5 ( SF7 BW125 )
+ */
+#define BENCH_FREQUENCY                             869525000
+#define BENCH_DATARATE                              DR_5
+#define BENCH_SF                                    7
+
+/*!
+ * Frames per burst, application payload size and package processing time per
+ * frame [us]
+ */
+#define BENCH_BURST_FRAMES                          4
+#define BENCH_FRAME_SIZE                            24
+#define BENCH_MAC_BUSY_US                           500000
+
+/*!
+ * Gap between two frames of a burst and between two bursts [us]. The MAC
+ * sleeps the radio for each frame it handles, the class C window opens again
+ * once the TCXO is ready ( RADIO_TCXO_SETUP_TIME ).
+ */
+#define BENCH_FRAME_GAP_US                          60000
+#define BENCH_BURST_PERIOD_US                       2500000
+
+/*!
+ * Application port of the downlinks
+ */
+#define BENCH_PORT                                  2
+
+/*!
+ * MHDR, DevAddr, FCtrl, FCnt, FPort and MIC around the application payload
+ */
+#define BENCH_FRAME_OVERHEAD                        13
+
+/*!
+ * Stack of the former LoRa task [bytes]
+ */
+#define BENCH_SINGLE_TASK_STACK_SIZE                8192
+
+typedef struct BenchResult_s
+{
+    uint32_t Sent;
+    uint32_t Received;
+    uint32_t RadioIrqs;
+    uint32_t RadioLatencyAvgUs;
+    uint32_t RadioLatencyMaxUs;
+    uint32_t MacLatencyAvgUs;
+    uint32_t MacLatencyMaxUs;
+    uint32_t RadioStackUsed;
+    uint32_t MacStackUsed;
+    RadioIrqStats_t Irq;
+}BenchResult_t;
+
+static uint8_t DevEui[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x04 };
+static uint8_t JoinEui[8] = { 0 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+                               0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10 };
+static uint8_t NwkSKey[16] = { 0x10, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09,
+                               0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 };
+static uint8_t AppDataBuffer[242];
+
+static LmHandlerParams_t HandlerParams =
+{
+    .Region = LORAMAC_REGION_EU868,
+    .AdrEnable = false,
+    .TxDatarate = DR_5,
+    .PublicNetworkEnable = true,
+    .DutyCycleEnabled = false,
+    .DataBufferMaxSize = sizeof( AppDataBuffer ),
+    .DataBuffer = AppDataBuffer,
+    .TxEirp = 16,
+    .joinType = ACTIVATION_TYPE_ABP,
+    .DevEui = DevEui,
+    .JoinEui = JoinEui,
+    .AppKey = AppKey,
+    .DevAddr = 0x26011BDD,
+    .AppSKey = AppSKey,
+    .NwkSKey = NwkSKey,
+    .NbTrials = 1,
+    .Class = CLASS_A,
+};
+
+static uint32_t Errors;
+
+/*!
+ * Next sequence number expected by the application and frames it got
+ */
+static uint32_t NextSeq;
+static uint32_t Received;
+static bool CheckOrder;
+
+/*!
+ * Frames delivered by the MAC and not processed by the packages yet
+ */
+static uint32_t Delivered;
+
+/*!
+ * Frames put on the air
+ */
+static uint32_t SentSeq;
+
+/*!
+ * Former single LoRa task state
+ */
+static bool SingleStop;
+static bool SingleDone;
+static uint64_t SingleLastIrqUs;
+static uint64_t SingleLatencyTotalUs;
+static uint32_t SingleLatencyMaxUs;
+static uint32_t SingleIrqs;
+
+static uint8_t BenchPattern( uint32_t seq, uint8_t i )
+{
+    return ( uint8_t )( seq * 31 + i * 7 );
+}
+
+static void OnMacProcess( void )
+{
+    xSemaphoreGiveFromISR( loraIntSem, NULL );
+}
+
+static void OnNetworkParametersChange( CommissioningParams_t *params )
+{
+}
+
+static void OnRxData( LmHandlerAppData_t *appData, LmHandlerRxParams_t *params )
+{
+    uint32_t seq;
+    bool intact = true;
+
+    if( ( appData->Port != BENCH_PORT ) || ( appData->BufferSize != BENCH_FRAME_SIZE ) )
+    {
+        printf( "FAIL frame of %u bytes on port %u\n", appData->BufferSize, appData->Port );
+        Errors++;
+        return;
+    }
+    seq = appData->Buffer[0] | ( appData->Buffer[1] << 8 ) | ( appData->Buffer[2] << 16 );
+    for( uint8_t i = 3; i < BENCH_FRAME_SIZE; i++ )
+    {
+        intact &= appData->Buffer[i] == BenchPattern( seq, i );
+    }
+    if( ( intact == false ) || ( seq < NextSeq ) || ( ( CheckOrder == true ) && ( seq != NextSeq ) ) )
+    {
+        printf( "FAIL frame %u: %s, %u expected\n", seq, ( intact == false ) ? "corrupted" : "out of order",
+                NextSeq );
+        Errors++;
+    }
+    NextSeq = seq + 1;
+    Received++;
+    Delivered++;
+}
+
+static void OnClassChange( DeviceClass_t deviceClass )
+{
+}
+
+static LmHandlerCallbacks_t HandlerCallbacks =
+{
+    .GetBatteryLevel = BoardGetBatteryLevel,
+    .GetTemperature = NULL,
+    .GetRandomSeed = BoardGetRandomSeed,
+    .OnMacProcess = OnMacProcess,
+    .OnNvmDataChange = NULL,
+    .OnNetworkParametersChange = OnNetworkParametersChange,
+    .OnMacMcpsRequest = NULL,
+    .OnMacMlmeRequest = NULL,
+    .OnJoinRequest = NULL,
+    .OnTxData = NULL,
+    .OnRxData = OnRxData,
+    .OnClassChange = OnClassChange,
+    .OnBeaconStatusChange = NULL,
+    .OnSysTimeUpdate = NULL,
+};
+
+/*!
+ * \brief MAC processing, then the package processing of the frames delivered
+ */
+static void BenchMacProcess( void )
+{
+    uint32_t frames;
+
+    LmHandlerProcess( );
+
+    frames = Delivered;
+    Delivered = 0;
+    if( frames > 0 )
+    {
+        HostTaskBusyUs( frames * BENCH_MAC_BUSY_US );
+    }
+}
+
+/*!
+ * \brief Fills the block of the downlink encryption ( tag 0x01 ) or MIC
+ *        ( tag 0x49 )
+ */
+static void BenchBlockFill( uint8_t block[16], uint8_t tag, uint32_t fCnt, uint8_t last )
+{
+    uint32_t devAddr = HandlerParams.DevAddr;
+
+    memset( block, 0, 16 );
+    block[0] = tag;
+    block[5] = 1;
+    block[6] = ( uint8_t )devAddr;
+    block[7] = ( uint8_t )( devAddr >> 8 );
+    block[8] = ( uint8_t )( devAddr >> 16 );
+    block[9] = ( uint8_t )( devAddr >> 24 );
+    block[10] = ( uint8_t )fCnt;
+    block[11] = ( uint8_t )( fCnt >> 8 );
+    block[12] = ( uint8_t )( fCnt >> 16 );
+    block[13] = ( uint8_t )( fCnt >> 24 );
+    block[15] = last;
+}
+
+/*!
+ * \brief Builds the unconfirmed data downlink of a sequence number, the
+ *        downlink counter following it
+ *
+ * \retval size PHY payload size
+ */
+static uint8_t BenchBuildDownlink( uint32_t seq, uint8_t *buffer )
+{
+    uint32_t fCnt = seq + 1;
+    uint8_t *payload = buffer + 9;
+    uint8_t block[16];
+    uint8_t s[16];
+    uint8_t mic[16];
+    aes_context aes;
+    AES_CMAC_CTX cmac;
+    uint8_t size;
+
+    buffer[0] = 0x60;
+    buffer[1] = ( uint8_t )HandlerParams.DevAddr;
+    buffer[2] = ( uint8_t )( HandlerParams.DevAddr >> 8 );
+    buffer[3] = ( uint8_t )( HandlerParams.DevAddr >> 16 );
+    buffer[4] = ( uint8_t )( HandlerParams.DevAddr >> 24 );
+    buffer[5] = 0x00;
+    buffer[6] = ( uint8_t )fCnt;
+    buffer[7] = ( uint8_t )( fCnt >> 8 );
+    buffer[8] = BENCH_PORT;
+    payload[0] = ( uint8_t )seq;
+    payload[1] = ( uint8_t )( seq >> 8 );
+    payload[2] = ( uint8_t )( seq >> 16 );
+    for( uint8_t i = 3; i < BENCH_FRAME_SIZE; i++ )
+    {
+        payload[i] = BenchPattern( seq, i );
+    }
+
+    aes_set_key( AppSKey, 16, &aes );
+    for( uint8_t i = 0; i < BENCH_FRAME_SIZE; i++ )
+    {
+        if( ( i % 16 ) == 0 )
+        {
+            BenchBlockFill( block, 0x01, fCnt, ( uint8_t )( ( i / 16 ) + 1 ) );
+            lora_aes_encrypt( block, s, &aes );
+        }
+        payload[i] ^= s[i % 16];
+    }
+
+    size = 9 + BENCH_FRAME_SIZE;
+    BenchBlockFill( block, 0x49, fCnt, size );
+    AES_CMAC_Init( &cmac );
+    AES_CMAC_SetKey( &cmac, NwkSKey );
+    AES_CMAC_Update( &cmac, block, 16 );
+    AES_CMAC_Update( &cmac, buffer, size );
+    AES_CMAC_Final( mic, &cmac );
+    memcpy( buffer + size, mic, 4 );
+    return size + 4;
+}
+
+/*!
+ * \brief Puts a frame of the burst on the air
+ */
+static void BenchPushFrame( uint64_t startUs )
+{
+    Sx126xSimFrame_t air;
+
+    memset( &air, 0, sizeof( air ) );
+    air.StartUs = startUs;
+    air.Frequency = BENCH_FREQUENCY;
+    air.Sf = BENCH_SF;
+    air.Bw = LORA_BW_125;
+    air.Cr = LORA_CR_4_5;
+    air.Preamble = 8;
+    air.CrcOn = false;
+    air.IqInverted = true;
+    air.Rssi = -80;
+    air.Snr = 8;
+    air.Size = BenchBuildDownlink( SentSeq, air.Payload );
+    if( Sx126xSimAirPush( &air ) == false )
+    {
+        printf( "FAIL air full\n" );
+        Errors++;
+    }
+    SentSeq++;
+}
+
+/*!
+ * \brief Moves the simulated clock to the next event, at most to the given
+ *        time, and raises the radio IRQs and RTC alarm due
+ *
+ * \retval pending false if there is no event up to limitUs
+ */
+static bool BenchAdvance( uint64_t limitUs )
+{
+    uint64_t next = limitUs;
+    uint64_t t;
+
+    if( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t < next ) )
+    {
+        next = t;
+    }
+    if( ( HostRtcGetAlarm( &t ) == true ) && ( t < next ) )
+    {
+        next = t;
+    }
+    if( ( HostTasksGetNextWakeUp( &t ) == true ) && ( t < next ) )
+    {
+        next = t;
+    }
+    if( next == UINT64_MAX )
+    {
+        return false;
+    }
+    HostClockAdvanceTo( next );
+    Sx126xSimProcess( );
+    HostRtcAlarmProcess( );
+    return true;
+}
+
+/*!
+ * \brief Runs the air schedule and the tasks on the simulated clock
+ */
+static void BenchRunHardware( uint32_t bursts )
+{
+    uint64_t frameUs = Sx126xSimTimeOnAirUs( BENCH_SF, LORA_BW_125, LORA_CR_4_5, 8, false,
+                                             BENCH_FRAME_SIZE + BENCH_FRAME_OVERHEAD, false );
+    uint64_t burstUs = HostClockGetUs( ) + 100000;
+    uint64_t endUs = burstUs + ( uint64_t )bursts * BENCH_BURST_PERIOD_US;
+    uint32_t frame = 0;
+    uint32_t burst = 0;
+
+    while( 1 )
+    {
+        uint64_t startUs = burstUs + frame * ( frameUs + BENCH_FRAME_GAP_US );
+
+        HostTasksRun( );
+        if( burst < bursts )
+        {
+            // On the air slightly before the preamble starts
+            if( startUs <= ( HostClockGetUs( ) + 1000 ) )
+            {
+                BenchPushFrame( startUs );
+                if( ++frame == BENCH_BURST_FRAMES )
+                {
+                    frame = 0;
+                    burst++;
+                    burstUs += BENCH_BURST_PERIOD_US;
+                }
+                continue;
+            }
+            BenchAdvance( startUs - 1000 );
+        }
+        else if( HostClockGetUs( ) >= endUs )
+        {
+            break;
+        }
+        else
+        {
+            BenchAdvance( endUs );
+        }
+    }
+}
+
+/*!
+ * \brief Runs the tasks until they all wait without a timeout
+ */
+static void BenchRunTasks( void )
+{
+    do
+    {
+        HostTasksRun( );
+    }
+    while( BenchAdvance( UINT64_MAX ) == true );
+}
+
+/*!
+ * \brief Task doing nothing, its stack is the thread overhead
+ */
+static void BenchIdleTask( void *pvParameters )
+{
+    SemaphoreHandle_t never = xSemaphoreCreateBinary( );
+
+    while( 1 )
+    {
+        xSemaphoreTake( never, portMAX_DELAY );
+    }
+}
+
+/*!
+ * \brief Former LoRa task: runs the timers, drains the radio IRQs and runs
+ *        the MAC ( LmHandlerProcess )
+ */
+static void BenchSingleTask( void *pvParameters )
+{
+    while( SingleStop == false )
+    {
+        if( xSemaphoreTake( loraIntSem, 10 ) == pdTRUE )
+        {
+            uint64_t start = RtcGetTimeUs( );
+            uint64_t irqUs = SX126xGetDio1IrqTimeUs( );
+
+            if( irqUs != SingleLastIrqUs )
+            {
+                uint32_t latency = ( start > irqUs ) ? ( uint32_t )( start - irqUs ) : 0;
+
+                SingleLastIrqUs = irqUs;
+                SingleIrqs++;
+                SingleLatencyTotalUs += latency;
+                if( latency > SingleLatencyMaxUs )
+                {
+                    SingleLatencyMaxUs = latency;
+                }
+            }
+            TimerProcess( );
+            BenchMacProcess( );
+        }
+    }
+    SingleDone = true;
+    // Stays for the stack high water mark
+    BenchIdleTask( NULL );
+}
+
+/*!
+ * \brief Activates the ABP session and switches to class C, as
+ *        LoRaWAN_Node::init does
+ */
+static void BenchInitClassC( void )
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    mibReq.Param.NetworkActivation = ACTIVATION_TYPE_ABP;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_RXC_CHANNEL;
+    mibReq.Param.RxCChannel.Frequency = BENCH_FREQUENCY;
+    mibReq.Param.RxCChannel.Datarate = BENCH_DATARATE;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    if( LmHandlerRequestClass( CLASS_C ) != LORAMAC_HANDLER_SUCCESS )
+    {
+        printf( "FAIL class C\n" );
+        Errors++;
+    }
+}
+
+static void BenchStart( bool checkOrder )
+{
+    CheckOrder = checkOrder;
+    Received = 0;
+    Delivered = 0;
+    NextSeq = SentSeq;
+    RadioResetIrqStats( );
+}
+
+static void BenchSingle( uint32_t bursts, uint32_t overhead, BenchResult_t *result )
+{
+    TaskHandle_t task;
+    uint32_t first = SentSeq;
+
+    BenchStart( false );
+    SingleLastIrqUs = SX126xGetDio1IrqTimeUs( );
+    xTaskCreatePinnedToCore( BenchSingleTask, "LORA", BENCH_SINGLE_TASK_STACK_SIZE, NULL, 2, &task, tskNO_AFFINITY );
+    BenchRunHardware( bursts );
+    SingleStop = true;
+    BenchRunTasks( );
+    if( SingleDone == false )
+    {
+        printf( "FAIL single task not stopped\n" );
+        Errors++;
+    }
+
+    memset( result, 0, sizeof( BenchResult_t ) );
+    result->Sent = SentSeq - first;
+    result->Received = Received;
+    result->RadioIrqs = SingleIrqs;
+    result->RadioLatencyAvgUs = ( SingleIrqs > 0 ) ? ( uint32_t )( SingleLatencyTotalUs / SingleIrqs ) : 0;
+    result->RadioLatencyMaxUs = SingleLatencyMaxUs;
+    result->MacStackUsed = HostTaskStackSize( BENCH_SINGLE_TASK_STACK_SIZE ) -
+                           ( uint32_t )uxTaskGetStackHighWaterMark( task ) - overhead;
+    RadioGetIrqStats( &result->Irq );
+}
+
+static void BenchSplit( uint32_t bursts, uint32_t overhead, BenchResult_t *result )
+{
+    LoRaTaskStats_t stats;
+    uint32_t first = SentSeq;
+
+    BenchStart( true );
+    if( LoRaTaskStart( BenchMacProcess ) == false )
+    {
+        printf( "FAIL tasks not started\n" );
+        Errors++;
+        return;
+    }
+    BenchRunHardware( bursts );
+    BenchRunTasks( );
+    LoRaTaskGetStats( &stats );
+
+    memset( result, 0, sizeof( BenchResult_t ) );
+    result->Sent = SentSeq - first;
+    result->Received = Received;
+    result->RadioIrqs = stats.RadioIrqs;
+    result->RadioLatencyAvgUs = stats.RadioLatencyAvgUs;
+    result->RadioLatencyMaxUs = stats.RadioLatencyMaxUs;
+    result->MacLatencyAvgUs = stats.MacLatencyAvgUs;
+    result->MacLatencyMaxUs = stats.MacLatencyMaxUs;
+    result->RadioStackUsed = HostTaskStackSize( LORA_RADIO_TASK_STACK_SIZE ) - stats.RadioStackFree - overhead;
+    result->MacStackUsed = HostTaskStackSize( LORA_MAC_TASK_STACK_SIZE ) - stats.MacStackFree - overhead;
+    RadioGetIrqStats( &result->Irq );
+
+    if( Received != result->Sent )
+    {
+        printf( "FAIL split tasks: %u frames of %u received\n", Received, result->Sent );
+        Errors++;
+    }
+}
+
+static void BenchPrintValue( uint32_t value, int width, bool used )
+{
+    if( used == true )
+    {
+        printf( " %*u", width, value );
+    }
+    else
+    {
+        printf( " %*s", width, "-" );
+    }
+}
+
+/*!
+ * \brief Prints a result line, the single task has no MAC latency and its
+ *        stack is in the MAC column
+ */
+static void BenchPrint( const char *name, const BenchResult_t *r, bool split )
+{
+    printf( "%-8s %6u %6u %6u %7u %7u", name, r->Sent, r->Sent - r->Received, r->RadioIrqs, r->RadioLatencyAvgUs,
+            r->RadioLatencyMaxUs );
+    BenchPrintValue( r->MacLatencyAvgUs, 7, split );
+    BenchPrintValue( r->MacLatencyMaxUs, 7, split );
+    BenchPrintValue( r->RadioStackUsed, 8, split );
+    BenchPrintValue( r->MacStackUsed, 8, true );
+    printf( "\n" );
+}
+
+/*!
+ * \brief Prints the DIO1 IRQ events statistics ( RadioGetIrqStats )
+ */
+static void BenchPrintIrq( const char *name, const RadioIrqStats_t *irq )
+{
+    printf( "%-8s %13u %9u %9u %9u %9u\n", name, irq->Events, irq->Dropped, irq->Coalesced, irq->Empty,
+            irq->MaxDepth );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t bursts = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 10;
+    BenchResult_t single;
+    BenchResult_t split;
+    TaskHandle_t idle;
+    uint32_t overhead;
+
+    // Thread descriptor and TLS in the painted stacks
+    xTaskCreatePinnedToCore( BenchIdleTask, "IDLE", BENCH_SINGLE_TASK_STACK_SIZE, NULL, 0, &idle, tskNO_AFFINITY );
+    HostTasksRun( );
+    overhead = HostTaskStackSize( BENCH_SINGLE_TASK_STACK_SIZE ) - ( uint32_t )uxTaskGetStackHighWaterMark( idle );
+
+    // ABP class C node listening on the RX2 channel
+    if( LmHandlerInit( &HandlerCallbacks, &HandlerParams ) != LORAMAC_HANDLER_SUCCESS )
+    {
+        printf( "FAIL init\n" );
+        return 1;
+    }
+    BenchInitClassC( );
+
+    BenchSingle( bursts, overhead, &single );
+    BenchSplit( bursts, overhead, &split );
+
+    printf( "%u bursts of %u frames, %u ms package processing per frame, stacks above %u B of thread overhead\n",
+            bursts, BENCH_BURST_FRAMES, BENCH_MAC_BUSY_US / 1000, overhead );
+    printf( "%-8s %6s %6s %6s %15s %15s %17s\n", "", "frames", "lost", "irqs", "irq->drain us", "drain->mac us",
+            "stack used B" );
+    printf( "%-8s %6s %6s %6s %7s %7s %7s %7s %8s %8s\n", "", "", "", "", "avg", "max", "avg", "max", "radio", "mac" );
+    BenchPrint( "single", &single, false );
+    BenchPrint( "split", &split, true );
+    printf( "\n%-8s %13s %9s %9s %9s %9s\n", "", "dio1 events", "dropped", "coalesced", "empty", "max depth" );
+    BenchPrintIrq( "single", &single.Irq );
+    BenchPrintIrq( "split", &split.Irq );
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*!
+ * \file      timer-bench.c
+ *
+ * \brief     Timer objects benchmark on the simulated clock.
+ *
+ * \remark    Starts, restarts and stops timers with pseudo random delays,
+ *            then lets the simulated clock run. Checks that every callback
+ *            fires once, in expiry order and on time, and reports the cost of
+ *            the timer operations.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <Arduino.h>
+#include "boards/mcu/timer.h"
+#include "host-board.h"
+
+#define BENCH_TIMERS_MAX                            64
+
+static TimerEvent_t Timers[BENCH_TIMERS_MAX];
+static uint64_t Expected[BENCH_TIMERS_MAX];
+static uint32_t Fired[BENCH_TIMERS_MAX];
+static uint64_t LastFiredUs;
+static uint32_t Errors;
+static uint32_t Rand = 0x12345678;
+
+static uint32_t BenchRand( void )
+{
+    // xorshift32
+    Rand ^= Rand << 13;
+    Rand ^= Rand >> 17;
+    Rand ^= Rand << 5;
+    return Rand;
+}
+
+static void OnTimer( int idx )
+{
+    uint64_t now = HostClockGetUs( );
+
+    if( ( now != Expected[idx] ) || ( now < LastFiredUs ) )
+    {
+        Errors++;
+    }
+    LastFiredUs = now;
+    Fired[idx]++;
+}
+
+// One callback per timer, the callbacks have no context
+#define BENCH_CB( n, k ) static void OnTimer##n##_##k( void ) { OnTimer( n * 8 + k ); }
+#define BENCH_CB8( n ) BENCH_CB( n, 0 ) BENCH_CB( n, 1 ) BENCH_CB( n, 2 ) BENCH_CB( n, 3 ) \
+                       BENCH_CB( n, 4 ) BENCH_CB( n, 5 ) BENCH_CB( n, 6 ) BENCH_CB( n, 7 )
+BENCH_CB8( 0 ) BENCH_CB8( 1 ) BENCH_CB8( 2 ) BENCH_CB8( 3 )
+BENCH_CB8( 4 ) BENCH_CB8( 5 ) BENCH_CB8( 6 ) BENCH_CB8( 7 )
+#define BENCH_CB_REF8( n ) OnTimer##n##_0, OnTimer##n##_1, OnTimer##n##_2, OnTimer##n##_3, \
+                           OnTimer##n##_4, OnTimer##n##_5, OnTimer##n##_6, OnTimer##n##_7
+static void ( *const Callbacks[BENCH_TIMERS_MAX] )( void ) =
+{
+    BENCH_CB_REF8( 0 ), BENCH_CB_REF8( 1 ), BENCH_CB_REF8( 2 ), BENCH_CB_REF8( 3 ),
+    BENCH_CB_REF8( 4 ), BENCH_CB_REF8( 5 ), BENCH_CB_REF8( 6 ), BENCH_CB_REF8( 7 ),
+};
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+/*!
+ * \brief Runs the timers until none is left, as the LoRa task does
+ */
+static void BenchRunTimers( void )
+{
+    uint64_t t;
+
+    while( HostRtcGetAlarm( &t ) == true )
+    {
+        HostClockAdvanceTo( t );
+        HostRtcAlarmProcess( );
+        while( HostLoRaSemTake( ) == true )
+        {
+            TimerProcess( );
+        }
+    }
+}
+
+static void BenchRound( int nbTimers, uint64_t *ops, double *opsNs )
+{
+    double start;
+
+    for( int i = 0; i < nbTimers; i++ )
+    {
+        TimerInit( &Timers[i], Callbacks[i] );
+        Fired[i] = 0;
+    }
+
+    start = WallNs( );
+    for( int i = 0; i < nbTimers; i++ )
+    {
+        TimerSetValue( &Timers[i], 1 + BenchRand( ) % 5000 );
+        TimerStart( &Timers[i] );
+    }
+    // Restart half of the timers and stop a quarter of them
+    for( int i = 0; i < nbTimers; i += 2 )
+    {
+        TimerSetValue( &Timers[i], 1 + BenchRand( ) % 5000 );
+        TimerStart( &Timers[i] );
+    }
+    for( int i = 1; i < nbTimers; i += 4 )
+    {
+        TimerStop( &Timers[i] );
+    }
+    *opsNs += WallNs( ) - start;
+    *ops += nbTimers + ( nbTimers + 1 ) / 2 + ( nbTimers + 2 ) / 4;
+
+    for( int i = 0; i < nbTimers; i++ )
+    {
+        Expected[i] = Timers[i].Timestamp;
+    }
+    LastFiredUs = HostClockGetUs( );
+    BenchRunTimers( );
+
+    for( int i = 0; i < nbTimers; i++ )
+    {
+        if( Fired[i] != ( ( ( i % 4 ) == 1 ) ? 0 : 1 ) )
+        {
+            Errors++;
+        }
+    }
+}
+
+int main( int argc, char **argv )
+{
+    static const int sizes[] = { 2, 4, 8, 16, 32, 64 };
+    int rounds = ( argc > 1 ) ? atoi( argv[1] ) : 20000;
+
+    printf( "timers  rounds  ns/op\n" );
+    for( size_t s = 0; s < sizeof( sizes ) / sizeof( sizes[0] ); s++ )
+    {
+        uint64_t ops = 0;
+        double opsNs = 0;
+
+        for( int r = 0; r < rounds; r++ )
+        {
+            BenchRound( sizes[s], &ops, &opsNs );
+        }
+        printf( "%6d  %6d  %5.1f\n", sizes[s], rounds, opsNs / ( double )ops );
+    }
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
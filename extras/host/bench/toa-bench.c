@@ -0,0 +1,141 @@
+/*!
+ * \file      toa-bench.c
+ *
+ * \brief     Time on air benchmark of the region layer: the cached LoRa time
+ *            on air ( RegionCommonGetTimeOnAirLoRa ) and the LoRa symbol time
+ *            ( RegionCommonComputeSymbolTimeLoRa ).
+ *
+ * \remark    Checks both bit exact against the radio driver and the former
+ *            division on every spreading factor, bandwidth and length, in
+ *            order and in random order to go through the cache evictions,
+ *            then reports the cost per call on the pattern of the MAC (one
+ *            datarate, a few frame sizes) and on random parameters.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Arduino.h>
+#include "radio/radio.h"
+#include "mac/region/RegionCommon.h"
+
+static uint32_t Errors;
+
+static double WallNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec * 1e9 + ( double )ts.tv_nsec;
+}
+
+static uint32_t BenchRand( uint32_t *state )
+{
+    // xorshift32
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static TimerTime_t RadioLoRa( int8_t sf, uint32_t bw, uint16_t len )
+{
+    return Radio.TimeOnAir( MODEM_LORA, bw, sf, 1, 8, false, len, true );
+}
+
+static void CheckTimeOnAir( int8_t sf, uint32_t bw, uint16_t len )
+{
+    TimerTime_t expected = RadioLoRa( sf, bw, len );
+    TimerTime_t timeOnAir = RegionCommonGetTimeOnAirLoRa( sf, bw, len );
+
+    if( timeOnAir != expected )
+    {
+        printf( "FAIL time on air sf %d bw %u len %u: %u ms, radio %u ms\n", sf, bw, len, timeOnAir, expected );
+        Errors++;
+    }
+}
+
+static void BenchCheck( void )
+{
+    static const uint32_t bandwidths[] = { 125000, 250000, 500000, 62500, 41670, 31250, 20830, 15630, 10420, 7810 };
+    uint32_t rand = 0x2468ACE1;
+
+    // In order twice, misses then hits, lengths above 255 included
+    for( uint8_t pass = 0; pass < 2; pass++ )
+    {
+        for( int8_t sf = 5; sf <= 12; sf++ )
+        {
+            for( uint32_t bw = 0; bw <= 2; bw++ )
+            {
+                for( uint16_t len = 0; len < 300; len++ )
+                {
+                    CheckTimeOnAir( sf, bw, len );
+                    CheckTimeOnAir( sf, bw, len );
+                }
+            }
+        }
+    }
+    // Random order, parameters the cache does not hold included
+    for( uint32_t i = 0; i < 1000000; i++ )
+    {
+        CheckTimeOnAir( 4 + BenchRand( &rand ) % 10, BenchRand( &rand ) % 4, BenchRand( &rand ) % 256 );
+    }
+
+    for( uint8_t sf = 5; sf <= 12; sf++ )
+    {
+        for( size_t b = 0; b < sizeof( bandwidths ) / sizeof( bandwidths[0] ); b++ )
+        {
+            // The former ( 1 << phyDr ) * 1000000 / bandwidthInHz, without the
+            // int overflow at SF12
+            uint32_t expected = ( uint32_t )( ( ( uint64_t )1 << sf ) * 1000000 / bandwidths[b] );
+            uint32_t symbolTime = RegionCommonComputeSymbolTimeLoRa( sf, bandwidths[b] );
+
+            if( symbolTime != expected )
+            {
+                printf( "FAIL symbol time sf %u bw %u: %u us, expected %u us\n", sf, bandwidths[b], symbolTime,
+                        expected );
+                Errors++;
+            }
+        }
+    }
+}
+
+static void BenchRun( const char *name, TimerTime_t ( *toa )( int8_t, uint32_t, uint16_t ), bool random,
+                      uint32_t rounds )
+{
+    static const uint16_t sizes[] = { 13, 23, 29, 29, 45, 29, 13, 29 };
+    uint32_t rand = 0x13579BDF;
+    volatile TimerTime_t sink = 0;
+    double start = WallNs( );
+
+    for( uint32_t i = 0; i < rounds; i++ )
+    {
+        if( random == true )
+        {
+            uint32_t r = BenchRand( &rand );
+
+            sink += toa( 7 + r % 6, ( r >> 8 ) % 3, ( r >> 16 ) % 256 );
+        }
+        else
+        {
+            sink += toa( 10, 0, sizes[i & 7] );
+        }
+    }
+    printf( "%-34s %8.1f\n", name, ( WallNs( ) - start ) / rounds );
+}
+
+int main( int argc, char **argv )
+{
+    uint32_t rounds = ( argc > 1 ) ? ( uint32_t )strtoul( argv[1], NULL, 0 ) : 2000000;
+
+    BenchCheck( );
+
+    printf( "%-34s %8s\n", "", "ns/call" );
+    BenchRun( "radio, mac pattern", RadioLoRa, false, rounds );
+    BenchRun( "cached, mac pattern", RegionCommonGetTimeOnAirLoRa, false, rounds );
+    BenchRun( "radio, random", RadioLoRa, true, rounds );
+    BenchRun( "cached, random", RegionCommonGetTimeOnAirLoRa, true, rounds );
+
+    printf( "%s: %u errors\n", ( Errors == 0 ) ? "PASS" : "FAIL", Errors );
+    return ( Errors == 0 ) ? 0 : 1;
+}
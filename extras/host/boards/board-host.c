@@ -0,0 +1,260 @@
+/*!
+ * \file      board-host.c
+ *
+ * \brief     Host implementation of the board, RTC and Arduino core hooks
+ *            used by the LoRaMac stack.
+ */
+#define _GNU_SOURCE
+#include <Arduino.h>
+#include <pthread.h>
+#include "boards/mcu/board.h"
+#include "boards/rtc-board.h"
+#include "boards/sx126x-board.h"
+#include "system/utilities.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+/*!
+ * Time from the light sleep wake up to the MCU running [us]
+ */
+#define HOST_MCU_WAKE_UP_US                         800
+
+/*!
+ * Estimate of the MCU wake up time until measured [us]
+ */
+#define HOST_MCU_WAKE_UP_DEFAULT_US                 1000
+
+/*!
+ * Simulated time since start-up [us], read and moved by the task threads
+ */
+static uint64_t HostClockUs = 0;
+
+/*!
+ * LoRa task wake-up semaphore ( rtos-host.c )
+ */
+extern SemaphoreHandle_t loraIntSem;
+
+/*!
+ * BoardDisableIrq lock of the task threads
+ */
+static pthread_mutex_t HostIrqLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static uint32_t RtcBkupRegisters[] = { 0, 0 };
+
+/*!
+ * RTC alarm time [us] and state
+ */
+static uint64_t RtcAlarmUs = 0;
+static bool RtcAlarmArmed = false;
+
+/*!
+ * Light sleep state, last wake up time asked for and measured wake up time [us]
+ */
+static bool LightSleepEnabled = false;
+static uint64_t LightSleepWakeUpUs = 0;
+static int16_t McuWakeUpTime = 0;
+
+uint64_t HostClockGetUs( void )
+{
+    return __atomic_load_n( &HostClockUs, __ATOMIC_SEQ_CST );
+}
+
+void HostClockAdvanceUs( uint64_t us )
+{
+    __atomic_fetch_add( &HostClockUs, us, __ATOMIC_SEQ_CST );
+}
+
+void HostClockAdvanceTo( uint64_t us )
+{
+    uint64_t now = HostClockGetUs( );
+
+    while( ( us > now ) &&
+           ( __atomic_compare_exchange_n( &HostClockUs, &now, us, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) == false ) )
+    {
+    }
+}
+
+void HostClockReset( void )
+{
+    __atomic_store_n( &HostClockUs, 0, __ATOMIC_SEQ_CST );
+}
+
+bool HostRtcGetAlarm( uint64_t *us )
+{
+    bool armed;
+
+    BoardDisableIrq( );
+    *us = RtcAlarmUs;
+    armed = RtcAlarmArmed;
+    BoardEnableIrq( );
+    return armed;
+}
+
+void HostRtcAlarmProcess( void )
+{
+    bool fired = false;
+
+    BoardDisableIrq( );
+    if( ( RtcAlarmArmed == true ) && ( RtcAlarmUs <= HostClockGetUs( ) ) )
+    {
+        RtcAlarmArmed = false;
+        fired = true;
+    }
+    BoardEnableIrq( );
+    if( fired == true )
+    {
+        xSemaphoreGiveFromISR( loraIntSem, NULL );
+    }
+}
+
+bool HostLoRaSemTake( void )
+{
+    return xSemaphoreTake( loraIntSem, 0 ) == pdTRUE;
+}
+
+void delay( uint32_t ms )
+{
+    HostClockAdvanceUs( ( uint64_t )ms * 1000 );
+}
+
+uint32_t millis( void )
+{
+    return ( uint32_t )( HostClockGetUs( ) / 1000 );
+}
+
+uint32_t micros( void )
+{
+    return ( uint32_t )HostClockGetUs( );
+}
+
+void BoardDisableIrq( void )
+{
+    pthread_mutex_lock( &HostIrqLock );
+}
+
+void BoardEnableIrq( void )
+{
+    pthread_mutex_unlock( &HostIrqLock );
+}
+
+uint32_t BoardGetRandomSeed( void )
+{
+    return randr( 0, 255 );
+}
+
+void BoardGetUniqueId( uint8_t *id )
+{
+    static const uint8_t uniqueId[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x01 };
+
+    memcpy1( id, uniqueId, 8 );
+}
+
+uint8_t BoardGetBatteryLevel( void )
+{
+    return 254;
+}
+
+uint64_t RtcGetTimeUs( void )
+{
+    return HostClockGetUs( );
+}
+
+uint32_t RtcGetMinimumTimeout( void )
+{
+    return 1;
+}
+
+void RtcSetAlarm( uint32_t timeout )
+{
+    BoardDisableIrq( );
+    RtcAlarmUs = HostClockGetUs( ) + timeout;
+    RtcAlarmArmed = true;
+    BoardEnableIrq( );
+}
+
+void RtcStopAlarm( void )
+{
+    BoardDisableIrq( );
+    RtcAlarmArmed = false;
+    BoardEnableIrq( );
+}
+
+void RtcSetMcuWakeUpTime( void )
+{
+    uint64_t now = HostClockGetUs( );
+    uint64_t wakeUp = ( now > LightSleepWakeUpUs ) ? ( now - LightSleepWakeUpUs ) : 0;
+
+    if( wakeUp > ( uint64_t )McuWakeUpTime )
+    {
+        McuWakeUpTime = ( int16_t )wakeUp;
+    }
+}
+
+int16_t RtcGetMcuWakeUpTime( void )
+{
+    if( LightSleepEnabled == false )
+    {
+        return 0;
+    }
+    return ( McuWakeUpTime != 0 ) ? McuWakeUpTime : HOST_MCU_WAKE_UP_DEFAULT_US;
+}
+
+void RtcSetLightSleep( bool enable )
+{
+    LightSleepEnabled = enable;
+}
+
+bool RtcLightSleep( uint64_t wakeUpUs )
+{
+    uint64_t t;
+
+    if( ( LightSleepEnabled == false ) || ( wakeUpUs <= HostClockGetUs( ) ) )
+    {
+        return false;
+    }
+    // The chip keeps running while the MCU sleeps, DIO1 wakes it up
+    while( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t < wakeUpUs ) )
+    {
+        HostClockAdvanceTo( t );
+        Sx126xSimProcess( );
+        if( SX126xGetDio1PinState( ) != 0 )
+        {
+            HostClockAdvanceUs( HOST_MCU_WAKE_UP_US );
+            return false;
+        }
+    }
+    HostClockAdvanceTo( wakeUpUs );
+    HostClockAdvanceUs( HOST_MCU_WAKE_UP_US );
+    LightSleepWakeUpUs = wakeUpUs;
+    RtcSetMcuWakeUpTime( );
+    return true;
+}
+
+uint32_t RtcGetCalendarTime( uint16_t *milliseconds )
+{
+    uint64_t now = HostClockGetUs( );
+
+    *milliseconds = ( uint16_t )( ( now % 1000000ULL ) / 1000ULL );
+    return ( uint32_t )( now / 1000000ULL );
+}
+
+void RtcBkupWrite( uint32_t data0, uint32_t data1 )
+{
+    RtcBkupRegisters[0] = data0;
+    RtcBkupRegisters[1] = data1;
+}
+
+void RtcBkupRead( uint32_t* data0, uint32_t* data1 )
+{
+    *data0 = RtcBkupRegisters[0];
+    *data1 = RtcBkupRegisters[1];
+}
+
+TimerTime_t RtcTempCompensation( TimerTime_t period, float temperature )
+{
+    return period;
+}
+
+void RtcProcess( void )
+{
+}
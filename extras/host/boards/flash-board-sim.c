@@ -0,0 +1,235 @@
+/*!
+ * \file      flash-board-sim.c
+ *
+ * \brief     Host implementation of the flash driver: NOR flash simulator
+ *            backed by a RAM buffer and optionally by a file.
+ *
+ * \remark    Programming can only clear bits, erasing sets a sector to 0xFF.
+ *            A power cut can be scheduled after a number of programmed bytes
+ *            and erased sectors: the operation in progress is left half done
+ *            and every access fails until HostFlashPowerOn is called.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boards/mcu/flash_board.h"
+#include "host-board.h"
+
+/*!
+ * Simulated storage area, NULL until HostFlashOpen
+ */
+static uint8_t* Flash = NULL;
+static uint32_t FlashSize = 0;
+static FILE* FlashFile = NULL;
+static uint32_t* SectorErases = NULL;
+
+/*!
+ * Operations left before the power cut, 0 when no cut is scheduled
+ */
+static uint32_t PowerCutBudget = 0;
+static bool PoweredOff = false;
+
+static HostFlashStats_t Stats;
+
+static uint32_t Rand = 0x2545F491;
+
+static uint32_t FlashRand( void )
+{
+    // xorshift32
+    Rand ^= Rand << 13;
+    Rand ^= Rand >> 17;
+    Rand ^= Rand << 5;
+    return Rand;
+}
+
+/*!
+ * \brief Consumes one operation of the power cut budget
+ *
+ * \retval cut true if the power is cut during this operation
+ */
+static bool FlashPowerCut( void )
+{
+    if( PowerCutBudget == 0 )
+    {
+        return false;
+    }
+    if( --PowerCutBudget == 0 )
+    {
+        PoweredOff = true;
+        Stats.PowerCuts++;
+        return true;
+    }
+    return false;
+}
+
+static void FlashSync( uint32_t addr, uint32_t size )
+{
+    if( FlashFile != NULL )
+    {
+        fseek( FlashFile, addr, SEEK_SET );
+        fwrite( &Flash[addr], 1, size, FlashFile );
+        fflush( FlashFile );
+    }
+}
+
+bool HostFlashOpen( const char* path, uint32_t size )
+{
+    HostFlashClose( );
+
+    FlashSize = size - ( size % FLASH_MCU_SECTOR_SIZE );
+    Flash = malloc( FlashSize );
+    SectorErases = calloc( FlashSize / FLASH_MCU_SECTOR_SIZE, sizeof( uint32_t ) );
+    if( ( Flash == NULL ) || ( SectorErases == NULL ) )
+    {
+        HostFlashClose( );
+        return false;
+    }
+    memset( Flash, 0xFF, FlashSize );
+    memset( &Stats, 0, sizeof( Stats ) );
+    PowerCutBudget = 0;
+    PoweredOff = false;
+
+    if( path != NULL )
+    {
+        FlashFile = fopen( path, "r+b" );
+        if( FlashFile != NULL )
+        {
+            // Missing bytes of a shorter file read as erased
+            if( fread( Flash, 1, FlashSize, FlashFile ) < FlashSize )
+            {
+                clearerr( FlashFile );
+            }
+        }
+        else
+        {
+            FlashFile = fopen( path, "w+b" );
+        }
+        if( FlashFile == NULL )
+        {
+            HostFlashClose( );
+            return false;
+        }
+        FlashSync( 0, FlashSize );
+    }
+    return true;
+}
+
+void HostFlashClose( void )
+{
+    if( FlashFile != NULL )
+    {
+        fclose( FlashFile );
+        FlashFile = NULL;
+    }
+    free( Flash );
+    free( SectorErases );
+    Flash = NULL;
+    SectorErases = NULL;
+    FlashSize = 0;
+}
+
+void HostFlashSetPowerCut( uint32_t operations )
+{
+    PowerCutBudget = operations;
+}
+
+void HostFlashPowerOn( void )
+{
+    PowerCutBudget = 0;
+    PoweredOff = false;
+}
+
+bool HostFlashIsPoweredOff( void )
+{
+    return PoweredOff;
+}
+
+void HostFlashGetStats( HostFlashStats_t* stats )
+{
+    *stats = Stats;
+    stats->SectorErasesMin = UINT32_MAX;
+    stats->SectorErasesMax = 0;
+    for( uint32_t s = 0; s < ( FlashSize / FLASH_MCU_SECTOR_SIZE ); s++ )
+    {
+        if( SectorErases[s] < stats->SectorErasesMin )
+        {
+            stats->SectorErasesMin = SectorErases[s];
+        }
+        if( SectorErases[s] > stats->SectorErasesMax )
+        {
+            stats->SectorErasesMax = SectorErases[s];
+        }
+    }
+    if( stats->SectorErasesMin == UINT32_MAX )
+    {
+        stats->SectorErasesMin = 0;
+    }
+}
+
+bool FlashMcuInit( void )
+{
+    return Flash != NULL;
+}
+
+uint32_t FlashMcuGetSize( void )
+{
+    return FlashSize;
+}
+
+bool FlashMcuRead( uint32_t addr, uint8_t* buffer, uint32_t size )
+{
+    if( ( Flash == NULL ) || ( PoweredOff == true ) || ( ( addr + size ) > FlashSize ) )
+    {
+        return false;
+    }
+    memcpy( buffer, &Flash[addr], size );
+    return true;
+}
+
+bool FlashMcuWrite( uint32_t addr, const uint8_t* buffer, uint32_t size )
+{
+    if( ( Flash == NULL ) || ( PoweredOff == true ) || ( ( addr + size ) > FlashSize ) )
+    {
+        return false;
+    }
+    for( uint32_t i = 0; i < size; i++ )
+    {
+        if( ( buffer[i] & ~Flash[addr + i] ) != 0 )
+        {
+            // Bits cannot go back to 1 without an erase
+            Stats.Overwrites++;
+        }
+        if( FlashPowerCut( ) == true )
+        {
+            // Some of the bits of the byte in progress are programmed
+            Flash[addr + i] &= buffer[i] | ( uint8_t )FlashRand( );
+            FlashSync( addr, i + 1 );
+            return false;
+        }
+        Flash[addr + i] &= buffer[i];
+        Stats.ProgrammedBytes++;
+    }
+    FlashSync( addr, size );
+    return true;
+}
+
+bool FlashMcuEraseSector( uint32_t addr )
+{
+    if( ( Flash == NULL ) || ( PoweredOff == true ) || ( ( addr % FLASH_MCU_SECTOR_SIZE ) != 0 ) ||
+        ( addr >= FlashSize ) )
+    {
+        return false;
+    }
+    SectorErases[addr / FLASH_MCU_SECTOR_SIZE]++;
+    Stats.Erases++;
+    if( FlashPowerCut( ) == true )
+    {
+        // Part of the sector is erased
+        memset( &Flash[addr], 0xFF, FlashRand( ) % FLASH_MCU_SECTOR_SIZE );
+        FlashSync( addr, FLASH_MCU_SECTOR_SIZE );
+        return false;
+    }
+    memset( &Flash[addr], 0xFF, FLASH_MCU_SECTOR_SIZE );
+    FlashSync( addr, FLASH_MCU_SECTOR_SIZE );
+    return true;
+}
@@ -0,0 +1,165 @@
+/*!
+ * \file      host-board.h
+ *
+ * \brief     Host (Linux) replacement of the ESP32 board layer: simulated
+ *            clock, LoRa task semaphore, RTC alarm and flash.
+ *
+ * \remark    The simulation is single threaded. What runs in ISR or esp_timer
+ *            context on the target is invoked from the simulation loop when
+ *            the simulated clock reaches the event time. The FreeRTOS tasks
+ *            of the target run as threads ( rtos-host.c ), the clock, the
+ *            semaphores, BoardDisableIrq and the radio lock are thread safe.
+ */
+#ifndef __HOST_BOARD_H__
+#define __HOST_BOARD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \brief Returns the simulated time in microseconds since start-up
+ */
+uint64_t HostClockGetUs( void );
+
+/*!
+ * \brief Moves the simulated clock forward
+ *
+ * \param [IN] us Number of microseconds to advance
+ */
+void HostClockAdvanceUs( uint64_t us );
+
+/*!
+ * \brief Moves the simulated clock to the given time. Going backwards is ignored.
+ *
+ * \param [IN] us Absolute time in microseconds
+ */
+void HostClockAdvanceTo( uint64_t us );
+
+/*!
+ * \brief Resets the simulated clock to 0
+ */
+void HostClockReset( void );
+
+/*!
+ * \brief Takes the LoRa task semaphore given by the radio ISR
+ *
+ * \retval taken true if the semaphore was given since the last take
+ */
+bool HostLoRaSemTake( void );
+
+/*!
+ * \brief Gets the stack size xTaskCreatePinnedToCore gives a task thread
+ *
+ * \param [IN] stackDepth Stack size asked for [bytes]
+ * \retval size Stack size, at least PTHREAD_STACK_MIN and whole pages [bytes]
+ */
+uint32_t HostTaskStackSize( uint32_t stackDepth );
+
+/*!
+ * \brief Runs the tasks ( xTaskCreatePinnedToCore ) while one is ready, the
+ *        highest priority one first. Called by the main thread, which stands
+ *        for the hardware and the ISRs, the simulated clock stands still.
+ */
+void HostTasksRun( void );
+
+/*!
+ * \brief Gets the next end of a task wait or busy time
+ *
+ * \param [OUT] us Absolute time in microseconds, UINT64_MAX when none
+ * \retval pending false if no task waits with a timeout nor is busy
+ */
+bool HostTasksGetNextWakeUp( uint64_t *us );
+
+/*!
+ * \brief Keeps the calling task busy on the simulated clock, the higher
+ *        priority tasks preempting it. Advances the clock when called by the
+ *        main thread.
+ *
+ * \param [IN] us Busy time [us]
+ */
+void HostTaskBusyUs( uint32_t us );
+
+/*!
+ * \brief Gets the time of the RTC alarm programmed by the timer objects
+ *
+ * \param [OUT] us Absolute alarm time in microseconds
+ * \retval pending false if the alarm is stopped
+ */
+bool HostRtcGetAlarm( uint64_t *us );
+
+/*!
+ * \brief Fires the RTC alarm if it is due: the alarm is cleared and the LoRa
+ *        task semaphore given, as the esp_timer callback does on the target.
+ */
+void HostRtcAlarmProcess( void );
+
+/*!
+ * Simulated flash statistics
+ */
+typedef struct HostFlashStats_s
+{
+    uint32_t ProgrammedBytes;
+    uint32_t Erases;
+    /*!
+     * Least and most erased sectors
+     */
+    uint32_t SectorErasesMin;
+    uint32_t SectorErasesMax;
+    /*!
+     * Programming of bytes which were not erased
+     */
+    uint32_t Overwrites;
+    uint32_t PowerCuts;
+}HostFlashStats_t;
+
+/*!
+ * \brief Creates the simulated flash used by the flash driver. Until then
+ *        FlashMcuInit fails.
+ *
+ * \param [IN] path File keeping the flash content across runs, NULL to keep it
+ *                  in RAM only
+ * \param [IN] size Flash size, rounded down to FLASH_MCU_SECTOR_SIZE
+ * \retval status false if the file cannot be opened
+ */
+bool HostFlashOpen( const char* path, uint32_t size );
+
+/*!
+ * \brief Releases the simulated flash
+ */
+void HostFlashClose( void );
+
+/*!
+ * \brief Schedules a power cut
+ *
+ * \param [IN] operations Programmed bytes and erased sectors before the cut,
+ *                        the last one is left half done. 0 cancels the cut.
+ */
+void HostFlashSetPowerCut( uint32_t operations );
+
+/*!
+ * \brief Restores the power after a cut
+ */
+void HostFlashPowerOn( void );
+
+/*!
+ * \brief Tells if the scheduled power cut happened
+ */
+bool HostFlashIsPoweredOff( void );
+
+/*!
+ * \brief Gets the simulated flash statistics since HostFlashOpen
+ *
+ * \param [OUT] stats Flash statistics
+ */
+void HostFlashGetStats( HostFlashStats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HOST_BOARD_H__
@@ -0,0 +1,347 @@
+/*!
+ * \file      rtos-host.c
+ *
+ * \brief     Host stand-in of the FreeRTOS semaphores and tasks used by the
+ *            LoRa tasks ( lora-task.h ), on top of pthreads
+ *
+ * \remark    The semaphores are binary. The tasks run on a single simulated
+ *            core: one thread runs at a time, the highest priority ready task
+ *            first, and a task given a semaphore preempts a lower priority
+ *            task giving it. The main thread stands for the hardware and the
+ *            ISRs: HostTasksRun runs the tasks while they are ready, the
+ *            simulated clock stands still meanwhile. The waits and the busy
+ *            time of the tasks ( HostTaskBusyUs ) are on the simulated clock,
+ *            the main thread moves it to HostTasksGetNextWakeUp.
+ */
+#define _GNU_SOURCE
+#include <Arduino.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "host-board.h"
+
+/*!
+ * Byte the task stacks are painted with
+ */
+#define HOST_TASK_STACK_PAINT                       0xA5
+
+typedef struct HostSemaphore_s
+{
+    bool Given;
+}HostSemaphore_t;
+
+typedef enum
+{
+    HOST_TASK_READY,
+    HOST_TASK_BLOCKED,
+    HOST_TASK_BUSY,
+    HOST_TASK_DELETED,
+}HostTaskState_t;
+
+typedef struct HostTask_s
+{
+    pthread_t Thread;
+    pthread_cond_t Cond;
+    TaskFunction_t Task;
+    void *Parameters;
+    uint8_t *Stack;
+    uint32_t StackSize;
+    UBaseType_t Priority;
+    HostTaskState_t State;
+    /*!
+     * Semaphore waited for, and set when it was taken on the wake up
+     */
+    HostSemaphore_t *WaitSem;
+    bool Taken;
+    /*!
+     * End of the wait or of the busy time [us], UINT64_MAX when none
+     */
+    uint64_t WakeUpUs;
+    struct HostTask_s *Next;
+}HostTask_t;
+
+/*!
+ * LoRa task wake-up semaphore. Given by RadioOnDioIrq on the target.
+ */
+static HostSemaphore_t LoRaIntSem = { false };
+
+SemaphoreHandle_t loraIntSem = &LoRaIntSem;
+
+/*!
+ * Scheduler lock, the task running, NULL for the main thread, and the tasks
+ * in creation order
+ */
+static pthread_mutex_t SchedLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t MainCond = PTHREAD_COND_INITIALIZER;
+static HostTask_t *Running;
+static HostTask_t *Tasks;
+
+/*!
+ * Task of the calling thread, NULL for the main thread
+ */
+static __thread HostTask_t *Self;
+
+/*!
+ * \brief Hands the core back to the main thread and waits to run again.
+ *        SchedLock is held.
+ */
+static void HostTaskSwitch( void )
+{
+    Running = NULL;
+    pthread_cond_signal( &MainCond );
+    while( Running != Self )
+    {
+        pthread_cond_wait( &Self->Cond, &SchedLock );
+    }
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary( void )
+{
+    return calloc( 1, sizeof( HostSemaphore_t ) );
+}
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t handle, TickType_t ticks )
+{
+    HostSemaphore_t *sem = handle;
+    BaseType_t taken = pdFALSE;
+
+    pthread_mutex_lock( &SchedLock );
+    if( sem->Given == true )
+    {
+        sem->Given = false;
+        taken = pdTRUE;
+    }
+    else if( ( ticks != 0 ) && ( Self != NULL ) )
+    {
+        // The main thread never blocks
+        Self->State = HOST_TASK_BLOCKED;
+        Self->WaitSem = sem;
+        Self->Taken = false;
+        Self->WakeUpUs = ( ticks == portMAX_DELAY ) ? UINT64_MAX : HostClockGetUs( ) + ( uint64_t )ticks * 1000;
+        HostTaskSwitch( );
+        taken = ( Self->Taken == true ) ? pdTRUE : pdFALSE;
+    }
+    pthread_mutex_unlock( &SchedLock );
+    return taken;
+}
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t handle )
+{
+    HostSemaphore_t *sem = handle;
+    HostTask_t *waiter = NULL;
+
+    pthread_mutex_lock( &SchedLock );
+    for( HostTask_t *task = Tasks; task != NULL; task = task->Next )
+    {
+        if( ( task->State == HOST_TASK_BLOCKED ) && ( task->WaitSem == sem ) &&
+            ( ( waiter == NULL ) || ( task->Priority > waiter->Priority ) ) )
+        {
+            waiter = task;
+        }
+    }
+    if( waiter != NULL )
+    {
+        // Taken at once by the highest priority task waiting
+        waiter->State = HOST_TASK_READY;
+        waiter->WaitSem = NULL;
+        waiter->Taken = true;
+        if( ( Self != NULL ) && ( waiter->Priority > Self->Priority ) )
+        {
+            Self->State = HOST_TASK_READY;
+            HostTaskSwitch( );
+        }
+    }
+    else
+    {
+        sem->Given = true;
+    }
+    pthread_mutex_unlock( &SchedLock );
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t sem, BaseType_t *higherPriorityTaskWoken )
+{
+    if( higherPriorityTaskWoken != NULL )
+    {
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+    return xSemaphoreGive( sem );
+}
+
+UBaseType_t uxSemaphoreGetCount( SemaphoreHandle_t handle )
+{
+    HostSemaphore_t *sem = handle;
+    UBaseType_t count;
+
+    pthread_mutex_lock( &SchedLock );
+    count = ( sem->Given == true ) ? 1 : 0;
+    pthread_mutex_unlock( &SchedLock );
+    return count;
+}
+
+static void* HostTaskRun( void *arg )
+{
+    HostTask_t *task = arg;
+
+    pthread_mutex_lock( &SchedLock );
+    Self = task;
+    while( Running != Self )
+    {
+        pthread_cond_wait( &Self->Cond, &SchedLock );
+    }
+    pthread_mutex_unlock( &SchedLock );
+
+    task->Task( task->Parameters );
+
+    pthread_mutex_lock( &SchedLock );
+    task->State = HOST_TASK_DELETED;
+    Running = NULL;
+    pthread_cond_signal( &MainCond );
+    pthread_mutex_unlock( &SchedLock );
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore( TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters,
+                                    UBaseType_t priority, TaskHandle_t *handle, BaseType_t core )
+{
+    HostTask_t *task = calloc( 1, sizeof( HostTask_t ) );
+    HostTask_t **last;
+    pthread_attr_t attr;
+    long page = sysconf( _SC_PAGESIZE );
+
+    if( task == NULL )
+    {
+        return pdFALSE;
+    }
+    task->Task = function;
+    task->Parameters = parameters;
+    task->Priority = priority;
+    task->State = HOST_TASK_READY;
+    task->WakeUpUs = UINT64_MAX;
+    task->StackSize = HostTaskStackSize( stackDepth );
+    if( posix_memalign( ( void** )&task->Stack, page, task->StackSize ) != 0 )
+    {
+        free( task );
+        return pdFALSE;
+    }
+    memset( task->Stack, HOST_TASK_STACK_PAINT, task->StackSize );
+    pthread_cond_init( &task->Cond, NULL );
+
+    pthread_attr_init( &attr );
+    pthread_attr_setstack( &attr, task->Stack, task->StackSize );
+    if( pthread_create( &task->Thread, &attr, HostTaskRun, task ) != 0 )
+    {
+        pthread_attr_destroy( &attr );
+        free( task->Stack );
+        free( task );
+        return pdFALSE;
+    }
+    pthread_attr_destroy( &attr );
+    pthread_setname_np( task->Thread, name );
+
+    // Runs from the next HostTasksRun on
+    pthread_mutex_lock( &SchedLock );
+    for( last = &Tasks; *last != NULL; last = &( *last )->Next )
+    {
+    }
+    *last = task;
+    pthread_mutex_unlock( &SchedLock );
+    if( handle != NULL )
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark( TaskHandle_t handle )
+{
+    HostTask_t *task = handle;
+    uint32_t unused = 0;
+
+    // The stack grows down, from the end of the buffer
+    while( ( unused < task->StackSize ) && ( task->Stack[unused] == HOST_TASK_STACK_PAINT ) )
+    {
+        unused++;
+    }
+    return unused;
+}
+
+uint32_t HostTaskStackSize( uint32_t stackDepth )
+{
+    uint32_t page = ( uint32_t )sysconf( _SC_PAGESIZE );
+    uint32_t size = ( stackDepth < PTHREAD_STACK_MIN ) ? PTHREAD_STACK_MIN : stackDepth;
+
+    return ( size + page - 1 ) / page * page;
+}
+
+void HostTasksRun( void )
+{
+    pthread_mutex_lock( &SchedLock );
+    for( ;; )
+    {
+        uint64_t now = HostClockGetUs( );
+        HostTask_t *next = NULL;
+
+        for( HostTask_t *task = Tasks; task != NULL; task = task->Next )
+        {
+            if( ( ( task->State == HOST_TASK_BLOCKED ) || ( task->State == HOST_TASK_BUSY ) ) &&
+                ( task->WakeUpUs <= now ) )
+            {
+                // Wait timed out or busy time over
+                task->State = HOST_TASK_READY;
+                task->WaitSem = NULL;
+                task->WakeUpUs = UINT64_MAX;
+            }
+            // A busy task keeps the core from the lower priority tasks
+            if( ( ( task->State == HOST_TASK_READY ) || ( task->State == HOST_TASK_BUSY ) ) &&
+                ( ( next == NULL ) || ( task->Priority > next->Priority ) ) )
+            {
+                next = task;
+            }
+        }
+        if( ( next == NULL ) || ( next->State == HOST_TASK_BUSY ) )
+        {
+            break;
+        }
+        Running = next;
+        pthread_cond_signal( &next->Cond );
+        while( Running != NULL )
+        {
+            pthread_cond_wait( &MainCond, &SchedLock );
+        }
+    }
+    pthread_mutex_unlock( &SchedLock );
+}
+
+bool HostTasksGetNextWakeUp( uint64_t *us )
+{
+    uint64_t next = UINT64_MAX;
+
+    pthread_mutex_lock( &SchedLock );
+    for( HostTask_t *task = Tasks; task != NULL; task = task->Next )
+    {
+        if( ( ( task->State == HOST_TASK_BLOCKED ) || ( task->State == HOST_TASK_BUSY ) ) &&
+            ( task->WakeUpUs < next ) )
+        {
+            next = task->WakeUpUs;
+        }
+    }
+    pthread_mutex_unlock( &SchedLock );
+    *us = next;
+    return next != UINT64_MAX;
+}
+
+void HostTaskBusyUs( uint32_t us )
+{
+    if( Self == NULL )
+    {
+        HostClockAdvanceUs( us );
+        return;
+    }
+    pthread_mutex_lock( &SchedLock );
+    Self->State = HOST_TASK_BUSY;
+    Self->WakeUpUs = HostClockGetUs( ) + us;
+    HostTaskSwitch( );
+    pthread_mutex_unlock( &SchedLock );
+}
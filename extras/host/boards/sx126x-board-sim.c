@@ -0,0 +1,1192 @@
+/*!
+ * \file      sx126x-board-sim.c
+ *
+ * \brief     Host implementation of the SX126x board hooks on top of a
+ *            simulated transceiver
+ *
+ * \remark    Every SPI access of the driver is decoded and applied to the chip
+ *            model. Timing follows the simulated clock: a transmission ends
+ *            after its time on air, a reception ends with the received frame
+ *            or with the symbol/RX timeout, whichever comes first.
+ */
+#define _GNU_SOURCE
+#include <Arduino.h>
+#include <math.h>
+#include <pthread.h>
+#include "boards/mcu/board.h"
+#include "boards/sx126x-board.h"
+#include "boards/lora-energy.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+
+/*!
+ * Maximum number of chip events pending at the same time
+ */
+#define SIM_MAX_EVENTS                              4
+
+/*!
+ * Tolerance used when matching the receiver and frame frequencies [Hz]
+ */
+#define SIM_FREQ_TOLERANCE                          500
+
+/*!
+ * Number of preamble symbols needed by the receiver to detect a preamble
+ */
+#define SIM_PREAMBLE_DETECT_SYMBOLS                 4
+
+/*!
+ * Rx/Tx timeout step of the SetRx/SetTx commands [us]
+ */
+#define SIM_RX_TIMEOUT_STEP_US                      15.625
+
+/*!
+ * Crystal frequency used by the PLL step conversion [Hz]
+ */
+#define SIM_XTAL_FREQ                               32000000ULL
+
+/*!
+ * Value used for "no limit" times
+ */
+#define SIM_TIME_INFINITE                           UINT64_MAX
+
+/*!
+ * Time the chip stays BUSY on an image calibration [us]
+ */
+#define SIM_IMAGE_CAL_US                            1000
+
+/*!
+ * Time the chip stays BUSY on the calibration of all its blocks [us]
+ */
+#define SIM_CALIBRATE_US                            3500
+
+/*!
+ * RF frequency and image calibration band, 902 to 928 MHz in 4 MHz steps,
+ * after a reset or a cold start
+ */
+#define SIM_FREQ_DEFAULT                            915000000
+#define SIM_IMAGE_CAL_DEFAULT_MIN                   0xE1
+#define SIM_IMAGE_CAL_DEFAULT_MAX                   0xE9
+
+typedef enum
+{
+    SIM_CHIP_SLEEP,
+    SIM_CHIP_STDBY,
+    SIM_CHIP_FS,
+    SIM_CHIP_TX,
+    SIM_CHIP_RX,
+    SIM_CHIP_CAD,
+}SimChipMode_t;
+
+typedef enum
+{
+    SIM_EVT_TX_DONE,
+    SIM_EVT_PREAMBLE_DETECTED,
+    SIM_EVT_HEADER_VALID,
+    SIM_EVT_RX_DONE,
+    SIM_EVT_RX_TIMEOUT,
+    SIM_EVT_CAD_DONE,
+}SimEventType_t;
+
+typedef struct SimEvent_s
+{
+    uint64_t TimeUs;
+    SimEventType_t Type;
+}SimEvent_t;
+
+static struct
+{
+    SimChipMode_t Mode;
+    uint8_t Registers[0x1000];
+    uint8_t Buffer[256];
+    uint8_t TxBaseAddress;
+    uint8_t RxBaseAddress;
+    uint16_t IrqStatus;
+    uint16_t IrqMask;
+    uint16_t Dio1Mask;
+    uint8_t PacketType;
+    uint32_t Frequency;
+    uint8_t Sf;
+    uint8_t Bw;
+    uint8_t Cr;
+    uint16_t Preamble;
+    bool ImplicitHeader;
+    uint8_t PayloadLength;
+    bool CrcOn;
+    bool IqInverted;
+    uint16_t SymbTimeout;
+    bool RxContinuous;
+    uint64_t RxStartUs;
+    uint64_t RxOnSinceUs;
+    uint64_t RxTimerLimitUs;
+    SimEvent_t Events[SIM_MAX_EVENTS];
+    uint8_t NbEvents;
+    Sx126xSimFrame_t RxFrame;
+    uint8_t RxSize;
+    int16_t RxRssi;
+    int8_t RxSnr;
+    uint32_t Random;
+    uint64_t TcxoDelayUs;
+    uint64_t TcxoReadyUs;
+    uint8_t ImageCal[2];
+}Chip;
+
+static Sx126xSimFrame_t Air[SX126X_SIM_AIR_MAX_FRAMES];
+static bool AirUsed[SX126X_SIM_AIR_MAX_FRAMES];
+
+static Sx126xSimStats_t Stats;
+static Sx126xSimTxHook_t TxHook = NULL;
+static Sx126xSimRxHook_t RxHook = NULL;
+static DioIrqHandler *DioIrq = NULL;
+extern SemaphoreHandle_t loraIntSem;
+extern SemaphoreHandle_t loraRadioSem;
+static uint64_t Dio1IrqTimeUs = 0;
+
+/*!
+ * Radio lock, SX126xRadioLock. Also held by Sx126xSimProcess and
+ * Sx126xSimAirPush, which may run in a thread standing for the hardware.
+ */
+static pthread_mutex_t RadioLock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/*!
+ * SPI clock of the board, used to account the bus time of each transaction [Hz]
+ */
+static uint32_t SpiClock = SX126X_SPI_CLOCK_HZ;
+static SX126xSpiStats_t SpiStats;
+
+/*!
+ * BUSY waits: the chip model completes every command at once, except the
+ * image calibrations and the injected faults
+ */
+static SX126xBusyStats_t BusyStats;
+static uint32_t BusyTimeoutCount = 0;
+static uint32_t BusyFaultPeriod = 0;
+static uint32_t BusyFaultCounter = 0;
+static uint8_t BusyFaultCommand = RADIO_SET_TX;
+
+static RadioOperatingModes_t OperatingMode;
+
+/*
+ * Chip model
+ */
+
+uint32_t Sx126xSimBandwidthHz( uint8_t bw )
+{
+    switch( bw )
+    {
+    case LORA_BW_007: return 7812;
+    case LORA_BW_010: return 10417;
+    case LORA_BW_015: return 15625;
+    case LORA_BW_020: return 20833;
+    case LORA_BW_031: return 31250;
+    case LORA_BW_041: return 41667;
+    case LORA_BW_062: return 62500;
+    case LORA_BW_125: return 125000;
+    case LORA_BW_250: return 250000;
+    case LORA_BW_500: return 500000;
+    default: return 125000;
+    }
+}
+
+static double SimSymbolTimeUs( uint8_t sf, uint8_t bw )
+{
+    return ( double )( 1UL << sf ) * 1e6 / ( double )Sx126xSimBandwidthHz( bw );
+}
+
+uint64_t Sx126xSimTimeOnAirUs( uint8_t sf, uint8_t bw, uint8_t cr, uint16_t preamble,
+                               bool implicitHeader, uint8_t size, bool crcOn )
+{
+    double tSym = SimSymbolTimeUs( sf, bw );
+    bool ldro = tSym >= 16384.0;
+    double nPreamble;
+    int32_t num = 8 * size + ( crcOn ? 16 : 0 ) - 4 * sf + ( implicitHeader ? 0 : 20 );
+    int32_t den;
+
+    if( sf <= 6 )
+    {
+        nPreamble = ( ( preamble < 12 ) ? 12 : preamble ) + 6.25;
+        den = 4 * sf;
+    }
+    else
+    {
+        nPreamble = preamble + 4.25;
+        num += 8;
+        den = 4 * ( sf - ( ldro ? 2 : 0 ) );
+    }
+    if( num < 0 )
+    {
+        num = 0;
+    }
+    double nSymbols = nPreamble + 8 + ( double )( ( ( num + den - 1 ) / den ) * ( cr + 4 ) );
+
+    return ( uint64_t )ceil( nSymbols * tSym );
+}
+
+static void SimEventsClear( void )
+{
+    Chip.NbEvents = 0;
+}
+
+static void SimEventAdd( uint64_t timeUs, SimEventType_t type )
+{
+    uint8_t i;
+
+    if( Chip.NbEvents >= SIM_MAX_EVENTS )
+    {
+        return;
+    }
+    // Keep the events sorted by time
+    for( i = Chip.NbEvents; ( i > 0 ) && ( Chip.Events[i - 1].TimeUs > timeUs ); i-- )
+    {
+        Chip.Events[i] = Chip.Events[i - 1];
+    }
+    Chip.Events[i].TimeUs = timeUs;
+    Chip.Events[i].Type = type;
+    Chip.NbEvents++;
+}
+
+static void SimRaiseIrq( uint16_t irq )
+{
+    bool dio1Before = ( Chip.IrqStatus & Chip.Dio1Mask ) != 0;
+
+    Chip.IrqStatus |= irq & Chip.IrqMask;
+    if( ( dio1Before == false ) && ( ( Chip.IrqStatus & Chip.Dio1Mask ) != 0 ) )
+    {
+        Stats.Irqs++;
+        Dio1IrqTimeUs = HostClockGetUs( );
+        if( DioIrq != NULL )
+        {
+            DioIrq( );
+        }
+    }
+}
+
+static void SimAirPurge( void )
+{
+    uint64_t now = HostClockGetUs( );
+
+    for( uint8_t i = 0; i < SX126X_SIM_AIR_MAX_FRAMES; i++ )
+    {
+        if( ( AirUsed[i] == true ) && ( Air[i].EndUs < now ) )
+        {
+            AirUsed[i] = false;
+        }
+    }
+}
+
+/*!
+ * \brief Accounts the receiver on time up to now, before a mode change
+ */
+static void SimRxOnUpdate( void )
+{
+    uint64_t now = HostClockGetUs( );
+
+    if( ( Chip.Mode == SIM_CHIP_RX ) && ( now > Chip.RxOnSinceUs ) )
+    {
+        Stats.RxOnUs += now - Chip.RxOnSinceUs;
+    }
+    Chip.RxOnSinceUs = now;
+}
+
+/*!
+ * \brief Receive window of the chip settings, the receiver being ready at
+ *        startUs
+ */
+static void SimRxWindowGet( uint64_t startUs, Sx126xSimRxWindow_t *window )
+{
+    window->StartUs = startUs;
+    window->SymbLimitUs = SIM_TIME_INFINITE;
+    if( Chip.SymbTimeout != 0 )
+    {
+        window->SymbLimitUs = startUs + ( uint64_t )( Chip.SymbTimeout * SimSymbolTimeUs( Chip.Sf, Chip.Bw ) );
+    }
+    window->TimerLimitUs = Chip.RxTimerLimitUs;
+    window->Frequency = Chip.Frequency;
+    window->Sf = Chip.Sf;
+    window->Bw = Chip.Bw;
+    window->IqInverted = Chip.IqInverted;
+}
+
+/*!
+ * \brief Checks if the receive window locks on the frame
+ *
+ * \param [OUT] detect Preamble detection time [us]
+ */
+static bool SimRxDetect( const Sx126xSimRxWindow_t *window, const Sx126xSimFrame_t *frame, uint64_t *detect )
+{
+    double tSym = SimSymbolTimeUs( window->Sf, window->Bw );
+    uint64_t header;
+
+    if( ( frame->Sf != window->Sf ) || ( frame->Bw != window->Bw ) ||
+        ( frame->IqInverted != window->IqInverted ) ||
+        ( labs( ( long )frame->Frequency - ( long )window->Frequency ) > SIM_FREQ_TOLERANCE ) )
+    {
+        return false;
+    }
+    *detect = ( ( frame->StartUs > window->StartUs ) ? frame->StartUs : window->StartUs ) +
+              ( uint64_t )( SIM_PREAMBLE_DETECT_SYMBOLS * tSym );
+    header = frame->StartUs + ( uint64_t )( ( frame->Preamble + 4.25 + 8 ) * tSym );
+    return ( *detect <= frame->StartUs + ( uint64_t )( frame->Preamble * tSym ) ) &&
+           ( *detect <= window->SymbLimitUs ) && ( header <= window->TimerLimitUs );
+}
+
+/*!
+ * \brief Looks for a frame the receiver can lock on and schedules the
+ *        reception events, or the timeout when there is none.
+ */
+static void SimRxSchedule( const Sx126xSimRxWindow_t *window )
+{
+    double tSym = SimSymbolTimeUs( Chip.Sf, Chip.Bw );
+    int8_t found = -1;
+    uint64_t foundDetect = 0;
+
+    SimAirPurge( );
+    for( uint8_t i = 0; i < SX126X_SIM_AIR_MAX_FRAMES; i++ )
+    {
+        uint64_t detect;
+
+        if( ( AirUsed[i] == false ) || ( SimRxDetect( window, &Air[i], &detect ) == false ) )
+        {
+            continue;
+        }
+        if( ( found < 0 ) || ( detect < foundDetect ) )
+        {
+            found = i;
+            foundDetect = detect;
+        }
+    }
+
+    if( found >= 0 )
+    {
+        Chip.RxFrame = Air[found];
+        AirUsed[found] = false;
+        SimEventAdd( foundDetect, SIM_EVT_PREAMBLE_DETECTED );
+        SimEventAdd( Chip.RxFrame.StartUs + ( uint64_t )( ( Chip.RxFrame.Preamble + 4.25 + 8 ) * tSym ),
+                     SIM_EVT_HEADER_VALID );
+        SimEventAdd( Chip.RxFrame.EndUs, SIM_EVT_RX_DONE );
+    }
+    else
+    {
+        uint64_t limit = ( window->SymbLimitUs < window->TimerLimitUs ) ? window->SymbLimitUs : window->TimerLimitUs;
+
+        if( limit != SIM_TIME_INFINITE )
+        {
+            SimEventAdd( limit, SIM_EVT_RX_TIMEOUT );
+        }
+    }
+}
+
+/*!
+ * \brief Time at which the RF front end is ready. After a wake-up from sleep
+ *        the chip waits for the TCXO before starting RX or TX.
+ */
+static uint64_t SimRfStartTime( void )
+{
+    uint64_t now = HostClockGetUs( );
+
+    return ( Chip.TcxoReadyUs > now ) ? Chip.TcxoReadyUs : now;
+}
+
+/*!
+ * \brief Sets the image calibration band of a reset or a cold start
+ */
+static void SimImageCalDefault( void )
+{
+    Chip.ImageCal[0] = SIM_IMAGE_CAL_DEFAULT_MIN;
+    Chip.ImageCal[1] = SIM_IMAGE_CAL_DEFAULT_MAX;
+}
+
+/*!
+ * \brief Accounts a TX or RX out of the band the image is calibrated for,
+ *        the receiver would lose sensitivity
+ */
+static void SimImageCalCheck( void )
+{
+    if( ( Chip.Frequency < ( uint32_t )Chip.ImageCal[0] * 4000000 ) ||
+        ( Chip.Frequency > ( uint32_t )Chip.ImageCal[1] * 4000000 ) )
+    {
+        Stats.Uncalibrated++;
+    }
+}
+
+/*!
+ * \brief BUSY wait of a command the chip takes time to complete
+ */
+static void SimBusyWait( uint32_t us )
+{
+    uint8_t bucket = 0;
+
+    HostClockAdvanceUs( us );
+    while( ( bucket < ( SX126X_BUSY_HISTOGRAM_SIZE - 1 ) ) && ( us >= ( 4UL << ( 2 * bucket ) ) ) )
+    {
+        bucket++;
+    }
+    BusyStats.Histogram[bucket]++;
+    if( us > BusyStats.MaxUs )
+    {
+        BusyStats.MaxUs = us;
+    }
+}
+
+static void SimStartTx( void )
+{
+    Sx126xSimFrame_t frame;
+
+    SimImageCalCheck( );
+    memset( &frame, 0, sizeof( frame ) );
+    frame.StartUs = SimRfStartTime( );
+    frame.Frequency = Chip.Frequency;
+    frame.Sf = Chip.Sf;
+    frame.Bw = Chip.Bw;
+    frame.Cr = Chip.Cr;
+    frame.Preamble = Chip.Preamble;
+    frame.ImplicitHeader = Chip.ImplicitHeader;
+    frame.CrcOn = Chip.CrcOn;
+    frame.IqInverted = Chip.IqInverted;
+    frame.Size = Chip.PayloadLength;
+    for( uint16_t i = 0; i < frame.Size; i++ )
+    {
+        frame.Payload[i] = Chip.Buffer[( uint8_t )( Chip.TxBaseAddress + i )];
+    }
+    frame.EndUs = frame.StartUs + Sx126xSimTimeOnAirUs( frame.Sf, frame.Bw, frame.Cr, frame.Preamble,
+                                                        frame.ImplicitHeader, frame.Size, frame.CrcOn );
+
+    SimRxOnUpdate( );
+    Chip.Mode = SIM_CHIP_TX;
+    SimEventsClear( );
+    SimEventAdd( frame.EndUs, SIM_EVT_TX_DONE );
+    Stats.TxFrames++;
+
+    if( TxHook != NULL )
+    {
+        TxHook( &frame );
+    }
+}
+
+static void SimStartRx( uint32_t timeout )
+{
+    uint64_t now = SimRfStartTime( );
+    Sx126xSimRxWindow_t window;
+
+    SimImageCalCheck( );
+    SimRxOnUpdate( );
+    Chip.Mode = SIM_CHIP_RX;
+    Chip.RxStartUs = now;
+    Chip.RxOnSinceUs = now;
+    Chip.RxContinuous = timeout == 0xFFFFFF;
+    if( ( timeout == 0 ) || ( timeout == 0xFFFFFF ) )
+    {
+        Chip.RxTimerLimitUs = SIM_TIME_INFINITE;
+    }
+    else
+    {
+        Chip.RxTimerLimitUs = now + ( uint64_t )( timeout * SIM_RX_TIMEOUT_STEP_US );
+    }
+    SimEventsClear( );
+    SimRxWindowGet( now, &window );
+    if( RxHook != NULL )
+    {
+        RxHook( &window );
+    }
+    SimRxSchedule( &window );
+}
+
+static void SimWriteCommand( uint8_t opcode, const uint8_t *buffer, uint16_t size )
+{
+    switch( opcode )
+    {
+    case RADIO_SET_SLEEP:
+        SimRxOnUpdate( );
+        SimEventsClear( );
+        Chip.Mode = SIM_CHIP_SLEEP;
+        // A cold start calibrates all over again
+        if( ( buffer[0] & 0x04 ) == 0 )
+        {
+            SimImageCalDefault( );
+        }
+        break;
+    case RADIO_SET_STANDBY:
+        SimRxOnUpdate( );
+        SimEventsClear( );
+        Chip.Mode = SIM_CHIP_STDBY;
+        break;
+    case RADIO_SET_FS:
+        SimRxOnUpdate( );
+        SimEventsClear( );
+        Chip.Mode = SIM_CHIP_FS;
+        break;
+    case RADIO_SET_TX:
+        SimStartTx( );
+        break;
+    case RADIO_SET_RX:
+        SimStartRx( ( ( uint32_t )buffer[0] << 16 ) | ( ( uint32_t )buffer[1] << 8 ) | buffer[2] );
+        break;
+    case RADIO_SET_CAD:
+        // No activity on the simulated air is reported to CAD
+        SimRxOnUpdate( );
+        Chip.Mode = SIM_CHIP_CAD;
+        SimEventsClear( );
+        SimEventAdd( HostClockGetUs( ) + ( uint64_t )( 2 * SimSymbolTimeUs( Chip.Sf, Chip.Bw ) ), SIM_EVT_CAD_DONE );
+        break;
+    case RADIO_SET_TCXOMODE:
+        Chip.TcxoDelayUs = ( uint64_t )( ( ( ( uint32_t )buffer[1] << 16 ) | ( ( uint32_t )buffer[2] << 8 ) | buffer[3] ) *
+                                         SIM_RX_TIMEOUT_STEP_US );
+        break;
+    case RADIO_CALIBRATE:
+        SimBusyWait( SIM_CALIBRATE_US );
+        break;
+    case RADIO_CALIBRATEIMAGE:
+        Chip.ImageCal[0] = buffer[0];
+        Chip.ImageCal[1] = buffer[1];
+        SimBusyWait( SIM_IMAGE_CAL_US );
+        break;
+    case RADIO_SET_PACKETTYPE:
+        Chip.PacketType = buffer[0];
+        break;
+    case RADIO_SET_RFFREQUENCY:
+    {
+        uint32_t steps = ( ( uint32_t )buffer[0] << 24 ) | ( ( uint32_t )buffer[1] << 16 ) |
+                         ( ( uint32_t )buffer[2] << 8 ) | buffer[3];
+        Chip.Frequency = ( uint32_t )( ( ( uint64_t )steps * SIM_XTAL_FREQ + ( 1 << 24 ) ) >> 25 );
+        break;
+    }
+    case RADIO_SET_MODULATIONPARAMS:
+        if( Chip.PacketType == PACKET_TYPE_LORA )
+        {
+            Chip.Sf = buffer[0];
+            Chip.Bw = buffer[1];
+            Chip.Cr = buffer[2];
+        }
+        break;
+    case RADIO_SET_PACKETPARAMS:
+        if( Chip.PacketType == PACKET_TYPE_LORA )
+        {
+            Chip.Preamble = ( ( uint16_t )buffer[0] << 8 ) | buffer[1];
+            Chip.ImplicitHeader = buffer[2] == LORA_PACKET_FIXED_LENGTH;
+            Chip.PayloadLength = buffer[3];
+            Chip.CrcOn = buffer[4] == LORA_CRC_ON;
+            Chip.IqInverted = buffer[5] == LORA_IQ_INVERTED;
+        }
+        break;
+    case RADIO_SET_BUFFERBASEADDRESS:
+        Chip.TxBaseAddress = buffer[0];
+        Chip.RxBaseAddress = buffer[1];
+        break;
+    case RADIO_CFG_DIOIRQ:
+        Chip.IrqMask = ( ( uint16_t )buffer[0] << 8 ) | buffer[1];
+        Chip.Dio1Mask = ( ( uint16_t )buffer[2] << 8 ) | buffer[3];
+        break;
+    case RADIO_CLR_IRQSTATUS:
+        Chip.IrqStatus &= ~( ( ( uint16_t )buffer[0] << 8 ) | buffer[1] );
+        break;
+    case RADIO_SET_LORASYMBTIMEOUT:
+    {
+        uint8_t reg = buffer[0];
+        uint8_t exp = 0;
+
+        // reg = mant << ( 2 * exp + 1 ), mant < 32
+        if( reg == 0 )
+        {
+            Chip.SymbTimeout = 0;
+            break;
+        }
+        while( ( ( reg >> ( 2 * exp + 1 ) ) > 31 ) || ( ( ( reg >> ( 2 * exp + 1 ) ) << ( 2 * exp + 1 ) ) != reg ) )
+        {
+            exp++;
+        }
+        Chip.SymbTimeout = ( uint16_t )( ( reg >> ( 2 * exp + 1 ) ) << ( 2 * exp + 1 ) );
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static uint8_t SimStatusByte( void )
+{
+    uint8_t mode;
+
+    switch( Chip.Mode )
+    {
+    case SIM_CHIP_FS: mode = 0x4; break;
+    case SIM_CHIP_RX: mode = 0x5; break;
+    case SIM_CHIP_TX: mode = 0x6; break;
+    default: mode = 0x2; break;
+    }
+    return mode << 4;
+}
+
+static void SimReadCommand( uint8_t opcode, uint8_t *buffer, uint16_t size )
+{
+    uint8_t data[8];
+
+    memset( data, 0, sizeof( data ) );
+    switch( opcode )
+    {
+    case RADIO_GET_STATUS:
+        data[0] = SimStatusByte( );
+        break;
+    case RADIO_GET_IRQSTATUS:
+        data[0] = ( uint8_t )( Chip.IrqStatus >> 8 );
+        data[1] = ( uint8_t )Chip.IrqStatus;
+        break;
+    case RADIO_GET_RXBUFFERSTATUS:
+        data[0] = Chip.RxSize;
+        data[1] = Chip.RxBaseAddress;
+        break;
+    case RADIO_GET_PACKETSTATUS:
+        data[0] = ( uint8_t )( -Chip.RxRssi * 2 );
+        data[1] = ( uint8_t )( Chip.RxSnr * 4 );
+        data[2] = ( uint8_t )( -Chip.RxRssi * 2 );
+        break;
+    case RADIO_GET_RSSIINST:
+        data[0] = 240;
+        break;
+    case RADIO_GET_PACKETTYPE:
+        data[0] = Chip.PacketType;
+        break;
+    default:
+        break;
+    }
+    memcpy( buffer, data, ( size < sizeof( data ) ) ? size : sizeof( data ) );
+}
+
+static uint8_t SimReadRegister( uint16_t address )
+{
+    if( ( address >= RANDOM_NUMBER_GENERATORBASEADDR ) && ( address < RANDOM_NUMBER_GENERATORBASEADDR + 4 ) )
+    {
+        Chip.Random = Chip.Random * 1103515245 + 12345;
+        return ( uint8_t )( Chip.Random >> 16 );
+    }
+    return Chip.Registers[address & 0x0FFF];
+}
+
+static void SimSpiTransaction( uint8_t opcode, uint16_t bytes )
+{
+    // The CPU is busy clocking the bus
+    HostClockAdvanceUs( ( bytes * 8ULL * 1000000ULL + SpiClock - 1 ) / SpiClock );
+    Stats.Transactions++;
+    Stats.Bytes += bytes;
+    Stats.Commands[opcode]++;
+}
+
+static void SimSpiStatsUpdate( SX126xSpiCall_t call, uint16_t bytes, uint64_t startUs )
+{
+    uint32_t elapsed = ( uint32_t )( HostClockGetUs( ) - startUs );
+    SX126xSpiCallStats_t *stats = &SpiStats.Call[call];
+
+    stats->Calls++;
+    stats->Bytes += bytes;
+    stats->TotalUs += elapsed;
+    if( elapsed > stats->MaxUs )
+    {
+        stats->MaxUs = elapsed;
+    }
+}
+
+void Sx126xSimReset( void )
+{
+    memset( &Chip, 0, sizeof( Chip ) );
+    Chip.Mode = SIM_CHIP_STDBY;
+    Chip.RxTimerLimitUs = SIM_TIME_INFINITE;
+    Chip.Random = 0x5EED;
+    Chip.Frequency = SIM_FREQ_DEFAULT;
+    SimImageCalDefault( );
+    memset( AirUsed, 0, sizeof( AirUsed ) );
+    memset( &Stats, 0, sizeof( Stats ) );
+    memset( &SpiStats, 0, sizeof( SpiStats ) );
+    memset( &BusyStats, 0, sizeof( BusyStats ) );
+    BusyFaultCounter = 0;
+}
+
+void Sx126xSimSetBusyFault( uint32_t period, uint8_t command )
+{
+    BusyFaultPeriod = period;
+    BusyFaultCommand = command;
+    BusyFaultCounter = 0;
+}
+
+/*!
+ * \brief Checks if the command hangs the chip
+ */
+static bool SimBusyFault( uint8_t command )
+{
+    if( ( command != BusyFaultCommand ) || ( BusyFaultPeriod == 0 ) )
+    {
+        return false;
+    }
+    if( ++BusyFaultCounter < BusyFaultPeriod )
+    {
+        return false;
+    }
+    BusyFaultCounter = 0;
+    return true;
+}
+
+void Sx126xSimSetTxHook( Sx126xSimTxHook_t hook )
+{
+    TxHook = hook;
+}
+
+void Sx126xSimSetRxHook( Sx126xSimRxHook_t hook )
+{
+    RxHook = hook;
+}
+
+bool Sx126xSimRxWindowCatches( const Sx126xSimRxWindow_t *window, const Sx126xSimFrame_t *frame )
+{
+    uint64_t detect;
+
+    return SimRxDetect( window, frame, &detect );
+}
+
+bool Sx126xSimAirPush( const Sx126xSimFrame_t *frame )
+{
+    bool pushed = false;
+
+    SX126xRadioLock( );
+    SimAirPurge( );
+    for( uint8_t i = 0; i < SX126X_SIM_AIR_MAX_FRAMES; i++ )
+    {
+        if( AirUsed[i] == false )
+        {
+            Air[i] = *frame;
+            Air[i].EndUs = frame->StartUs + Sx126xSimTimeOnAirUs( frame->Sf, frame->Bw, frame->Cr, frame->Preamble,
+                                                                  frame->ImplicitHeader, frame->Size, frame->CrcOn );
+            AirUsed[i] = true;
+            // A receiver already listening may lock on the new frame, the
+            // continuous receiver has no timeout pending
+            if( ( Chip.Mode == SIM_CHIP_RX ) && ( ( Chip.NbEvents == 0 ) ||
+                ( ( Chip.NbEvents == 1 ) && ( Chip.Events[0].Type == SIM_EVT_RX_TIMEOUT ) ) ) )
+            {
+                Sx126xSimRxWindow_t window;
+
+                SimEventsClear( );
+                SimRxWindowGet( Chip.RxStartUs, &window );
+                SimRxSchedule( &window );
+            }
+            pushed = true;
+            break;
+        }
+    }
+    SX126xRadioUnlock( );
+    return pushed;
+}
+
+bool Sx126xSimGetNextEvent( uint64_t *us )
+{
+    bool pending;
+
+    SX126xRadioLock( );
+    pending = Chip.NbEvents > 0;
+    if( pending == true )
+    {
+        *us = Chip.Events[0].TimeUs;
+    }
+    SX126xRadioUnlock( );
+    return pending;
+}
+
+void Sx126xSimProcess( void )
+{
+    uint64_t now;
+
+    SX126xRadioLock( );
+    now = HostClockGetUs( );
+
+    while( ( Chip.NbEvents > 0 ) && ( Chip.Events[0].TimeUs <= now ) )
+    {
+        SimEvent_t evt = Chip.Events[0];
+
+        Chip.NbEvents--;
+        memmove( &Chip.Events[0], &Chip.Events[1], Chip.NbEvents * sizeof( SimEvent_t ) );
+
+        switch( evt.Type )
+        {
+        case SIM_EVT_TX_DONE:
+            Chip.Mode = SIM_CHIP_STDBY;
+            SimRaiseIrq( IRQ_TX_DONE );
+            break;
+        case SIM_EVT_PREAMBLE_DETECTED:
+            SimRaiseIrq( IRQ_PREAMBLE_DETECTED );
+            break;
+        case SIM_EVT_HEADER_VALID:
+            SimRaiseIrq( IRQ_HEADER_VALID );
+            break;
+        case SIM_EVT_RX_DONE:
+            for( uint16_t i = 0; i < Chip.RxFrame.Size; i++ )
+            {
+                Chip.Buffer[( uint8_t )( Chip.RxBaseAddress + i )] = Chip.RxFrame.Payload[i];
+            }
+            Chip.RxSize = Chip.RxFrame.Size;
+            Chip.RxRssi = Chip.RxFrame.Rssi;
+            Chip.RxSnr = Chip.RxFrame.Snr;
+            Stats.RxFrames++;
+            SimRxOnUpdate( );
+            if( Chip.RxContinuous == false )
+            {
+                Chip.Mode = SIM_CHIP_STDBY;
+            }
+            SimRaiseIrq( IRQ_RX_DONE );
+            if( ( Chip.Mode == SIM_CHIP_RX ) && ( Chip.NbEvents == 0 ) )
+            {
+                Sx126xSimRxWindow_t window;
+
+                Chip.RxStartUs = now;
+                SimRxWindowGet( now, &window );
+                SimRxSchedule( &window );
+            }
+            break;
+        case SIM_EVT_RX_TIMEOUT:
+            SimRxOnUpdate( );
+            Chip.Mode = SIM_CHIP_STDBY;
+            Stats.RxTimeouts++;
+            SimRaiseIrq( IRQ_RX_TX_TIMEOUT );
+            break;
+        case SIM_EVT_CAD_DONE:
+            Chip.Mode = SIM_CHIP_STDBY;
+            SimRaiseIrq( IRQ_CAD_DONE );
+            break;
+        }
+    }
+    SX126xRadioUnlock( );
+}
+
+const Sx126xSimStats_t* Sx126xSimGetStats( void )
+{
+    return &Stats;
+}
+
+/*
+ * sx126x-board.h hooks
+ */
+
+void SX126xIOInit( void )
+{
+}
+
+void SX126xIoReInit( void )
+{
+}
+
+void SX126xIoIrqInit( DioIrqHandler dioIrq )
+{
+    DioIrq = dioIrq;
+}
+
+void SX126xIoDio1WakeUp( bool enable )
+{
+    // The simulated light sleep ( RtcLightSleep ) ends on DIO1 by itself and
+    // the ISR runs at the IRQ time
+}
+
+void SX126xIoDeInit( void )
+{
+    DioIrq = NULL;
+}
+
+void SX126xReset( void )
+{
+    SX126xRadioLock( );
+    delay( 10 );
+    SimRxOnUpdate( );
+    SimEventsClear( );
+    Chip.Mode = SIM_CHIP_STDBY;
+    Chip.IrqStatus = 0;
+    Chip.IrqMask = 0;
+    Chip.Dio1Mask = 0;
+    // The configuration is lost, the resume checks the packet type
+    Chip.PacketType = PACKET_TYPE_GFSK;
+    Chip.TcxoDelayUs = 0;
+    Chip.Frequency = SIM_FREQ_DEFAULT;
+    SimImageCalDefault( );
+    delay( 20 );
+    SX126xRadioUnlock( );
+}
+
+void SX126xRadioLock( void )
+{
+    pthread_mutex_lock( &RadioLock );
+}
+
+void SX126xRadioUnlock( void )
+{
+    pthread_mutex_unlock( &RadioLock );
+}
+
+void SX126xWaitOnBusy( void )
+{
+    BusyStats.Histogram[0]++;
+}
+
+uint32_t SX126xGetBusyTimeoutCount( void )
+{
+    return BusyTimeoutCount;
+}
+
+void SX126xGetBusyStats( SX126xBusyStats_t *stats )
+{
+    *stats = BusyStats;
+}
+
+void SX126xResetBusyStats( void )
+{
+    memset( &BusyStats, 0, sizeof( BusyStats ) );
+}
+
+void SX126xWakeup( void )
+{
+    SX126xRadioLock( );
+    SimSpiTransaction( RADIO_GET_STATUS, 2 );
+    if( Chip.Mode == SIM_CHIP_SLEEP )
+    {
+        Chip.Mode = SIM_CHIP_STDBY;
+        Chip.TcxoReadyUs = HostClockGetUs( ) + Chip.TcxoDelayUs;
+    }
+    SX126xRadioUnlock( );
+}
+
+void SX126xWriteCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( ( uint8_t )command, 1 + size );
+    if( SimBusyFault( ( uint8_t )command ) == true )
+    {
+        // The command is lost and the board gives up waiting on BUSY
+        HostClockAdvanceUs( SX126X_BUSY_TIMEOUT_US );
+        BusyStats.Histogram[SX126X_BUSY_HISTOGRAM_SIZE - 1]++;
+        BusyStats.Timeouts++;
+        BusyStats.MaxUs = SX126X_BUSY_TIMEOUT_US;
+        BusyTimeoutCount++;
+        SX126xShadowInvalidate( );
+        xSemaphoreGiveFromISR( ( loraRadioSem != NULL ) ? loraRadioSem : loraIntSem, NULL );
+    }
+    else
+    {
+        SimWriteCommand( ( uint8_t )command, buffer, size );
+    }
+    SimSpiStatsUpdate( SX126X_SPI_WRITE_COMMAND, 1 + size, start );
+    SX126xRadioUnlock( );
+}
+
+void SX126xReadCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( ( uint8_t )command, 2 + size );
+    SimReadCommand( ( uint8_t )command, buffer, size );
+    SimSpiStatsUpdate( SX126X_SPI_READ_COMMAND, 2 + size, start );
+    SX126xRadioUnlock( );
+}
+
+void SX126xWriteRegisters( uint16_t address, uint8_t *buffer, uint16_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( RADIO_WRITE_REGISTER, 3 + size );
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        Chip.Registers[( address + i ) & 0x0FFF] = buffer[i];
+    }
+    SimSpiStatsUpdate( SX126X_SPI_WRITE_REGISTERS, 3 + size, start );
+    SX126xRadioUnlock( );
+}
+
+void SX126xWriteRegister( uint16_t address, uint8_t value )
+{
+    SX126xWriteRegisters( address, &value, 1 );
+}
+
+void SX126xReadRegisters( uint16_t address, uint8_t *buffer, uint16_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( RADIO_READ_REGISTER, 4 + size );
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        buffer[i] = SimReadRegister( address + i );
+    }
+    SimSpiStatsUpdate( SX126X_SPI_READ_REGISTERS, 4 + size, start );
+    SX126xRadioUnlock( );
+}
+
+uint8_t SX126xReadRegister( uint16_t address )
+{
+    uint8_t data;
+
+    SX126xReadRegisters( address, &data, 1 );
+    return data;
+}
+
+void SX126xWriteBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( RADIO_WRITE_BUFFER, 2 + size );
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        Chip.Buffer[( uint8_t )( offset + i )] = buffer[i];
+    }
+    SimSpiStatsUpdate( SX126X_SPI_WRITE_BUFFER, 2 + size, start );
+    SX126xRadioUnlock( );
+}
+
+void SX126xReadBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
+{
+    uint64_t start;
+
+    SX126xRadioLock( );
+    start = HostClockGetUs( );
+    SX126xCheckDeviceReady( );
+    SimSpiTransaction( RADIO_READ_BUFFER, 3 + size );
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        buffer[i] = Chip.Buffer[( uint8_t )( offset + i )];
+    }
+    SimSpiStatsUpdate( SX126X_SPI_READ_BUFFER, 3 + size, start );
+    SX126xRadioUnlock( );
+}
+
+void SX126xSetRfTxPower( int8_t power )
+{
+    LoRaEnergySetTxPower( power );
+    SX126xSetTxParams( power, RADIO_RAMP_40_US );
+}
+
+uint8_t SX126xGetPaSelect( uint32_t channel )
+{
+    return SX1262;
+}
+
+void SX126xAntSwOn( void )
+{
+}
+
+void SX126xAntSwOff( void )
+{
+}
+
+void SX126xRXena( void )
+{
+}
+
+void SX126xTXena( void )
+{
+}
+
+bool SX126xCheckRfFrequency( uint32_t frequency )
+{
+    return true;
+}
+
+void SX126xGetStats( uint16_t *nb_pkt_received, uint16_t *nb_pkt_crc_error, uint16_t *nb_pkt_length_error )
+{
+    uint8_t buf[6];
+
+    SX126xReadCommand( RADIO_GET_STATS, buf, 6 );
+
+    *nb_pkt_received = ( buf[0] << 8 ) | buf[1];
+    *nb_pkt_crc_error = ( buf[2] << 8 ) | buf[3];
+    *nb_pkt_length_error = ( buf[4] << 8 ) | buf[5];
+}
+
+void SX126xResetStats( void )
+{
+    uint8_t buf[6] = { 0x00 };
+
+    SX126xWriteCommand( RADIO_RESET_STATS, buf, 6 );
+}
+
+void SX126xSetSpiClock( uint32_t frequency )
+{
+    if( frequency > SX126X_SPI_CLOCK_MAX_HZ )
+    {
+        frequency = SX126X_SPI_CLOCK_MAX_HZ;
+    }
+    SpiClock = frequency;
+}
+
+uint32_t SX126xGetSpiClock( void )
+{
+    return SpiClock;
+}
+
+void SX126xGetSpiStats( SX126xSpiStats_t *stats )
+{
+    *stats = SpiStats;
+}
+
+void SX126xResetSpiStats( void )
+{
+    memset( &SpiStats, 0, sizeof( SpiStats ) );
+}
+
+void SX126xRxDoneLatencyUpdate( void )
+{
+    uint32_t latency = ( uint32_t )( HostClockGetUs( ) - Dio1IrqTimeUs );
+
+    SpiStats.RxDone++;
+    SpiStats.RxDoneLatencyUs = latency;
+    SpiStats.RxDoneLatencyTotalUs += latency;
+    if( latency > SpiStats.RxDoneLatencyMaxUs )
+    {
+        SpiStats.RxDoneLatencyMaxUs = latency;
+    }
+}
+
+uint64_t SX126xGetDio1IrqTimeUs( void )
+{
+    uint64_t time;
+
+    // Written by Sx126xSimProcess
+    SX126xRadioLock( );
+    time = Dio1IrqTimeUs;
+    SX126xRadioUnlock( );
+    return time;
+}
+
+uint32_t SX126xGetDio1PinState( void )
+{
+    uint32_t state;
+
+    SX126xRadioLock( );
+    state = ( ( Chip.IrqStatus & Chip.Dio1Mask ) != 0 ) ? 1 : 0;
+    SX126xRadioUnlock( );
+    return state;
+}
+
+RadioOperatingModes_t SX126xGetOperatingMode( void )
+{
+    return OperatingMode;
+}
+
+void SX126xSetOperatingMode( RadioOperatingModes_t mode )
+{
+    OperatingMode = mode;
+    LoRaEnergySetRadioMode( mode );
+}
+
+uint32_t SX126xGetBoardTcxoWakeupTime( void )
+{
+    return 5;
+}
+
+uint8_t SX126xGetDeviceId( void )
+{
+    return SX1262;
+}
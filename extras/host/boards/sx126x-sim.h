@@ -0,0 +1,176 @@
+/*!
+ * \file      sx126x-sim.h
+ *
+ * \brief     Simulated SX126x transceiver behind the sx126x-board.h hooks
+ *
+ * \remark    The model decodes the SPI commands issued by the driver, keeps
+ *            the register file and data buffer, computes LoRa time on air and
+ *            raises the DIO1 interrupt on TX done, preamble/header detection,
+ *            RX done and RX timeout. Frames transmitted by the node are handed
+ *            to a hook, frames to be received are pushed on the simulated air
+ *            and the receive windows opened by the node to another hook.
+ */
+#ifndef __SX126X_SIM_H__
+#define __SX126X_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * Maximum number of frames waiting on the simulated air
+ */
+#define SX126X_SIM_AIR_MAX_FRAMES                   8
+
+/*!
+ * \brief LoRa frame on the simulated air
+ */
+typedef struct Sx126xSimFrame_s
+{
+    uint64_t StartUs;           //!< Start of the preamble [us]
+    uint64_t EndUs;             //!< End of the last symbol [us], filled by Sx126xSimAirPush
+    uint32_t Frequency;         //!< RF frequency [Hz]
+    uint8_t Sf;                 //!< Spreading factor 5..12
+    uint8_t Bw;                 //!< Bandwidth register value, see RadioLoRaBandwidths_t
+    uint8_t Cr;                 //!< Coding rate register value 1..4
+    uint16_t Preamble;          //!< Preamble length [symbols]
+    bool ImplicitHeader;        //!< Fixed length packet
+    bool CrcOn;                 //!< Payload CRC present
+    bool IqInverted;            //!< IQ inverted (downlinks)
+    int16_t Rssi;               //!< RSSI seen by the receiver [dBm]
+    int8_t Snr;                 //!< SNR seen by the receiver [dB]
+    uint8_t Size;               //!< Payload size
+    uint8_t Payload[255];       //!< Payload
+}Sx126xSimFrame_t;
+
+/*!
+ * \brief Receive window opened by the node
+ */
+typedef struct Sx126xSimRxWindow_s
+{
+    uint64_t StartUs;           //!< Receiver ready [us]
+    uint64_t SymbLimitUs;       //!< End of the symbol timeout, UINT64_MAX when none [us]
+    uint64_t TimerLimitUs;      //!< End of the RX timer, UINT64_MAX when none [us]
+    uint32_t Frequency;         //!< RF frequency [Hz]
+    uint8_t Sf;                 //!< Spreading factor 5..12
+    uint8_t Bw;                 //!< Bandwidth register value, see RadioLoRaBandwidths_t
+    bool IqInverted;            //!< IQ inverted (downlinks)
+}Sx126xSimRxWindow_t;
+
+/*!
+ * \brief SPI traffic counters
+ */
+typedef struct Sx126xSimStats_s
+{
+    uint32_t Transactions;      //!< Number of SPI transactions (CS assertions)
+    uint32_t Bytes;             //!< Number of bytes clocked on the bus
+    uint32_t Commands[256];     //!< Number of transactions per opcode
+    uint32_t TxFrames;          //!< Frames transmitted
+    uint32_t RxFrames;          //!< Frames received
+    uint32_t RxTimeouts;        //!< RX windows closed without a frame
+    uint64_t RxOnUs;            //!< Time spent with the receiver on [us]
+    uint32_t Irqs;              //!< DIO1 rising edges
+    uint32_t Uncalibrated;      //!< TX and RX out of the band the image is calibrated for
+}Sx126xSimStats_t;
+
+/*!
+ * \brief Callback invoked when the node starts a transmission
+ *
+ * \param [IN] frame Transmitted frame, StartUs/EndUs filled in
+ */
+typedef void ( *Sx126xSimTxHook_t )( const Sx126xSimFrame_t *frame );
+
+/*!
+ * \brief Callback invoked when the node opens a receive window, before the
+ *        chip looks for a frame on the air
+ *
+ * \param [IN] window Receive window
+ */
+typedef void ( *Sx126xSimRxHook_t )( const Sx126xSimRxWindow_t *window );
+
+/*!
+ * \brief Resets the chip model, the air and the statistics
+ */
+void Sx126xSimReset( void );
+
+/*!
+ * \brief Registers the hook called on every transmission
+ */
+void Sx126xSimSetTxHook( Sx126xSimTxHook_t hook );
+
+/*!
+ * \brief Registers the hook called on every receive window
+ */
+void Sx126xSimSetRxHook( Sx126xSimRxHook_t hook );
+
+/*!
+ * \brief Checks if a receive window locks on a frame, with the preamble
+ *        detection rule of the chip model
+ *
+ * \param [IN] window Receive window
+ * \param [IN] frame  Frame on the air. StartUs and Preamble must be set.
+ * \retval caught true if the preamble is detected and the header received
+ *                before the window closes
+ */
+bool Sx126xSimRxWindowCatches( const Sx126xSimRxWindow_t *window, const Sx126xSimFrame_t *frame );
+
+/*!
+ * \brief Puts a frame on the air. Frames overlapping a receive window with
+ *        matching parameters are received by the node.
+ *
+ * \param [IN] frame Frame to transmit. StartUs must be set.
+ * \retval status false if the air queue is full
+ */
+bool Sx126xSimAirPush( const Sx126xSimFrame_t *frame );
+
+/*!
+ * \brief Gets the time of the next pending chip event
+ *
+ * \param [OUT] us Absolute time [us]
+ * \retval pending false if the chip has nothing scheduled
+ */
+bool Sx126xSimGetNextEvent( uint64_t *us );
+
+/*!
+ * \brief Runs the chip events due at the current simulated time. Raises
+ *        the DIO1 interrupt when required.
+ */
+void Sx126xSimProcess( void );
+
+/*!
+ * \brief Computes the LoRa time on air of a frame
+ *
+ * \retval airTime Time on air [us]
+ */
+uint64_t Sx126xSimTimeOnAirUs( uint8_t sf, uint8_t bw, uint8_t cr, uint16_t preamble,
+                               bool implicitHeader, uint8_t size, bool crcOn );
+
+/*!
+ * \brief Converts a bandwidth register value to Hz
+ */
+uint32_t Sx126xSimBandwidthHz( uint8_t bw );
+
+/*!
+ * \brief Returns the SPI and air statistics
+ */
+const Sx126xSimStats_t* Sx126xSimGetStats( void );
+
+/*!
+ * \brief Makes one command out of every period hang: BUSY stays high until
+ *        the board gives up after SX126X_BUSY_TIMEOUT_US.
+ *
+ * \param [IN] period  Period of the fault in commands, 0 disables it
+ * \param [IN] command Opcode of the commands hanging, RADIO_SET_TX,
+ *                     RADIO_SET_STANDBY...
+ */
+void Sx126xSimSetBusyFault( uint32_t period, uint8_t command );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SX126X_SIM_H__
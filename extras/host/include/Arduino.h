@@ -0,0 +1,109 @@
+/*!
+ * \file      Arduino.h
+ *
+ * \brief     Minimal Arduino/ESP-IDF shim used by the host build of the
+ *            LoRaMac stack.
+ *
+ * \remark    Only the symbols referenced by the C sources under src/ are
+ *            provided here. Attribute macros expand to nothing, the FreeRTOS
+ *            semaphores and tasks are stand-ins scheduled on the simulated
+ *            clock ( rtos-host.c ) and
+ *            delay()/millis() run on the simulated clock.
+ */
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* SemaphoreHandle_t;
+typedef void* TaskHandle_t;
+typedef void ( *TaskFunction_t )( void* );
+
+#define pdFALSE                                     ( ( BaseType_t )0 )
+#define pdTRUE                                      ( ( BaseType_t )1 )
+#define pdPASS                                      pdTRUE
+#define portMAX_DELAY                               ( ( TickType_t )0xFFFFFFFF )
+#define tskNO_AFFINITY                              ( ( BaseType_t )0x7FFFFFFF )
+
+/*!
+ * \brief Creates a binary semaphore, not given
+ */
+SemaphoreHandle_t xSemaphoreCreateBinary( void );
+
+/*!
+ * \brief Takes the semaphore
+ *
+ * \param [IN] ticks Wait on the simulated clock [ms], 0 polls, portMAX_DELAY
+ *                   waits forever. The main thread only polls.
+ */
+BaseType_t xSemaphoreTake( SemaphoreHandle_t sem, TickType_t ticks );
+
+/*!
+ * \brief Gives the semaphore, a higher priority task waiting for it preempts
+ *        the calling task
+ */
+BaseType_t xSemaphoreGive( SemaphoreHandle_t sem );
+
+/*!
+ * \brief Gives the semaphore, same as xSemaphoreGive
+ */
+BaseType_t xSemaphoreGiveFromISR( SemaphoreHandle_t sem, BaseType_t *higherPriorityTaskWoken );
+
+/*!
+ * \brief Gets 1 if the semaphore is given, 0 otherwise
+ */
+UBaseType_t uxSemaphoreGetCount( SemaphoreHandle_t sem );
+
+/*!
+ * \brief Runs the task in a thread, from the next HostTasksRun on. The stack
+ *        is painted for uxTaskGetStackHighWaterMark and at least
+ *        PTHREAD_STACK_MIN. The tasks share a single simulated core by
+ *        priority, the core asked for is ignored.
+ *
+ * \param [IN] stackDepth Stack size [bytes], as ESP-IDF
+ */
+BaseType_t xTaskCreatePinnedToCore( TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                    UBaseType_t priority, TaskHandle_t *handle, BaseType_t core );
+
+/*!
+ * \brief Stack of the task never used [bytes], as ESP-IDF
+ */
+UBaseType_t uxTaskGetStackHighWaterMark( TaskHandle_t task );
+
+/*!
+ * \brief Blocks for the given time, advances the simulated clock
+ */
+void delay( uint32_t ms );
+
+/*!
+ * \brief Milliseconds elapsed on the simulated clock
+ */
+uint32_t millis( void );
+
+/*!
+ * \brief Microseconds elapsed on the simulated clock
+ */
+uint32_t micros( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __HOST_ARDUINO_H__
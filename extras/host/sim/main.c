@@ -0,0 +1,879 @@
+/*!
+ * \file      main.c
+ *
+ * \brief     Host simulation of the LoRaWAN stack: the MAC, region, crypto
+ *            and LmHandler layers run unmodified against a simulated SX126x
+ *            and a network server emulator, on a simulated clock.
+ *
+ * \remark    Usage: lorawan-sim [-r region|all] [-j joins] [-u uplinks] [-c]
+ *                               [-d period] [-s size] [-D datarate] [-f file]
+ *                               [-Q] [-A] [-y] [-e error] [-J jitter] [-C] [-q]
+ *
+ *            Each join cycle resets the MAC, joins over the air and sends the
+ *            requested number of uplinks. The network server checks that every
+ *            RX1 and RX2 window the node opens would receive a downlink sent
+ *            on time; the run fails on a missed window. -r all runs every
+ *            region in turn, as a single image built with REGION_ALL does. With a flash file, the MAC contexts
+ *            are stored in the simulated flash and the join cycles after the
+ *            first one resume the session from it instead of joining. With
+ *            -Q the uplinks of a join cycle are pushed into the uplink queue
+ *            as fast as it accepts them and the LoRa task sends them, with -A
+ *            as records packed together into aggregated frames. -e and -J
+ *            add a timing error to the downlinks of the network server, which
+ *            the RX windows calibration of the MAC measures and follows; -C
+ *            keeps the windows of the system max RX error instead.
+ *            Simulated time only advances to the next timer or radio event,
+ *            so thousands of exchanges run per second of wall time. Run it
+ *            under perf to profile the stack.
+ */
+#include <Arduino.h>
+#include <getopt.h>
+#include <time.h>
+#include "system/utilities.h"
+#include "boards/mcu/board.h"
+#include "boards/mcu/timer.h"
+#include "boards/sx126x-board.h"
+#include "boards/lora-energy.h"
+#include "boards/lora-task.h"
+#include "mac/LoRaMac.h"
+#include "mac/LoRaMacRxCalibration.h"
+#include "apps/LoRaMac/common/LmHandler/LmHandler.h"
+#include "apps/LoRaMac/common/NvmDataMgmt.h"
+#include "apps/LoRaMac/common/UplinkQueue.h"
+#include "system/nvmm.h"
+#include "host-board.h"
+#include "sx126x-sim.h"
+#include "ns-sim.h"
+
+/*!
+ * Upper bound of simulated time spent waiting for a single MAC operation, duty
+ * cycle waits included [us]
+ */
+#define SIM_OPERATION_TIMEOUT_US                    ( 3600ULL * 1000000ULL )
+
+/*!
+ * Join attempts per join cycle before giving up
+ */
+#define SIM_JOIN_ATTEMPTS                           8
+
+/*!
+ * Simulated flash size, as the "lorawan" partition of the target
+ */
+#define SIM_FLASH_SIZE                              ( 8 * 4096 )
+
+typedef struct SimRegion_s
+{
+    const char *Name;
+    LoRaMacRegion_t Region;
+    uint8_t Rx2Datarate;
+}SimRegion_t;
+
+typedef struct SimConfig_s
+{
+    uint32_t Joins;
+    uint32_t Uplinks;
+    bool Confirmed;
+    uint16_t DownlinkPeriod;
+    uint8_t Size;
+    const char *FlashFile;
+    bool Queued;
+    bool Aggregate;
+    int32_t DownlinkErrorUs;
+    uint32_t DownlinkJitterUs;
+    bool RxCalibration;
+}SimConfig_t;
+
+static const SimRegion_t SimRegions[] =
+{
+    { "as923", LORAMAC_REGION_AS923, DR_2 },
+    { "au915", LORAMAC_REGION_AU915, DR_8 },
+    { "cn470", LORAMAC_REGION_CN470, DR_0 },
+    { "cn779", LORAMAC_REGION_CN779, DR_0 },
+    { "eu433", LORAMAC_REGION_EU433, DR_0 },
+    { "eu868", LORAMAC_REGION_EU868, DR_0 },
+    { "kr920", LORAMAC_REGION_KR920, DR_0 },
+    { "in865", LORAMAC_REGION_IN865, DR_2 },
+    { "us915", LORAMAC_REGION_US915, DR_8 },
+    { "ru864", LORAMAC_REGION_RU864, DR_0 },
+};
+
+static uint8_t DevEui[8] = { 0x48, 0x4F, 0x53, 0x54, 0x00, 0x00, 0x00, 0x01 };
+static uint8_t JoinEui[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t SessionKey[16] = { 0 };
+static uint8_t AppDataBuffer[242];
+
+static LmHandlerParams_t LmHandlerParams =
+{
+    .Region = LORAMAC_REGION_EU868,
+    .AdrEnable = false,
+    .TxDatarate = DR_3,
+    .PublicNetworkEnable = true,
+    .DutyCycleEnabled = false,
+    .DataBufferMaxSize = sizeof( AppDataBuffer ),
+    .DataBuffer = AppDataBuffer,
+    .TxEirp = 16,
+    .joinType = ACTIVATION_TYPE_OTAA,
+    .DevEui = DevEui,
+    .JoinEui = JoinEui,
+    .AppKey = AppKey,
+    .DevAddr = 0,
+    .AppSKey = SessionKey,
+    .NwkSKey = SessionKey,
+    .NbTrials = 3,
+    .Class = CLASS_A,
+};
+
+static struct
+{
+    bool JoinDone;
+    bool JoinOk;
+    bool TxDone;
+    uint32_t Joins;
+    uint32_t JoinFailures;
+    uint32_t Resumes;
+    uint32_t NvmStores;
+    uint32_t NvmStoreBytes;
+    uint32_t Uplinks;
+    uint32_t UplinkFailures;
+    uint32_t AcksReceived;
+    uint32_t RxData;
+    uint32_t RxBytes;
+    uint32_t QueueFull;
+}Sim;
+
+extern SemaphoreHandle_t loraIntSem;
+
+static bool Quiet = false;
+
+/*!
+ * Latency of the LoRa task after a DIO1 interrupt, random up to this [us]
+ */
+static uint32_t IrqLatencyUs = 0;
+static uint32_t IrqLatencyRandom = 0x3C4D5E6F;
+
+static void OnMacProcess( void )
+{
+    // Wake up the LoRa task, as done by the radio ISR on the target
+    xSemaphoreGiveFromISR( loraIntSem, NULL );
+}
+
+static float GetTemperature( void )
+{
+    return 25.0f;
+}
+
+static void OnNvmDataChange( LmHandlerNvmContextStates_t state, uint16_t size )
+{
+    if( state == LORAMAC_HANDLER_NVM_STORE )
+    {
+        Sim.NvmStores++;
+        Sim.NvmStoreBytes += size;
+    }
+}
+
+static void OnNetworkParametersChange( CommissioningParams_t *params )
+{
+}
+
+static void OnMacMcpsRequest( LoRaMacStatus_t status, McpsReq_t *mcpsReq, TimerTime_t nextTxIn )
+{
+    UplinkQueueOnMcpsRequest( status, mcpsReq, nextTxIn );
+}
+
+static void OnMacMlmeRequest( LoRaMacStatus_t status, MlmeReq_t *mlmeReq, TimerTime_t nextTxIn )
+{
+    if( ( mlmeReq->Type == MLME_JOIN ) && ( status != LORAMAC_STATUS_OK ) )
+    {
+        Sim.JoinDone = true;
+        Sim.JoinOk = false;
+    }
+}
+
+static void OnJoinRequest( LmHandlerJoinParams_t *params )
+{
+    Sim.JoinDone = true;
+    Sim.JoinOk = params->Status == LORAMAC_HANDLER_SUCCESS;
+}
+
+static void OnTxData( LmHandlerTxParams_t *params )
+{
+    UplinkQueueOnTxData( params );
+    if( params->IsMcpsConfirm == 0 )
+    {
+        return;
+    }
+    Sim.TxDone = true;
+    if( params->Status != LORAMAC_EVENT_INFO_STATUS_OK )
+    {
+        Sim.UplinkFailures++;
+    }
+    if( params->AckReceived != 0 )
+    {
+        Sim.AcksReceived++;
+    }
+}
+
+static void OnRxData( LmHandlerAppData_t *appData, LmHandlerRxParams_t *params )
+{
+    if( ( appData != NULL ) && ( appData->BufferSize > 0 ) )
+    {
+        SX126xRxDoneLatencyUpdate( );
+        Sim.RxData++;
+        Sim.RxBytes += appData->BufferSize;
+    }
+}
+
+static void OnClassChange( DeviceClass_t deviceClass )
+{
+}
+
+static LmHandlerCallbacks_t LmHandlerCallbacks =
+{
+    .GetBatteryLevel = BoardGetBatteryLevel,
+    .GetTemperature = GetTemperature,
+    .GetRandomSeed = BoardGetRandomSeed,
+    .OnMacProcess = OnMacProcess,
+    .OnNvmDataChange = OnNvmDataChange,
+    .OnNetworkParametersChange = OnNetworkParametersChange,
+    .OnMacMcpsRequest = OnMacMcpsRequest,
+    .OnMacMlmeRequest = OnMacMlmeRequest,
+    .OnJoinRequest = OnJoinRequest,
+    .OnTxData = OnTxData,
+    .OnRxData = OnRxData,
+    .OnClassChange = OnClassChange,
+    .OnBeaconStatusChange = NULL,
+    .OnSysTimeUpdate = NULL,
+};
+
+/*!
+ * \brief Delays the LoRa task after a DIO1 interrupt as a busy scheduler
+ *        would, the chip and the RTC alarm keep running meanwhile
+ */
+static void SimIrqLatency( void )
+{
+    uint64_t until;
+    uint64_t t;
+
+    if( IrqLatencyUs == 0 )
+    {
+        return;
+    }
+    // xorshift32
+    IrqLatencyRandom ^= IrqLatencyRandom << 13;
+    IrqLatencyRandom ^= IrqLatencyRandom >> 17;
+    IrqLatencyRandom ^= IrqLatencyRandom << 5;
+    until = HostClockGetUs( ) + IrqLatencyRandom % ( IrqLatencyUs + 1 );
+    while( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t <= until ) )
+    {
+        HostClockAdvanceTo( t );
+        Sx126xSimProcess( );
+    }
+    HostClockAdvanceTo( until );
+    HostRtcAlarmProcess( );
+}
+
+/*!
+ * \brief Runs the LoRa task and moves the simulated clock from event to event
+ *        until the flag is set or the MAC gets idle with nothing scheduled.
+ *
+ * \param [IN] done    Flag set by the callbacks when the operation completes
+ * \param [IN] untilIdle Also wait for the MAC to be idle
+ * \retval status false on timeout
+ */
+static bool SimRun( bool *done, bool untilIdle )
+{
+    uint64_t limit = HostClockGetUs( ) + SIM_OPERATION_TIMEOUT_US;
+
+    for( ;; )
+    {
+        uint64_t next = UINT64_MAX;
+        uint64_t t;
+
+        while( HostLoRaSemTake( ) == true )
+        {
+            TimerProcess( );
+            LmHandlerProcess( );
+            UplinkQueueProcess( );
+        }
+        if( ( *done == true ) && ( ( untilIdle == false ) || ( LoRaMacIsBusy( ) == false ) ) )
+        {
+            return true;
+        }
+        // The LoRa task waits, in light sleep when enabled
+        if( LoRaTaskLightSleep( ) == true )
+        {
+            HostRtcAlarmProcess( );
+            continue;
+        }
+        if( HostRtcGetAlarm( &t ) == true )
+        {
+            next = t;
+        }
+        if( ( Sx126xSimGetNextEvent( &t ) == true ) && ( t < next ) )
+        {
+            next = t;
+        }
+        if( ( next == UINT64_MAX ) || ( next > limit ) )
+        {
+            return false;
+        }
+        uint32_t irqs = Sx126xSimGetStats( )->Irqs;
+
+        HostClockAdvanceTo( next );
+        Sx126xSimProcess( );
+        HostRtcAlarmProcess( );
+        if( Sx126xSimGetStats( )->Irqs != irqs )
+        {
+            SimIrqLatency( );
+        }
+    }
+}
+
+static bool SimJoin( void )
+{
+    MibRequestConfirm_t mibReq;
+
+    // Forget the session so that LoRaMacInitialization resets the MAC
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    mibReq.Param.NetworkActivation = ACTIVATION_TYPE_NONE;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    if( LmHandlerInit( &LmHandlerCallbacks, &LmHandlerParams ) != LORAMAC_HANDLER_SUCCESS )
+    {
+        return false;
+    }
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    if( mibReq.Param.NetworkActivation != ACTIVATION_TYPE_NONE )
+    {
+        // Session restored from flash
+        Sim.Resumes++;
+        return true;
+    }
+    for( uint8_t attempt = 0; attempt < SIM_JOIN_ATTEMPTS; attempt++ )
+    {
+        Sim.JoinDone = false;
+        Sim.JoinOk = false;
+        LmHandlerJoin( );
+        if( ( SimRun( &Sim.JoinDone, true ) == true ) && ( Sim.JoinOk == true ) )
+        {
+            Sim.Joins++;
+            mibReq.Type = MIB_CHANNELS_DATARATE;
+            mibReq.Param.ChannelsDatarate = LmHandlerParams.TxDatarate;
+            LoRaMacMibSetRequestConfirm( &mibReq );
+            return true;
+        }
+        Sim.JoinFailures++;
+    }
+    return false;
+}
+
+static bool SimUplink( bool confirmed, uint8_t size )
+{
+    McpsReq_t mcpsReq;
+    LoRaMacTxInfo_t txInfo;
+    MibRequestConfirm_t mibReq;
+
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        AppDataBuffer[i] = ( uint8_t )( Sim.Uplinks + i );
+    }
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+
+    if( LoRaMacQueryTxPossible( size, &txInfo ) != LORAMAC_STATUS_OK )
+    {
+        // Send empty frame in order to flush MAC commands
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fBuffer = NULL;
+        mcpsReq.Req.Unconfirmed.fBufferSize = 0;
+        mcpsReq.Req.Unconfirmed.Datarate = mibReq.Param.ChannelsDatarate;
+    }
+    else if( confirmed == true )
+    {
+        mcpsReq.Type = MCPS_CONFIRMED;
+        mcpsReq.Req.Confirmed.fPort = 2;
+        mcpsReq.Req.Confirmed.fBuffer = AppDataBuffer;
+        mcpsReq.Req.Confirmed.fBufferSize = size;
+        mcpsReq.Req.Confirmed.NbTrials = LmHandlerParams.NbTrials;
+        mcpsReq.Req.Confirmed.Datarate = mibReq.Param.ChannelsDatarate;
+    }
+    else
+    {
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = 2;
+        mcpsReq.Req.Unconfirmed.fBuffer = AppDataBuffer;
+        mcpsReq.Req.Unconfirmed.fBufferSize = size;
+        mcpsReq.Req.Unconfirmed.Datarate = mibReq.Param.ChannelsDatarate;
+    }
+
+    Sim.TxDone = false;
+    if( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK )
+    {
+        return false;
+    }
+    return SimRun( &Sim.TxDone, true );
+}
+
+/*!
+ * \brief Pushes the uplinks of a join cycle into the uplink queue, waiting for
+ *        an uplink to complete whenever the queue is full, and waits until
+ *        the queue is empty.
+ */
+static bool SimQueuedUplinks( bool confirmed, bool aggregate, uint8_t size, uint32_t count )
+{
+    UplinkQueueParams_t params =
+    {
+        .Port = 2,
+        .Confirmed = confirmed,
+        .Priority = 0,
+        .TtlMs = 0,
+        .CoalesceKey = 0,
+        .Aggregate = aggregate,
+    };
+    UplinkQueueStats_t stats;
+    uint8_t buffer[UPLINK_QUEUE_PAYLOAD_SIZE];
+    uint32_t queued = 0;
+
+    while( queued < count )
+    {
+        for( uint8_t i = 0; i < size; i++ )
+        {
+            buffer[i] = ( uint8_t )( Sim.Uplinks + queued + i );
+        }
+        if( UplinkQueuePush( &params, buffer, size ) == true )
+        {
+            queued++;
+            xSemaphoreGiveFromISR( loraIntSem, NULL );
+            continue;
+        }
+        Sim.QueueFull++;
+        Sim.TxDone = false;
+        if( SimRun( &Sim.TxDone, false ) == false )
+        {
+            return false;
+        }
+    }
+    for( ;; )
+    {
+        UplinkQueueGetStats( &stats );
+        if( stats.Depth == 0 )
+        {
+            break;
+        }
+        // The next uplink is sent as soon as one completes, the MAC is only
+        // idle once the queue is empty
+        Sim.TxDone = false;
+        if( SimRun( &Sim.TxDone, false ) == false )
+        {
+            return false;
+        }
+    }
+    return SimRun( &Sim.TxDone, true );
+}
+
+static double SimWallTime( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double )ts.tv_sec + ( double )ts.tv_nsec * 1e-9;
+}
+
+static void SimUsage( const char *name )
+{
+    fprintf( stderr, "Usage: %s [-r region|all] [-j joins] [-u uplinks] [-c] [-d period] [-s size] [-D datarate] [-k clock] [-b period] [-f file] [-Q] [-A] [-y] [-e error] [-J jitter] [-C] [-L latency] [-S] [-R] [-P] [-q]\n"
+                     "  -r region    as923 au915 cn470 cn779 eu433 eu868 kr920 in865 us915 ru864 (eu868)\n"
+                     "               or all to run every region in turn\n"
+                     "  -j joins     number of join cycles (100)\n"
+                     "  -u uplinks   uplinks per join cycle (10)\n"
+                     "  -c           confirmed uplinks\n"
+                     "  -d period    application downlink every N uplinks, 0 disables (4)\n"
+                     "  -s size      uplink payload size (16)\n"
+                     "  -D datarate  uplink datarate (3)\n"
+                     "  -k clock     radio SPI clock in kHz (%u)\n"
+                     "  -b period    hang one SetTx out of period on BUSY, 0 disables (0)\n"
+                     "  -B           with -b, hang SetStandby commands instead of SetTx\n"
+                     "  -z           with -b, hang SetSleep commands instead of SetTx\n"
+                     "  -f file      store the MAC contexts in a simulated flash file and resume\n"
+                     "               the session from it after the first join cycle, one region only\n"
+                     "  -Q           send the uplinks through the uplink queue\n"
+                     "  -A           queue the uplinks as aggregated records, use with -Q\n"
+                     "  -y           enforce the regional duty cycle, use with -Q\n"
+                     "  -e error     downlinks sent late by error us, early when negative (0)\n"
+                     "  -J jitter    random downlink timing error within +/- jitter us (0)\n"
+                     "  -C           disable the RX windows calibration\n"
+                     "  -L latency   LoRa task run a random 0..latency us after the DIO1 interrupts (0)\n"
+                     "  -S           disable the SX126x shadow copy of the configuration\n"
+                     "  -R           reset the radio on every init instead of resuming it\n"
+                     "  -P           light sleep of the MCU while the uplinks wait for the radio\n"
+                     "  -q           only print the summary\n", name, SX126X_SPI_CLOCK_HZ / 1000 );
+}
+
+/*!
+ * \brief Runs the join cycles of a region against a fresh network server
+ *
+ * \retval status false if a join or an uplink failed
+ */
+static bool SimRegionRun( const SimRegion_t *region, const SimConfig_t *config )
+{
+    NsSimParams_t nsParams;
+
+    memset( &Sim, 0, sizeof( Sim ) );
+    memset( &nsParams, 0, sizeof( nsParams ) );
+    nsParams.Region = region->Region;
+    memcpy( nsParams.NwkKey, AppKey, sizeof( AppKey ) );
+    nsParams.NetId = 0x000013;
+    nsParams.DevAddr = 0x26011BDA;
+    nsParams.Rx2Datarate = region->Rx2Datarate;
+    nsParams.DownlinkPeriod = config->DownlinkPeriod;
+    nsParams.DownlinkPort = 10;
+    nsParams.DownlinkSize = 8;
+    nsParams.Rssi = -60;
+    nsParams.Snr = 8;
+    nsParams.DownlinkErrorUs = config->DownlinkErrorUs;
+    nsParams.DownlinkJitterUs = config->DownlinkJitterUs;
+    NsSimInit( &nsParams );
+    LoRaMacRxCalibrationReset( );
+    LoRaMacRxCalibrationEnable( config->RxCalibration );
+    LmHandlerParams.Region = region->Region;
+
+    UplinkQueueInit( );
+
+    for( uint32_t j = 0; j < config->Joins; j++ )
+    {
+        uint32_t sent = 0;
+
+        if( SimJoin( ) == false )
+        {
+            fprintf( stderr, "%s join cycle %u: join failed\n", region->Name, j );
+            return false;
+        }
+        if( config->Queued == true )
+        {
+            if( SimQueuedUplinks( config->Confirmed, config->Aggregate, config->Size, config->Uplinks ) == false )
+            {
+                fprintf( stderr, "%s join cycle %u: queued uplinks failed\n", region->Name, j );
+                return false;
+            }
+            Sim.Uplinks += config->Uplinks;
+            sent = config->Uplinks;
+        }
+        for( uint32_t u = sent; u < config->Uplinks; u++ )
+        {
+            if( SimUplink( config->Confirmed, config->Size ) == false )
+            {
+                fprintf( stderr, "%s join cycle %u: uplink %u failed\n", region->Name, j, u );
+                return false;
+            }
+            Sim.Uplinks++;
+            sent++;
+        }
+        if( Quiet == false )
+        {
+            printf( "join cycle %u: %u uplinks, t=%.3f s\n", j, sent, HostClockGetUs( ) / 1e6 );
+        }
+    }
+    return true;
+}
+
+static bool SimRxWindowsOk( const NsSimStats_t *ns )
+{
+    return ( ns->MicErrors == 0 ) && ( ns->Rx[0].Missed == 0 ) && ( ns->Rx[1].Missed == 0 );
+}
+
+/*!
+ * \brief Runs every region in turn and prints one line per region
+ */
+static int SimAllRegions( const SimConfig_t *config )
+{
+    uint32_t failed = 0;
+
+    printf( "region  joins  uplinks  rx1 windows  missed  lead [us]        rx2 windows  missed  lead [us]\n" );
+    for( uint8_t i = 0; i < sizeof( SimRegions ) / sizeof( SimRegions[0] ); i++ )
+    {
+        const NsSimStats_t *ns = NsSimGetStats( );
+        bool ok = SimRegionRun( &SimRegions[i], config );
+
+        ok = ok && SimRxWindowsOk( ns );
+        printf( "%-6s  %5u  %7u  %11u  %6u  %6d..%-6d  %11u  %6u  %6d..%-6d  %s\n", SimRegions[i].Name, Sim.Joins,
+                Sim.Uplinks, ns->Rx[0].Opened, ns->Rx[0].Missed, ns->Rx[0].LeadMinUs, ns->Rx[0].LeadMaxUs,
+                ns->Rx[1].Opened, ns->Rx[1].Missed, ns->Rx[1].LeadMinUs, ns->Rx[1].LeadMaxUs,
+                ( ok == true ) ? "ok" : "FAIL" );
+        if( ok == false )
+        {
+            failed++;
+        }
+    }
+    printf( "%s: %u regions failed\n", ( failed == 0 ) ? "PASS" : "FAIL", failed );
+    return ( failed == 0 ) ? 0 : 1;
+}
+
+int main( int argc, char *argv[] )
+{
+    const SimRegion_t *region = &SimRegions[5];
+    bool allRegions = false;
+    SimConfig_t config =
+    {
+        .Joins = 100,
+        .Uplinks = 10,
+        .Confirmed = false,
+        .DownlinkPeriod = 4,
+        .Size = 16,
+        .FlashFile = NULL,
+        .Queued = false,
+        .Aggregate = false,
+        .DownlinkErrorUs = 0,
+        .DownlinkJitterUs = 0,
+        .RxCalibration = true,
+    };
+    uint32_t busyFault = 0;
+    uint8_t busyFaultCommand = RADIO_SET_TX;
+    bool ok;
+    double start;
+    double elapsed;
+    int opt;
+
+    while( ( opt = getopt( argc, argv, "r:j:u:cd:s:D:k:b:Bzf:QAye:J:CL:SRPqh" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'r':
+            region = NULL;
+            allRegions = strcmp( optarg, "all" ) == 0;
+            for( uint8_t i = 0; i < sizeof( SimRegions ) / sizeof( SimRegions[0] ); i++ )
+            {
+                if( ( allRegions == true ) || ( strcmp( optarg, SimRegions[i].Name ) == 0 ) )
+                {
+                    region = &SimRegions[i];
+                }
+            }
+            if( region == NULL )
+            {
+                SimUsage( argv[0] );
+                return 1;
+            }
+            break;
+        case 'j':
+            config.Joins = strtoul( optarg, NULL, 0 );
+            break;
+        case 'u':
+            config.Uplinks = strtoul( optarg, NULL, 0 );
+            break;
+        case 'c':
+            config.Confirmed = true;
+            break;
+        case 'd':
+            config.DownlinkPeriod = ( uint16_t )strtoul( optarg, NULL, 0 );
+            break;
+        case 's':
+            config.Size = ( uint8_t )strtoul( optarg, NULL, 0 );
+            break;
+        case 'D':
+            LmHandlerParams.TxDatarate = ( int8_t )strtol( optarg, NULL, 0 );
+            break;
+        case 'k':
+            SX126xSetSpiClock( ( uint32_t )strtoul( optarg, NULL, 0 ) * 1000 );
+            break;
+        case 'b':
+            busyFault = ( uint32_t )strtoul( optarg, NULL, 0 );
+            break;
+        case 'B':
+            busyFaultCommand = RADIO_SET_STANDBY;
+            break;
+        case 'z':
+            busyFaultCommand = RADIO_SET_SLEEP;
+            break;
+        case 'f':
+            config.FlashFile = optarg;
+            break;
+        case 'Q':
+            config.Queued = true;
+            break;
+        case 'A':
+            config.Aggregate = true;
+            break;
+        case 'y':
+            LmHandlerParams.DutyCycleEnabled = true;
+            break;
+        case 'e':
+            config.DownlinkErrorUs = ( int32_t )strtol( optarg, NULL, 0 );
+            break;
+        case 'J':
+            config.DownlinkJitterUs = ( uint32_t )strtoul( optarg, NULL, 0 );
+            break;
+        case 'C':
+            config.RxCalibration = false;
+            break;
+        case 'L':
+            IrqLatencyUs = ( uint32_t )strtoul( optarg, NULL, 0 );
+            break;
+        case 'S':
+            SX126xShadowEnable( false );
+            break;
+        case 'R':
+            SX126xResumeEnable( false );
+            break;
+        case 'P':
+            LoRaTaskSetLightSleep( LoRaMacIsUplinkRunning );
+            break;
+        case 'q':
+            Quiet = true;
+            break;
+        default:
+            SimUsage( argv[0] );
+            return 1;
+        }
+    }
+    if( config.Size > sizeof( AppDataBuffer ) )
+    {
+        config.Size = sizeof( AppDataBuffer );
+    }
+    if( ( allRegions == true ) && ( config.FlashFile != NULL ) )
+    {
+        SimUsage( argv[0] );
+        return 1;
+    }
+
+    HostClockReset( );
+    Sx126xSimReset( );
+    Sx126xSimSetBusyFault( busyFault, busyFaultCommand );
+    if( allRegions == true )
+    {
+        Quiet = true;
+        return SimAllRegions( &config );
+    }
+    if( config.FlashFile != NULL )
+    {
+        if( HostFlashOpen( config.FlashFile, SIM_FLASH_SIZE ) == false )
+        {
+            fprintf( stderr, "cannot open %s\n", config.FlashFile );
+            return 1;
+        }
+        // The network server emulator does not know the stored session
+        NvmDataMgmtFactoryReset( );
+    }
+
+    start = SimWallTime( );
+    ok = SimRegionRun( region, &config );
+    elapsed = SimWallTime( ) - start;
+    if( ok == false )
+    {
+        return 1;
+    }
+
+    const Sx126xSimStats_t *radio = Sx126xSimGetStats( );
+    SX126xSpiStats_t spi;
+    SX126xBusyStats_t busy;
+    RadioIrqStats_t irq;
+    SX126xShadowStats_t shadow;
+    SX126xImageCalStats_t imageCal;
+    SX126xResumeStats_t resume;
+    LoRaTaskStats_t task;
+    LoRaEnergyStats_t energy;
+    uint32_t saved;
+    SX126xSpiCallStats_t *readBuffer;
+    const NsSimStats_t *ns = NsSimGetStats( );
+    UplinkQueueStats_t queue;
+    LoRaMacRxCalibrationStats_t rxCal;
+    uint32_t frames = Sim.Joins + Sim.JoinFailures + Sim.Uplinks;
+
+    UplinkQueueGetStats( &queue );
+    if( config.Queued == true )
+    {
+        frames += queue.Frames - queue.Sent - queue.Failed;
+    }
+
+    printf( "region              %s\n", region->Name );
+    printf( "joins               %u (%u failed attempts, %u resumed from flash)\n", Sim.Joins, Sim.JoinFailures,
+            Sim.Resumes );
+    printf( "uplinks             %u (%u failed, %u acked)\n", Sim.Uplinks, Sim.UplinkFailures, Sim.AcksReceived );
+    if( config.Queued == true )
+    {
+        printf( "uplink queue        %u queued, %u sent, %u failed, %u full, %u max depth, %u duty cycle waits\n",
+                queue.Queued, queue.Sent, queue.Failed, Sim.QueueFull, queue.MaxDepth, queue.DutyCycleWaits );
+        printf( "queue latency       %u ms avg, %u ms max\n", queue.LatencyAvgMs, queue.LatencyMaxMs );
+        printf( "queue frames        %u, %.1f uplinks/frame\n", queue.Frames,
+                ( queue.Frames != 0 ) ? ( double )( queue.Sent + queue.Failed ) / queue.Frames : 0.0 );
+    }
+    printf( "downlinks           %u app, %u bytes\n", Sim.RxData, Sim.RxBytes );
+    printf( "server              %u join req, %u uplinks, %u acks, %u downlinks, %u MIC errors\n",
+            ns->JoinRequests, ns->Uplinks, ns->Acks, ns->Downlinks, ns->MicErrors );
+    for( uint8_t i = 0; i < 2; i++ )
+    {
+        printf( "rx%u window          %u opened, %u missed, downlink %d..%d us after opening\n", i + 1,
+                ns->Rx[i].Opened, ns->Rx[i].Missed, ns->Rx[i].LeadMinUs, ns->Rx[i].LeadMaxUs );
+    }
+    LoRaMacRxCalibrationGetStats( &rxCal );
+    printf( "rx calibration      %s, %u downlinks, %u misses, %u fallbacks, error %d us avg, %u us dev\n",
+            ( rxCal.Active == true ) ? "active" : "inactive", rxCal.Samples, rxCal.Misses, rxCal.Fallbacks,
+            rxCal.BiasUs, rxCal.DeviationUs );
+    if( rxCal.Active == true )
+    {
+        printf( "rx windows          %+d ms shift, %u ms max rx error\n", rxCal.Offset, rxCal.MaxRxError );
+    }
+    printf( "radio               %u tx, %u rx, %u rx timeouts, %u irqs\n",
+            radio->TxFrames, radio->RxFrames, radio->RxTimeouts, radio->Irqs );
+    printf( "receiver on         %.1f ms total, %.2f ms/frame\n", radio->RxOnUs / 1e3,
+            ( frames != 0 ) ? radio->RxOnUs / 1e3 / frames : 0.0 );
+    printf( "spi                 %u transactions, %u bytes, %.1f transactions/frame\n",
+            radio->Transactions, radio->Bytes, ( frames != 0 ) ? ( double )radio->Transactions / frames : 0.0 );
+    SX126xGetSpiStats( &spi );
+    readBuffer = &spi.Call[SX126X_SPI_READ_BUFFER];
+    printf( "spi read buffer     %u calls, %.1f us avg, %u us max at %u kHz\n", readBuffer->Calls,
+            ( readBuffer->Calls != 0 ) ? ( double )readBuffer->TotalUs / readBuffer->Calls : 0.0,
+            readBuffer->MaxUs, SX126xGetSpiClock( ) / 1000 );
+    printf( "rx done latency     %.1f us avg, %u us max\n",
+            ( spi.RxDone != 0 ) ? ( double )spi.RxDoneLatencyTotalUs / spi.RxDone : 0.0, spi.RxDoneLatencyMaxUs );
+    printf( "rx frames           %u dropped\n", RadioRxFrameGetDropped( ) );
+    RadioGetIrqStats( &irq );
+    printf( "dio1 irq events     %u, %u dropped, %u coalesced, %u empty, %u max queued\n", irq.Events, irq.Dropped,
+            irq.Coalesced, irq.Empty, irq.MaxDepth );
+    SX126xGetShadowStats( &shadow );
+    saved = shadow.CommandsSkipped + shadow.RegisterWritesSkipped + shadow.RegisterReadsSkipped +
+            shadow.RegisterWritesMerged;
+    printf( "spi shadow          %u saved, %.1f/uplink (%u commands, %u register writes, %u reads, %u merged)\n",
+            saved, ( shadow.Transmissions != 0 ) ? ( double )saved / shadow.Transmissions : 0.0,
+            shadow.CommandsSkipped, shadow.RegisterWritesSkipped, shadow.RegisterReadsSkipped,
+            shadow.RegisterWritesMerged );
+    SX126xGetImageCalStats( &imageCal );
+    printf( "image calibration   %u runs, %u skipped, %.1f us avg, %u us max, %u tx/rx out of band\n",
+            imageCal.Calibrations, imageCal.Skipped,
+            ( imageCal.Calibrations != 0 ) ? ( double )imageCal.TotalUs / imageCal.Calibrations : 0.0,
+            imageCal.MaxUs, radio->Uncalibrated );
+    SX126xGetResumeStats( &resume );
+    printf( "radio inits         %u resumed, %u reset, %u failed, wake to tx %u us avg resumed, %u us avg reset\n",
+            resume.Resumes, resume.Resets, resume.Failures, resume.ResumeTxAvgUs, resume.ResetTxAvgUs );
+    LoRaTaskGetStats( &task );
+    printf( "light sleep         %u sleeps, %u ended by dio1, %.3f s total\n", task.LightSleeps,
+            task.LightSleepDio1WakeUps, task.LightSleepMs / 1e3 );
+    LoRaEnergyGetStats( &energy );
+    printf( "energy              %.1f mJ/uplink, %u uplinks, last one %u ms: mcu %.1f ms active, radio %.1f ms tx, %.1f ms rx\n",
+            energy.UplinkAvgUj / 1e3, energy.Uplinks, energy.UplinkLastMs,
+            energy.UplinkLastStateUs[LORA_ENERGY_MCU_ACTIVE] / 1e3, energy.UplinkLastStateUs[LORA_ENERGY_RADIO_TX] / 1e3,
+            energy.UplinkLastStateUs[LORA_ENERGY_RADIO_RX] / 1e3 );
+    SX126xGetBusyStats( &busy );
+    printf( "busy waits          %u timeouts, %u us max\n", busy.Timeouts, busy.MaxUs );
+    if( config.FlashFile != NULL )
+    {
+        NvmmStats_t nvmm;
+        HostFlashStats_t flash;
+
+        NvmmGetStats( &nvmm );
+        HostFlashGetStats( &flash );
+        printf( "nvm                 %u stores, %.1f bytes/store, %u bytes programmed, %u compactions\n",
+                Sim.NvmStores, ( Sim.NvmStores != 0 ) ? ( double )Sim.NvmStoreBytes / Sim.NvmStores : 0.0,
+                flash.ProgrammedBytes, nvmm.Compactions );
+        printf( "flash erases        %u total, %u max per sector\n", flash.Erases, flash.SectorErasesMax );
+        HostFlashClose( );
+    }
+    printf( "simulated time      %.3f s\n", HostClockGetUs( ) / 1e6 );
+    printf( "wall time           %.3f s\n", elapsed );
+    if( elapsed > 0 )
+    {
+        printf( "rate                %.0f joins/s, %.0f uplinks/s\n", Sim.Joins / elapsed, Sim.Uplinks / elapsed );
+    }
+    return ( SimRxWindowsOk( ns ) == true ) ? 0 : 1;
+}
@@ -0,0 +1,614 @@
+/*!
+ * \file      ns-sim.c
+ *
+ * \brief     Minimal LoRaWAN 1.0.x network server emulator for the host
+ *            simulation
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system/crypto/aes.h"
+#include "system/crypto/cmac.h"
+#include "radio/sx126x/sx126x.h"
+#include "mac/region/Region.h"
+#include "ns-sim.h"
+
+/*!
+ * Delay between the end of the uplink and the RX1 window [us]
+ */
+#define NS_RECEIVE_DELAY1_US                        1000000
+#define NS_JOIN_ACCEPT_DELAY1_US                    5000000
+
+/*!
+ * Delay between the RX1 and RX2 windows [us]
+ */
+#define NS_RX2_DELAY_US                             1000000
+
+/*!
+ * Preamble of the downlinks [symbols]
+ */
+#define NS_DOWNLINK_PREAMBLE                        8
+
+/*!
+ * LoRaWAN message types
+ */
+#define NS_MTYPE_JOIN_REQUEST                       0x00
+#define NS_MTYPE_JOIN_ACCEPT                        0x01
+#define NS_MTYPE_UNCONFIRMED_UP                     0x02
+#define NS_MTYPE_UNCONFIRMED_DOWN                   0x03
+#define NS_MTYPE_CONFIRMED_UP                       0x04
+
+#define NS_FCTRL_ADR_ACK_REQ                        0x40
+#define NS_FCTRL_ACK                                0x20
+
+#define NS_JOIN_REQUEST_SIZE                        23
+#define NS_MIC_SIZE                                 4
+
+static NsSimParams_t Params;
+static NsSimStats_t Stats;
+static NsSimUplinkHandler_t UplinkHandler = NULL;
+static uint32_t Random;
+
+static struct
+{
+    bool Joined;
+    uint32_t JoinNonce;
+    uint8_t NwkSKey[16];
+    uint8_t AppSKey[16];
+    uint32_t FCntUp;
+    bool FCntUpValid;
+    uint32_t FCntDown;
+}Session;
+
+/*!
+ * Downlinks sent on time in the RX1 and RX2 windows of the last uplink, as
+ * probes of the windows the node opens
+ */
+static struct
+{
+    Sx126xSimFrame_t Probe[2];
+    uint8_t Next;
+}RxWindows;
+
+/*
+ * AES-128 inverse cipher. The device decrypts the join accept with the AES
+ * encrypt operation, the server therefore has to encrypt it with the AES
+ * decrypt operation which is not built in the stack.
+ */
+
+static uint8_t Sbox[256];
+static uint8_t InvSbox[256];
+
+static uint8_t NsRotl8( uint8_t x, uint8_t shift )
+{
+    return ( uint8_t )( ( x << shift ) | ( x >> ( 8 - shift ) ) );
+}
+
+static uint8_t NsGfMul( uint8_t a, uint8_t b )
+{
+    uint8_t p = 0;
+
+    while( b != 0 )
+    {
+        if( ( b & 1 ) != 0 )
+        {
+            p ^= a;
+        }
+        a = ( uint8_t )( ( a << 1 ) ^ ( ( ( a & 0x80 ) != 0 ) ? 0x1B : 0x00 ) );
+        b >>= 1;
+    }
+    return p;
+}
+
+static void NsAesInitTables( void )
+{
+    uint8_t p = 1;
+    uint8_t q = 1;
+
+    // p walks the multiplicative group with generator 3, q its inverse
+    do
+    {
+        p = ( uint8_t )( p ^ ( p << 1 ) ^ ( ( ( p & 0x80 ) != 0 ) ? 0x1B : 0x00 ) );
+        q ^= ( uint8_t )( q << 1 );
+        q ^= ( uint8_t )( q << 2 );
+        q ^= ( uint8_t )( q << 4 );
+        if( ( q & 0x80 ) != 0 )
+        {
+            q ^= 0x09;
+        }
+        Sbox[p] = q ^ NsRotl8( q, 1 ) ^ NsRotl8( q, 2 ) ^ NsRotl8( q, 3 ) ^ NsRotl8( q, 4 ) ^ 0x63;
+    } while( p != 1 );
+    Sbox[0] = 0x63;
+
+    for( uint16_t i = 0; i < 256; i++ )
+    {
+        InvSbox[Sbox[i]] = ( uint8_t )i;
+    }
+}
+
+static void NsAesExpandKey( const uint8_t key[16], uint8_t roundKeys[176] )
+{
+    uint8_t rcon = 1;
+
+    memcpy( roundKeys, key, 16 );
+    for( uint8_t i = 16; i < 176; i += 4 )
+    {
+        uint8_t t[4];
+
+        memcpy( t, &roundKeys[i - 4], 4 );
+        if( ( i % 16 ) == 0 )
+        {
+            uint8_t t0 = t[0];
+
+            t[0] = Sbox[t[1]] ^ rcon;
+            t[1] = Sbox[t[2]];
+            t[2] = Sbox[t[3]];
+            t[3] = Sbox[t0];
+            rcon = NsGfMul( rcon, 2 );
+        }
+        for( uint8_t j = 0; j < 4; j++ )
+        {
+            roundKeys[i + j] = roundKeys[i - 16 + j] ^ t[j];
+        }
+    }
+}
+
+static void NsAesDecrypt( const uint8_t key[16], const uint8_t in[16], uint8_t out[16] )
+{
+    uint8_t rk[176];
+    uint8_t s[16];
+    uint8_t t[16];
+
+    NsAesExpandKey( key, rk );
+    for( uint8_t i = 0; i < 16; i++ )
+    {
+        s[i] = in[i] ^ rk[160 + i];
+    }
+    for( int8_t round = 9; round >= 0; round-- )
+    {
+        // InvShiftRows and InvSubBytes, byte i is row i % 4 of column i / 4
+        for( uint8_t i = 0; i < 16; i++ )
+        {
+            uint8_t row = i % 4;
+            uint8_t col = i / 4;
+
+            t[i] = InvSbox[s[row + 4 * ( ( col + 4 - row ) % 4 )]];
+        }
+        for( uint8_t i = 0; i < 16; i++ )
+        {
+            s[i] = t[i] ^ rk[16 * round + i];
+        }
+        if( round == 0 )
+        {
+            break;
+        }
+        // InvMixColumns
+        for( uint8_t c = 0; c < 4; c++ )
+        {
+            uint8_t *col = &s[4 * c];
+            uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+
+            col[0] = NsGfMul( a0, 14 ) ^ NsGfMul( a1, 11 ) ^ NsGfMul( a2, 13 ) ^ NsGfMul( a3, 9 );
+            col[1] = NsGfMul( a0, 9 ) ^ NsGfMul( a1, 14 ) ^ NsGfMul( a2, 11 ) ^ NsGfMul( a3, 13 );
+            col[2] = NsGfMul( a0, 13 ) ^ NsGfMul( a1, 9 ) ^ NsGfMul( a2, 14 ) ^ NsGfMul( a3, 11 );
+            col[3] = NsGfMul( a0, 11 ) ^ NsGfMul( a1, 13 ) ^ NsGfMul( a2, 9 ) ^ NsGfMul( a3, 14 );
+        }
+    }
+    memcpy( out, s, 16 );
+}
+
+static void NsAesEncrypt( const uint8_t key[16], const uint8_t in[16], uint8_t out[16] )
+{
+    aes_context ctx;
+
+    memset( &ctx, 0, sizeof( ctx ) );
+    aes_set_key( key, 16, &ctx );
+    lora_aes_encrypt( in, out, &ctx );
+}
+
+static void NsCmac( const uint8_t key[16], const uint8_t *b0, const uint8_t *buffer, uint16_t size, uint8_t mic[NS_MIC_SIZE] )
+{
+    AES_CMAC_CTX ctx;
+    uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+
+    AES_CMAC_Init( &ctx );
+    AES_CMAC_SetKey( &ctx, key );
+    if( b0 != NULL )
+    {
+        AES_CMAC_Update( &ctx, b0, 16 );
+    }
+    AES_CMAC_Update( &ctx, buffer, size );
+    AES_CMAC_Final( digest, &ctx );
+    memcpy( mic, digest, NS_MIC_SIZE );
+}
+
+static void NsBlockFill( uint8_t block[16], uint8_t tag, uint8_t dir, uint32_t devAddr, uint32_t fCnt, uint8_t last )
+{
+    memset( block, 0, 16 );
+    block[0] = tag;
+    block[5] = dir;
+    block[6] = ( uint8_t )devAddr;
+    block[7] = ( uint8_t )( devAddr >> 8 );
+    block[8] = ( uint8_t )( devAddr >> 16 );
+    block[9] = ( uint8_t )( devAddr >> 24 );
+    block[10] = ( uint8_t )fCnt;
+    block[11] = ( uint8_t )( fCnt >> 8 );
+    block[12] = ( uint8_t )( fCnt >> 16 );
+    block[13] = ( uint8_t )( fCnt >> 24 );
+    block[15] = last;
+}
+
+static void NsDataMic( uint8_t dir, uint32_t fCnt, const uint8_t *buffer, uint8_t size, uint8_t mic[NS_MIC_SIZE] )
+{
+    uint8_t b0[16];
+
+    NsBlockFill( b0, 0x49, dir, Params.DevAddr, fCnt, size );
+    NsCmac( Session.NwkSKey, b0, buffer, size, mic );
+}
+
+static void NsPayloadCrypt( const uint8_t key[16], uint8_t dir, uint32_t fCnt, uint8_t *buffer, uint8_t size )
+{
+    uint8_t a[16];
+    uint8_t s[16];
+
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        if( ( i % 16 ) == 0 )
+        {
+            NsBlockFill( a, 0x01, dir, Params.DevAddr, fCnt, ( uint8_t )( i / 16 + 1 ) );
+            NsAesEncrypt( key, a, s );
+        }
+        buffer[i] ^= s[i % 16];
+    }
+}
+
+/*
+ * Radio side
+ */
+
+static void NsRx1Channel( const Sx126xSimFrame_t *up, Sx126xSimFrame_t *down )
+{
+    uint32_t channel;
+
+    down->Frequency = up->Frequency;
+    down->Sf = up->Sf;
+    down->Bw = up->Bw;
+    switch( Params.Region )
+    {
+    case LORAMAC_REGION_US915:
+    case LORAMAC_REGION_AU915:
+    {
+        uint32_t base125 = ( Params.Region == LORAMAC_REGION_US915 ) ? 902300000 : 915200000;
+        uint32_t base500 = ( Params.Region == LORAMAC_REGION_US915 ) ? 903000000 : 915900000;
+
+        if( up->Bw == LORA_BW_500 )
+        {
+            channel = 64 + ( up->Frequency - base500 + 800000 ) / 1600000;
+            down->Sf = 7;
+        }
+        else
+        {
+            channel = ( up->Frequency - base125 + 100000 ) / 200000;
+        }
+        down->Frequency = 923300000 + ( channel % 8 ) * 600000;
+        down->Bw = LORA_BW_500;
+        break;
+    }
+    case LORAMAC_REGION_CN470:
+        channel = ( up->Frequency - 470300000 + 100000 ) / 200000;
+        down->Frequency = 500300000 + ( channel % 48 ) * 200000;
+        break;
+    default:
+        break;
+    }
+}
+
+/*!
+ * \brief Timing error of the gateway for the downlinks of an uplink
+ */
+static int32_t NsDownlinkError( void )
+{
+    int32_t errorUs = Params.DownlinkErrorUs;
+
+    if( Params.DownlinkJitterUs != 0 )
+    {
+        // xorshift32
+        Random ^= Random << 13;
+        Random ^= Random >> 17;
+        Random ^= Random << 5;
+        errorUs += ( int32_t )( Random % ( 2 * Params.DownlinkJitterUs + 1 ) ) - ( int32_t )Params.DownlinkJitterUs;
+    }
+    return errorUs;
+}
+
+/*!
+ * \brief Sets the probes of the RX1 and RX2 windows of an uplink, the
+ *        downlinks answering it are sent at the start of the RX1 probe
+ *
+ * \param [IN] delay1Us Delay of the RX1 window
+ * \param [IN] rx2Dr    Datarate of the RX2 window
+ */
+static void NsRxWindowsSet( const Sx126xSimFrame_t *up, uint64_t delay1Us, uint8_t rx2Dr )
+{
+    GetPhyParams_t getPhy = { .Datarate = rx2Dr, .UplinkDwellTime = 0, .DownlinkDwellTime = 0 };
+
+    memset( &RxWindows, 0, sizeof( RxWindows ) );
+    for( uint8_t i = 0; i < 2; i++ )
+    {
+        RxWindows.Probe[i].Preamble = NS_DOWNLINK_PREAMBLE;
+        RxWindows.Probe[i].IqInverted = true;
+    }
+    NsRx1Channel( up, &RxWindows.Probe[0] );
+    RxWindows.Probe[0].StartUs = up->EndUs + delay1Us + NsDownlinkError( );
+
+    getPhy.Attribute = PHY_DEF_RX2_FREQUENCY;
+    RxWindows.Probe[1].Frequency = RegionGetPhyParam( Params.Region, &getPhy ).Value;
+    getPhy.Attribute = PHY_SF_FROM_DR;
+    RxWindows.Probe[1].Sf = ( uint8_t )RegionGetPhyParam( Params.Region, &getPhy ).Value;
+    getPhy.Attribute = PHY_BW_FROM_DR;
+    RxWindows.Probe[1].Bw = LORA_BW_125 + ( uint8_t )RegionGetPhyParam( Params.Region, &getPhy ).Value;
+    RxWindows.Probe[1].StartUs = RxWindows.Probe[0].StartUs + NS_RX2_DELAY_US;
+}
+
+static void NsSend( const Sx126xSimFrame_t *up, const uint8_t *buffer, uint8_t size )
+{
+    Sx126xSimFrame_t down;
+
+    memset( &down, 0, sizeof( down ) );
+    NsRx1Channel( up, &down );
+    down.StartUs = RxWindows.Probe[0].StartUs;
+    down.Cr = LORA_CR_4_5;
+    down.Preamble = NS_DOWNLINK_PREAMBLE;
+    down.ImplicitHeader = false;
+    down.CrcOn = false;
+    down.IqInverted = true;
+    down.Rssi = Params.Rssi;
+    down.Snr = Params.Snr;
+    down.Size = size;
+    memcpy( down.Payload, buffer, size );
+    if( Sx126xSimAirPush( &down ) == false )
+    {
+        Stats.AirFull++;
+    }
+}
+
+static void NsHandleJoinRequest( const Sx126xSimFrame_t *frame )
+{
+    const uint8_t *p = frame->Payload;
+    uint8_t mic[NS_MIC_SIZE];
+    uint8_t accept[17];
+    uint8_t keyBlock[16];
+    uint16_t devNonce;
+    GetPhyParams_t getPhy = { 0 };
+
+    if( frame->Size != NS_JOIN_REQUEST_SIZE )
+    {
+        return;
+    }
+    Stats.JoinRequests++;
+    getPhy.Attribute = PHY_DEF_RX2_DR;
+    NsRxWindowsSet( frame, NS_JOIN_ACCEPT_DELAY1_US, ( uint8_t )RegionGetPhyParam( Params.Region, &getPhy ).Value );
+    NsCmac( Params.NwkKey, NULL, p, NS_JOIN_REQUEST_SIZE - NS_MIC_SIZE, mic );
+    if( memcmp( mic, &p[NS_JOIN_REQUEST_SIZE - NS_MIC_SIZE], NS_MIC_SIZE ) != 0 )
+    {
+        Stats.MicErrors++;
+        return;
+    }
+    devNonce = ( uint16_t )p[17] | ( ( uint16_t )p[18] << 8 );
+    Session.JoinNonce++;
+
+    accept[0] = NS_MTYPE_JOIN_ACCEPT << 5;
+    accept[1] = ( uint8_t )Session.JoinNonce;
+    accept[2] = ( uint8_t )( Session.JoinNonce >> 8 );
+    accept[3] = ( uint8_t )( Session.JoinNonce >> 16 );
+    accept[4] = ( uint8_t )Params.NetId;
+    accept[5] = ( uint8_t )( Params.NetId >> 8 );
+    accept[6] = ( uint8_t )( Params.NetId >> 16 );
+    accept[7] = ( uint8_t )Params.DevAddr;
+    accept[8] = ( uint8_t )( Params.DevAddr >> 8 );
+    accept[9] = ( uint8_t )( Params.DevAddr >> 16 );
+    accept[10] = ( uint8_t )( Params.DevAddr >> 24 );
+    accept[11] = Params.Rx2Datarate & 0x0F;     // RX1DRoffset 0
+    accept[12] = 1;                             // RxDelay 1 s
+    NsCmac( Params.NwkKey, NULL, accept, 13, &accept[13] );
+
+    // Session keys, LoRaWAN 1.0.x derivation
+    memset( keyBlock, 0, sizeof( keyBlock ) );
+    memcpy( &keyBlock[1], &accept[1], 6 );
+    keyBlock[7] = ( uint8_t )devNonce;
+    keyBlock[8] = ( uint8_t )( devNonce >> 8 );
+    keyBlock[0] = 0x01;
+    NsAesEncrypt( Params.NwkKey, keyBlock, Session.NwkSKey );
+    keyBlock[0] = 0x02;
+    NsAesEncrypt( Params.NwkKey, keyBlock, Session.AppSKey );
+    Session.Joined = true;
+    Session.FCntUpValid = false;
+    Session.FCntDown = 0;
+
+    NsAesDecrypt( Params.NwkKey, &accept[1], &accept[1] );
+    NsSend( frame, accept, sizeof( accept ) );
+    Stats.JoinAccepts++;
+}
+
+static void NsHandleDataUplink( const Sx126xSimFrame_t *frame )
+{
+    const uint8_t *p = frame->Payload;
+    uint8_t size = frame->Size;
+    uint8_t mic[NS_MIC_SIZE];
+    uint8_t fCtrl;
+    uint8_t fOptsLen;
+    uint32_t devAddr;
+    uint32_t fCnt;
+    uint8_t port = 0;
+    uint8_t payload[256];
+    uint8_t payloadSize = 0;
+    bool ack;
+    bool data;
+
+    if( ( Session.Joined == false ) || ( size < 8 + NS_MIC_SIZE ) )
+    {
+        return;
+    }
+    devAddr = ( uint32_t )p[1] | ( ( uint32_t )p[2] << 8 ) | ( ( uint32_t )p[3] << 16 ) | ( ( uint32_t )p[4] << 24 );
+    if( devAddr != Params.DevAddr )
+    {
+        return;
+    }
+    NsRxWindowsSet( frame, NS_RECEIVE_DELAY1_US, Params.Rx2Datarate );
+    fCtrl = p[5];
+    fOptsLen = fCtrl & 0x0F;
+    fCnt = ( uint32_t )p[6] | ( ( uint32_t )p[7] << 8 );
+    if( Session.FCntUpValid == true )
+    {
+        fCnt |= Session.FCntUp & 0xFFFF0000;
+        if( fCnt < Session.FCntUp )
+        {
+            fCnt += 0x10000;
+        }
+    }
+
+    NsDataMic( 0, fCnt, p, size - NS_MIC_SIZE, mic );
+    if( memcmp( mic, &p[size - NS_MIC_SIZE], NS_MIC_SIZE ) != 0 )
+    {
+        Stats.MicErrors++;
+        return;
+    }
+    Session.FCntUp = fCnt;
+    Session.FCntUpValid = true;
+    Stats.Uplinks++;
+
+    if( size > 8 + fOptsLen + NS_MIC_SIZE )
+    {
+        port = p[8 + fOptsLen];
+        payloadSize = size - 9 - fOptsLen - NS_MIC_SIZE;
+        memcpy( payload, &p[9 + fOptsLen], payloadSize );
+        NsPayloadCrypt( ( port == 0 ) ? Session.NwkSKey : Session.AppSKey, 0, fCnt, payload, payloadSize );
+    }
+    if( UplinkHandler != NULL )
+    {
+        UplinkHandler( port, payload, payloadSize );
+    }
+
+    ack = ( p[0] >> 5 ) == NS_MTYPE_CONFIRMED_UP;
+    data = ( Params.DownlinkPeriod != 0 ) && ( ( Stats.Uplinks % Params.DownlinkPeriod ) == 0 );
+    if( ( ack == true ) || ( data == true ) || ( ( fCtrl & NS_FCTRL_ADR_ACK_REQ ) != 0 ) )
+    {
+        uint8_t down[255];
+        uint8_t downSize = 0;
+
+        down[downSize++] = NS_MTYPE_UNCONFIRMED_DOWN << 5;
+        memcpy( &down[downSize], &p[1], 4 );
+        downSize += 4;
+        down[downSize++] = ( ack == true ) ? NS_FCTRL_ACK : 0;
+        down[downSize++] = ( uint8_t )Session.FCntDown;
+        down[downSize++] = ( uint8_t )( Session.FCntDown >> 8 );
+        if( data == true )
+        {
+            down[downSize++] = Params.DownlinkPort;
+            for( uint8_t i = 0; i < Params.DownlinkSize; i++ )
+            {
+                down[downSize + i] = ( uint8_t )( Stats.Uplinks + i );
+            }
+            NsPayloadCrypt( Session.AppSKey, 1, Session.FCntDown, &down[downSize], Params.DownlinkSize );
+            downSize += Params.DownlinkSize;
+            Stats.Downlinks++;
+        }
+        NsDataMic( 1, Session.FCntDown, down, downSize, &down[downSize] );
+        downSize += NS_MIC_SIZE;
+        Session.FCntDown++;
+        if( ack == true )
+        {
+            Stats.Acks++;
+        }
+        NsSend( frame, down, downSize );
+    }
+}
+
+void NsSimInit( const NsSimParams_t *params )
+{
+    static const uint8_t key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                     0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+    static const uint8_t plain[16] = { 0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+                                       0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A };
+    uint8_t cipher[16];
+    uint8_t check[16];
+
+    NsAesInitTables( );
+    // The inverse cipher must undo the stack AES implementation
+    NsAesEncrypt( key, plain, cipher );
+    NsAesDecrypt( key, cipher, check );
+    if( memcmp( check, plain, sizeof( plain ) ) != 0 )
+    {
+        fprintf( stderr, "ns-sim: AES inverse cipher self test failed\n" );
+        abort( );
+    }
+
+    Params = *params;
+    memset( &Stats, 0, sizeof( Stats ) );
+    memset( &Session, 0, sizeof( Session ) );
+    memset( &RxWindows, 0, sizeof( RxWindows ) );
+    RxWindows.Next = 2;
+    Random = 0x1F2E3D4C;
+    Sx126xSimSetTxHook( NsSimOnUplink );
+    Sx126xSimSetRxHook( NsSimOnRxWindow );
+}
+
+void NsSimSetUplinkHandler( NsSimUplinkHandler_t handler )
+{
+    UplinkHandler = handler;
+}
+
+void NsSimOnUplink( const Sx126xSimFrame_t *frame )
+{
+    if( ( frame->IqInverted == true ) || ( frame->Size == 0 ) )
+    {
+        return;
+    }
+    switch( frame->Payload[0] >> 5 )
+    {
+    case NS_MTYPE_JOIN_REQUEST:
+        NsHandleJoinRequest( frame );
+        break;
+    case NS_MTYPE_UNCONFIRMED_UP:
+    case NS_MTYPE_CONFIRMED_UP:
+        NsHandleDataUplink( frame );
+        break;
+    default:
+        break;
+    }
+}
+
+void NsSimOnRxWindow( const Sx126xSimRxWindow_t *window )
+{
+    NsSimRxWindowStats_t *stats;
+    const Sx126xSimFrame_t *probe;
+    int32_t leadUs;
+
+    // Class A windows run under the RX timer, continuous receptions are the
+    // random number generation of Radio.Random
+    if( ( window->IqInverted == false ) || ( window->TimerLimitUs == UINT64_MAX ) || ( RxWindows.Next >= 2 ) )
+    {
+        return;
+    }
+    stats = &Stats.Rx[RxWindows.Next];
+    probe = &RxWindows.Probe[RxWindows.Next++];
+    leadUs = ( int32_t )( ( int64_t )probe->StartUs - ( int64_t )window->StartUs );
+    if( ( stats->Opened == 0 ) || ( leadUs < stats->LeadMinUs ) )
+    {
+        stats->LeadMinUs = leadUs;
+    }
+    if( ( stats->Opened == 0 ) || ( leadUs > stats->LeadMaxUs ) )
+    {
+        stats->LeadMaxUs = leadUs;
+    }
+    stats->Opened++;
+    if( Sx126xSimRxWindowCatches( window, probe ) == false )
+    {
+        stats->Missed++;
+    }
+}
+
+const NsSimStats_t* NsSimGetStats( void )
+{
+    return &Stats;
+}
@@ -0,0 +1,119 @@
+/*!
+ * \file      ns-sim.h
+ *
+ * \brief     Minimal LoRaWAN 1.0.x network server emulator for the host
+ *            simulation
+ *
+ * \remark    Answers OTAA join requests, checks the MIC of data uplinks,
+ *            acknowledges confirmed uplinks and optionally sends application
+ *            downlinks. Downlinks are put on the simulated air in the RX1
+ *            window of the uplink they answer. The receive windows the node
+ *            opens after each uplink are checked against the RX1 and RX2
+ *            windows of the region. A timing error of the gateway can be
+ *            added to every downlink, a constant part and a random one.
+ */
+#ifndef __NS_SIM_H__
+#define __NS_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mac/LoRaMac.h"
+#include "sx126x-sim.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \brief Network server configuration
+ */
+typedef struct NsSimParams_s
+{
+    LoRaMacRegion_t Region;     //!< Region used to compute the RX1 channel
+    uint8_t NwkKey[16];         //!< Root key shared with the device
+    uint32_t NetId;             //!< Network identifier sent in the join accept
+    uint32_t DevAddr;           //!< Device address assigned on join
+    uint8_t Rx2Datarate;        //!< RX2 datarate sent in the join accept DLSettings
+    uint16_t DownlinkPeriod;    //!< Sends an application downlink every N uplinks, 0 to disable
+    uint8_t DownlinkPort;       //!< Port of the application downlinks
+    uint8_t DownlinkSize;       //!< Size of the application downlinks
+    int16_t Rssi;               //!< RSSI of the downlinks seen by the node [dBm]
+    int8_t Snr;                 //!< SNR of the downlinks seen by the node [dB]
+    int32_t DownlinkErrorUs;    //!< Downlinks sent late by this, early when negative [us]
+    uint32_t DownlinkJitterUs;  //!< Random error added to each downlink, within +/- this [us]
+}NsSimParams_t;
+
+/*!
+ * \brief Receive window timing counters
+ */
+typedef struct NsSimRxWindowStats_s
+{
+    uint32_t Opened;            //!< Windows opened by the node
+    uint32_t Missed;            //!< Windows which would not receive a downlink sent on time
+    int32_t LeadMinUs;          //!< Smallest time from the window opening to the downlink [us]
+    int32_t LeadMaxUs;          //!< Largest time from the window opening to the downlink [us]
+}NsSimRxWindowStats_t;
+
+/*!
+ * \brief Network server counters
+ */
+typedef struct NsSimStats_s
+{
+    uint32_t JoinRequests;      //!< Join requests received
+    uint32_t JoinAccepts;       //!< Join accepts sent
+    uint32_t Uplinks;           //!< Data uplinks with a valid MIC
+    uint32_t MicErrors;         //!< Frames dropped on MIC mismatch
+    uint32_t Acks;              //!< Downlinks carrying an ACK
+    uint32_t Downlinks;         //!< Downlinks carrying application data
+    uint32_t AirFull;           //!< Downlinks dropped, simulated air full
+    NsSimRxWindowStats_t Rx[2]; //!< RX1 and RX2 windows
+}NsSimStats_t;
+
+/*!
+ * \brief Callback invoked with the decrypted payload of every valid uplink
+ *
+ * \param [IN] port   Frame port, 0 when no FRMPayload
+ * \param [IN] buffer Decrypted FRMPayload
+ * \param [IN] size   FRMPayload size
+ */
+typedef void ( *NsSimUplinkHandler_t )( uint8_t port, const uint8_t *buffer, uint8_t size );
+
+/*!
+ * \brief Initializes the network server and registers it as the radio TX and
+ *        RX hooks
+ *
+ * \param [IN] params Network server configuration
+ */
+void NsSimInit( const NsSimParams_t *params );
+
+/*!
+ * \brief Registers the callback invoked on every valid uplink
+ */
+void NsSimSetUplinkHandler( NsSimUplinkHandler_t handler );
+
+/*!
+ * \brief Handles a frame transmitted by the node
+ *
+ * \param [IN] frame Frame on the air
+ */
+void NsSimOnUplink( const Sx126xSimFrame_t *frame );
+
+/*!
+ * \brief Checks a receive window opened by the node against the RX1 or RX2
+ *        window of the last uplink
+ *
+ * \param [IN] window Receive window
+ */
+void NsSimOnRxWindow( const Sx126xSimRxWindow_t *window );
+
+/*!
+ * \brief Returns the network server counters
+ */
+const NsSimStats_t* NsSimGetStats( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NS_SIM_H__
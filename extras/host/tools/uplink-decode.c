@@ -0,0 +1,105 @@
+/*!
+ * \file      uplink-decode.c
+ *
+ * \brief     Decodes the aggregated frames sent by the uplink queue
+ *            ( UplinkQueueParams_t.Aggregate ) with the stack sources.
+ *
+ * \remark    Usage: uplink-decode [hex frame...]
+ *
+ *            Without arguments, reads one hex frame per line on stdin, as a
+ *            network server integration would forward the FRMPayload. Prints
+ *            one line per record and exits non-zero if a frame is malformed.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apps/LoRaMac/common/UplinkAggregate.h"
+
+static void OnRecord( const uint8_t *data, uint8_t size, uint32_t age, void *context )
+{
+    uint32_t *index = context;
+
+    printf( "  record %u: age %u s, %u bytes:", *index, age, size );
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        printf( " %02X", data[i] );
+    }
+    printf( "\n" );
+    ( *index )++;
+}
+
+/*!
+ * \brief Parses a hex string, spaces allowed between bytes
+ *
+ * \retval size Frame size, -1 if the string is not valid
+ */
+static int ParseHex( const char *text, uint8_t *frame, int maxSize )
+{
+    int size = 0;
+
+    while( *text != '\0' )
+    {
+        unsigned int value;
+
+        if( isspace( ( unsigned char )*text ) )
+        {
+            text++;
+            continue;
+        }
+        if( ( size == maxSize ) || ( isxdigit( ( unsigned char )text[0] ) == 0 ) ||
+            ( isxdigit( ( unsigned char )text[1] ) == 0 ) || ( sscanf( text, "%2x", &value ) != 1 ) )
+        {
+            return -1;
+        }
+        frame[size++] = ( uint8_t )value;
+        text += 2;
+    }
+    return size;
+}
+
+static int DecodeFrame( const char *text )
+{
+    uint8_t frame[255];
+    uint32_t index = 0;
+    int size = ParseHex( text, frame, sizeof( frame ) );
+    int16_t count;
+
+    if( size < 0 )
+    {
+        printf( "invalid hex frame\n" );
+        return 1;
+    }
+    printf( "frame, %d bytes\n", size );
+    count = UplinkAggregateDecode( frame, ( uint8_t )size, OnRecord, &index );
+    if( count < 0 )
+    {
+        printf( "  malformed record %u\n", index );
+        return 1;
+    }
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    char line[1024];
+    int errors = 0;
+
+    if( argc > 1 )
+    {
+        for( int i = 1; i < argc; i++ )
+        {
+            errors += DecodeFrame( argv[i] );
+        }
+        return ( errors == 0 ) ? 0 : 1;
+    }
+    while( fgets( line, sizeof( line ), stdin ) != NULL )
+    {
+        line[strcspn( line, "\r\n" )] = '\0';
+        if( line[0] != '\0' )
+        {
+            errors += DecodeFrame( line );
+        }
+    }
+    return ( errors == 0 ) ? 0 : 1;
+}
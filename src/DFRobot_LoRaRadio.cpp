@@ -31,26 +31,25 @@ void loraRxCb(uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr)
     if(rxEncryptiondone == NULL)
     {
         printf("rxEncryptiondone NULL");
+        Radio2.RxFrameRelease(payload);
         return;
     }
     
-    if(isEncryption == false)
-    {
-        rxEncryptiondone(payload,size,rssi,snr);
-    } 
-    else
+    if(isEncryption == true)
     {
-        uint8_t* dataread = (uint8_t*)malloc(sizeof(uint8_t)*size+1);
+        // 在接收帧内原地解密
         LoRaMacPayloadDecrypt(payload,
                             size,
                             dataKey,
                             0xDFDFDFDF,
                             1,
                             0X66,
-                            dataread);
-        rxEncryptiondone(dataread,size,rssi,snr);
-        free(dataread);
+                            payload);
     }
+    SX126xRxDoneLatencyUpdate();
+    rxEncryptiondone(payload,size,rssi,snr);
+    // 回调返回后接收帧归还给radio层
+    Radio2.RxFrameRelease(payload);
 }
 
 DFRobot_LoRaRadio::DFRobot_LoRaRadio(){
@@ -63,7 +62,8 @@ void loraRadioTask(void *pvParameters)
     {
         if (xSemaphoreTake(loraIntSem, portMAX_DELAY) == pdTRUE)
         {
-            // Handle Radio2 events
+            // Run expired timers then handle Radio2 events
+            TimerProcess();
             Radio2.BgIrqProcess();
         }
     }
@@ -211,6 +211,8 @@ void DFRobot_LoRaRadio::deepSleepMs(uint32_t timesleep)
     pinMode(LORA_SS, OUTPUT);
     digitalWrite(LORA_SS, HIGH);
     rtc_gpio_hold_en(gpio_num_t(LORA_SS));
+    // RST保持高电平，唤醒后radio从warm start睡眠恢复，无需复位（SX126xInit）
+    rtc_gpio_hold_en(gpio_num_t(LORA_RST));
     esp_deep_sleep_start();
 }
 
@@ -220,6 +222,11 @@ void DFRobot_LoRaRadio::setEncryptKey(const uint8_t *key)
     memcpy(dataKey,key,16);
 }
 
+void DFRobot_LoRaRadio::getImageCalStats(SX126xImageCalStats_t *stats)
+{
+    SX126xGetImageCalStats(stats);
+}
+
 void DFRobot_LoRaRadio::dumpRegisters()
 {
     static const uint16_t regs[] = {
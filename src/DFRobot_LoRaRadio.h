@@ -52,7 +52,7 @@ typedef void txCB(void);
 /**
  * @fn rxCB
  * @brief Callback function for when data reception is completed.
- * @param payload The received payload.
+ * @param payload The received payload, only valid until the callback returns.
  * @param size The size of the received payload.
  * @param rssi The received signal strength indicator.
  * @param snr The signal-to-noise ratio.
@@ -215,6 +215,14 @@ public:
        */
       void dumpRegisters();
 
+      /**
+       * @fn getImageCalStats
+       * @brief Get the image calibrations of the radio: the radio calibrates again each time the frequency leaves the calibrated band (430-440, 470-510, 779-787, 863-870 or 902-928 MHz).
+       * @param stats Calibrated band, calibrations run and skipped, calibration time
+       * @return None
+       */
+      void getImageCalStats(SX126xImageCalStats_t *stats);
+
       /**
        * @fn setSync
        * @brief This method is not available.
@@ -36,18 +36,29 @@ RTC_DATA_ATTR uint16_t ChannelsMask[6];
 RTC_DATA_ATTR uint16_t ChannelsDefaultMask[6];
 RTC_DATA_ATTR uint16_t ChannelsMaskRemaining[6];
 
-// 地区条件编译，从Arduino IDE中地区选项卡里设置
-#ifdef REGION_EU868
-#include "mac/region/RegionEU868.h"
+// 地区条件编译，从Arduino IDE中地区选项卡里设置。REGION_ALL编译所有地区，默认EU868，init()前用setRegion()选择
+#if defined(REGION_ALL) || defined(REGION_EU868)
 LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_EU868;
-#endif
-#ifdef REGION_CN470
-#include "mac/region/RegionCN470.h"
+#elif defined(REGION_CN470)
 LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_CN470;
-#endif
-#ifdef REGION_US915
-#include "mac/region/RegionUS915.h"
+#elif defined(REGION_US915)
 LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_US915;
+#elif defined(REGION_AU915)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_AU915;
+#elif defined(REGION_AS923)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_AS923;
+#elif defined(REGION_KR920)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_KR920;
+#elif defined(REGION_IN865)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_IN865;
+#elif defined(REGION_RU864)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_RU864;
+#elif defined(REGION_CN779)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_CN779;
+#elif defined(REGION_EU433)
+LoRaMacRegion_t loraWanRegion = LORAMAC_REGION_EU433;
+#else
+#error "No LoRaWAN region selected, define one of REGION_EU868, REGION_US915, ... or REGION_ALL"
 #endif
 
 static void OnMacProcessNotify( void );
@@ -132,6 +143,7 @@ static void OnNetworkParametersChange( CommissioningParams_t* params )
 static void OnMacMcpsRequest( LoRaMacStatus_t status, McpsReq_t *mcpsReq, TimerTime_t nextTxIn )
 {
     // DisplayMacMcpsRequestUpdate( status, mcpsReq, nextTxIn );
+    UplinkQueueOnMcpsRequest( status, mcpsReq, nextTxIn );    // 队列根据nextTxIn安排下次发送
 }
 
 // MLME请求回调函数，可以在这里打出MLME请求是否成功，比如入网包请求是否成功
@@ -198,15 +210,10 @@ static void OnJoinRequest( LmHandlerJoinParams_t* params )
 // 发送数据回调 可以在此处打出发送数据包的TxPower、频道等信息
 static void OnTxData( LmHandlerTxParams_t* params )
 {
+    UplinkQueueOnTxData(params);
     if(txCb != NULL && params != NULL)
     {
-        uint8_t txeirp = 0;
-#ifdef REGION_EU868
-        txeirp = txpowerEirpEU868[params->TxPower][1];
-#endif
-#ifdef REGION_US915
-        txeirp = txpowerEirpUS915[((params->TxPower < 4)?4:params->TxPower) - 4][1];
-#endif
+        uint8_t txeirp = LmHandlerGetTxEirp(params->TxPower);
         txCb(params->AckReceived, params->Datarate, txeirp, params->Channel);
     }
 }
@@ -221,6 +228,7 @@ static void OnRxData( LmHandlerAppData_t* appData, LmHandlerRxParams_t* params )
 
         if(appData != NULL)
         {
+            SX126xRxDoneLatencyUpdate();
             rxCb(
                 appData->Buffer,
                 appData->BufferSize,
@@ -242,17 +250,12 @@ static void OnClassChange( DeviceClass_t deviceClass )
 }
 
 
-void loraTask(void *pvParameters)
+// MAC任务处理：协议栈、功能包和发送队列。radio中断由radio服务任务处理
+static void loraMacProcess(void)
 {
-    // printf("LoRa Task started\n");
-    while (1)
-    {
-        if (xSemaphoreTake(loraIntSem, portMAX_DELAY) == pdTRUE)
-        {   
-            // printf("\n--------LmHandlerProcess ---------\n");
-            LmHandlerProcess();
-        }
-    }
+    // printf("\n--------LmHandlerProcess ---------\n");
+    LmHandlerProcess();
+    UplinkQueueProcess();       // 发送队列中的数据
 }
 
 bool taskLoad(void)
@@ -263,12 +266,8 @@ bool taskLoad(void)
     xSemaphoreGive(loraIntSem);
     xSemaphoreTake(loraIntSem, 10);
 
-    // xTaskCreateUniversal(loraTask, "LORA", 8192, NULL, 1, &loraTaskHandle, ARDUINO_RUNNING_CORE);
-    if (!xTaskCreate(loraTask, "LORA", 8192, NULL, 2, &loraTaskHandle))
-    {
-        return false;
-    }
-    return true;
+    // 高优先级radio服务任务（绑定核心）和MAC任务，见lora-task.h
+    return LoRaTaskStart(loraMacProcess);
 }
 
 static void startDeepSleep( void )
@@ -277,9 +276,12 @@ static void startDeepSleep( void )
     Radio.Standby();   // 容错
     Radio.Sleep();
     SetMacState(0);
+    LmHandlerSuspend();     // 封存RTC中的会话，唤醒后init()直接恢复
     pinMode(LORA_SS, OUTPUT);
     digitalWrite(LORA_SS, HIGH);
     rtc_gpio_hold_en(gpio_num_t(LORA_SS));
+    // RST保持高电平，唤醒后radio从warm start睡眠恢复，无需复位（SX126xInit）
+    rtc_gpio_hold_en(gpio_num_t(LORA_RST));
     esp_deep_sleep_start();
 }
 
@@ -308,14 +310,20 @@ bool LoRaWAN_Node::init(int8_t dataRate, int8_t txEirp, bool adr, bool dutyCycle
     // sx1262 IO初始化
     SX126xIOInit();
 
-    // 915地区速率选择限制
-#ifdef REGION_US915
-    if (dataRate == DR_5 || dataRate == DR_6 || dataRate == DR_7)
+    // 地区速率选择限制，如US915不使用DR_5 DR_6 DR_7
+    VerifyParams_t verify;
+    GetPhyParams_t getPhy;
+    getPhy.Attribute = PHY_DEF_UPLINK_DWELL_TIME;
+    verify.DatarateParams.Datarate = dataRate;
+    verify.DatarateParams.UplinkDwellTime = RegionGetPhyParam(LmHandlerParams.Region, &getPhy).Value;
+    if (RegionVerify(LmHandlerParams.Region, &verify, PHY_TX_DR) == false)
     {
-        printf("DDR_5 DR_6 DR_7 is not used on the US915\n");
+        printf("DR_%d is not used in this region\n", dataRate);
         return false;
     }
-#endif
+
+    // 发送队列在lora任务运行前清空
+    UplinkQueueInit();
 
     // lora任务创建
     taskLoad();
@@ -328,6 +336,12 @@ bool LoRaWAN_Node::init(int8_t dataRate, int8_t txEirp, bool adr, bool dutyCycle
     LmHandlerParams.AdrEnable = adr;
     LmHandlerParams.DutyCycleEnabled = dutyCycle;
 
+    // 深度睡眠唤醒：RTC中封存的会话校验通过后直接恢复，不重新初始化协议栈，保留网络下发的参数
+    if(LmHandlerResume(&LmHandlerCallbacks, &LmHandlerParams) == LORAMAC_HANDLER_SUCCESS)
+    {
+        return true;
+    }
+
     if(LmHandlerInit(&LmHandlerCallbacks, &LmHandlerParams) != LORAMAC_HANDLER_SUCCESS)
     {
         printf("\n\n\n--------------LmHandlerInit Failed!---------------\n\n");
@@ -335,9 +349,10 @@ bool LoRaWAN_Node::init(int8_t dataRate, int8_t txEirp, bool adr, bool dutyCycle
     }
     else
     {
-#ifdef REGION_US915
-    setSubBand(2);
-#endif
+        if (LmHandlerParams.Region == LORAMAC_REGION_US915 || LmHandlerParams.Region == LORAMAC_REGION_AU915)
+        {
+            setSubBand(2);
+        }
         if(LmHandlerParams.joinType == ACTIVATION_TYPE_ABP)         // ABP模式相关参数在这里配置，用户无需在ABP模式调用join
         {
             MibRequestConfirm_t mibReq;
@@ -351,6 +366,19 @@ bool LoRaWAN_Node::init(int8_t dataRate, int8_t txEirp, bool adr, bool dutyCycle
     }    
 }
 
+bool LoRaWAN_Node::setRegion(LoRaMacRegion_t region)
+{
+    // 只能选择固件中编译了的地区
+    if (RegionIsActive(region) == false)
+    {
+        printf("Region %d is not built in\n", region);
+        return false;
+    }
+    loraWanRegion = region;
+    LmHandlerParams.Region = region;
+    return true;
+}
+
 void LoRaWAN_Node::deepSleepMs(uint32_t timesleep)
 {
     if(timesleep != 0){
@@ -526,6 +554,100 @@ bool LoRaWAN_Node::sendUnconfirmedPacket(uint8_t port, void *buffer, uint8_t siz
     return true;
 }
 
+bool LoRaWAN_Node::queuePacket(uint8_t port, const void *buffer, uint8_t size, bool confirmed, uint8_t priority, uint32_t ttlMs, uint16_t coalesceKey)
+{
+    UplinkQueueParams_t params;
+    params.Port = port;
+    params.Confirmed = confirmed;
+    params.Priority = priority;
+    params.TtlMs = ttlMs;
+    params.CoalesceKey = coalesceKey;
+    params.Aggregate = false;
+
+    if (!UplinkQueuePush(&params, (const uint8_t *)buffer, size))
+    {
+        return false;
+    }
+    // 唤醒lora任务发送
+    xSemaphoreGive(loraIntSem);
+    return true;
+}
+
+bool LoRaWAN_Node::queueRecord(uint8_t port, const void *buffer, uint8_t size, bool confirmed, uint8_t priority, uint32_t ttlMs)
+{
+    UplinkQueueParams_t params;
+    params.Port = port;
+    params.Confirmed = confirmed;
+    params.Priority = priority;
+    params.TtlMs = ttlMs;
+    params.CoalesceKey = 0;
+    params.Aggregate = true;
+
+    if (!UplinkQueuePush(&params, (const uint8_t *)buffer, size))
+    {
+        return false;
+    }
+    // 唤醒lora任务,记录可能已满一帧
+    xSemaphoreGive(loraIntSem);
+    return true;
+}
+
+void LoRaWAN_Node::setAggregation(uint32_t maxAgeMs, uint8_t flushPriority, uint8_t fillPercent)
+{
+    UplinkQueueAggregation_t params;
+    params.MaxAgeMs = maxAgeMs;
+    params.FlushPriority = flushPriority;
+    params.FillPercent = fillPercent;
+
+    UplinkQueueSetAggregation(&params);
+    // 重新检查等待中的记录
+    xSemaphoreGive(loraIntSem);
+}
+
+void LoRaWAN_Node::getQueueStats(UplinkQueueStats_t *stats)
+{
+    if (stats != NULL)
+    {
+        UplinkQueueGetStats(stats);
+    }
+}
+
+void LoRaWAN_Node::getTaskStats(LoRaTaskStats_t *stats)
+{
+    LoRaTaskGetStats(stats);
+}
+
+void LoRaWAN_Node::getRadioIrqStats(RadioIrqStats_t *stats)
+{
+    RadioGetIrqStats(stats);
+}
+
+void LoRaWAN_Node::getRadioShadowStats(SX126xShadowStats_t *stats)
+{
+    SX126xGetShadowStats(stats);
+}
+
+void LoRaWAN_Node::getRadioResumeStats(SX126xResumeStats_t *stats)
+{
+    SX126xGetResumeStats(stats);
+}
+
+void LoRaWAN_Node::setLightSleep(bool enable)
+{
+    // 仅在A类上行发送中或等待RX窗口时浅睡眠
+    LoRaTaskSetLightSleep(enable ? LoRaMacIsUplinkRunning : NULL);
+}
+
+void LoRaWAN_Node::setEnergyProfile(const LoRaEnergyProfile_t *profile)
+{
+    LoRaEnergySetProfile(profile);
+}
+
+void LoRaWAN_Node::getEnergyStats(LoRaEnergyStats_t *stats)
+{
+    LoRaEnergyGetStats(stats);
+}
+
 int LoRaWAN_Node::join(joinCallback callback)
 {
     loraJoinCb = callback;
@@ -563,17 +685,8 @@ uint8_t LoRaWAN_Node::getEIRP()
     MibRequestConfirm_t mibReq;
     mibReq.Type = MIB_CHANNELS_TX_POWER;
     LoRaMacMibGetRequestConfirm(&mibReq);
-    uint8_t txeirp = 0;
 
-#ifdef REGION_EU868
-    txeirp = txpowerEirpEU868[mibReq.Param.ChannelsTxPower][1];
-#endif
-
-#ifdef REGION_US915
-    txeirp = txpowerEirpUS915[((mibReq.Param.ChannelsTxPower < 4)?4:mibReq.Param.ChannelsTxPower) - 4][1];
-#endif
-
-    return txeirp;
+    return LmHandlerGetTxEirp(mibReq.Param.ChannelsTxPower);
 }
 
 bool LoRaWAN_Node::addChannel(uint32_t freq)
@@ -612,23 +725,27 @@ bool LoRaWAN_Node::addChannel(uint32_t freq)
     channelAdd.NewChannel = &newChannel;
     channelAdd.ChannelId = chanIdx;
     printf("id = %d\n", chanIdx);
-#ifdef REGION_EU868
-    if (RegionEU868ChannelAdd(&channelAdd) == LORAMAC_STATUS_OK) {
+    if (RegionChannelAdd(LmHandlerParams.Region, &channelAdd) == LORAMAC_STATUS_OK) {
         return true;
     }
-#endif
     return false;
 }
 
 bool LoRaWAN_Node::delChannel(uint32_t freq)
 {
     ChannelRemoveParams_t channelRemove;
-#ifdef REGION_EU868
-    channelRemove.ChannelId = getEU868FrqID(freq);
-    if (RegionEU868ChannelsRemove(&channelRemove) == LORAMAC_STATUS_OK) {
-        return true;
+    MibRequestConfirm_t mibReq;
+    GetPhyParams_t getPhy;
+    getPhy.Attribute = PHY_MAX_NB_CHANNELS;
+    uint8_t nbChannels = RegionGetPhyParam(LmHandlerParams.Region, &getPhy).Value;
+    mibReq.Type = MIB_CHANNELS;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    for (uint8_t id = 0; id < nbChannels; id++) {
+        if (mibReq.Param.ChannelList[id].Frequency == freq) {
+            channelRemove.ChannelId = id;
+            return RegionChannelsRemove(LmHandlerParams.Region, &channelRemove);
+        }
     }
-#endif
     return false;
 }
 
@@ -22,6 +22,10 @@
 #include "mac/Commissioning.h"
 #include "mac/LoRaMac.h"
 #include "mac/region/Region.h"
+#include "apps/LoRaMac/common/UplinkQueue.h"
+#include "boards/lora-task.h"
+#include "boards/lora-energy.h"
+#include "radio/sx126x/sx126x.h"
 
 #define LCD_OnBoard LoRaWAN::DFRobot_ST7735_80x160_HW_SPI ///< The type of screen on the development board
 #define SPI_MUTEX LoRaWAN::spimutex
@@ -42,7 +46,7 @@ typedef void (*joinCallback)(bool isOk, int16_t rssi, int8_t snr);
  * @fn rxCB
  * @brief The callback function for the node to receive data from the gateway.
  * @details The user-defined data reception callback function can obtain the received data and some network parameters.
- * @param buffer Received data
+ * @param buffer Received data, only valid until the callback returns
  * @param size The size of the received data
  * @param port Communication port
  * @param rssi Received Signal Strength Indication(dBm)
@@ -107,12 +111,27 @@ public:
      *                  with LORAWAN_DUTYCYCLE_OFF being the default.
      * @n LORAWAN_DUTYCYCLE_ON Enable duty cycle transmission limitation
      * @n LORAWAN_DUTYCYCLE_OFF Disable duty cycle transmission limitation
+     * @n After a wake up from deepSleepMs() the session sealed in the RTC memory is checked and resumed as is, the parameters are then left unchanged.
      * @return Whether the node initialization was successful
      * @retval true Initialization successful
      * @retval false Initialization failed
      */
     bool init(int8_t dataRate, int8_t txEirp, bool adr = false, bool dutyCycle = LORAWAN_DUTYCYCLE_OFF);
 
+    /**
+     * @fn setRegion
+     * @brief Select the LoRaWAN region of the node, to be called before init().
+     * @n The region must be built in: the one of the region menu, or any region when the library is built with REGION_ALL,
+     *    so that one firmware image serves every region. The default is the one of the region menu, EU868 with REGION_ALL.
+     * @param region LORAMAC_REGION_AS923, LORAMAC_REGION_AU915, LORAMAC_REGION_CN470, LORAMAC_REGION_CN779,
+     *               LORAMAC_REGION_EU433, LORAMAC_REGION_EU868, LORAMAC_REGION_KR920, LORAMAC_REGION_IN865,
+     *               LORAMAC_REGION_US915 or LORAMAC_REGION_RU864
+     * @return Whether the region was selected
+     * @retval true Set successful
+     * @retval false The region is not built in
+     */
+    bool setRegion(LoRaMacRegion_t region);
+
     /**
      * @fn join
      * @brief LoRaWAN node performs the network join operation and sets a user-defined join callback function.
@@ -200,6 +219,7 @@ public:
     /**
      * @fn deepSleepMs
      * @brief Set the MCU to immediately enter sleep for a specified duration.
+     * @n The joined session is sealed in the RTC memory, init() resumes it on wake up.
      * @param timesleep Node sleep duration(ms).If set to 0, the device will never wake up.
      * @return None
      */
@@ -249,6 +269,116 @@ public:
      */
     bool sendUnconfirmedPacket(uint8_t port, void *buffer, uint8_t size);
 
+    /**
+     * @fn queuePacket
+     * @brief Queue data for the gateway. The LoRa task sends it as soon as the node is joined,
+     * @n     the MAC is free and the duty cycle allows it, highest priority first.
+     * @param port Node communication port with the gateway (1-223)
+     * @param buffer Data to be sent by the node, copied into the queue
+     * @param size Size of the data to be sent by the node
+     * @param confirmed Send in confirmed packet mode
+     * @param priority Higher priorities are sent first
+     * @param ttlMs Time in ms after which the data is dropped if not sent yet, 0 for no limit
+     * @param coalesceKey Data queued with the same port and key replaces the data not sent yet, 0 disables it
+     * @return Whether the data was queued
+     * @retval true Queued
+     * @retval false The queue is full or a parameter is invalid, try again after the next transmission
+     */
+    bool queuePacket(uint8_t port, const void *buffer, uint8_t size, bool confirmed = false, uint8_t priority = 0, uint32_t ttlMs = 0, uint16_t coalesceKey = 0);
+
+    /**
+     * @fn queueRecord
+     * @brief Queue a small reading which is packed with the other readings of the port into one packet.
+     * @n     The packet is sent once the readings fill it, one of them has the flush priority or the
+     * @n     oldest one waited for the maximum age, see setAggregation. Each reading is preceded by its
+     * @n     size and its age in seconds in the packet, see UplinkAggregate.h to decode it.
+     * @param port Node communication port with the gateway (1-223)
+     * @param buffer Reading, copied into the queue
+     * @param size Size of the reading
+     * @param confirmed Send the packet carrying the reading in confirmed packet mode
+     * @param priority Higher priorities are packed first, the flush priority sends the packet at once
+     * @param ttlMs Time in ms after which the reading is dropped if not sent yet, 0 for no limit
+     * @return Whether the reading was queued
+     * @retval true Queued
+     * @retval false The queue is full or a parameter is invalid, try again after the next transmission
+     */
+    bool queueRecord(uint8_t port, const void *buffer, uint8_t size, bool confirmed = false, uint8_t priority = 0, uint32_t ttlMs = 0);
+
+    /**
+     * @fn setAggregation
+     * @brief Set when the readings queued by queueRecord are sent.
+     * @param maxAgeMs Maximum time in ms a reading waits for others (60000 by default)
+     * @param flushPriority Readings with this priority or a higher one are sent at once (1 by default)
+     * @param fillPercent Readings are sent once they fill this percentage of the largest packet of the data rate (100 by default)
+     * @return None
+     */
+    void setAggregation(uint32_t maxAgeMs, uint8_t flushPriority = 1, uint8_t fillPercent = 100);
+
+    /**
+     * @fn getQueueStats
+     * @brief Get the queue depth, drop and latency statistics of queuePacket.
+     * @param stats Queue statistics
+     * @return None
+     */
+    void getQueueStats(UplinkQueueStats_t *stats);
+
+    /**
+     * @fn getTaskStats
+     * @brief Get the latency, processing time and stack statistics of the radio service task and of the MAC task.
+     * @param stats Task statistics
+     * @return None
+     */
+    void getTaskStats(LoRaTaskStats_t *stats);
+
+    /**
+     * @fn getRadioIrqStats
+     * @brief Get the radio DIO1 interrupt events counts: queued, dropped when the queue was full and coalesced.
+     * @param stats Interrupt events statistics
+     * @return None
+     */
+    void getRadioIrqStats(RadioIrqStats_t *stats);
+
+    /**
+     * @fn getRadioShadowStats
+     * @brief Get the SPI transactions saved by the shadow copy of the radio configuration: unchanged commands and register writes skipped, register reads skipped and register writes merged, with the transmissions count.
+     * @param stats Shadow copy statistics
+     * @return None
+     */
+    void getRadioShadowStats(SX126xShadowStats_t *stats);
+
+    /**
+     * @fn getRadioResumeStats
+     * @brief Get the radio inits: resumed from warm start sleep without a reset, reset, and the wake to TX start latency of both.
+     * @param stats Radio inits statistics
+     * @return None
+     */
+    void getRadioResumeStats(SX126xResumeStats_t *stats);
+
+    /**
+     * @fn setLightSleep
+     * @brief Put the MCU in light sleep while an uplink is on the air and between its RX windows, the next LoRa timer or DIO1 wakes it up.
+     * @n     The whole chip sleeps: the loop task and the other tasks are stopped meanwhile, up to a few seconds per uplink.
+     * @param enable true to enable the light sleep (Default: disabled)
+     * @return None
+     */
+    void setLightSleep(bool enable);
+
+    /**
+     * @fn setEnergyProfile
+     * @brief Set the supply voltage and the currents of the MCU and radio states used by the energy estimate.
+     * @param profile Energy profile, NULL restores the typical ESP32-S3 and SX1262 currents
+     * @return None
+     */
+    void setEnergyProfile(const LoRaEnergyProfile_t *profile);
+
+    /**
+     * @fn getEnergyStats
+     * @brief Get the time spent in each MCU and radio state and the energy estimate, per uplink and in total.
+     * @param stats Energy statistics
+     * @return None
+     */
+    void getEnergyStats(LoRaEnergyStats_t *stats);
+
     /**
      * @fn setSubBand
      * @brief Set the frequency band for the US915 regional node.
@@ -0,0 +1,434 @@
+/*!
+ * \file      CayenneLppDelta.h
+ *
+ * \brief     Compact telemetry encoder: the readings of a compile-time
+ *            CayenneLPP schema are sent as deltas against the last
+ *            acknowledged readings, with a full CayenneLPP frame when the
+ *            receiver has to resynchronize.
+ *
+ * \remark    C++ only, header only. The schema is a list of fields:
+ *
+ *                typedef CayenneLppSchema<
+ *                    CayenneLppField<1, LPP_TEMPERATURE>,
+ *                    CayenneLppField<2, LPP_RELATIVE_HUMIDITY>,
+ *                    CayenneLppField<3, LPP_GPS> > WeatherSchema;
+ *                static CayenneLppDelta<WeatherSchema> Encoder;
+ *
+ *            Readings are passed as integers in CayenneLPP units (0.1 °C,
+ *            0.5 %, 0.0001 °, ...), one per axis in schema order, so no float
+ *            math is done per field. They are clamped to the field range.
+ *
+ *            Full frame: the CayenneLPP encoding of the schema, byte for byte
+ *            what CayenneLpp.c writes for the same readings.
+ *
+ *            Delta frame:
+ *
+ *            | Reference | Changed    | Deltas                    |
+ *            | 1 byte    | LEB128     | zigzag LEB128 per change  |
+ *
+ *            Reference is the low byte of the uplink counter of the frame the
+ *            deltas apply to, Changed has bit n set when reading n differs
+ *            from it. The receiver keeps the readings of its last frames by
+ *            uplink counter, so a lost acknowledgement only costs a larger
+ *            delta, never a wrong value.
+ *
+ *            The two kinds are told apart by the port: the application sends
+ *            full frames on its CayenneLPP port and delta frames on another
+ *            one (IsDelta).
+ */
+#ifndef __CAYENNE_LPP_DELTA_H__
+#define __CAYENNE_LPP_DELTA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "CayenneLpp.h"
+
+/*!
+ * Frames sent against the same reference before a full frame is forced. Keeps
+ * the reference within the 256 uplinks identified by its counter low byte.
+ */
+#ifndef CAYENNE_LPP_DELTA_RESYNC_PERIOD
+#define CAYENNE_LPP_DELTA_RESYNC_PERIOD             32
+#endif
+
+/*!
+ * Layout of a CayenneLPP data type: axes, bytes per axis, signedness
+ */
+template<uint8_t Type> struct CayenneLppType;
+
+#define CAYENNE_LPP_TYPE( type, axes, bytes, isSigned )                         \
+    template<> struct CayenneLppType<type>                                      \
+    {                                                                           \
+        static const uint8_t Axes = axes;                                       \
+        static const uint8_t Bytes = bytes;                                     \
+        static const bool Signed = isSigned;                                    \
+    }
+
+CAYENNE_LPP_TYPE( LPP_DIGITAL_INPUT,       1, 1, false );
+CAYENNE_LPP_TYPE( LPP_DIGITAL_OUTPUT,      1, 1, false );
+CAYENNE_LPP_TYPE( LPP_ANALOG_INPUT,        1, 2, true );   // 0.01 signed
+CAYENNE_LPP_TYPE( LPP_ANALOG_OUTPUT,       1, 2, true );   // 0.01 signed
+CAYENNE_LPP_TYPE( LPP_LUMINOSITY,          1, 2, false );  // 1 lux
+CAYENNE_LPP_TYPE( LPP_PRESENCE,            1, 1, false );
+CAYENNE_LPP_TYPE( LPP_TEMPERATURE,         1, 2, true );   // 0.1 °C
+CAYENNE_LPP_TYPE( LPP_RELATIVE_HUMIDITY,   1, 1, false );  // 0.5 %
+CAYENNE_LPP_TYPE( LPP_ACCELEROMETER,       3, 2, true );   // 0.001 G
+CAYENNE_LPP_TYPE( LPP_BAROMETRIC_PRESSURE, 1, 2, false );  // 0.1 hPa
+CAYENNE_LPP_TYPE( LPP_GYROMETER,           3, 2, true );   // 0.01 °/s
+CAYENNE_LPP_TYPE( LPP_GPS,                 3, 3, true );   // 0.0001 ° lat/lon, 0.01 m alt
+
+#undef CAYENNE_LPP_TYPE
+
+/*!
+ * Schema field: CayenneLPP channel and data type
+ */
+template<uint8_t ChannelId, uint8_t Type>
+struct CayenneLppField : CayenneLppType<Type>
+{
+    static const uint8_t Channel = ChannelId;
+    static const uint8_t DataType = Type;
+    /*!
+     * Channel, type and axes in a full frame
+     */
+    static const uint8_t FullSize = 2 + CayenneLppType<Type>::Axes * CayenneLppType<Type>::Bytes;
+    static const int32_t Min = CayenneLppType<Type>::Signed ? -( 1L << ( 8 * CayenneLppType<Type>::Bytes - 1 ) ) : 0;
+    static const int32_t Max = CayenneLppType<Type>::Signed ? ( 1L << ( 8 * CayenneLppType<Type>::Bytes - 1 ) ) - 1
+                                                            : ( 1L << ( 8 * CayenneLppType<Type>::Bytes ) ) - 1;
+};
+
+/*!
+ * List of fields, unrolled at compile time
+ */
+template<typename... Fields> struct CayenneLppSchema;
+
+template<>
+struct CayenneLppSchema<>
+{
+    static const uint8_t Readings = 0;
+    static const uint8_t FullSize = 0;
+
+    static void Clamp( const int32_t* src, int32_t* dst ) { }
+    static uint8_t* EncodeFull( const int32_t* readings, uint8_t* buffer ) { return buffer; }
+    static const uint8_t* DecodeFull( const uint8_t* buffer, const uint8_t* end, int32_t* readings ) { return buffer; }
+};
+
+template<typename Field, typename... Fields>
+struct CayenneLppSchema<Field, Fields...>
+{
+    typedef CayenneLppSchema<Fields...> Next;
+
+    /*!
+     * Number of readings, one per axis of each field
+     */
+    static const uint8_t Readings = Field::Axes + Next::Readings;
+    static const uint8_t FullSize = Field::FullSize + Next::FullSize;
+
+    static void Clamp( const int32_t* src, int32_t* dst )
+    {
+        const int32_t min = Field::Min;
+        const int32_t max = Field::Max;
+
+        for( uint8_t i = 0; i < Field::Axes; i++ )
+        {
+            dst[i] = ( src[i] < min ) ? min : ( ( src[i] > max ) ? max : src[i] );
+        }
+        Next::Clamp( src + Field::Axes, dst + Field::Axes );
+    }
+
+    static uint8_t* EncodeFull( const int32_t* readings, uint8_t* buffer )
+    {
+        *buffer++ = Field::Channel;
+        *buffer++ = Field::DataType;
+        for( uint8_t i = 0; i < Field::Axes; i++ )
+        {
+            for( uint8_t b = Field::Bytes; b-- > 0; )
+            {
+                *buffer++ = ( uint8_t )( readings[i] >> ( 8 * b ) );
+            }
+        }
+        return Next::EncodeFull( readings + Field::Axes, buffer );
+    }
+
+    /*!
+     * \retval next End of the field, NULL if the frame does not match the
+     *              schema
+     */
+    static const uint8_t* DecodeFull( const uint8_t* buffer, const uint8_t* end, int32_t* readings )
+    {
+        if( ( ( end - buffer ) < Field::FullSize ) || ( buffer[0] != Field::Channel ) || ( buffer[1] != Field::DataType ) )
+        {
+            return NULL;
+        }
+        buffer += 2;
+        for( uint8_t i = 0; i < Field::Axes; i++ )
+        {
+            uint32_t value = 0;
+
+            for( uint8_t b = 0; b < Field::Bytes; b++ )
+            {
+                value = ( value << 8 ) | *buffer++;
+            }
+            if( ( Field::Signed == true ) && ( ( value >> ( 8 * Field::Bytes - 1 ) ) != 0 ) )
+            {
+                value |= ~0UL << ( 8 * Field::Bytes - 1 );
+            }
+            readings[i] = ( int32_t )value;
+        }
+        return Next::DecodeFull( buffer, end, readings + Field::Axes );
+    }
+};
+
+template<typename Schema>
+class CayenneLppDelta
+{
+public:
+    static const uint8_t Readings = Schema::Readings;
+    /*!
+     * Largest frame, a full one
+     */
+    static const uint8_t MaxSize = Schema::FullSize;
+
+    CayenneLppDelta( ) : HasReference( false ), PendingValid( false ), Delta( false ), ReferenceCounter( 0 ),
+                         Since( 0 )
+    {
+    }
+
+    /*!
+     * \brief Forces a full frame next, e.g. after a join or when the receiver
+     *        asks for it
+     */
+    void Resync( void )
+    {
+        HasReference = false;
+    }
+
+    /*!
+     * \brief Encodes readings, as a delta frame if there is an acknowledged
+     *        reference and the delta is smaller than the full frame
+     *
+     * \param [IN]  readings Readings in schema order
+     * \param [OUT] buffer   Frame
+     * \param [IN]  maxSize  Buffer size, MaxSize always fits
+     * \retval size Frame size, 0 if it does not fit maxSize
+     */
+    uint8_t Encode( const int32_t* readings, uint8_t* buffer, uint8_t maxSize )
+    {
+        uint8_t size = 0;
+
+        Schema::Clamp( readings, Pending );
+        PendingValid = true;
+        Delta = ( HasReference == true ) && ( Since < CAYENNE_LPP_DELTA_RESYNC_PERIOD );
+        if( Delta == true )
+        {
+            size = EncodeDelta( buffer, maxSize );
+            Delta = size != 0;
+        }
+        if( Delta == false )
+        {
+            if( maxSize < MaxSize )
+            {
+                PendingValid = false;
+                return 0;
+            }
+            size = ( uint8_t )( Schema::EncodeFull( Pending, buffer ) - buffer );
+        }
+        if( Since < UINT8_MAX )
+        {
+            Since++;
+        }
+        return size;
+    }
+
+    /*!
+     * \brief Tells if the last encoded frame is a delta one
+     */
+    bool IsDelta( void ) const
+    {
+        return Delta;
+    }
+
+    /*!
+     * \brief The last encoded frame was received: its readings become the
+     *        reference of the next deltas. To be called from OnTxData when a
+     *        confirmed frame is acknowledged.
+     *
+     * \param [IN] uplinkCounter Uplink counter of the frame
+     */
+    void Acknowledge( uint32_t uplinkCounter )
+    {
+        if( PendingValid == false )
+        {
+            return;
+        }
+        for( uint8_t i = 0; i < Readings; i++ )
+        {
+            Reference[i] = Pending[i];
+        }
+        ReferenceCounter = ( uint8_t )uplinkCounter;
+        HasReference = true;
+        PendingValid = false;
+        Since = 0;
+    }
+
+    /*!
+     * \brief Decodes a full frame
+     *
+     * \param [IN]  buffer   Frame
+     * \param [IN]  size     Frame size
+     * \param [OUT] readings Readings in schema order
+     * \retval status false if the frame does not match the schema
+     */
+    static bool DecodeFull( const uint8_t* buffer, uint8_t size, int32_t* readings )
+    {
+        return Schema::DecodeFull( buffer, buffer + size, readings ) == ( buffer + size );
+    }
+
+    /*!
+     * \brief Decodes a delta frame
+     *
+     * \param [IN]  buffer    Frame
+     * \param [IN]  size      Frame size
+     * \param [IN]  reference Readings of the reference frame, looked up by the
+     *                        caller from ReferenceOf
+     * \param [OUT] readings  Readings in schema order
+     * \retval status false if the frame is malformed
+     */
+    static bool DecodeDelta( const uint8_t* buffer, uint8_t size, const int32_t* reference, int32_t* readings )
+    {
+        const uint8_t* end = buffer + size;
+        uint32_t changed;
+
+        if( size == 0 )
+        {
+            return false;
+        }
+        buffer++;
+        if( ( ReadVarint( buffer, end, &changed ) == false ) ||
+            ( ( Readings < 32 ) && ( ( changed >> ( Readings & 31 ) ) != 0 ) ) )
+        {
+            return false;
+        }
+        for( uint8_t i = 0; i < Readings; i++ )
+        {
+            uint32_t zigzag = 0;
+
+            if( ( ( changed >> i ) & 1 ) && ( ReadVarint( buffer, end, &zigzag ) == false ) )
+            {
+                return false;
+            }
+            readings[i] = ( int32_t )( ( uint32_t )reference[i] + ( ( zigzag >> 1 ) ^ ( 0U - ( zigzag & 1 ) ) ) );
+        }
+        return buffer == end;
+    }
+
+    /*!
+     * \brief Low byte of the uplink counter of the reference of a delta frame
+     */
+    static uint8_t ReferenceOf( const uint8_t* buffer )
+    {
+        return buffer[0];
+    }
+
+private:
+    static_assert( Readings <= 32, "a delta frame flags at most 32 changed readings" );
+
+    static uint8_t VarintSize( uint32_t value )
+    {
+        uint8_t size = 1;
+
+        while( value > 0x7F )
+        {
+            value >>= 7;
+            size++;
+        }
+        return size;
+    }
+
+    static uint8_t* WriteVarint( uint8_t* buffer, uint32_t value )
+    {
+        while( value > 0x7F )
+        {
+            *buffer++ = ( uint8_t )( value | 0x80 );
+            value >>= 7;
+        }
+        *buffer++ = ( uint8_t )value;
+        return buffer;
+    }
+
+    static bool ReadVarint( const uint8_t*& buffer, const uint8_t* end, uint32_t* value )
+    {
+        *value = 0;
+        for( uint8_t shift = 0; shift < 35; shift += 7 )
+        {
+            if( buffer == end )
+            {
+                return false;
+            }
+            *value |= ( uint32_t )( *buffer & 0x7F ) << shift;
+            if( ( *buffer++ & 0x80 ) == 0 )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*!
+     * \retval size Delta frame size, 0 if it is not smaller than the full
+     *              frame or does not fit
+     */
+    uint8_t EncodeDelta( uint8_t* buffer, uint8_t maxSize )
+    {
+        uint32_t zigzag[Readings];
+        uint32_t changed = 0;
+        uint16_t size = 1;
+        uint8_t* cursor;
+
+        for( uint8_t i = 0; i < Readings; i++ )
+        {
+            int32_t delta = ( int32_t )( ( uint32_t )Pending[i] - ( uint32_t )Reference[i] );
+
+            zigzag[i] = ( ( uint32_t )delta << 1 ) ^ ( uint32_t )( delta >> 31 );
+            if( delta != 0 )
+            {
+                changed |= 1UL << i;
+                size += VarintSize( zigzag[i] );
+            }
+        }
+        size += VarintSize( changed );
+        if( ( size >= MaxSize ) || ( size > maxSize ) )
+        {
+            return 0;
+        }
+
+        buffer[0] = ReferenceCounter;
+        cursor = WriteVarint( &buffer[1], changed );
+        for( uint8_t i = 0; i < Readings; i++ )
+        {
+            if( zigzag[i] != 0 )
+            {
+                cursor = WriteVarint( cursor, zigzag[i] );
+            }
+        }
+        return ( uint8_t )size;
+    }
+
+    /*!
+     * Last acknowledged readings and low byte of their uplink counter
+     */
+    int32_t Reference[Readings];
+    /*!
+     * Readings of the last encoded frame, until it is acknowledged
+     */
+    int32_t Pending[Readings];
+    bool HasReference;
+    bool PendingValid;
+    bool Delta;
+    uint8_t ReferenceCounter;
+    /*!
+     * Frames encoded since the reference
+     */
+    uint8_t Since;
+};
+
+#endif // __CAYENNE_LPP_DELTA_H__
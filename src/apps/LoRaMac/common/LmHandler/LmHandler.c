@@ -25,11 +25,15 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "system/utilities.h"
 #include "boards/mcu/timer.h"
+#include "boards/lora-energy.h"
 #include "apps/LoRaMac/common/Commissioning.h"
 #include "apps/LoRaMac/common/NvmDataMgmt.h"
 #include "radio/radio.h"
+#include "mac/region/Region.h"
+#include "mac/region/RegionUS915.h"
 #include "LmHandler.h"
 #include "packages/LmhPackage.h"
 #include "packages/LmhpCompliance.h"
@@ -46,6 +50,7 @@
 // #endif
 
 #include "mac/LoRaMacTest.h"
+#include "mac/LoRaMacRxCalibration.h"
 #include <Arduino.h>
 
 RTC_DATA_ATTR static CommissioningParams_t CommissioningParams =
@@ -134,59 +139,60 @@ RTC_DATA_ATTR static LoRaMAcHandlerBeaconParams_t BeaconParams =
 RTC_DATA_ATTR static bool IsClassBSwitchPending = false;
 
 
-// 协议栈输出功率下标对应设置功率
-const uint8_t txpowerEirpEU868[][2] = {
-        {TX_POWER_0, 16},
-        {TX_POWER_1, 14},
-        {TX_POWER_2, 12},
-        {TX_POWER_3, 10},
-        {TX_POWER_4, 8},
-        {TX_POWER_5, 6},
-        {TX_POWER_6, 4},
-        {TX_POWER_7, 2}
-};
-
-const uint8_t txpowerEirpUS915[][2] = {
-        {TX_POWER_4, 22},
-        {TX_POWER_5, 20},
-        {TX_POWER_6, 18},
-        {TX_POWER_7, 16},
-        {TX_POWER_8, 14},
-        {TX_POWER_9, 12},
-        {TX_POWER_10, 10},
-        {TX_POWER_11, 8},
-        {TX_POWER_12, 6},
-        {TX_POWER_13, 4},
-        {TX_POWER_14, 2}
-};
+/*!
+ * Highest EIRP of the node, in dBm ( SX1262, +22 dBm ). The power steps of a
+ * region above it are not offered.
+ */
+#define LMHANDLER_MAX_EIRP                          22
 
-// 获取地区索引数组的行数
-static uint8_t getTxpowerEirpRowNum(LoRaMacRegion_t region)
+// 地区发射功率计算所用的最大EIRP（与地区TxConfig一致）
+static int8_t getMaxEirp(LoRaMacRegion_t region)
 {
-    switch (region)
+    GetPhyParams_t getPhy;
+
+    if (region == LORAMAC_REGION_US915)
     {
-    case LORAMAC_REGION_EU868:
-        return (sizeof(txpowerEirpEU868) / sizeof(txpowerEirpEU868[0]));
-        break;
+        // US915的TxConfig从最大ERP计算功率，PHY_DEF_MAX_EIRP多出2.15dB
+        return (int8_t)US915_DEFAULT_MAX_ERP;
+    }
+    getPhy.Attribute = PHY_DEF_MAX_EIRP;
+    return (int8_t)RegionGetPhyParam(region, &getPhy).fValue;
+}
 
-    case LORAMAC_REGION_US915:
-        return (sizeof(txpowerEirpUS915) / sizeof(txpowerEirpUS915[0]));
-        break;
-    default:
-        return 0;
-        break;
+// 地区默认最大EIRP，协议栈输出功率下标每加1降低2dB
+static int8_t getTxpowerEirp(LoRaMacRegion_t region, int8_t txPower)
+{
+    int8_t eirp;
+
+    eirp = getMaxEirp(region) - 2 * txPower;
+    if (eirp > LMHANDLER_MAX_EIRP)
+    {
+        eirp = LMHANDLER_MAX_EIRP;
     }
+    return (eirp < 0) ? 0 : eirp;
 }
 
 // 检查输入发射功率是否合法并获取TXpower
-static bool isEirpValid(const uint8_t (*txpowerEirp)[2], uint8_t row, uint8_t eripS, uint8_t *index)
+static bool isEirpValid(LoRaMacRegion_t region, uint8_t eripS, uint8_t *index)
 {
-    for (int i = 0; i < row; i++)
+    VerifyParams_t verify;
+    int8_t maxEirp;
+
+    maxEirp = getMaxEirp(region);
+    // 从最高功率TX_POWER_0开始，直到地区不支持的下标
+    for (uint8_t i = TX_POWER_0; i <= TX_POWER_15; i++)
     {
-        if (txpowerEirp[i][1] == eripS)
+        int8_t eirp = maxEirp - 2 * i;
+
+        verify.TxPower = i;
+        if (RegionVerify(region, &verify, PHY_TX_POWER) == false)
+        {
+            break;
+        }
+
+        if ((eirp <= LMHANDLER_MAX_EIRP) && (eirp == eripS))
         {
-            // printf("txpowerEirp[i][0] = %d, txpowerEirp[i][1] = %d", txpowerEirp[i][0], txpowerEirp[i][1]);
-            *index = txpowerEirp[i][0];
+            *index = i;
             return true;
         }
     }
@@ -194,7 +200,10 @@ static bool isEirpValid(const uint8_t (*txpowerEirp)[2], uint8_t row, uint8_t er
     return false;
 }
 
-
+uint8_t LmHandlerGetTxEirp(int8_t txPower)
+{
+    return getTxpowerEirp(LmHandlerParams->Region, txPower);
+}
 
 /*!
  * \brief   MCPS-Confirm event function
@@ -269,10 +278,47 @@ static void LmHandlerPackagesNotify(PackageNotifyTypes_t notifyType, void *param
 
 static void LmHandlerPackagesProcess(void);
 
-LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmHandlerParams_t *handlerParams)
+/*!
+ * \brief Checks that the contexts restored from flash belong to the device
+ *        described by the handler parameters
+ *
+ * \retval match false if the region or the device identity differ
+ */
+static bool LmHandlerRestoredCtxsMatch(void)
 {
-
     MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NVM_CTXS;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    if (mibReq.Param.Contexts->MacGroup2.Region != LmHandlerParams->Region)
+    {
+        return false;
+    }
+    mibReq.Type = MIB_NETWORK_ACTIVATION;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    if (mibReq.Param.NetworkActivation == ACTIVATION_TYPE_ABP)
+    {
+        mibReq.Type = MIB_DEV_ADDR;
+        LoRaMacMibGetRequestConfirm(&mibReq);
+        return mibReq.Param.DevAddr == LmHandlerParams->DevAddr;
+    }
+    mibReq.Type = MIB_DEV_EUI;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    if (memcmp(mibReq.Param.DevEui, LmHandlerParams->DevEui, 8) != 0)
+    {
+        return false;
+    }
+    mibReq.Type = MIB_JOIN_EUI;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    return memcmp(mibReq.Param.JoinEui, LmHandlerParams->JoinEui, 8) == 0;
+}
+
+/*!
+ * \brief Binds the handler parameters and callbacks and the MAC primitives
+ *        and callbacks
+ */
+static void LmHandlerBind(LmHandlerCallbacks_t *handlerCallbacks, LmHandlerParams_t *handlerParams)
+{
     LmHandlerParams = handlerParams;
     LmHandlerCallbacks = handlerCallbacks;
 
@@ -286,6 +332,13 @@ LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmH
     LoRaMacCallbacks.MacProcessNotify = LmHandlerCallbacks->OnMacProcess;
 
     IsClassBSwitchPending = false;
+}
+
+LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmHandlerParams_t *handlerParams)
+{
+
+    MibRequestConfirm_t mibReq;
+    LmHandlerBind(handlerCallbacks, handlerParams);
 
     if (LoRaMacInitialization(&LoRaMacPrimitives, &LoRaMacCallbacks, LmHandlerParams->Region) != LORAMAC_STATUS_OK)
     {
@@ -299,6 +352,38 @@ LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmH
         return LORAMAC_HANDLER_SUCCESS;
     }
 
+    // Cold boot: the RTC memory lost the contexts, restore them from flash     冷启动：从flash恢复上下文
+    uint16_t nvmSize = NvmDataMgmtRestore();
+    if (nvmSize > 0)
+    {
+        if (LmHandlerRestoredCtxsMatch() == false)
+        {
+            // Contexts of another device or region, start from the defaults
+            mibReq.Type = MIB_NETWORK_ACTIVATION;
+            mibReq.Param.NetworkActivation = ACTIVATION_TYPE_NONE;
+            LoRaMacMibSetRequestConfirm(&mibReq);
+            if (LoRaMacInitialization(&LoRaMacPrimitives, &LoRaMacCallbacks, LmHandlerParams->Region) != LORAMAC_STATUS_OK)
+            {
+                return LORAMAC_HANDLER_ERROR;
+            }
+        }
+        else
+        {
+            if (LmHandlerCallbacks->OnNvmDataChange != NULL)
+            {
+                LmHandlerCallbacks->OnNvmDataChange(LORAMAC_HANDLER_NVM_RESTORE, nvmSize);
+            }
+            mibReq.Type = MIB_NETWORK_ACTIVATION;
+            LoRaMacMibGetRequestConfirm(&mibReq);
+            if (mibReq.Param.NetworkActivation != ACTIVATION_TYPE_NONE)     // 恢复了会话，不必重新入网
+            {
+                LoRaMacStart();
+                return LORAMAC_HANDLER_SUCCESS;
+            }
+            // Not joined yet, the restored DevNonce is kept
+        }
+    }
+
 
     // set
     // 公共网络
@@ -377,30 +462,13 @@ LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmH
     // 发射功率
     mibReq.Type = MIB_CHANNELS_TX_POWER;
     uint8_t index = 0;
-    switch(LmHandlerParams->Region)
+    if(isEirpValid(LmHandlerParams->Region, LmHandlerParams->TxEirp, &index))
     {
-    case LORAMAC_REGION_US915:
-        if(isEirpValid(txpowerEirpUS915, getTxpowerEirpRowNum(LORAMAC_REGION_US915), LmHandlerParams->TxEirp, &index))
-        {
-            mibReq.Param.ChannelsTxPower = index;   //(maxEirp - dtuConfig.loraWanPara.eirp - antennaGain)/2;
-        } 
-        else 
-        {
-            mibReq.Param.ChannelsTxPower = TX_POWER_0;
-        }
-        break;
-    case LORAMAC_REGION_EU868:
-        if(isEirpValid(txpowerEirpEU868, getTxpowerEirpRowNum(LORAMAC_REGION_EU868), LmHandlerParams->TxEirp, &index)) 
-        {
-            mibReq.Param.ChannelsTxPower = index;   //(maxEirp - dtuConfig.loraWanPara.eirp - antennaGain)/2;
-        } 
-        else 
-        {
-            mibReq.Param.ChannelsTxPower = TX_POWER_0;
-        }
-        break;
-    default:
-        break;
+        mibReq.Param.ChannelsTxPower = index;   //(maxEirp - dtuConfig.loraWanPara.eirp - antennaGain)/2;
+    }
+    else
+    {
+        mibReq.Param.ChannelsTxPower = TX_POWER_0;
     }
     LoRaMacMibSetRequestConfirm(&mibReq);
     mibReq.Type = MIB_CHANNELS_DEFAULT_TX_POWER;
@@ -445,6 +513,26 @@ LmHandlerErrorStatus_t LmHandlerInit(LmHandlerCallbacks_t *handlerCallbacks, LmH
     return LORAMAC_HANDLER_SUCCESS;
 }
 
+LmHandlerErrorStatus_t LmHandlerSuspend(void)
+{
+    if (LoRaMacSuspend() != LORAMAC_STATUS_OK)
+    {
+        return LORAMAC_HANDLER_ERROR;
+    }
+    return LORAMAC_HANDLER_SUCCESS;
+}
+
+LmHandlerErrorStatus_t LmHandlerResume(LmHandlerCallbacks_t *handlerCallbacks, LmHandlerParams_t *handlerParams)
+{
+    LmHandlerBind(handlerCallbacks, handlerParams);
+
+    if (LoRaMacResume(&LoRaMacPrimitives, &LoRaMacCallbacks, LmHandlerParams->Region) != LORAMAC_STATUS_OK)
+    {
+        return LORAMAC_HANDLER_ERROR;
+    }
+    return LORAMAC_HANDLER_SUCCESS;
+}
+
 bool LmHandlerIsBusy(void)
 {
     if (LoRaMacIsBusy() == true)
@@ -458,7 +546,7 @@ bool LmHandlerIsBusy(void)
         return true;
     }
 
-    if (LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->IsRunning() == true)
+    if ((LmHandlerPackages[PACKAGE_ID_COMPLIANCE] != NULL) && (LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->IsRunning() == true))
     {
         return true;
     }
@@ -467,7 +555,7 @@ bool LmHandlerIsBusy(void)
 
 void LmHandlerProcess(void)
 {
-    // uint16_t size = 0;
+    uint16_t size = 0;
 
     // Process Radio IRQ
     // if (Radio.IrqProcess != NULL)
@@ -487,12 +575,12 @@ void LmHandlerProcess(void)
     LmHandlerPackagesProcess();
 
     // Store to NVM if required
-    // size = NvmDataMgmtStore();
+    size = NvmDataMgmtStore();
 
-    // if (size > 0)
-    // {
-    //     LmHandlerCallbacks->OnNvmDataChange(LORAMAC_HANDLER_NVM_STORE, size);
-    // }
+    if ((size > 0) && (LmHandlerCallbacks->OnNvmDataChange != NULL))
+    {
+        LmHandlerCallbacks->OnNvmDataChange(LORAMAC_HANDLER_NVM_STORE, size);
+    }
 }
 
 /*!
@@ -587,7 +675,8 @@ LmHandlerErrorStatus_t LmHandlerSend(LmHandlerAppData_t *appData, LmHandlerMsgTy
         return LORAMAC_HANDLER_ERROR;
     }
 
-    if ((LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->IsRunning() == true) && (appData->Port != LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->Port) && (appData->Port != 0))
+    // The compliance package is only there when the application registers it
+    if ((LmHandlerPackages[PACKAGE_ID_COMPLIANCE] != NULL) && (LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->IsRunning() == true) && (appData->Port != LmHandlerPackages[PACKAGE_ID_COMPLIANCE]->Port) && (appData->Port != 0))
     {
         return LORAMAC_HANDLER_ERROR;
     }
@@ -808,6 +897,15 @@ LmHandlerErrorStatus_t LmHandlerSetSystemMaxRxError(uint32_t maxErrorInMs)
     return LORAMAC_HANDLER_SUCCESS;
 }
 
+void LmHandlerSetRxCalibration(bool enable)
+{
+    LoRaMacRxCalibrationEnable(enable);
+    if (enable == false)
+    {
+        LoRaMacRxCalibrationReset();
+    }
+}
+
 /*
  *=============================================================================
  * LORAMAC NOTIFICATIONS HANDLING   Loramac通知处理
@@ -816,6 +914,9 @@ LmHandlerErrorStatus_t LmHandlerSetSystemMaxRxError(uint32_t maxErrorInMs)
 
 static void McpsConfirm(McpsConfirm_t *mcpsConfirm)
 {
+    // RX窗口已结束，结算本次上行的能耗
+    LoRaEnergyUplinkEnd();
+
     TxParams.IsMcpsConfirm = 1;
     TxParams.Status = mcpsConfirm->Status;
     TxParams.Datarate = mcpsConfirm->Datarate;
@@ -895,6 +996,8 @@ static void MlmeConfirm(MlmeConfirm_t *mlmeConfirm)
     case MLME_JOIN:
     {
         MibRequestConfirm_t mibReq;
+
+        LoRaEnergyUplinkEnd();
         mibReq.Type = MIB_DEV_ADDR;
         LoRaMacMibGetRequestConfirm(&mibReq);
         JoinParams.CommissioningParams->DevAddr = mibReq.Param.DevAddr;
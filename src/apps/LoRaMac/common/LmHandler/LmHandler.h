@@ -33,9 +33,6 @@ extern "C"
 #include "LmHandlerTypes.h"
 #include "packages/LmhpCompliance.h"
 
-extern const uint8_t txpowerEirpEU868[][2];
-extern const uint8_t txpowerEirpUS915[][2];
-
 typedef struct LmHandlerJoinParams_s
 {
     CommissioningParams_t *CommissioningParams;
@@ -258,6 +255,33 @@ typedef struct LmHandlerCallbacks_s
 LmHandlerErrorStatus_t LmHandlerInit( LmHandlerCallbacks_t *callbacks,
                                       LmHandlerParams_t *handlerParams );
 
+/*!
+ * Seals the session before a deep sleep for LmHandlerResume     深度睡眠前封存会话
+ *
+ * \retval status Returns \ref LORAMAC_HANDLER_SUCCESS if sealed, else
+ *                \ref LORAMAC_HANDLER_ERROR: not joined or MAC busy
+ */
+LmHandlerErrorStatus_t LmHandlerSuspend( void );
+
+/*!
+ * Resumes the session sealed by LmHandlerSuspend after a deep sleep instead
+ * of LmHandlerInit      深度睡眠唤醒后恢复会话，代替LmHandlerInit
+ *
+ * \remark The session kept in the RTC memory is checked against its CRCs. The
+ *         callbacks, the timers and the radio events are bound again, the MAC
+ *         parameters are kept. On \ref LORAMAC_HANDLER_ERROR call
+ *         LmHandlerInit, which starts over from the defaults or from flash
+ *         when the session was corrupted.
+ *
+ * \param [IN] callbacks     LoRaMac handler callbacks
+ * \param [IN] handlerParams LoRaMac handler parameters
+ *
+ * \retval status Returns \ref LORAMAC_HANDLER_SUCCESS if resumed, else
+ *                \ref LORAMAC_HANDLER_ERROR
+ */
+LmHandlerErrorStatus_t LmHandlerResume( LmHandlerCallbacks_t *callbacks,
+                                        LmHandlerParams_t *handlerParams );
+
 /*!
  * Indicates if the LoRaMacHandler is busy      检测mac层是否繁忙
  * 
@@ -345,6 +369,16 @@ int8_t LmHandlerGetCurrentDatarate( void );
  */
 LoRaMacRegion_t LmHandlerGetActiveRegion( void );
 
+/*!
+ * Gets the EIRP of a TX power of the active region, limited to the one of
+ * the radio                                            获取当前地区输出功率下标对应的EIRP
+ *
+ * \param [IN] txPower TX power index, see TX_POWER_0
+ *
+ * \retval eirp EIRP in dBm
+ */
+uint8_t LmHandlerGetTxEirp( int8_t txPower );
+
 /*!
  * Set system maximum tolerated rx error in milliseconds        设置系统最大耐受性RX错误中的毫秒误差
  *
@@ -355,6 +389,15 @@ LoRaMacRegion_t LmHandlerGetActiveRegion( void );
  */
 LmHandlerErrorStatus_t LmHandlerSetSystemMaxRxError( uint32_t maxErrorInMs );
 
+/*!
+ * Enables or disables the RX windows timing calibration, enabled by default.
+ * The calibrated windows are narrowed from the measured timing error of the
+ * downlinks, the disabled ones always cover the system maximum rx error.
+ *
+ * \param [IN] enable Set to false to always use the system maximum rx error
+ */
+void LmHandlerSetRxCalibration( bool enable );
+
 /*
  *=============================================================================
  * PACKAGES HANDLING        包装处理
@@ -31,9 +31,10 @@
  * \author    Johannes Bruder ( STACKFORCE )
  */
 
+#include <stddef.h>
 #include <stdio.h>
 #include "system/utilities.h"
-// #include "nvmm.h"
+#include "system/nvmm.h"
 #include "mac/LoRaMac.h"
 #include "NvmDataMgmt.h"
 
@@ -45,230 +46,188 @@
 #define CONTEXT_MANAGEMENT_ENABLED         1
 #endif
 
-
-// static uint16_t NvmNotifyFlags = 0;
-
-void NvmDataMgmtEvent( uint16_t notifyFlags )
+#if( CONTEXT_MANAGEMENT_ENABLED == 1 )
+/*!
+ * NVM group stored in flash
+ */
+typedef struct NvmDataMgmtGroup_s
 {
-    // NvmNotifyFlags = notifyFlags;
-}
-
-uint16_t NvmDataMgmtStore( void )
+    /*!
+     * LORAMAC_NVM_NOTIFY_FLAG_XXX of the group
+     */
+    uint16_t NotifyFlag;
+    /*!
+     * Offset in LoRaMacNvmData_t, the groups may be padded
+     */
+    uint16_t Offset;
+    /*!
+     * Group size, CRC32 included
+     */
+    uint16_t Size;
+}NvmDataMgmtGroup_t;
+
+static const NvmDataMgmtGroup_t NvmGroups[] =
 {
-// #if( CONTEXT_MANAGEMENT_ENABLED == 1 )
-//     uint16_t offset = 0;
-//     uint16_t dataSize = 0;
-//     MibRequestConfirm_t mibReq;
-//     mibReq.Type = MIB_NVM_CTXS;
-//     LoRaMacMibGetRequestConfirm( &mibReq );
-//     LoRaMacNvmData_t* nvm = mibReq.Param.Contexts;
-
-//     // Input checks
-//     if( NvmNotifyFlags == LORAMAC_NVM_NOTIFY_FLAG_NONE )
-//     {
-//         // There was no update.
-//         return 0;
-//     }
-//     if( LoRaMacStop( ) != LORAMAC_STATUS_OK )
-//     {
-//         return 0;
-//     }
-
-//     // Crypto
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_CRYPTO )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->Crypto, sizeof( nvm->Crypto ),
-//                                offset );
-//     }
-//     offset += sizeof( nvm->Crypto );
+    { LORAMAC_NVM_NOTIFY_FLAG_CRYPTO, offsetof( LoRaMacNvmData_t, Crypto ), sizeof( LoRaMacCryptoNvmData_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1, offsetof( LoRaMacNvmData_t, MacGroup1 ), sizeof( LoRaMacNvmDataGroup1_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2, offsetof( LoRaMacNvmData_t, MacGroup2 ), sizeof( LoRaMacNvmDataGroup2_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT, offsetof( LoRaMacNvmData_t, SecureElement ), sizeof( SecureElementNvmData_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1, offsetof( LoRaMacNvmData_t, RegionGroup1 ), sizeof( RegionNvmDataGroup1_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2, offsetof( LoRaMacNvmData_t, RegionGroup2 ), sizeof( RegionNvmDataGroup2_t ) },
+    { LORAMAC_NVM_NOTIFY_FLAG_CLASS_B, offsetof( LoRaMacNvmData_t, ClassB ), sizeof( LoRaMacClassBNvmData_t ) },
+};
 
-//     // MacGroup1
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->MacGroup1,
-//                                sizeof( nvm->MacGroup1 ), offset );
-//     }
-//     offset += sizeof( nvm->MacGroup1 );
+#define NVM_GROUPS_NB                      ( sizeof( NvmGroups ) / sizeof( NvmGroups[0] ) )
 
-//     // MacGroup2
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->MacGroup2,
-//                                sizeof( nvm->MacGroup2 ), offset );
-//     }
-//     offset += sizeof( nvm->MacGroup2 );
-
-//     // Secure element
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->SecureElement, sizeof( nvm->SecureElement ),
-//                                offset );
-//     }
-//     offset += sizeof( nvm->SecureElement );
+/*!
+ * Groups notified by the MAC since the last store
+ */
+static uint16_t NvmNotifyFlags = 0;
 
-//     // Region group 1
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->RegionGroup1,
-//                                sizeof( nvm->RegionGroup1 ), offset );
-//     }
-//     offset += sizeof( nvm->RegionGroup1 );
+/*!
+ * Copy of the contexts as stored in flash. NvmmWrite compares the MAC
+ * contexts with it and only logs the bytes which changed.
+ */
+static LoRaMacNvmData_t NvmImage;
 
-//     // Region group 2
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->RegionGroup2,
-//                                sizeof( nvm->RegionGroup2 ), offset );
-//     }
-//     offset += sizeof( nvm->RegionGroup2 );
+/*!
+ * The log is mounted, NvmImage is valid
+ */
+static bool NvmMounted = false;
 
-//     // Class b
-//     if( ( NvmNotifyFlags & LORAMAC_NVM_NOTIFY_FLAG_CLASS_B ) ==
-//         LORAMAC_NVM_NOTIFY_FLAG_CLASS_B )
-//     {
-//         dataSize += NvmmWrite( ( uint8_t* ) &nvm->ClassB, sizeof( nvm->ClassB ),
-//                                offset );
-//     }
-//     offset += sizeof( nvm->ClassB );
+/*!
+ * MAC contexts, read only here
+ */
+static LoRaMacNvmData_t* NvmCtxs = NULL;
 
-//     // Reset notification flags
-//     NvmNotifyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+/*!
+ * \brief Mounts the log and loads NvmImage
+ *
+ * \retval status false when the board has no flash storage
+ */
+static bool NvmDataMgmtMount( void )
+{
+    NvmMounted = NvmmInit( ( uint8_t* ) &NvmImage, sizeof( NvmImage ) );
+    return NvmMounted;
+}
+#endif
 
-//     // Resume LoRaMac
-//     LoRaMacStart( );
-//     return dataSize;
-// #else
-//     return 0;
-// #endif
+void NvmDataMgmtEvent( uint16_t notifyFlags )
+{
+#if( CONTEXT_MANAGEMENT_ENABLED == 1 )
+    NvmNotifyFlags |= notifyFlags;
+#endif
+}
 
-return 0;
+uint16_t NvmDataMgmtStore( void )
+{
+#if( CONTEXT_MANAGEMENT_ENABLED == 1 )
+    uint16_t dataSize = 0;
+
+    // Input checks
+    if( NvmNotifyFlags == LORAMAC_NVM_NOTIFY_FLAG_NONE )
+    {
+        // There was no update.
+        return 0;
+    }
+    if( NvmMounted == false )
+    {
+        if( NvmDataMgmtMount( ) == false )
+        {
+            // No flash storage, the contexts are only kept in RTC memory
+            NvmNotifyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+            return 0;
+        }
+        // Changes notified before a deep sleep are compared as well
+        for( uint8_t i = 0; i < NVM_GROUPS_NB; i++ )
+        {
+            NvmNotifyFlags |= NvmGroups[i].NotifyFlag;
+        }
+    }
+    if( LoRaMacStop( ) != LORAMAC_STATUS_OK )
+    {
+        return 0;
+    }
+    if( NvmCtxs == NULL )
+    {
+        MibRequestConfirm_t mibReq;
+
+        // The get marks all the groups as written, only fetch the pointer once
+        mibReq.Type = MIB_NVM_CTXS;
+        LoRaMacMibGetRequestConfirm( &mibReq );
+        NvmCtxs = mibReq.Param.Contexts;
+    }
+
+    // Only the bytes which differ from the flash copy are written
+    for( uint8_t i = 0; i < NVM_GROUPS_NB; i++ )
+    {
+        if( ( NvmNotifyFlags & NvmGroups[i].NotifyFlag ) != 0 )
+        {
+            dataSize += NvmmWrite( ( uint8_t* ) NvmCtxs + NvmGroups[i].Offset, NvmGroups[i].Size,
+                                   NvmGroups[i].Offset );
+        }
+    }
+
+    // A failed commit is retried with the next notification, the log keeps
+    // the previous contexts meanwhile
+    NvmmCommit( );
+
+    // Reset notification flags
+    NvmNotifyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+
+    // Resume LoRaMac
+    LoRaMacStart( );
+    return dataSize;
+#else
+    return 0;
+#endif
 }
 
 uint16_t NvmDataMgmtRestore( void )
 {
-// #if( CONTEXT_MANAGEMENT_ENABLED == 1 )
-//     MibRequestConfirm_t mibReq;
-//     mibReq.Type = MIB_NVM_CTXS;
-//     LoRaMacMibGetRequestConfirm( &mibReq );
-//     LoRaMacNvmData_t* nvm = mibReq.Param.Contexts;
-//     uint16_t offset = 0;
-
-//     // Crypto
-//     if( NvmmCrc32Check( sizeof( LoRaMacCryptoNvmData_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( LoRaMacCryptoNvmData_t );
-
-//     // Mac Group 1
-//     if( NvmmCrc32Check( sizeof( LoRaMacNvmDataGroup1_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( LoRaMacNvmDataGroup1_t );
-
-//     // Mac Group 2
-//     if( NvmmCrc32Check( sizeof( LoRaMacNvmDataGroup2_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( LoRaMacNvmDataGroup2_t );
-
-//     // Secure element
-//     if( NvmmCrc32Check( sizeof( SecureElementNvmData_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( SecureElementNvmData_t );
-
-//     // Region group 1
-//     if( NvmmCrc32Check( sizeof( RegionNvmDataGroup1_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( RegionNvmDataGroup1_t );
-
-//     // Region group 2
-//     if( NvmmCrc32Check( sizeof( RegionNvmDataGroup2_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( RegionNvmDataGroup2_t );
-
-//     // Class b
-//     if( NvmmCrc32Check( sizeof( LoRaMacClassBNvmData_t ), offset ) == false )
-//     {
-//         return 0;
-//     }
-//     offset += sizeof( LoRaMacClassBNvmData_t );
-
-//     if( NvmmRead( ( uint8_t* ) nvm, sizeof( LoRaMacNvmData_t ), 0 ) ==
-//                   sizeof( LoRaMacNvmData_t ) )
-//     {
-//         return sizeof( LoRaMacNvmData_t );
-//     }
-// #endif
+#if( CONTEXT_MANAGEMENT_ENABLED == 1 )
+    MibRequestConfirm_t mibReq;
+
+    if( NvmDataMgmtMount( ) == false )
+    {
+        return 0;
+    }
+    for( uint8_t i = 0; i < NVM_GROUPS_NB; i++ )
+    {
+        if( NvmmCrc32Check( NvmGroups[i].Size, NvmGroups[i].Offset ) == false )
+        {
+            return 0;
+        }
+    }
+
+    // The MAC copies the image, NvmImage stays the flash copy
+    mibReq.Type = MIB_NVM_CTXS;
+    mibReq.Param.Contexts = &NvmImage;
+    if( LoRaMacMibSetRequestConfirm( &mibReq ) == LORAMAC_STATUS_OK )
+    {
+        NvmNotifyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+        return sizeof( LoRaMacNvmData_t );
+    }
+#endif
     return 0;
 }
 
 bool NvmDataMgmtFactoryReset( void )
 {
-//     uint16_t offset = 0;
-// #if( CONTEXT_MANAGEMENT_ENABLED == 1 )
-//     // Crypto
-//     if( NvmmReset( sizeof( LoRaMacCryptoNvmData_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( LoRaMacCryptoNvmData_t );
-
-//     // Mac Group 1
-//     if( NvmmReset( sizeof( LoRaMacNvmDataGroup1_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( LoRaMacNvmDataGroup1_t );
-
-//     // Mac Group 2
-//     if( NvmmReset( sizeof( LoRaMacNvmDataGroup2_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( LoRaMacNvmDataGroup2_t );
-
-//     // Secure element
-//     if( NvmmReset( sizeof( SecureElementNvmData_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( SecureElementNvmData_t );
-
-//     // Region group 1
-//     if( NvmmReset( sizeof( RegionNvmDataGroup1_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( RegionNvmDataGroup1_t );
-
-//     // Region group 2
-//     if( NvmmReset( sizeof( RegionNvmDataGroup2_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( RegionNvmDataGroup2_t );
-
-//     // Class b
-//     if( NvmmReset( sizeof( LoRaMacClassBNvmData_t ), offset ) == false )
-//     {
-//         return false;
-//     }
-//     offset += sizeof( LoRaMacClassBNvmData_t );
-// #endif
+#if( CONTEXT_MANAGEMENT_ENABLED == 1 )
+    if( ( NvmMounted == false ) && ( NvmDataMgmtMount( ) == false ) )
+    {
+        return false;
+    }
+    for( uint8_t i = 0; i < NVM_GROUPS_NB; i++ )
+    {
+        if( NvmmReset( NvmGroups[i].Size, NvmGroups[i].Offset ) == false )
+        {
+            return false;
+        }
+    }
+    return NvmmCommit( );
+#else
     return true;
+#endif
 }
@@ -0,0 +1,91 @@
+/*!
+ * \file      UplinkAggregate.c
+ *
+ * \brief     Frame format of the application records packed together by the
+ *            uplink queue
+ */
+#include <stddef.h>
+#include <string.h>
+#include "UplinkAggregate.h"
+
+uint16_t UplinkAggregateRecordSize( uint8_t size, uint32_t age )
+{
+    uint16_t header = UPLINK_AGGREGATE_HEADER_MIN_SIZE;
+
+    if( age > UPLINK_AGGREGATE_MAX_AGE )
+    {
+        age = UPLINK_AGGREGATE_MAX_AGE;
+    }
+    while( age > 0x7F )
+    {
+        age >>= 7;
+        header++;
+    }
+    return header + size;
+}
+
+bool UplinkAggregateAppend( uint8_t* frame, uint8_t* frameSize, uint8_t maxSize, const uint8_t* data, uint8_t size,
+                            uint32_t age )
+{
+    uint8_t pos = *frameSize;
+
+    if( ( pos + UplinkAggregateRecordSize( size, age ) ) > maxSize )
+    {
+        return false;
+    }
+    if( age > UPLINK_AGGREGATE_MAX_AGE )
+    {
+        age = UPLINK_AGGREGATE_MAX_AGE;
+    }
+
+    frame[pos++] = size;
+    while( age > 0x7F )
+    {
+        frame[pos++] = ( uint8_t )( age | 0x80 );
+        age >>= 7;
+    }
+    frame[pos++] = ( uint8_t )age;
+    memcpy( &frame[pos], data, size );
+    *frameSize = pos + size;
+    return true;
+}
+
+int16_t UplinkAggregateDecode( const uint8_t* frame, uint8_t size,
+                               void ( *callback )( const uint8_t* data, uint8_t size, uint32_t age, void* context ),
+                               void* context )
+{
+    uint8_t pos = 0;
+    int16_t count = 0;
+
+    while( pos < size )
+    {
+        uint8_t length = frame[pos++];
+        uint32_t age = 0;
+        uint8_t shift = 0;
+
+        for( ;; )
+        {
+            if( ( pos == size ) || ( shift > 14 ) )
+            {
+                return -1;
+            }
+            age |= ( uint32_t )( frame[pos] & 0x7F ) << shift;
+            shift += 7;
+            if( ( frame[pos++] & 0x80 ) == 0 )
+            {
+                break;
+            }
+        }
+        if( length > ( size - pos ) )
+        {
+            return -1;
+        }
+        if( callback != NULL )
+        {
+            callback( &frame[pos], length, age, context );
+        }
+        pos += length;
+        count++;
+    }
+    return count;
+}
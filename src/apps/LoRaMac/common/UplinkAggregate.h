@@ -0,0 +1,84 @@
+/*!
+ * \file      UplinkAggregate.h
+ *
+ * \brief     Frame format of the application records packed together by the
+ *            uplink queue
+ *
+ * \remark    The FRMPayload of an aggregated frame is a sequence of records:
+ *
+ *            | Length | Age         | Data        |
+ *            | 1 byte | 1 - 3 bytes | Length bytes|
+ *
+ *            Age is the time in seconds between the queuing of the record
+ *            and the building of the frame, as an unsigned LEB128 varint
+ *            (7 bits per byte, least significant first, bit 7 set when more
+ *            bytes follow). All the records of a frame were queued on the
+ *            frame port.
+ *
+ *            The module has no dependency on the stack so that a backend or
+ *            a host tool can decode the frames with the same sources.
+ */
+#ifndef __UPLINK_AGGREGATE_H__
+#define __UPLINK_AGGREGATE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Largest record age, in seconds, 3 varint bytes
+ */
+#define UPLINK_AGGREGATE_MAX_AGE                    0x1FFFFF
+
+/*!
+ * Record header size when the age is below 128 s
+ */
+#define UPLINK_AGGREGATE_HEADER_MIN_SIZE            2
+
+/*!
+ * \brief Size of a record in a frame, header included
+ *
+ * \param [IN] size Record data size
+ * \param [IN] age  Record age [s]
+ * \retval size Record size
+ */
+uint16_t UplinkAggregateRecordSize( uint8_t size, uint32_t age );
+
+/*!
+ * \brief Appends a record to a frame
+ *
+ * \param [IN]     frame     Frame buffer
+ * \param [IN,OUT] frameSize Frame size, updated
+ * \param [IN]     maxSize   Frame buffer size
+ * \param [IN]     data      Record data
+ * \param [IN]     size      Record data size
+ * \param [IN]     age       Record age [s], saturated to UPLINK_AGGREGATE_MAX_AGE
+ * \retval status false if the record does not fit, the frame is unchanged
+ */
+bool UplinkAggregateAppend( uint8_t* frame, uint8_t* frameSize, uint8_t maxSize, const uint8_t* data, uint8_t size,
+                            uint32_t age );
+
+/*!
+ * \brief Splits a frame into its records
+ *
+ * \param [IN] frame    Frame payload
+ * \param [IN] size     Frame payload size
+ * \param [IN] callback Called for each record, may be NULL to only check the
+ *                      frame
+ * \param [IN] context  Passed to the callback
+ * \retval count Number of records, -1 if the frame is malformed. The callback
+ *               has then been called for the records before the error.
+ */
+int16_t UplinkAggregateDecode( const uint8_t* frame, uint8_t size,
+                               void ( *callback )( const uint8_t* data, uint8_t size, uint32_t age, void* context ),
+                               void* context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __UPLINK_AGGREGATE_H__
@@ -0,0 +1,667 @@
+/*!
+ * \file      UplinkQueue.c
+ *
+ * \brief     Queued uplinks in front of LmHandlerSend
+ *
+ * \remark    The ring is a bounded multi-producer single-consumer queue: a
+ *            producer reserves a cell by moving the tail with a compare and
+ *            swap, fills it and publishes it through the cell sequence
+ *            number. Only the LoRa task consumes, so the pending list, the
+ *            timers and most statistics need no locking.
+ *
+ *            Records (UplinkQueueParams_t.Aggregate) wait in the pending list
+ *            until the ones of their port are due, then as many as fit the
+ *            datarate are packed into one frame (UplinkAggregate.h).
+ */
+#include <string.h>
+#include "system/utilities.h"
+#include "boards/mcu/timer.h"
+#include "UplinkAggregate.h"
+#include "UplinkQueue.h"
+
+#if( ( UPLINK_QUEUE_SIZE & ( UPLINK_QUEUE_SIZE - 1 ) ) != 0 ) || ( UPLINK_QUEUE_SIZE > 127 )
+#error "UPLINK_QUEUE_SIZE must be a power of 2 lower than 128"
+#endif
+
+#define UPLINK_QUEUE_MASK                           ( UPLINK_QUEUE_SIZE - 1 )
+
+/*!
+ * Delay before a new attempt when the MAC refuses the uplink without giving
+ * the time of the next possible transmission [ms]
+ */
+#ifndef UPLINK_QUEUE_RETRY_DELAY
+#define UPLINK_QUEUE_RETRY_DELAY                    1000
+#endif
+
+typedef struct UplinkQueueEntry_s
+{
+    UplinkQueueParams_t Params;
+    TimerTime_t QueuedAt;
+    /*!
+     * Arrival order, orders the uplinks of the same priority
+     */
+    uint32_t Order;
+    /*!
+     * Handed to the MAC, alone or in an aggregated frame
+     */
+    bool InFlight;
+    uint8_t Size;
+    uint8_t Buffer[UPLINK_QUEUE_PAYLOAD_SIZE];
+}UplinkQueueEntry_t;
+
+typedef struct UplinkQueueCell_s
+{
+    /*!
+     * Equals the ring position when the cell is free, the position + 1 when
+     * it holds an uplink
+     */
+    uint32_t Sequence;
+    UplinkQueueEntry_t Entry;
+}UplinkQueueCell_t;
+
+static UplinkQueueCell_t Ring[UPLINK_QUEUE_SIZE];
+
+/*!
+ * Next position to fill, moved by the producers
+ */
+static uint32_t RingTail;
+
+/*!
+ * Next position to read, moved by the LoRa task
+ */
+static uint32_t RingHead;
+
+/*!
+ * Uplinks taken from the ring, in no particular order
+ */
+static UplinkQueueEntry_t Pending[UPLINK_QUEUE_SIZE];
+static uint8_t PendingCount;
+
+/*!
+ * Pending uplinks handed to the MAC and confirmed type of their frame
+ */
+static uint8_t InFlightCount;
+static bool InFlightConfirmed;
+
+/*!
+ * Records of the aggregated frame handed to the MAC
+ */
+static uint8_t Frame[UPLINK_QUEUE_PAYLOAD_SIZE];
+
+static UplinkQueueAggregation_t Aggregation =
+{
+    .MaxAgeMs = UPLINK_QUEUE_AGGREGATION_MAX_AGE,
+    .FlushPriority = UPLINK_QUEUE_AGGREGATION_FLUSH_PRIORITY,
+    .FillPercent = 100,
+};
+
+/*!
+ * An empty frame flushing MAC commands was handed to the MAC instead
+ */
+static bool FlushInFlight;
+
+/*!
+ * Set while the queue calls LmHandlerSend, for UplinkQueueOnMcpsRequest
+ */
+static bool Sending;
+static LoRaMacStatus_t SendStatus;
+static TimerTime_t SendNextTxIn;
+
+/*!
+ * Runs while the MAC cannot take the next uplink
+ */
+static TimerEvent_t RetryTimer;
+
+/*!
+ * Runs until the oldest record which is not due yet reaches its maximum age
+ */
+static TimerEvent_t FlushTimer;
+
+static UplinkQueueStats_t Stats;
+static uint32_t LatencyCount;
+static uint64_t LatencyTotalMs;
+
+static void OnTimerEvent( void )
+{
+    // The LoRa task calls UplinkQueueProcess once the timers are processed
+}
+
+/*!
+ * \brief Copies an uplink, payload bytes past its size excluded
+ */
+static void EntryCopy( UplinkQueueEntry_t* dst, const UplinkQueueEntry_t* src )
+{
+    dst->Params = src->Params;
+    dst->QueuedAt = src->QueuedAt;
+    dst->Order = src->Order;
+    dst->InFlight = src->InFlight;
+    dst->Size = src->Size;
+    memcpy1( dst->Buffer, src->Buffer, src->Size );
+}
+
+static void PendingRemove( uint8_t index )
+{
+    PendingCount--;
+    if( index != PendingCount )
+    {
+        EntryCopy( &Pending[index], &Pending[PendingCount] );
+    }
+}
+
+/*!
+ * \brief Tells if a pending uplink is sent before another one
+ */
+static bool PendingIsBefore( const UplinkQueueEntry_t* a, const UplinkQueueEntry_t* b )
+{
+    if( a->Params.Priority != b->Params.Priority )
+    {
+        return a->Params.Priority > b->Params.Priority;
+    }
+    return ( int32_t )( a->Order - b->Order ) < 0;
+}
+
+/*!
+ * \brief Finds the pending uplink which is sent first
+ *
+ * \param [IN] lowest Find the one which is sent last instead
+ * \retval index Index in Pending, -1 if none is waiting
+ */
+static int8_t PendingSelect( bool lowest )
+{
+    int8_t best = -1;
+
+    for( uint8_t i = 0; i < PendingCount; i++ )
+    {
+        if( Pending[i].InFlight == true )
+        {
+            continue;
+        }
+        if( ( best < 0 ) || ( PendingIsBefore( &Pending[i], &Pending[best] ) != lowest ) )
+        {
+            best = ( int8_t )i;
+        }
+    }
+    return best;
+}
+
+/*!
+ * \brief Tells if the records of a port are due: they fill the frame, one of
+ *        them has the flush priority, the oldest one reached the maximum age or
+ *        the pending list is full
+ *
+ * \param [IN]  port    Records port
+ * \param [IN]  maxSize Largest payload of the datarate
+ * \param [IN]  now     Current time
+ * \param [OUT] wait    Lowered to the time before the records are due
+ * \retval due true if the records are sent now
+ */
+static bool AggregateIsDue( uint8_t port, uint8_t maxSize, TimerTime_t now, TimerTime_t* wait )
+{
+    uint32_t total = 0;
+    TimerTime_t age = 0;
+
+    if( PendingCount == UPLINK_QUEUE_SIZE )
+    {
+        // New uplinks wait in the ring
+        return true;
+    }
+    for( uint8_t i = 0; i < PendingCount; i++ )
+    {
+        const UplinkQueueEntry_t* entry = &Pending[i];
+
+        if( ( entry->InFlight == true ) || ( entry->Params.Aggregate == false ) || ( entry->Params.Port != port ) )
+        {
+            continue;
+        }
+        if( entry->Params.Priority >= Aggregation.FlushPriority )
+        {
+            return true;
+        }
+        age = MAX( age, now - entry->QueuedAt );
+        total += UplinkAggregateRecordSize( entry->Size, ( now - entry->QueuedAt ) / 1000 );
+    }
+    if( ( ( total * 100 ) >= ( ( uint32_t )maxSize * Aggregation.FillPercent ) ) || ( age >= Aggregation.MaxAgeMs ) )
+    {
+        return true;
+    }
+    *wait = MIN( *wait, Aggregation.MaxAgeMs - age );
+    return false;
+}
+
+/*!
+ * \brief Finds the pending uplink which is sent first among the ones which
+ *        are not records or whose records are due
+ *
+ * \param [IN]  maxSize Largest payload of the datarate
+ * \param [OUT] wait    Time before the next records are due, TIMERTIME_T_MAX
+ *                      if none waits
+ * \retval index Index in Pending, -1 if none can be sent
+ */
+static int8_t PendingSelectDue( uint8_t maxSize, TimerTime_t* wait )
+{
+    TimerTime_t now = TimerGetCurrentTime( );
+    int8_t best = -1;
+
+    *wait = TIMERTIME_T_MAX;
+    for( uint8_t i = 0; i < PendingCount; i++ )
+    {
+        const UplinkQueueEntry_t* entry = &Pending[i];
+
+        if( ( entry->InFlight == true ) || ( ( best >= 0 ) && ( PendingIsBefore( entry, &Pending[best] ) == false ) ) )
+        {
+            continue;
+        }
+        if( ( entry->Params.Aggregate == true ) && ( AggregateIsDue( entry->Params.Port, maxSize, now, wait ) == false ) )
+        {
+            continue;
+        }
+        best = ( int8_t )i;
+    }
+    return best;
+}
+
+/*!
+ * \brief Packs the due records of a port into Frame, first ones first, and
+ *        marks them in flight
+ *
+ * \param [IN] port    Records port
+ * \param [IN] maxSize Frame size limit
+ * \retval size Frame size, 0 if the first record does not fit
+ */
+static uint8_t AggregateBuild( uint8_t port, uint8_t maxSize )
+{
+    TimerTime_t now = TimerGetCurrentTime( );
+    uint8_t size = 0;
+
+    InFlightConfirmed = false;
+    for( ;; )
+    {
+        int8_t next = -1;
+
+        for( uint8_t i = 0; i < PendingCount; i++ )
+        {
+            const UplinkQueueEntry_t* entry = &Pending[i];
+
+            if( ( entry->InFlight == false ) && ( entry->Params.Aggregate == true ) && ( entry->Params.Port == port ) &&
+                ( ( next < 0 ) || ( PendingIsBefore( entry, &Pending[next] ) == true ) ) )
+            {
+                next = ( int8_t )i;
+            }
+        }
+        if( ( next < 0 ) || ( UplinkAggregateAppend( Frame, &size, maxSize, Pending[next].Buffer, Pending[next].Size,
+                                                     ( now - Pending[next].QueuedAt ) / 1000 ) == false ) )
+        {
+            return size;
+        }
+        Pending[next].InFlight = true;
+        InFlightCount++;
+        InFlightConfirmed |= Pending[next].Params.Confirmed;
+    }
+}
+
+static void InFlightCancel( void )
+{
+    for( uint8_t i = 0; i < PendingCount; i++ )
+    {
+        Pending[i].InFlight = false;
+    }
+    InFlightCount = 0;
+}
+
+static int8_t PendingFindKey( uint8_t port, uint16_t key )
+{
+    for( uint8_t i = 0; i < PendingCount; i++ )
+    {
+        if( ( Pending[i].InFlight == false ) && ( Pending[i].Params.CoalesceKey == key ) &&
+            ( Pending[i].Params.Port == port ) )
+        {
+            return ( int8_t )i;
+        }
+    }
+    return -1;
+}
+
+/*!
+ * \brief Moves the uplinks published in the ring into the pending list. When
+ *        the list is full, an uplink of higher priority evicts the lowest
+ *        one, otherwise it stays in the ring.
+ */
+static void PendingFill( void )
+{
+    for( ;; )
+    {
+        UplinkQueueCell_t* cell = &Ring[RingHead & UPLINK_QUEUE_MASK];
+        UplinkQueueEntry_t* entry = &cell->Entry;
+        int8_t index;
+
+        if( __atomic_load_n( &cell->Sequence, __ATOMIC_ACQUIRE ) != ( RingHead + 1 ) )
+        {
+            break;
+        }
+
+        index = ( entry->Params.CoalesceKey != 0 ) ? PendingFindKey( entry->Params.Port, entry->Params.CoalesceKey ) : -1;
+        if( index >= 0 )
+        {
+            UplinkQueueEntry_t* old = &Pending[index];
+
+            // Newer data, in the place of the older uplink
+            old->Params.Confirmed |= entry->Params.Confirmed;
+            old->Params.Priority = MAX( old->Params.Priority, entry->Params.Priority );
+            old->Params.TtlMs = entry->Params.TtlMs;
+            if( entry->Params.TtlMs != 0 )
+            {
+                old->Params.TtlMs += entry->QueuedAt - old->QueuedAt;
+            }
+            old->Size = entry->Size;
+            memcpy1( old->Buffer, entry->Buffer, entry->Size );
+            Stats.Coalesced++;
+        }
+        else
+        {
+            if( PendingCount == UPLINK_QUEUE_SIZE )
+            {
+                index = PendingSelect( true );
+                if( ( index < 0 ) || ( Pending[index].Params.Priority >= entry->Params.Priority ) )
+                {
+                    break;
+                }
+                PendingRemove( ( uint8_t )index );
+                Stats.Evicted++;
+            }
+            EntryCopy( &Pending[PendingCount], entry );
+            Pending[PendingCount].Order = RingHead;
+            Pending[PendingCount].InFlight = false;
+            PendingCount++;
+        }
+
+        // Give the cell back to the producers
+        __atomic_store_n( &cell->Sequence, RingHead + UPLINK_QUEUE_SIZE, __ATOMIC_RELEASE );
+        __atomic_store_n( &RingHead, RingHead + 1, __ATOMIC_RELAXED );
+    }
+}
+
+static void PendingExpire( void )
+{
+    TimerTime_t now = TimerGetCurrentTime( );
+    uint8_t i = 0;
+
+    while( i < PendingCount )
+    {
+        const UplinkQueueEntry_t* entry = &Pending[i];
+
+        if( ( entry->InFlight == false ) && ( entry->Params.TtlMs != 0 ) &&
+            ( ( now - entry->QueuedAt ) >= entry->Params.TtlMs ) )
+        {
+            PendingRemove( i );
+            Stats.Expired++;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+static uint16_t QueueDepth( void )
+{
+    uint32_t ring = __atomic_load_n( &RingTail, __ATOMIC_RELAXED ) - __atomic_load_n( &RingHead, __ATOMIC_RELAXED );
+
+    return ( uint16_t )( ring + PendingCount );
+}
+
+void UplinkQueueInit( void )
+{
+    for( uint32_t i = 0; i < UPLINK_QUEUE_SIZE; i++ )
+    {
+        Ring[i].Sequence = i;
+    }
+    RingTail = 0;
+    RingHead = 0;
+    PendingCount = 0;
+    InFlightCount = 0;
+    FlushInFlight = false;
+    Sending = false;
+    memset1( ( uint8_t* )&Stats, 0, sizeof( Stats ) );
+    LatencyCount = 0;
+    LatencyTotalMs = 0;
+    TimerInit( &RetryTimer, OnTimerEvent );
+    TimerInit( &FlushTimer, OnTimerEvent );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+void UplinkQueueSetAggregation( const UplinkQueueAggregation_t* params )
+{
+    Aggregation = *params;
+    if( Aggregation.FillPercent > 100 )
+    {
+        Aggregation.FillPercent = 100;
+    }
+}
+
+bool UplinkQueuePush( const UplinkQueueParams_t* params, const uint8_t* buffer, uint8_t size )
+{
+    UplinkQueueCell_t* cell;
+    uint32_t pos;
+
+    if( ( params == NULL ) || ( params->Port == 0 ) || ( params->Port > 223 ) ||
+        ( size > UPLINK_QUEUE_PAYLOAD_SIZE ) || ( ( buffer == NULL ) && ( size != 0 ) ) )
+    {
+        return false;
+    }
+
+    pos = __atomic_load_n( &RingTail, __ATOMIC_RELAXED );
+    for( ;; )
+    {
+        int32_t diff;
+
+        cell = &Ring[pos & UPLINK_QUEUE_MASK];
+        diff = ( int32_t )( __atomic_load_n( &cell->Sequence, __ATOMIC_ACQUIRE ) - pos );
+        if( diff == 0 )
+        {
+            if( __atomic_compare_exchange_n( &RingTail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            {
+                break;
+            }
+        }
+        else if( diff < 0 )
+        {
+            // The LoRa task has not freed the cell yet
+            __atomic_fetch_add( &Stats.Rejected, 1, __ATOMIC_RELAXED );
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n( &RingTail, __ATOMIC_RELAXED );
+        }
+    }
+
+    cell->Entry.Params = *params;
+    cell->Entry.QueuedAt = TimerGetCurrentTime( );
+    cell->Entry.Size = size;
+    memcpy1( cell->Entry.Buffer, buffer, size );
+    __atomic_store_n( &cell->Sequence, pos + 1, __ATOMIC_RELEASE );
+    __atomic_fetch_add( &Stats.Queued, 1, __ATOMIC_RELAXED );
+    return true;
+}
+
+void UplinkQueueProcess( void )
+{
+    uint16_t depth;
+
+    PendingFill( );
+    PendingExpire( );
+    depth = QueueDepth( );
+    if( depth > Stats.MaxDepth )
+    {
+        Stats.MaxDepth = depth;
+    }
+
+    while( ( InFlightCount == 0 ) && ( FlushInFlight == false ) && ( TimerIsStarted( &RetryTimer ) == false ) &&
+           ( LoRaMacIsBusy( ) == false ) && ( LmHandlerJoinStatus( ) == LORAMAC_HANDLER_SET ) )
+    {
+        LoRaMacTxInfo_t txInfo;
+        LmHandlerAppData_t appData;
+        UplinkQueueEntry_t* entry;
+        TimerTime_t wait;
+        int8_t index;
+        bool confirmed;
+        bool flush;
+
+        // Room for the payload, with and without the pending MAC commands
+        LoRaMacQueryTxPossible( 0, &txInfo );
+        index = PendingSelectDue( MIN( txInfo.CurrentPossiblePayloadSize, UPLINK_QUEUE_PAYLOAD_SIZE ), &wait );
+        if( index < 0 )
+        {
+            if( wait != TIMERTIME_T_MAX )
+            {
+                TimerStop( &FlushTimer );
+                TimerSetValue( &FlushTimer, MAX( wait, 1 ) );
+                TimerStart( &FlushTimer );
+            }
+            break;
+        }
+        entry = &Pending[index];
+        appData.Port = entry->Params.Port;
+        if( entry->Params.Aggregate == true )
+        {
+            uint8_t maxSize = MIN( txInfo.MaxPossibleApplicationDataSize, UPLINK_QUEUE_PAYLOAD_SIZE );
+
+            appData.BufferSize = AggregateBuild( entry->Params.Port, maxSize );
+            if( appData.BufferSize == 0 )
+            {
+                // No room next to the MAC commands, flush them first
+                appData.BufferSize = AggregateBuild( entry->Params.Port, MIN( txInfo.CurrentPossiblePayloadSize, UPLINK_QUEUE_PAYLOAD_SIZE ) );
+            }
+            appData.Buffer = Frame;
+            confirmed = InFlightConfirmed;
+        }
+        else
+        {
+            appData.BufferSize = entry->Size;
+            appData.Buffer = entry->Buffer;
+            confirmed = entry->Params.Confirmed;
+            entry->InFlight = true;
+            InFlightCount = 1;
+        }
+
+        flush = LoRaMacQueryTxPossible( appData.BufferSize, &txInfo ) != LORAMAC_STATUS_OK;
+        if( ( InFlightCount == 0 ) || ( ( flush == true ) && ( appData.BufferSize > txInfo.CurrentPossiblePayloadSize ) ) )
+        {
+            // Does not fit the datarate even without MAC commands
+            InFlightCancel( );
+            PendingRemove( ( uint8_t )index );
+            Stats.Oversized++;
+            continue;
+        }
+        if( flush == true )
+        {
+            // LmHandlerSend sends an empty frame instead, the payload is sent
+            // once the MAC commands are out
+            InFlightCancel( );
+        }
+
+        Sending = true;
+        SendStatus = LORAMAC_STATUS_ERROR;
+        SendNextTxIn = 0;
+        LmHandlerSend( &appData, ( confirmed == true ) ? LORAMAC_HANDLER_CONFIRMED_MSG : LORAMAC_HANDLER_UNCONFIRMED_MSG );
+        Sending = false;
+
+        if( SendStatus == LORAMAC_STATUS_OK )
+        {
+            if( flush == true )
+            {
+                FlushInFlight = true;
+            }
+            else
+            {
+                InFlightConfirmed = confirmed;
+                Stats.Frames++;
+            }
+            if( SendNextTxIn != 0 )
+            {
+                // The MAC holds the frame until the band is free
+                Stats.DutyCycleWaits++;
+            }
+        }
+        else
+        {
+            InFlightCancel( );
+            if( SendStatus == LORAMAC_STATUS_DUTYCYCLE_RESTRICTED )
+            {
+                Stats.DutyCycleWaits++;
+            }
+            // Try again when the MAC allows the next transmission
+            TimerSetValue( &RetryTimer, ( SendNextTxIn != 0 ) ? SendNextTxIn : UPLINK_QUEUE_RETRY_DELAY );
+            TimerStart( &RetryTimer );
+        }
+    }
+}
+
+void UplinkQueueOnMcpsRequest( LoRaMacStatus_t status, McpsReq_t* mcpsReq, TimerTime_t nextTxIn )
+{
+    if( Sending == true )
+    {
+        SendStatus = status;
+        SendNextTxIn = nextTxIn;
+    }
+}
+
+void UplinkQueueOnTxData( LmHandlerTxParams_t* params )
+{
+    bool success;
+    uint8_t i = 0;
+
+    if( ( params == NULL ) || ( params->IsMcpsConfirm == 0 ) )
+    {
+        return;
+    }
+    if( FlushInFlight == true )
+    {
+        FlushInFlight = false;
+        return;
+    }
+    if( InFlightCount == 0 )
+    {
+        // Uplink sent by someone else
+        return;
+    }
+
+    success = ( params->Status == LORAMAC_EVENT_INFO_STATUS_OK ) &&
+              ( ( InFlightConfirmed == false ) || ( params->AckReceived != 0 ) );
+    while( i < PendingCount )
+    {
+        TimerTime_t latency;
+
+        if( Pending[i].InFlight == false )
+        {
+            i++;
+            continue;
+        }
+        if( success == true )
+        {
+            Stats.Sent++;
+        }
+        else
+        {
+            Stats.Failed++;
+        }
+        latency = TimerGetElapsedTime( Pending[i].QueuedAt );
+        LatencyTotalMs += latency;
+        LatencyCount++;
+        if( latency > Stats.LatencyMaxMs )
+        {
+            Stats.LatencyMaxMs = latency;
+        }
+        PendingRemove( i );
+    }
+    InFlightCount = 0;
+}
+
+void UplinkQueueGetStats( UplinkQueueStats_t* stats )
+{
+    *stats = Stats;
+    stats->Queued = __atomic_load_n( &Stats.Queued, __ATOMIC_RELAXED );
+    stats->Rejected = __atomic_load_n( &Stats.Rejected, __ATOMIC_RELAXED );
+    stats->Depth = QueueDepth( );
+    stats->LatencyAvgMs = ( LatencyCount != 0 ) ? ( uint32_t )( LatencyTotalMs / LatencyCount ) : 0;
+}
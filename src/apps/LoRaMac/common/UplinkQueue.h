@@ -0,0 +1,238 @@
+/*!
+ * \file      UplinkQueue.h
+ *
+ * \brief     Queued uplinks in front of LmHandlerSend
+ *
+ * \remark    Application tasks push uplinks into a bounded lock-free ring.
+ *            The LoRa task moves them into the pending list, where entries
+ *            with the same coalescing key are merged and expired ones are
+ *            dropped, and sends the highest priority one as soon as the MAC
+ *            is joined and idle. When the duty cycle delays the uplink, the
+ *            next attempt is scheduled with the delay returned by the MAC
+ *            instead of polling.
+ *
+ *            Small readings can be queued as records instead: they wait until
+ *            the records of their port fill the frame, one of them has the
+ *            flush priority, the oldest one reaches the maximum age or the
+ *            pending list is full, then
+ *            they are packed together in one frame (UplinkAggregate.h).
+ *
+ *            The application forwards the OnMacMcpsRequest and OnTxData
+ *            LmHandler callbacks to UplinkQueueOnMcpsRequest and
+ *            UplinkQueueOnTxData, and calls UplinkQueueProcess from the LoRa
+ *            task after LmHandlerProcess.
+ */
+#ifndef __UPLINK_QUEUE_H__
+#define __UPLINK_QUEUE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mac/LoRaMac.h"
+#include "LmHandler/LmHandler.h"
+
+/*!
+ * Number of uplinks in the ring and in the pending list, power of 2
+ */
+#ifndef UPLINK_QUEUE_SIZE
+#define UPLINK_QUEUE_SIZE                           8
+#endif
+
+/*!
+ * Largest payload of a queued uplink
+ */
+#ifndef UPLINK_QUEUE_PAYLOAD_SIZE
+#define UPLINK_QUEUE_PAYLOAD_SIZE                   242
+#endif
+
+/*!
+ * Default maximum time a record waits for others [ms]
+ */
+#ifndef UPLINK_QUEUE_AGGREGATION_MAX_AGE
+#define UPLINK_QUEUE_AGGREGATION_MAX_AGE            60000
+#endif
+
+/*!
+ * Default priority from which a record is sent at once with the waiting ones
+ */
+#ifndef UPLINK_QUEUE_AGGREGATION_FLUSH_PRIORITY
+#define UPLINK_QUEUE_AGGREGATION_FLUSH_PRIORITY     1
+#endif
+
+/*!
+ * Uplink parameters
+ */
+typedef struct UplinkQueueParams_s
+{
+    /*!
+     * Application port, 1 to 223
+     */
+    uint8_t Port;
+    /*!
+     * Confirmed uplink
+     */
+    bool Confirmed;
+    /*!
+     * Higher priorities are sent first, in order of arrival within a priority
+     */
+    uint8_t Priority;
+    /*!
+     * Time to live in the queue [ms], 0 for no limit. An expired uplink which
+     * was not sent yet is dropped.
+     */
+    uint32_t TtlMs;
+    /*!
+     * Coalescing key, 0 disables coalescing. A pending uplink with the same
+     * port and key which is not sent yet is replaced by the new one, keeping
+     * its place in the queue.
+     */
+    uint16_t CoalesceKey;
+    /*!
+     * Record packed with the other records of the port instead of being sent
+     * in its own frame
+     */
+    bool Aggregate;
+}UplinkQueueParams_t;
+
+/*!
+ * Flush thresholds of the records
+ */
+typedef struct UplinkQueueAggregation_s
+{
+    /*!
+     * Maximum time a record waits for others [ms]
+     */
+    uint32_t MaxAgeMs;
+    /*!
+     * Records with this priority or a higher one are sent at once
+     */
+    uint8_t FlushPriority;
+    /*!
+     * Records are sent once they fill this percentage of the largest payload
+     * of the datarate
+     */
+    uint8_t FillPercent;
+}UplinkQueueAggregation_t;
+
+/*!
+ * Queue statistics
+ */
+typedef struct UplinkQueueStats_s
+{
+    /*!
+     * Uplinks in the queue, the one being sent included
+     */
+    uint16_t Depth;
+    uint16_t MaxDepth;
+    /*!
+     * Uplinks accepted by UplinkQueuePush
+     */
+    uint32_t Queued;
+    /*!
+     * Uplinks refused by UplinkQueuePush because the queue was full
+     */
+    uint32_t Rejected;
+    /*!
+     * Uplinks replaced by a newer one with the same coalescing key
+     */
+    uint32_t Coalesced;
+    /*!
+     * Uplinks dropped when their time to live elapsed
+     */
+    uint32_t Expired;
+    /*!
+     * Uplinks dropped to make room for a higher priority one
+     */
+    uint32_t Evicted;
+    /*!
+     * Uplinks dropped because they do not fit the datarate
+     */
+    uint32_t Oversized;
+    /*!
+     * Uplinks sent, acknowledged if confirmed
+     */
+    uint32_t Sent;
+    /*!
+     * Uplinks sent without success or acknowledgement
+     */
+    uint32_t Failed;
+    /*!
+     * Frames sent for the uplinks, an aggregated frame carries several records
+     */
+    uint32_t Frames;
+    /*!
+     * Attempts delayed by the duty cycle
+     */
+    uint32_t DutyCycleWaits;
+    /*!
+     * Time from UplinkQueuePush to the end of the transmission of the sent
+     * and failed uplinks [ms]
+     */
+    uint32_t LatencyAvgMs;
+    uint32_t LatencyMaxMs;
+}UplinkQueueStats_t;
+
+/*!
+ * \brief Empties the queue and clears the statistics. Not to be called while
+ *        other tasks push uplinks.
+ */
+void UplinkQueueInit( void );
+
+/*!
+ * \brief Queues an uplink. Can be called from any task, the LoRa task must
+ *        then be woken up to send it.
+ *
+ * \param [IN] params Uplink parameters
+ * \param [IN] buffer Payload, copied into the queue
+ * \param [IN] size   Payload size
+ * \retval status false if the queue is full or the parameters are invalid
+ */
+bool UplinkQueuePush( const UplinkQueueParams_t* params, const uint8_t* buffer, uint8_t size );
+
+/*!
+ * \brief Sets the flush thresholds of the records
+ *
+ * \param [IN] params Flush thresholds
+ */
+void UplinkQueueSetAggregation( const UplinkQueueAggregation_t* params );
+
+/*!
+ * \brief Sends the next uplink if the MAC is ready. To be called by the LoRa
+ *        task after LmHandlerProcess.
+ */
+void UplinkQueueProcess( void );
+
+/*!
+ * \brief Gets the result of the uplink request. To be called from the
+ *        OnMacMcpsRequest callback.
+ *
+ * \param [IN] status   Request status
+ * \param [IN] mcpsReq  MCPS request
+ * \param [IN] nextTxIn Time before the next transmission is allowed [ms]
+ */
+void UplinkQueueOnMcpsRequest( LoRaMacStatus_t status, McpsReq_t* mcpsReq, TimerTime_t nextTxIn );
+
+/*!
+ * \brief Completes the uplink being sent. To be called from the OnTxData
+ *        callback.
+ *
+ * \param [IN] params Transmission parameters
+ */
+void UplinkQueueOnTxData( LmHandlerTxParams_t* params );
+
+/*!
+ * \brief Gets the queue statistics
+ *
+ * \param [OUT] stats Queue statistics
+ */
+void UplinkQueueGetStats( UplinkQueueStats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __UPLINK_QUEUE_H__
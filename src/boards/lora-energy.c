@@ -0,0 +1,280 @@
+/*!
+ * \file      lora-energy.c
+ *
+ * \brief     Energy accounting of the MCU and radio states
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "boards/mcu/board.h"
+#include "boards/rtc-board.h"
+#include "system/utilities.h"
+#include "lora-energy.h"
+
+/*!
+ * Typical currents: ESP32-S3 at 240 MHz with idle cores and in light sleep,
+ * SX1262 in warm start sleep, STDBY_RC, RX at 125 kHz and TX with the DC-DC
+ * converter
+ */
+static const LoRaEnergyProfile_t LoRaEnergyDefaultProfile =
+{
+    .SupplyMv = 3300,
+    .CurrentNa =
+    {
+        [LORA_ENERGY_MCU_ACTIVE]      = 30000000,
+        [LORA_ENERGY_MCU_LIGHT_SLEEP] = 240000,
+        [LORA_ENERGY_RADIO_SLEEP]     = 600,
+        [LORA_ENERGY_RADIO_STANDBY]   = 600000,
+        [LORA_ENERGY_RADIO_RX]        = 4600000,
+        [LORA_ENERGY_RADIO_TX]        = 45000000,
+    },
+    .TxHighCurrentNa = 118000000,
+};
+
+/*
+ * Energy accounting context
+ */
+typedef struct sLoRaEnergyCtx
+{
+    LoRaEnergyProfile_t Profile;
+    /*!
+     * Current states of the MCU and of the radio, and their start times [us]
+     */
+    LoRaEnergyState_t McuState;
+    LoRaEnergyState_t RadioState;
+    uint64_t McuSinceUs;
+    uint64_t RadioSinceUs;
+    /*!
+     * TX power [dBm] and current [nA]
+     */
+    int8_t TxPower;
+    uint32_t TxCurrentNa;
+    /*!
+     * Time [us] and charge [pC] of each state since the statistics reset
+     */
+    uint64_t StateUs[LORA_ENERGY_STATES];
+    uint64_t ChargePc[LORA_ENERGY_STATES];
+    /*!
+     * Uplink running, its start time and the totals at its start
+     */
+    bool UplinkRunning;
+    uint64_t UplinkStartUs;
+    uint64_t UplinkStateUs[LORA_ENERGY_STATES];
+    uint64_t UplinkChargePc;
+    /*!
+     * Charge of all the uplinks accounted [pC]
+     */
+    uint64_t UplinksChargePc;
+    LoRaEnergyStats_t Stats;
+}LoRaEnergyCtx_t;
+
+static LoRaEnergyCtx_t EnergyCtx =
+{
+    .Profile = LoRaEnergyDefaultProfile,
+    .McuState = LORA_ENERGY_MCU_ACTIVE,
+    // The radio stands by after a reset
+    .RadioState = LORA_ENERGY_RADIO_STANDBY,
+    .TxPower = LORA_ENERGY_TX_LOW_POWER,
+    .TxCurrentNa = 45000000,
+};
+
+/*!
+ * \brief Gets the current of a state [nA]
+ */
+static uint32_t LoRaEnergyCurrent( LoRaEnergyState_t state )
+{
+    return ( state == LORA_ENERGY_RADIO_TX ) ? EnergyCtx.TxCurrentNa : EnergyCtx.Profile.CurrentNa[state];
+}
+
+/*!
+ * \brief Accounts the time spent in a state up to now and restarts it
+ */
+static void LoRaEnergyAccount( LoRaEnergyState_t state, uint64_t *sinceUs, uint64_t nowUs )
+{
+    uint64_t elapsed = ( nowUs > *sinceUs ) ? ( nowUs - *sinceUs ) : 0;
+
+    EnergyCtx.StateUs[state] += elapsed;
+    EnergyCtx.ChargePc[state] += elapsed * LoRaEnergyCurrent( state ) / 1000;
+    *sinceUs = nowUs;
+}
+
+/*!
+ * \brief Accounts the MCU and radio states up to now
+ */
+static void LoRaEnergyFlush( void )
+{
+    uint64_t now = RtcGetTimeUs( );
+
+    LoRaEnergyAccount( EnergyCtx.McuState, &EnergyCtx.McuSinceUs, now );
+    LoRaEnergyAccount( EnergyCtx.RadioState, &EnergyCtx.RadioSinceUs, now );
+}
+
+static uint64_t LoRaEnergyTotalChargePc( void )
+{
+    uint64_t charge = 0;
+
+    for( uint8_t i = 0; i < LORA_ENERGY_STATES; i++ )
+    {
+        charge += EnergyCtx.ChargePc[i];
+    }
+    return charge;
+}
+
+/*!
+ * \brief Converts a charge [pC] to an energy [uJ]
+ */
+static uint64_t LoRaEnergyUj( uint64_t chargePc )
+{
+    return chargePc / 1000 * EnergyCtx.Profile.SupplyMv / 1000000;
+}
+
+static void LoRaEnergyUpdateTxCurrent( void )
+{
+    int64_t low = EnergyCtx.Profile.CurrentNa[LORA_ENERGY_RADIO_TX];
+    int64_t high = EnergyCtx.Profile.TxHighCurrentNa;
+
+    if( EnergyCtx.TxPower <= LORA_ENERGY_TX_LOW_POWER )
+    {
+        EnergyCtx.TxCurrentNa = ( uint32_t )low;
+    }
+    else if( EnergyCtx.TxPower >= LORA_ENERGY_TX_HIGH_POWER )
+    {
+        EnergyCtx.TxCurrentNa = ( uint32_t )high;
+    }
+    else
+    {
+        EnergyCtx.TxCurrentNa = ( uint32_t )( low + ( high - low ) * ( EnergyCtx.TxPower - LORA_ENERGY_TX_LOW_POWER ) /
+                                                     ( LORA_ENERGY_TX_HIGH_POWER - LORA_ENERGY_TX_LOW_POWER ) );
+    }
+}
+
+void LoRaEnergySetProfile( const LoRaEnergyProfile_t *profile )
+{
+    BoardDisableIrq( );
+    LoRaEnergyFlush( );
+    EnergyCtx.Profile = ( profile != NULL ) ? *profile : LoRaEnergyDefaultProfile;
+    LoRaEnergyUpdateTxCurrent( );
+    BoardEnableIrq( );
+}
+
+void LoRaEnergyGetProfile( LoRaEnergyProfile_t *profile )
+{
+    if( profile == NULL )
+    {
+        return;
+    }
+    BoardDisableIrq( );
+    *profile = EnergyCtx.Profile;
+    BoardEnableIrq( );
+}
+
+void LoRaEnergySetMcuSleep( bool sleep )
+{
+    BoardDisableIrq( );
+    LoRaEnergyAccount( EnergyCtx.McuState, &EnergyCtx.McuSinceUs, RtcGetTimeUs( ) );
+    EnergyCtx.McuState = ( sleep == true ) ? LORA_ENERGY_MCU_LIGHT_SLEEP : LORA_ENERGY_MCU_ACTIVE;
+    BoardEnableIrq( );
+}
+
+void LoRaEnergySetRadioMode( RadioOperatingModes_t mode )
+{
+    LoRaEnergyState_t state;
+
+    switch( mode )
+    {
+        case MODE_SLEEP:
+            state = LORA_ENERGY_RADIO_SLEEP;
+            break;
+        case MODE_TX:
+            state = LORA_ENERGY_RADIO_TX;
+            break;
+        case MODE_RX:
+        case MODE_RX_DC:
+        case MODE_CAD:
+            state = LORA_ENERGY_RADIO_RX;
+            break;
+        default:
+            state = LORA_ENERGY_RADIO_STANDBY;
+            break;
+    }
+
+    BoardDisableIrq( );
+    if( state != EnergyCtx.RadioState )
+    {
+        LoRaEnergyFlush( );
+        EnergyCtx.RadioState = state;
+        if( ( state == LORA_ENERGY_RADIO_TX ) && ( EnergyCtx.UplinkRunning == false ) )
+        {
+            EnergyCtx.UplinkRunning = true;
+            EnergyCtx.UplinkStartUs = EnergyCtx.RadioSinceUs;
+            memcpy1( ( uint8_t* )EnergyCtx.UplinkStateUs, ( uint8_t* )EnergyCtx.StateUs, sizeof( EnergyCtx.StateUs ) );
+            EnergyCtx.UplinkChargePc = LoRaEnergyTotalChargePc( );
+        }
+    }
+    BoardEnableIrq( );
+}
+
+void LoRaEnergySetTxPower( int8_t power )
+{
+    BoardDisableIrq( );
+    if( power != EnergyCtx.TxPower )
+    {
+        LoRaEnergyFlush( );
+        EnergyCtx.TxPower = power;
+        LoRaEnergyUpdateTxCurrent( );
+    }
+    BoardEnableIrq( );
+}
+
+void LoRaEnergyUplinkEnd( void )
+{
+    uint64_t charge;
+
+    BoardDisableIrq( );
+    if( EnergyCtx.UplinkRunning == true )
+    {
+        LoRaEnergyFlush( );
+        EnergyCtx.UplinkRunning = false;
+        charge = LoRaEnergyTotalChargePc( ) - EnergyCtx.UplinkChargePc;
+        EnergyCtx.UplinksChargePc += charge;
+        EnergyCtx.Stats.Uplinks++;
+        EnergyCtx.Stats.UplinkLastUj = ( uint32_t )LoRaEnergyUj( charge );
+        EnergyCtx.Stats.UplinkAvgUj = ( uint32_t )LoRaEnergyUj( EnergyCtx.UplinksChargePc / EnergyCtx.Stats.Uplinks );
+        EnergyCtx.Stats.UplinkLastMs = ( uint32_t )( ( EnergyCtx.McuSinceUs - EnergyCtx.UplinkStartUs ) / 1000 );
+        for( uint8_t i = 0; i < LORA_ENERGY_STATES; i++ )
+        {
+            EnergyCtx.Stats.UplinkLastStateUs[i] = ( uint32_t )( EnergyCtx.StateUs[i] - EnergyCtx.UplinkStateUs[i] );
+        }
+    }
+    BoardEnableIrq( );
+}
+
+void LoRaEnergyGetStats( LoRaEnergyStats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return;
+    }
+    BoardDisableIrq( );
+    LoRaEnergyFlush( );
+    *stats = EnergyCtx.Stats;
+    for( uint8_t i = 0; i < LORA_ENERGY_STATES; i++ )
+    {
+        stats->StateMs[i] = ( uint32_t )( EnergyCtx.StateUs[i] / 1000 );
+    }
+    stats->TotalMj = ( uint32_t )( LoRaEnergyUj( LoRaEnergyTotalChargePc( ) ) / 1000 );
+    BoardEnableIrq( );
+}
+
+void LoRaEnergyResetStats( void )
+{
+    BoardDisableIrq( );
+    LoRaEnergyFlush( );
+    memset1( ( uint8_t* )EnergyCtx.StateUs, 0, sizeof( EnergyCtx.StateUs ) );
+    memset1( ( uint8_t* )EnergyCtx.ChargePc, 0, sizeof( EnergyCtx.ChargePc ) );
+    memset1( ( uint8_t* )&EnergyCtx.Stats, 0, sizeof( EnergyCtx.Stats ) );
+    EnergyCtx.UplinkRunning = false;
+    EnergyCtx.UplinksChargePc = 0;
+    BoardEnableIrq( );
+}
@@ -0,0 +1,166 @@
+/*!
+ * \file      lora-energy.h
+ *
+ * \brief     Energy accounting of the MCU and radio states
+ *
+ * \remark    The MCU is active or in light sleep ( LoRaTaskLightSleep ), the
+ *            radio sleeps, stands by, receives or transmits
+ *            ( SX126xSetOperatingMode ). The time spent in each state is
+ *            accounted on the RtcGetTimeUs time base and turned into charge
+ *            with the currents of a profile, the TX current following the TX
+ *            power. An uplink is accounted from the start of its first
+ *            transmission to its confirmation ( LoRaEnergyUplinkEnd ), RX
+ *            windows and retransmissions included.
+ *            The default profile holds typical datasheet currents of the
+ *            ESP32-S3 and of the SX1262 with its DC-DC converter, a board
+ *            measurement gives a better estimate.
+ *
+ * \defgroup  LORAENERGY LoRa energy accounting
+ * \{
+ */
+#ifndef __LORA_ENERGY_H__
+#define __LORA_ENERGY_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio/sx126x/sx126x.h"
+
+/*!
+ * TX powers of the profile TX currents [dBm]
+ */
+#define LORA_ENERGY_TX_LOW_POWER                    14
+#define LORA_ENERGY_TX_HIGH_POWER                   22
+
+/*!
+ * States accounted. The MCU states and the radio states are accounted in
+ * parallel.
+ */
+typedef enum eLoRaEnergyState
+{
+    LORA_ENERGY_MCU_ACTIVE = 0,
+    LORA_ENERGY_MCU_LIGHT_SLEEP,
+    LORA_ENERGY_RADIO_SLEEP,
+    LORA_ENERGY_RADIO_STANDBY,
+    LORA_ENERGY_RADIO_RX,
+    LORA_ENERGY_RADIO_TX,
+    LORA_ENERGY_STATES,
+}LoRaEnergyState_t;
+
+/*!
+ * Supply voltage and currents of the states
+ */
+typedef struct sLoRaEnergyProfile
+{
+    /*!
+     * Supply voltage [mV]
+     */
+    uint32_t SupplyMv;
+    /*!
+     * Current of each state [nA], the TX one at LORA_ENERGY_TX_LOW_POWER and
+     * below
+     */
+    uint32_t CurrentNa[LORA_ENERGY_STATES];
+    /*!
+     * TX current at LORA_ENERGY_TX_HIGH_POWER and above [nA], interpolated
+     * in between
+     */
+    uint32_t TxHighCurrentNa;
+}LoRaEnergyProfile_t;
+
+/*!
+ * Energy statistics
+ */
+typedef struct sLoRaEnergyStats
+{
+    /*!
+     * Time spent in each state since the statistics reset [ms]
+     */
+    uint32_t StateMs[LORA_ENERGY_STATES];
+    /*!
+     * Energy used since the statistics reset [mJ]
+     */
+    uint32_t TotalMj;
+    /*!
+     * Uplinks accounted
+     */
+    uint32_t Uplinks;
+    /*!
+     * Energy of the last uplink and mean energy of the uplinks [uJ]
+     */
+    uint32_t UplinkLastUj;
+    uint32_t UplinkAvgUj;
+    /*!
+     * Duration of the last uplink [ms] and time spent in each state during
+     * it [us]
+     */
+    uint32_t UplinkLastMs;
+    uint32_t UplinkLastStateUs[LORA_ENERGY_STATES];
+}LoRaEnergyStats_t;
+
+/*!
+ * \brief Sets the supply voltage and the currents of the states
+ *
+ * \param [IN] profile Energy profile, NULL restores the default one
+ */
+void LoRaEnergySetProfile( const LoRaEnergyProfile_t *profile );
+
+/*!
+ * \brief Gets the energy profile in use
+ *
+ * \param [OUT] profile Energy profile
+ */
+void LoRaEnergyGetProfile( LoRaEnergyProfile_t *profile );
+
+/*!
+ * \brief Accounts the MCU entering or leaving light sleep
+ *
+ * \param [IN] sleep true when the MCU enters light sleep
+ */
+void LoRaEnergySetMcuSleep( bool sleep );
+
+/*!
+ * \brief Accounts a radio operating mode change. The first transmission
+ *        after the last uplink confirmation starts an uplink.
+ *
+ * \param [IN] mode New radio operating mode
+ */
+void LoRaEnergySetRadioMode( RadioOperatingModes_t mode );
+
+/*!
+ * \brief Sets the TX power the TX current follows
+ *
+ * \param [IN] power TX power [dBm]
+ */
+void LoRaEnergySetTxPower( int8_t power );
+
+/*!
+ * \brief Ends the uplink started by the last transmission, once its RX
+ *        windows are over
+ */
+void LoRaEnergyUplinkEnd( void );
+
+/*!
+ * \brief Gets the energy statistics, up to now
+ *
+ * \param [OUT] stats Statistics
+ */
+void LoRaEnergyGetStats( LoRaEnergyStats_t *stats );
+
+/*!
+ * \brief Resets the energy statistics, an uplink running is no longer
+ *        accounted
+ */
+void LoRaEnergyResetStats( void );
+
+/*! \} defgroup LORAENERGY */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LORA_ENERGY_H__
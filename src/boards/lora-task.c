@@ -0,0 +1,289 @@
+/*!
+ * \file      lora-task.c
+ *
+ * \brief     LoRa tasks: radio service task and MAC task
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <Arduino.h>
+#include "boards/mcu/board.h"
+#include "boards/mcu/timer.h"
+#include "boards/rtc-board.h"
+#include "boards/sx126x-board.h"
+#include "radio/radio.h"
+#include "system/utilities.h"
+#include "lora-energy.h"
+#include "lora-task.h"
+
+/*!
+ * Radio service task wake-up semaphore, given by the DIO1 ISR
+ */
+SemaphoreHandle_t loraRadioSem = NULL;
+
+/*!
+ * MAC task wake-up semaphore, given by the radio service task, the RTC alarm
+ * and the application
+ */
+extern SemaphoreHandle_t loraIntSem;
+
+/*
+ * LoRa tasks context
+ */
+typedef struct sLoRaTaskCtx
+{
+    TaskHandle_t RadioTask;
+    TaskHandle_t MacTask;
+    void ( *MacProcess )( void );
+    /*!
+     * Time of the last DIO1 IRQ drained
+     */
+    uint64_t LastIrqUs;
+    /*!
+     * Set when an IRQ drain is pending in the MAC task, with its end time
+     */
+    bool MacEventPending;
+    uint64_t MacEventUs;
+    /*!
+     * Cumulated latencies [us]
+     */
+    uint64_t RadioLatencyTotalUs;
+    uint64_t MacLatencyTotalUs;
+    /*!
+     * Light sleep check of the MAC, NULL when the light sleep is disabled
+     */
+    bool ( *CanSleep )( void );
+    /*!
+     * Cumulated light sleep time [us]
+     */
+    uint64_t LightSleepTotalUs;
+    /*!
+     * Statistics
+     */
+    LoRaTaskStats_t Stats;
+}LoRaTaskCtx_t;
+
+static LoRaTaskCtx_t TaskCtx;
+
+static void LoRaRadioTask( void *pvParameters )
+{
+    uint64_t irqUs;
+    uint64_t startUs;
+    uint64_t endUs;
+    uint32_t busy;
+
+    while( 1 )
+    {
+        if( xSemaphoreTake( loraRadioSem, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+        startUs = RtcGetTimeUs( );
+        irqUs = SX126xGetDio1IrqTimeUs( );
+        Radio.BgIrqProcess( );
+        endUs = RtcGetTimeUs( );
+        busy = ( uint32_t )( endUs - startUs );
+
+        BoardDisableIrq( );
+        // Wake-ups by a BUSY timeout are not IRQs
+        if( irqUs != TaskCtx.LastIrqUs )
+        {
+            uint32_t latency = ( startUs > irqUs ) ? ( uint32_t )( startUs - irqUs ) : 0;
+
+            TaskCtx.LastIrqUs = irqUs;
+            TaskCtx.Stats.RadioIrqs++;
+            TaskCtx.RadioLatencyTotalUs += latency;
+            if( latency > TaskCtx.Stats.RadioLatencyMaxUs )
+            {
+                TaskCtx.Stats.RadioLatencyMaxUs = latency;
+            }
+        }
+        if( busy > TaskCtx.Stats.RadioBusyMaxUs )
+        {
+            TaskCtx.Stats.RadioBusyMaxUs = busy;
+        }
+        if( TaskCtx.MacEventPending == false )
+        {
+            TaskCtx.MacEventPending = true;
+            TaskCtx.MacEventUs = endUs;
+        }
+        BoardEnableIrq( );
+
+        xSemaphoreGive( loraIntSem );
+    }
+}
+
+static void LoRaMacTask( void *pvParameters )
+{
+    bool event;
+    uint64_t eventUs;
+    uint64_t startUs;
+    uint32_t busy;
+
+    while( 1 )
+    {
+        LoRaTaskLightSleep( );
+        if( xSemaphoreTake( loraIntSem, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+        startUs = RtcGetTimeUs( );
+        BoardDisableIrq( );
+        event = TaskCtx.MacEventPending;
+        eventUs = TaskCtx.MacEventUs;
+        TaskCtx.MacEventPending = false;
+        BoardEnableIrq( );
+
+        // The timer callbacks open and close the RX windows, each one a
+        // sequence of radio commands
+        SX126xRadioLock( );
+        TimerProcess( );
+        SX126xRadioUnlock( );
+        TaskCtx.MacProcess( );
+        busy = ( uint32_t )( RtcGetTimeUs( ) - startUs );
+
+        BoardDisableIrq( );
+        if( event == true )
+        {
+            uint32_t latency = ( startUs > eventUs ) ? ( uint32_t )( startUs - eventUs ) : 0;
+
+            TaskCtx.Stats.MacEvents++;
+            TaskCtx.MacLatencyTotalUs += latency;
+            if( latency > TaskCtx.Stats.MacLatencyMaxUs )
+            {
+                TaskCtx.Stats.MacLatencyMaxUs = latency;
+            }
+        }
+        if( busy > TaskCtx.Stats.MacBusyMaxUs )
+        {
+            TaskCtx.Stats.MacBusyMaxUs = busy;
+        }
+        BoardEnableIrq( );
+    }
+}
+
+bool LoRaTaskStart( void ( *macProcess )( void ) )
+{
+    if( ( loraIntSem == NULL ) || ( macProcess == NULL ) || ( TaskCtx.MacTask != NULL ) )
+    {
+        return false;
+    }
+    TaskCtx.MacProcess = macProcess;
+    TaskCtx.LastIrqUs = SX126xGetDio1IrqTimeUs( );
+
+    if( loraRadioSem == NULL )
+    {
+        loraRadioSem = xSemaphoreCreateBinary( );
+        if( loraRadioSem == NULL )
+        {
+            return false;
+        }
+    }
+    if( xTaskCreatePinnedToCore( LoRaRadioTask, "LORA_RADIO", LORA_RADIO_TASK_STACK_SIZE, NULL,
+                                 LORA_RADIO_TASK_PRIORITY, &TaskCtx.RadioTask, LORA_RADIO_TASK_CORE ) != pdPASS )
+    {
+        return false;
+    }
+    if( xTaskCreatePinnedToCore( LoRaMacTask, "LORA", LORA_MAC_TASK_STACK_SIZE, NULL,
+                                 LORA_MAC_TASK_PRIORITY, &TaskCtx.MacTask, tskNO_AFFINITY ) != pdPASS )
+    {
+        return false;
+    }
+    return true;
+}
+
+void LoRaTaskSetLightSleep( bool ( *canSleep )( void ) )
+{
+    TaskCtx.CanSleep = canSleep;
+    RtcSetLightSleep( canSleep != NULL );
+}
+
+bool LoRaTaskLightSleep( void )
+{
+    RadioOperatingModes_t mode;
+    uint64_t expiryUs;
+    uint64_t startUs;
+    uint64_t sleptUs;
+    bool alarm;
+
+    if( TaskCtx.CanSleep == NULL )
+    {
+        return false;
+    }
+    // The radio service task stays out of the radio until the wake up
+    SX126xRadioLock( );
+    mode = SX126xGetOperatingMode( );
+    startUs = RtcGetTimeUs( );
+    // The reception of the RX windows keeps the MCU awake, its DIO1 IRQ time
+    // calibrates the windows
+    if( ( ( mode != MODE_SLEEP ) && ( mode != MODE_TX ) ) ||
+        ( TaskCtx.CanSleep( ) == false ) ||
+        ( TimerGetNextExpiry( &expiryUs ) == false ) ||
+        ( expiryUs < ( startUs + LORA_LIGHT_SLEEP_MIN_US ) ) ||
+        ( uxSemaphoreGetCount( loraIntSem ) != 0 ) ||
+        ( ( loraRadioSem != NULL ) && ( uxSemaphoreGetCount( loraRadioSem ) != 0 ) ) ||
+        ( SX126xGetDio1PinState( ) != 0 ) )
+    {
+        SX126xRadioUnlock( );
+        return false;
+    }
+
+    LoRaEnergySetMcuSleep( true );
+    SX126xIoDio1WakeUp( true );
+    alarm = RtcLightSleep( expiryUs );
+    SX126xIoDio1WakeUp( false );
+    LoRaEnergySetMcuSleep( false );
+    SX126xRadioUnlock( );
+    sleptUs = RtcGetTimeUs( ) - startUs;
+
+    BoardDisableIrq( );
+    TaskCtx.Stats.LightSleeps++;
+    if( alarm == false )
+    {
+        TaskCtx.Stats.LightSleepDio1WakeUps++;
+    }
+    TaskCtx.LightSleepTotalUs += sleptUs;
+    BoardEnableIrq( );
+    return true;
+}
+
+void LoRaTaskGetStats( LoRaTaskStats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return;
+    }
+    BoardDisableIrq( );
+    *stats = TaskCtx.Stats;
+    if( stats->RadioIrqs > 0 )
+    {
+        stats->RadioLatencyAvgUs = ( uint32_t )( TaskCtx.RadioLatencyTotalUs / stats->RadioIrqs );
+    }
+    if( stats->MacEvents > 0 )
+    {
+        stats->MacLatencyAvgUs = ( uint32_t )( TaskCtx.MacLatencyTotalUs / stats->MacEvents );
+    }
+    stats->LightSleepMs = ( uint32_t )( TaskCtx.LightSleepTotalUs / 1000 );
+    BoardEnableIrq( );
+
+    // ESP-IDF gives the stack high water marks in bytes
+    if( TaskCtx.RadioTask != NULL )
+    {
+        stats->RadioStackFree = ( uint32_t )uxTaskGetStackHighWaterMark( TaskCtx.RadioTask );
+    }
+    if( TaskCtx.MacTask != NULL )
+    {
+        stats->MacStackFree = ( uint32_t )uxTaskGetStackHighWaterMark( TaskCtx.MacTask );
+    }
+}
+
+void LoRaTaskResetStats( void )
+{
+    BoardDisableIrq( );
+    memset1( ( uint8_t* )&TaskCtx.Stats, 0, sizeof( TaskCtx.Stats ) );
+    TaskCtx.RadioLatencyTotalUs = 0;
+    TaskCtx.MacLatencyTotalUs = 0;
+    TaskCtx.LightSleepTotalUs = 0;
+    BoardEnableIrq( );
+}
@@ -0,0 +1,183 @@
+/*!
+ * \file      lora-task.h
+ *
+ * \brief     LoRa tasks: radio service task and MAC task
+ *
+ * \remark    The radio service task is small, has a high priority and is
+ *            pinned to a core. The DIO1 ISR wakes it up through loraRadioSem,
+ *            it drains the radio IRQs ( Radio.BgIrqProcess ) and the radio
+ *            driver hands the events to the MAC: they are queued in their
+ *            order with their parameters, a received frame staying in the
+ *            radio frame pool until the MAC releases it ( LoRaMac.c ). The
+ *            task then wakes the MAC task up through loraIntSem, which
+ *            handles the queued events one after the other.
+ *            The MAC task runs the timers and the MAC and packages processing
+ *            which can take long, fragments decoding or NVM CRCs, without
+ *            delaying the service of the next radio IRQ.
+ *            Both tasks access the radio, each access holds the radio lock
+ *            ( SX126xRadioLock ).
+ *            With the light sleep enabled the MAC task puts the MCU in light
+ *            sleep before waiting, while a class A uplink is on the air or
+ *            waits for its RX windows with the radio asleep. The next timer
+ *            or DIO1 wakes it up. The RX windows open the MCU wake up time
+ *            earlier ( RtcGetMcuWakeUpTime ).
+ *
+ * \defgroup  LORATASK LoRa tasks
+ * \{
+ */
+#ifndef __LORA_TASK_H__
+#define __LORA_TASK_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Radio service task priority, above the application tasks
+ */
+#ifndef LORA_RADIO_TASK_PRIORITY
+#define LORA_RADIO_TASK_PRIORITY                    10
+#endif
+
+/*!
+ * Core the radio service task is pinned to
+ */
+#ifndef LORA_RADIO_TASK_CORE
+#define LORA_RADIO_TASK_CORE                        1
+#endif
+
+/*!
+ * Radio service task stack size [bytes]
+ */
+#ifndef LORA_RADIO_TASK_STACK_SIZE
+#define LORA_RADIO_TASK_STACK_SIZE                  4096
+#endif
+
+/*!
+ * MAC task priority
+ */
+#ifndef LORA_MAC_TASK_PRIORITY
+#define LORA_MAC_TASK_PRIORITY                      2
+#endif
+
+/*!
+ * MAC task stack size [bytes]
+ */
+#ifndef LORA_MAC_TASK_STACK_SIZE
+#define LORA_MAC_TASK_STACK_SIZE                    8192
+#endif
+
+/*!
+ * Shortest light sleep, the MCU stays awake until a timer expiring sooner
+ * [us]
+ */
+#ifndef LORA_LIGHT_SLEEP_MIN_US
+#define LORA_LIGHT_SLEEP_MIN_US                     5000
+#endif
+
+/*!
+ * LoRa tasks statistics
+ */
+typedef struct sLoRaTaskStats
+{
+    /*!
+     * DIO1 IRQs drained by the radio service task
+     */
+    uint32_t RadioIrqs;
+    /*!
+     * Mean and longest DIO1 IRQ to IRQ drain latency [us]
+     */
+    uint32_t RadioLatencyAvgUs;
+    uint32_t RadioLatencyMaxUs;
+    /*!
+     * Longest IRQ drain [us]
+     */
+    uint32_t RadioBusyMaxUs;
+    /*!
+     * Radio service task stack never used [bytes]
+     */
+    uint32_t RadioStackFree;
+    /*!
+     * MAC task runs following an IRQ drain
+     */
+    uint32_t MacEvents;
+    /*!
+     * Mean and longest IRQ drain to MAC processing latency [us]
+     */
+    uint32_t MacLatencyAvgUs;
+    uint32_t MacLatencyMaxUs;
+    /*!
+     * Longest MAC processing [us]
+     */
+    uint32_t MacBusyMaxUs;
+    /*!
+     * MAC task stack never used [bytes]
+     */
+    uint32_t MacStackFree;
+    /*!
+     * Light sleeps of the MAC task, the ones ended by DIO1
+     */
+    uint32_t LightSleeps;
+    uint32_t LightSleepDio1WakeUps;
+    /*!
+     * Time spent in light sleep [ms]
+     */
+    uint32_t LightSleepMs;
+}LoRaTaskStats_t;
+
+/*!
+ * \brief Starts the radio service task and the MAC task. loraIntSem must
+ *        exist. Once started the DIO1 IRQs wake the radio service task up
+ *        instead of the MAC task.
+ *
+ * \param [IN] macProcess MAC and packages processing, run by the MAC task
+ *                        after the timers each time loraIntSem is given
+ *
+ * \retval status true if both tasks run
+ */
+bool LoRaTaskStart( void ( *macProcess )( void ) );
+
+/*!
+ * \brief Enables the light sleep of the MCU between the radio events of the
+ *        uplinks. The whole chip sleeps, the application tasks are stopped
+ *        meanwhile.
+ *
+ * \param [IN] canSleep Tells if the MAC waits for radio events and timers
+ *                      only, LoRaMacIsUplinkRunning. NULL disables the light
+ *                      sleep.
+ */
+void LoRaTaskSetLightSleep( bool ( *canSleep )( void ) );
+
+/*!
+ * \brief Puts the MCU in light sleep until the next timer expiry or DIO1, if
+ *        the light sleep is enabled, nothing is pending, the radio sleeps or
+ *        transmits and the next timer expires late enough. Run by the MAC
+ *        task before waiting.
+ *
+ * \retval slept true if the MCU slept
+ */
+bool LoRaTaskLightSleep( void );
+
+/*!
+ * \brief Gets the LoRa tasks statistics
+ *
+ * \param [OUT] stats Statistics
+ */
+void LoRaTaskGetStats( LoRaTaskStats_t *stats );
+
+/*!
+ * \brief Resets the latency and processing time statistics
+ */
+void LoRaTaskResetStats( void );
+
+/*! \} defgroup LORATASK */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LORA_TASK_H__
@@ -0,0 +1,158 @@
+/*!
+ * \file      crypto_board.c
+ *
+ * \brief     Secure Element crypto backend on the ESP32 AES accelerator
+ *
+ * \remark    The AES peripheral is shared with the other users of esp_aes
+ *            (TLS, flash encryption), which lock it per operation. Any
+ *            accelerator error makes the operation fall back to the software
+ *            backend.
+ */
+#if defined( ESP32 )
+#include <stdint.h>
+#include <string.h>
+#include "aes/esp_aes.h"
+#include "system/crypto/soft-se-hal.h"
+
+/*!
+ * CBC chunk processed per accelerator call
+ */
+#define CRYPTO_BOARD_CBC_CHUNK                      64
+
+static SecureElementStatus_t Esp32AesEncrypt( Key_t* key, const uint8_t* buffer, uint16_t size, uint8_t* encBuffer )
+{
+    esp_aes_context ctx;
+    uint16_t block = 0;
+    int err;
+
+    esp_aes_init( &ctx );
+    err = esp_aes_setkey( &ctx, key->KeyValue, SE_KEY_SIZE * 8 );
+    while( ( err == 0 ) && ( block < size ) )
+    {
+        err = esp_aes_crypt_ecb( &ctx, ESP_AES_ENCRYPT, &buffer[block], &encBuffer[block] );
+        if( err == 0 )
+        {
+            block += 16;
+        }
+    }
+    esp_aes_free( &ctx );
+
+    if( err != 0 )
+    {
+        // Blocks are independent, encBuffer may be buffer
+        return SoftSeCryptoSoftware.AesEncrypt( key, &buffer[block], size - block, &encBuffer[block] );
+    }
+    return SECURE_ELEMENT_SUCCESS;
+}
+
+/*!
+ * \brief Doubles a value in GF(2^128), RFC 4493 subkey generation
+ */
+static void CmacDouble( uint8_t* out, const uint8_t* in )
+{
+    uint8_t carry = 0;
+
+    for( int8_t i = 15; i >= 0; i-- )
+    {
+        uint8_t b = in[i];
+
+        out[i] = ( uint8_t )( ( b << 1 ) | carry );
+        carry = b >> 7;
+    }
+    if( carry != 0 )
+    {
+        out[15] ^= 0x87;
+    }
+}
+
+/*!
+ * \brief Chains complete blocks into the CBC-MAC state
+ */
+static int CmacChain( esp_aes_context* ctx, uint8_t* x, const uint8_t* data, uint16_t size )
+{
+    uint8_t out[CRYPTO_BOARD_CBC_CHUNK];
+    int err = 0;
+
+    while( ( err == 0 ) && ( size != 0 ) )
+    {
+        uint16_t len = ( size > CRYPTO_BOARD_CBC_CHUNK ) ? CRYPTO_BOARD_CBC_CHUNK : size;
+
+        // The IV is updated with the last cipher block, that is the state
+        err = esp_aes_crypt_cbc( ctx, ESP_AES_ENCRYPT, len, x, data, out );
+        data += len;
+        size -= len;
+    }
+    return err;
+}
+
+static SecureElementStatus_t Esp32AesCmac( Key_t* key, const uint8_t* micBxBuffer, const uint8_t* buffer, uint16_t size,
+                                           uint8_t* cmac )
+{
+    esp_aes_context ctx;
+    uint8_t x[16] = { 0 };
+    uint8_t k[16] = { 0 };
+    uint16_t head;
+    uint16_t last;
+    int err;
+
+    if( ( micBxBuffer != NULL ) && ( size == 0 ) )
+    {
+        // The Bx block alone is the message
+        buffer = micBxBuffer;
+        size = 16;
+        micBxBuffer = NULL;
+    }
+    // Complete blocks chained before the last one, which is 1 to 16 bytes
+    // long, or empty for an empty message
+    last = ( size == 0 ) ? 0 : ( uint16_t )( ( ( size - 1 ) % 16 ) + 1 );
+    head = size - last;
+
+    esp_aes_init( &ctx );
+    err = esp_aes_setkey( &ctx, key->KeyValue, SE_KEY_SIZE * 8 );
+    if( err == 0 )
+    {
+        // L = E( 0 ), K1 = 2 L, K2 = 4 L
+        err = esp_aes_crypt_ecb( &ctx, ESP_AES_ENCRYPT, k, k );
+    }
+    if( err == 0 )
+    {
+        CmacDouble( k, k );
+        if( last < 16 )
+        {
+            CmacDouble( k, k );
+        }
+        if( micBxBuffer != NULL )
+        {
+            err = CmacChain( &ctx, x, micBxBuffer, 16 );
+        }
+    }
+    if( err == 0 )
+    {
+        err = CmacChain( &ctx, x, buffer, head );
+    }
+    if( err == 0 )
+    {
+        for( uint8_t i = 0; i < 16; i++ )
+        {
+            uint8_t m = ( i < last ) ? buffer[head + i] : ( ( i == last ) ? 0x80 : 0x00 );
+
+            x[i] ^= m ^ k[i];
+        }
+        err = esp_aes_crypt_ecb( &ctx, ESP_AES_ENCRYPT, x, cmac );
+    }
+    esp_aes_free( &ctx );
+
+    if( err != 0 )
+    {
+        return SoftSeCryptoSoftware.AesCmac( key, micBxBuffer, buffer, size, cmac );
+    }
+    return SECURE_ELEMENT_SUCCESS;
+}
+
+const SoftSeCryptoBackend_t SoftSeCryptoEsp32 =
+{
+    .Name = "esp32-aes",
+    .AesEncrypt = Esp32AesEncrypt,
+    .AesCmac = Esp32AesCmac,
+};
+#endif
@@ -0,0 +1,61 @@
+/*!
+ * \file      flash_board.c
+ *
+ * \brief     Flash driver on an ESP32 data partition
+ *
+ * \remark    The NVM log uses the data partition labelled "lorawan". Add it to
+ *            the partition table of the sketch (partitions.csv), for example:
+ *
+ *            lorawan,  data, 0x40,    ,  0x8000,
+ *
+ *            Without it FlashMcuInit fails and the MAC context is only kept
+ *            in RTC memory, as before.
+ */
+#if defined( ESP32 )
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_partition.h"
+#include "boards/mcu/flash_board.h"
+
+/*!
+ * Label of the data partition holding the NVM log
+ */
+#define FLASH_BOARD_PARTITION_LABEL                 "lorawan"
+
+static const esp_partition_t* Partition = NULL;
+
+bool FlashMcuInit( void )
+{
+    if( Partition == NULL )
+    {
+        Partition = esp_partition_find_first( ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              FLASH_BOARD_PARTITION_LABEL );
+    }
+    return Partition != NULL;
+}
+
+uint32_t FlashMcuGetSize( void )
+{
+    if( Partition == NULL )
+    {
+        return 0;
+    }
+    return Partition->size - ( Partition->size % FLASH_MCU_SECTOR_SIZE );
+}
+
+bool FlashMcuRead( uint32_t addr, uint8_t* buffer, uint32_t size )
+{
+    return ( Partition != NULL ) && ( esp_partition_read( Partition, addr, buffer, size ) == ESP_OK );
+}
+
+bool FlashMcuWrite( uint32_t addr, const uint8_t* buffer, uint32_t size )
+{
+    return ( Partition != NULL ) && ( esp_partition_write( Partition, addr, buffer, size ) == ESP_OK );
+}
+
+bool FlashMcuEraseSector( uint32_t addr )
+{
+    return ( Partition != NULL ) &&
+           ( esp_partition_erase_range( Partition, addr, FLASH_MCU_SECTOR_SIZE ) == ESP_OK );
+}
+#endif
@@ -0,0 +1,74 @@
+/*!
+ * \file      flash_board.h
+ *
+ * \brief     Target board flash driver used by the NVM log (nvmm.c)
+ *
+ * \remark    The storage follows NOR flash rules: erasing a sector sets all
+ *            its bytes to 0xFF and programming can only clear bits. Addresses
+ *            are relative to the start of the storage area.
+ */
+#ifndef __FLASH_BOARD_H__
+#define __FLASH_BOARD_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Erase unit of the storage area
+ */
+#define FLASH_MCU_SECTOR_SIZE                       4096
+
+/*!
+ * \brief Opens the storage area
+ *
+ * \retval status false when the board has no storage area, the NVM context
+ *                is then only kept in RTC memory
+ */
+bool FlashMcuInit( void );
+
+/*!
+ * \brief Gets the size of the storage area
+ *
+ * \retval size Storage area size, multiple of FLASH_MCU_SECTOR_SIZE. 0 when
+ *              FlashMcuInit failed.
+ */
+uint32_t FlashMcuGetSize( void );
+
+/*!
+ * \brief Reads from the storage area
+ *
+ * \param [IN]  addr   Address to read from
+ * \param [OUT] buffer Destination buffer
+ * \param [IN]  size   Number of bytes to read
+ * \retval status Operation status
+ */
+bool FlashMcuRead( uint32_t addr, uint8_t* buffer, uint32_t size );
+
+/*!
+ * \brief Programs the storage area. The bytes must have been erased.
+ *
+ * \param [IN] addr   Address to program
+ * \param [IN] buffer Source buffer
+ * \param [IN] size   Number of bytes to program
+ * \retval status Operation status
+ */
+bool FlashMcuWrite( uint32_t addr, const uint8_t* buffer, uint32_t size );
+
+/*!
+ * \brief Erases one sector of the storage area
+ *
+ * \param [IN] addr Sector address, multiple of FLASH_MCU_SECTOR_SIZE
+ * \retval status Operation status
+ */
+bool FlashMcuEraseSector( uint32_t addr );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __FLASH_BOARD_H__
@@ -0,0 +1,275 @@
+/*!
+ * \file      timer.c
+ *
+ * \brief     Timer objects and scheduling management implementation
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *                ______                              _
+ *               / _____)             _              | |
+ *              ( (____  _____ ____ _| |_ _____  ____| |__
+ *               \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ *               _____) ) ____| | | || |_| ____( (___| | | |
+ *              (______/|_____)_|_|_| \__)_____)\____)_| |_|
+ *              (C)2013-2017 Semtech
+ *
+ * \endcode
+ *
+ * \author    Miguel Luis ( Semtech )
+ *
+ * \author    Gregory Cristian ( Semtech )
+ *
+ * \remark    Running timers are kept in a list sorted by expiry time, the
+ *            head expires first. A single RTC alarm is armed for the head.
+ *            The alarm only wakes up the LoRa task, expired timers callbacks
+ *            are run by TimerProcess from the LoRa task.
+ *            Timestamps are absolute times in microseconds since start-up
+ *            ( RtcGetTimeUs ), the RTC ticks are microseconds.
+ */
+#include "system/utilities.h"
+#include "boards/mcu/board.h"
+#include "boards/rtc-board.h"
+#include "boards/mcu/timer.h"
+
+/*!
+ * Timers list head pointer
+ */
+static TimerEvent_t *TimerListHead = NULL;
+
+/*!
+ * \brief Adds a timer to the list.
+ *
+ * \remark The list is automatically sorted. The list head always contains the
+ *         next timer to expire.
+ *
+ * \param [IN]  obj Timer object to be added to the list
+ */
+static void TimerInsertTimer( TimerEvent_t *obj );
+
+/*!
+ * \brief Removes a timer from the list if it is present
+ *
+ * \param [IN]  obj Timer object to be removed
+ */
+static void TimerRemoveTimer( TimerEvent_t *obj );
+
+/*!
+ * \brief Arms the RTC alarm for the list head, or stops it when the list is
+ *        empty
+ */
+static void TimerSetTimeout( void );
+
+void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) )
+{
+    BoardDisableIrq( );
+    TimerRemoveTimer( obj );
+    BoardEnableIrq( );
+
+    obj->Timestamp = 0;
+    obj->ReloadValue = 0;
+    obj->IsRunning = false;
+    obj->Callback = callback;
+    obj->Next = NULL;
+}
+
+void TimerSetContext( TimerEvent_t *obj, void* context )
+{
+    // obj->Context = context;
+}
+
+void TimerStart( TimerEvent_t *obj )
+{
+    TimerStartAt( obj, RtcGetTimeUs( ) );
+}
+
+void TimerStartAt( TimerEvent_t *obj, uint64_t referenceUs )
+{
+    if( obj == NULL )
+    {
+        return;
+    }
+
+    BoardDisableIrq( );
+    TimerRemoveTimer( obj );
+    obj->Timestamp = referenceUs + ( uint64_t )obj->ReloadValue * 1000;
+    TimerInsertTimer( obj );
+    BoardEnableIrq( );
+
+    TimerSetTimeout( );
+}
+
+static void TimerInsertTimer( TimerEvent_t *obj )
+{
+    TimerEvent_t **cur = &TimerListHead;
+
+    // Timers with the same expiry time are run in start order
+    while( ( *cur != NULL ) && ( ( *cur )->Timestamp <= obj->Timestamp ) )
+    {
+        cur = &( *cur )->Next;
+    }
+    obj->Next = *cur;
+    obj->IsRunning = true;
+    *cur = obj;
+}
+
+static void TimerRemoveTimer( TimerEvent_t *obj )
+{
+    TimerEvent_t **cur = &TimerListHead;
+
+    while( *cur != NULL )
+    {
+        if( *cur == obj )
+        {
+            *cur = obj->Next;
+            break;
+        }
+        cur = &( *cur )->Next;
+    }
+    obj->Next = NULL;
+    obj->IsRunning = false;
+}
+
+bool TimerIsStarted( TimerEvent_t *obj )
+{
+    return obj->IsRunning;
+}
+
+void TimerIrqHandler( void )
+{
+    TimerEvent_t* cur;
+
+    // Remove all the expired object from the list and execute their callback
+    for( ;; )
+    {
+        BoardDisableIrq( );
+        cur = TimerListHead;
+        if( ( cur == NULL ) || ( cur->Timestamp > RtcGetTimeUs( ) ) )
+        {
+            BoardEnableIrq( );
+            break;
+        }
+        TimerListHead = cur->Next;
+        cur->Next = NULL;
+        cur->IsRunning = false;
+        BoardEnableIrq( );
+
+        // The callback may start or stop any timer, including this one
+        if( cur->Callback != NULL )
+        {
+            cur->Callback( );
+        }
+    }
+
+    // Start the alarm for the next TimerListHead if it exists
+    TimerSetTimeout( );
+}
+
+void TimerStop( TimerEvent_t *obj )
+{
+    bool isHead;
+
+    if( obj == NULL )
+    {
+        return;
+    }
+
+    BoardDisableIrq( );
+    isHead = TimerListHead == obj;
+    TimerRemoveTimer( obj );
+    BoardEnableIrq( );
+
+    if( isHead == true )
+    {
+        TimerSetTimeout( );
+    }
+}
+
+void TimerReset( TimerEvent_t *obj )
+{
+    TimerStop( obj );
+    TimerStart( obj );
+}
+
+void TimerSetValue( TimerEvent_t *obj, uint32_t value )
+{
+    obj->ReloadValue = value;
+}
+
+TimerTime_t TimerGetCurrentTime( void )
+{
+    return ( TimerTime_t )( RtcGetTimeUs( ) / 1000 );
+}
+
+TimerTime_t TimerGetElapsedTime( TimerTime_t past )
+{
+    // Intentional wrap around
+    return TimerGetCurrentTime( ) - past;
+}
+
+bool TimerGetNextExpiry( uint64_t *expiryUs )
+{
+    bool running;
+
+    BoardDisableIrq( );
+    running = TimerListHead != NULL;
+    if( running == true )
+    {
+        *expiryUs = TimerListHead->Timestamp;
+    }
+    BoardEnableIrq( );
+    return running;
+}
+
+static void TimerSetTimeout( void )
+{
+    TimerEvent_t *head;
+    uint64_t expiry;
+    bool armed = false;
+
+    // The alarm is programmed outside of the critical section. Check that the
+    // head did not change meanwhile, otherwise program it again.
+    while( armed == false )
+    {
+        BoardDisableIrq( );
+        head = TimerListHead;
+        expiry = ( head != NULL ) ? head->Timestamp : 0;
+        BoardEnableIrq( );
+
+        if( head == NULL )
+        {
+            RtcStopAlarm( );
+        }
+        else
+        {
+            uint64_t now = RtcGetTimeUs( );
+            uint64_t timeout = ( expiry > now ) ? ( expiry - now ) : 0;
+
+            if( timeout < RtcGetMinimumTimeout( ) )
+            {
+                timeout = RtcGetMinimumTimeout( );
+            }
+            // Longer timeouts wake up early and program the remaining time
+            if( timeout > UINT32_MAX )
+            {
+                timeout = UINT32_MAX;
+            }
+            RtcSetAlarm( ( uint32_t )timeout );
+        }
+
+        BoardDisableIrq( );
+        armed = ( TimerListHead == head ) && ( ( head == NULL ) || ( head->Timestamp == expiry ) );
+        BoardEnableIrq( );
+    }
+}
+
+TimerTime_t TimerTempCompensation( TimerTime_t period, float temperature )
+{
+    return RtcTempCompensation( period, temperature );
+}
+
+void TimerProcess( void )
+{
+    TimerIrqHandler( );
+    RtcProcess( );
+}
@@ -50,12 +50,8 @@ extern "C"
  */
 typedef struct TimerEvent_s
 {
-	uint8_t timerNum;			  /**< Used with ESP32 MCU 1 for TX, 2 for RX*/
-	// bool oneShot = true;		  /**< True if it is a one shot timer */
-    bool oneShot;
-	uint32_t Timestamp;			  /**< Current timer value */
-	// uint32_t ReloadValue = 10000; /**< Timer delay value	*/
-    uint32_t ReloadValue;
+	uint64_t Timestamp;			  /**< Expiry time in us since start-up */
+    uint32_t ReloadValue;		  /**< Timer delay value in ms */
 	bool IsRunning;				  /**< Is the timer currently running	*/
 	void (*Callback)(void);		  /**< Timer IRQ callback function	*/
 	struct TimerEvent_s *Next;	  /**< Pointer to the next Timer object.	*/
@@ -89,9 +85,12 @@ void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) );           // 
 void TimerSetContext( TimerEvent_t *obj, void* context );                           // 设置自定义用户数据指针       项目未使用
 
 /*!
- * Timer IRQ event handler
+ * \brief Timer IRQ event handler
+ *
+ * \remark Runs the callbacks of the expired timers. Called by TimerProcess
+ *         from the LoRa task, never from the alarm context.
  */
-void TimerIrqHandler( void );                                                       // 定时器中断处理               项目未使用
+void TimerIrqHandler( void );                                                       // 定时器中断处理
 
 /*!
  * \brief Starts and adds the timer object to the list of timer events
@@ -100,6 +99,16 @@ void TimerIrqHandler( void );
  */
 void TimerStart( TimerEvent_t *obj );                                               // 定时器启动
 
+/*!
+ * \brief Starts the timer object, its value counted from a reference time
+ *        instead of now, e.g. the time of a radio IRQ. Expires at once when
+ *        the reference plus the value is already past.
+ *
+ * \param [IN] obj         Structure containing the timer object parameters
+ * \param [IN] referenceUs Reference time, RtcGetTimeUs time base [us]
+ */
+void TimerStartAt( TimerEvent_t *obj, uint64_t referenceUs );                       // 定时器从参考时间启动
+
 /*!
  * \brief Checks if the provided timer is running
  *
@@ -149,6 +158,14 @@ TimerTime_t TimerGetCurrentTime( void );
  */
 TimerTime_t TimerGetElapsedTime( TimerTime_t past );                                // 返回至参数时刻以来经过的时间
 
+/*!
+ * \brief Gets the expiry time of the next timer to expire
+ *
+ * \param [OUT] expiryUs Absolute expiry time, RtcGetTimeUs time base [us]
+ * \retval running false if no timer is running
+ */
+bool TimerGetNextExpiry( uint64_t *expiryUs );                                      // 获取下一个到期定时器的到期时间
+
 /*!
  * \brief Computes the temperature compensation for a period of time on a
  *        specific temperature.
@@ -162,8 +179,10 @@ TimerTime_t TimerTempCompensation( TimerTime_t period, float temperature );
 
 /*!
  * \brief Processes pending timer events
+ *
+ * \remark Must be called by the LoRa task each time it is woken up
  */
-void TimerProcess( void );                                                          // 处理待处理的计时器事件                   项目未使用
+void TimerProcess( void );                                                          // 处理待处理的计时器事件
 
 #ifdef __cplusplus
 }
@@ -2,9 +2,34 @@
 #include <esp_timer.h>
 #include <stdint.h>
 #include <esp_attr.h>
+#include <esp_sleep.h>
+#include <Arduino.h>
 #include "system/utilities.h"
 
-#define MIN_ALARM_DELAY                             3
+/*!
+ * RTC ticks are microseconds ( esp_timer )
+ */
+#define MIN_ALARM_DELAY                             50
+
+/*!
+ * Light sleep wake up time until measured, and longest one kept [us]
+ */
+#define MCU_WAKE_UP_TIME_DEFAULT                    1000
+#define MCU_WAKE_UP_TIME_MAX                        5000
+
+extern SemaphoreHandle_t loraIntSem;
+
+/*!
+ * One shot timer used as the timer objects alarm
+ */
+static esp_timer_handle_t RtcAlarmTimer = NULL;
+
+/*!
+ * Light sleep state, last wake up time asked for and measured wake up time [us]
+ */
+static bool LightSleepEnabled = false;
+static uint64_t LightSleepWakeUpUs = 0;
+static int16_t McuWakeUpTime = 0;
 
 uint32_t RtcGetCalendarTime( uint16_t *milliseconds )
 {
@@ -53,22 +78,112 @@ void RtcProcess( void )
 
 uint32_t RtcMs2Tick( TimerTime_t milliseconds )
 {
-    return ( uint32_t )( ( ( ( uint64_t )milliseconds ) << 15 ) / 1000 );
+    return ( uint32_t )( ( uint64_t )milliseconds * 1000 );
 }
 
+TimerTime_t RtcTick2Ms( uint32_t tick )
+{
+    return ( TimerTime_t )( tick / 1000 );
+}
 
-// vvvvvvvvvvvvv以下函数先空实现占位，后续用ticker库代替vvvvvvvvvvvvvvvvvvv
-void RtcSetAlarm( uint32_t timeout )
+uint32_t RtcGetTimerValue( void )
+{
+    return ( uint32_t )esp_timer_get_time( );
+}
+
+uint64_t RtcGetTimeUs( void )
+{
+    return ( uint64_t )esp_timer_get_time( );
+}
+
+/*!
+ * \brief Alarm callback, runs in the esp_timer task. The timer objects
+ *        callbacks are run by the LoRa task ( TimerProcess ).
+ */
+static void RtcOnAlarm( void *arg )
 {
+    if( loraIntSem != NULL )
+    {
+        xSemaphoreGive( loraIntSem );
+    }
+}
 
+void RtcSetAlarm( uint32_t timeout )
+{
+    if( RtcAlarmTimer == NULL )
+    {
+        const esp_timer_create_args_t args = {
+            .callback = RtcOnAlarm,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "lora_timer",
+        };
+        if( esp_timer_create( &args, &RtcAlarmTimer ) != ESP_OK )
+        {
+            RtcAlarmTimer = NULL;
+            return;
+        }
+    }
+    esp_timer_stop( RtcAlarmTimer );
+    esp_timer_start_once( RtcAlarmTimer, timeout );
 }
 
 void RtcStopAlarm( void )
 {
+    if( RtcAlarmTimer != NULL )
+    {
+        esp_timer_stop( RtcAlarmTimer );
+    }
+}
 
+void RtcSetMcuWakeUpTime( void )
+{
+    uint64_t now = RtcGetTimeUs( );
+    uint64_t wakeUp = ( now > LightSleepWakeUpUs ) ? ( now - LightSleepWakeUpUs ) : 0;
+
+    // 过长的唤醒（被中断或其他任务推迟）不计入
+    if( ( wakeUp > ( uint64_t )McuWakeUpTime ) && ( wakeUp <= MCU_WAKE_UP_TIME_MAX ) )
+    {
+        McuWakeUpTime = ( int16_t )wakeUp;
+    }
 }
 
+int16_t RtcGetMcuWakeUpTime( void )
+{
+    if( LightSleepEnabled == false )
+    {
+        return 0;
+    }
+    return ( McuWakeUpTime != 0 ) ? McuWakeUpTime : MCU_WAKE_UP_TIME_DEFAULT;
+}
+
+void RtcSetLightSleep( bool enable )
+{
+    LightSleepEnabled = enable;
+}
+
+bool RtcLightSleep( uint64_t wakeUpUs )
+{
+    uint64_t now = RtcGetTimeUs( );
+    bool alarm;
+
+    if( ( LightSleepEnabled == false ) || ( wakeUpUs <= ( now + MIN_ALARM_DELAY ) ) )
+    {
+        return false;
+    }
+    LightSleepWakeUpUs = wakeUpUs;
+    esp_sleep_enable_timer_wakeup( wakeUpUs - now );
+    alarm = ( esp_light_sleep_start( ) == ESP_OK ) && ( esp_sleep_get_wakeup_cause( ) == ESP_SLEEP_WAKEUP_TIMER );
+    // 不影响deepSleepMs的唤醒源
+    esp_sleep_disable_wakeup_source( ESP_SLEEP_WAKEUP_TIMER );
+    if( alarm == true )
+    {
+        RtcSetMcuWakeUpTime( );
+    }
+    return alarm;
+}
 
+// vvvvvvvvvvvvv以下函数未使用，定时器对象直接使用 RtcGetTimeUs 的绝对时间vvvvvvvvvvvvvvvvvvv
 uint32_t RtcSetTimerContext( void )
 {
     return 0;
@@ -84,4 +199,4 @@ uint32_t RtcGetTimerElapsedTime( void )
     return 0;
 }
 
-// ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
\ No newline at end of file
+// ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
@@ -87,7 +87,7 @@ uint32_t RtcMs2Tick( TimerTime_t milliseconds );                      // 将毫
  * \param[IN] time in timer ticks
  * \retval returns time in milliseconds
  */
-TimerTime_t RtcTick2Ms( uint32_t tick );                              // 将以刻度为单位的时间转换为以毫秒为单位的时间       未使用
+TimerTime_t RtcTick2Ms( uint32_t tick );                              // 将以刻度为单位的时间转换为以毫秒为单位的时间       已实现
 
 /*!
  * \brief Performs a delay of milliseconds by polling RTC
@@ -99,30 +99,55 @@ void RtcDelayMs( TimerTime_t milliseconds );                          // 通过
 /*!
  * \brief Calculates the wake up time between wake up and MCU start
  *
- * \note Resolution in RTC_ALARM_TIME_BASE
+ * \remark Measured on the light sleeps ended by the alarm, the longest one
+ *         is kept
  */
-void RtcSetMcuWakeUpTime( void );                                     // 意义不明       未使用
+void RtcSetMcuWakeUpTime( void );                                     // 测量浅睡眠唤醒时间         已实现
 
 /*!
  * \brief Returns the wake up time in ticks
  *
+ * \remark An estimate until a light sleep measured it, 0 while the light
+ *         sleep is disabled. The RX windows open that much earlier.
+ *
  * \retval wakeUpTime The WakeUpTime value in ticks
  */
-int16_t RtcGetMcuWakeUpTime( void );                                  // 返回唤醒时间（以刻度为单位）   未使用
+int16_t RtcGetMcuWakeUpTime( void );                                  // 返回唤醒时间（以刻度为单位）   已实现
+
+/*!
+ * \brief Enables the light sleep of the MCU ( RtcLightSleep )
+ *
+ * \param [IN] enable true to enable the light sleep
+ */
+void RtcSetLightSleep( bool enable );                                 // 允许浅睡眠               已实现
+
+/*!
+ * \brief Enters light sleep until the given time. The other wake up sources
+ *        armed, the DIO1 one, end it earlier.
+ *
+ * \remark The whole chip sleeps, the other tasks are stopped meanwhile
+ *
+ * \param [IN] wakeUpUs Wake up time, RtcGetTimeUs time base [us]
+ * \retval alarm true if the sleep ended at the wake up time
+ */
+bool RtcLightSleep( uint64_t wakeUpUs );                              // 浅睡眠至唤醒时间或DIO1中断  已实现
 
 /*!
  * \brief Sets the alarm
  *
  * \note The alarm is set at now (read in this funtion) + timeout
  *
+ * \remark When the alarm expires the LoRa task is woken up, it runs the
+ *         expired timers callbacks through TimerProcess
+ *
  * \param timeout [IN] Duration of the Timer ticks
  */
-void RtcSetAlarm( uint32_t timeout );                                 // 设置闹钟               不实现，相关功能改用esp32 Ticker库实现
+void RtcSetAlarm( uint32_t timeout );                                 // 设置闹钟               已实现，基于esp_timer单次定时器
 
 /*!
  * \brief Stops the Alarm
  */
-void RtcStopAlarm( void );                                            // 停止闹钟               不实现，相关功能改用esp32 Ticker库实现
+void RtcStopAlarm( void );                                            // 停止闹钟               已实现
 
 /*!
  * \brief Starts wake up alarm
@@ -138,14 +163,14 @@ void RtcStartAlarm( uint32_t timeout );                               // 启动
  *
  * \retval value Timer reference value in ticks
  */
-uint32_t RtcSetTimerContext( void );                                  // 设置 RTC 定时器参考    不实现，相关功能改用esp32 Ticker库实现
+uint32_t RtcSetTimerContext( void );                                  // 设置 RTC 定时器参考    未使用
   
 /*!
  * \brief Gets the RTC timer reference
  *
  * \retval value Timer value in ticks
  */
-uint32_t RtcGetTimerContext( void );                                  // 获取 RTC 定时器参考    不实现，相关功能改用esp32 Ticker库实现
+uint32_t RtcGetTimerContext( void );                                  // 获取 RTC 定时器参考    未使用
 
 /*!
  * \brief Gets the system time with the number of seconds elapsed since epoch
@@ -160,14 +185,24 @@ uint32_t RtcGetCalendarTime( uint16_t *milliseconds );                // 获取
  *
  * \retval RTC Timer value
  */
-uint32_t RtcGetTimerValue( void );                                    // 获取 RTC 定时器值          未使用
+uint32_t RtcGetTimerValue( void );                                    // 获取 RTC 定时器值          已实现
+
+/*!
+ * \brief Get the time elapsed since start-up
+ *
+ * \remark Timer objects timestamps are based on this time. It does not wrap
+ *         around.
+ *
+ * \retval time Time in microseconds
+ */
+uint64_t RtcGetTimeUs( void );                                        // 获取启动以来的时间（微秒）  已实现
 
 /*!
  * \brief Get the RTC timer elapsed time since the last Alarm was set
  *
  * \retval RTC Elapsed time since the last alarm in ticks.
  */
-uint32_t RtcGetTimerElapsedTime( void );                              // 获取自上次设置闹钟以来 RTC 计时器经过的时间    不实现，相关功能改用esp32 Ticker库实现
+uint32_t RtcGetTimerElapsedTime( void );                              // 获取自上次设置闹钟以来 RTC 计时器经过的时间    未使用
 
 /*!
  * \brief Writes data0 and data1 to the RTC backup registers
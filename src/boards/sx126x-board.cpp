@@ -40,17 +40,48 @@ Maintainer: Miguel Luis and Gregory Cristian
 #include "boards/mcu/spi_board.h"
 // #include "radio/sx126x/sx126x.h"
 #include "sx126x-board.h"
+#include "rtc-board.h"
+#include "lora-energy.h"
+#include <driver/gpio.h>
 #include <driver/rtc_io.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
 
 static RadioOperatingModes_t OperatingMode;
 
-SPISettings spiSettings = SPISettings(2000000, MSBFIRST, SPI_MODE0);
+static uint32_t spiClock = SX126X_SPI_CLOCK_HZ;
+SPISettings spiSettings = SPISettings(SX126X_SPI_CLOCK_HZ, MSBFIRST, SPI_MODE0);
+
+// SPI accesses timing and RxDone latency
+static SX126xSpiStats_t SpiStats;
+
+// BUSY waits histogram and pending BUSY timeout
+static SX126xBusyStats_t BusyStats;
+static uint32_t BusyTimeoutCount = 0;
+
+extern SemaphoreHandle_t loraIntSem;
+extern SemaphoreHandle_t loraRadioSem;
+
+// Lock of the tasks sharing the radio, see SX126xRadioLock
+static SemaphoreHandle_t RadioLock = NULL;
+
+// DIO1 interrupt handler of the radio driver and time of the last interrupt
+static DioIrqHandler *Dio1Irq = NULL;
+static volatile uint64_t Dio1IrqTimeUs = 0;
 
 // No need to initialize DIO3 as output everytime, do it once and remember it
 bool dio3IsOutput = false;
 
 void SX126xIOInit(void)
 {
+	if (RadioLock == NULL)
+	{
+		RadioLock = xSemaphoreCreateRecursiveMutex();
+	}
+	// RST和SS在深度睡眠期间保持高电平，radio保持warm start睡眠及其配置
+	// 不在此复位radio：SX126xInit无法恢复radio时才复位（SX126xReset）
+	digitalWrite(LORA_RST, HIGH);
+	rtc_gpio_hold_dis(gpio_num_t(LORA_RST));
 	rtc_gpio_hold_dis(gpio_num_t(LORA_SS));
 	initSPI();
     pinMode(LORA_SS, OUTPUT);
@@ -60,10 +91,6 @@ void SX126xIOInit(void)
     digitalWrite(LORA_RST, HIGH);
     pinMode(LORA_ANTPWR, OUTPUT);
     digitalWrite(LORA_ANTPWR, LOW);
-    digitalWrite(LORA_RST, LOW);
-    delay(10);
-    digitalWrite(LORA_RST, HIGH);
-    delay(20);
 
 
 // 新逻辑
@@ -120,9 +147,41 @@ void SX126xIoReInit(void)
 	digitalWrite(LORA_ANTPWR, LOW);
 }
 
+static void IRAM_ATTR SX126xOnDio1Irq(void)
+{
+	// Same time base as the timers ( RtcGetTimeUs )
+	Dio1IrqTimeUs = (uint64_t)esp_timer_get_time();
+	Dio1Irq();
+}
+
 void SX126xIoIrqInit(DioIrqHandler dioIrq)
 {
-	attachInterrupt(LORA_DIO1, dioIrq, RISING);
+	Dio1Irq = dioIrq;
+	attachInterrupt(LORA_DIO1, SX126xOnDio1Irq, RISING);
+}
+
+void SX126xIoDio1WakeUp(bool enable)
+{
+	gpio_num_t dio1 = gpio_num_t(LORA_DIO1);
+
+	if (enable)
+	{
+		// 唤醒需要电平触发，睡眠期间关闭DIO1中断，避免电平中断反复触发
+		gpio_intr_disable(dio1);
+		gpio_wakeup_enable(dio1, GPIO_INTR_HIGH_LEVEL);
+		esp_sleep_enable_gpio_wakeup();
+		return;
+	}
+	gpio_wakeup_disable(dio1);
+	esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+	gpio_set_intr_type(dio1, GPIO_INTR_POSEDGE);
+	gpio_intr_enable(dio1);
+	// 睡眠期间的上升沿没有进入中断，补交给radio驱动。重复的中断由驱动计为空事件
+	if ((digitalRead(LORA_DIO1) == HIGH) && (Dio1Irq != NULL))
+	{
+		Dio1IrqTimeUs = (uint64_t)esp_timer_get_time() - (uint64_t)RtcGetMcuWakeUpTime();
+		Dio1Irq();
+	}
 }
 
 void SX126xIoDeInit(void)
@@ -137,114 +196,230 @@ void SX126xIoDeInit(void)
 
 void SX126xReset(void)
 {
+	SX126xRadioLock();
 	pinMode(LORA_RST, OUTPUT);
 	digitalWrite(LORA_RST, LOW);
 	delay(10);
 	digitalWrite(LORA_RST, HIGH);
 	delay(20);
 	dio3IsOutput = false;
+	SX126xRadioUnlock();
+}
+
+void SX126xRadioLock(void)
+{
+	if (RadioLock != NULL)
+	{
+		xSemaphoreTakeRecursive(RadioLock, portMAX_DELAY);
+	}
+}
+
+void SX126xRadioUnlock(void)
+{
+	if (RadioLock != NULL)
+	{
+		xSemaphoreGiveRecursive(RadioLock);
+	}
+}
+
+/**@brief Accounts a BUSY wait in the histogram
+ */
+static void SX126xBusyStatsUpdate(uint32_t elapsed)
+{
+	uint8_t bucket = 0;
+
+	while ((bucket < (SX126X_BUSY_HISTOGRAM_SIZE - 1)) && (elapsed >= (4UL << (2 * bucket))))
+	{
+		bucket++;
+	}
+	BusyStats.Histogram[bucket]++;
+	if (elapsed > BusyStats.MaxUs)
+	{
+		BusyStats.MaxUs = elapsed;
+	}
 }
 
 void SX126xWaitOnBusy(void)
 {
-	int timeout = 1000;
+	uint32_t start = micros();
+	uint32_t elapsed = 0;
+
 	while (digitalRead(LORA_BUSY) == HIGH)
 	{
-		delay(1);
-		timeout -= 1;
-		//Serial.printf("1");
-		if (timeout < 0)
+		elapsed = micros() - start;
+		if (elapsed >= SX126X_BUSY_TIMEOUT_US)
 		{
-			/// \todo This error should be reported to the main app
-			//LOG_LIB("LORA", "[SX126xWaitOnBusy] Timeout waiting for BUSY low");
+			// Reported to the radio driver, which fails the ongoing operation.
+			// RadioBgIrqProcess runs in the radio service task when it runs
+			BusyStats.Timeouts++;
+			BusyTimeoutCount++;
+			// The command may not have reached the radio
+			SX126xShadowInvalidate();
+			if (loraRadioSem != NULL)
+			{
+				xSemaphoreGive(loraRadioSem);
+			}
+			else if (loraIntSem != NULL)
+			{
+				xSemaphoreGive(loraIntSem);
+			}
+			SX126xBusyStatsUpdate(elapsed);
 			return;
 		}
+		// Spin for short waits, long ones (wake up, calibration) yield the CPU
+		if ((elapsed >= SX126X_BUSY_SPIN_US) && xPortCanYield())
+		{
+			vTaskDelay(1);
+		}
 	}
+	SX126xBusyStatsUpdate(micros() - start);
+}
+
+uint32_t SX126xGetBusyTimeoutCount(void)
+{
+	uint32_t count;
+
+	BoardDisableIrq();
+	count = BusyTimeoutCount;
+	BoardEnableIrq();
+	return count;
+}
+
+void SX126xGetBusyStats(SX126xBusyStats_t *stats)
+{
+	BoardDisableIrq();
+	*stats = BusyStats;
+	BoardEnableIrq();
+}
+
+void SX126xResetBusyStats(void)
+{
+	BoardDisableIrq();
+	memset(&BusyStats, 0, sizeof(BusyStats));
+	BoardEnableIrq();
 }
 
 void SX126xWakeup(void)
 {
+	uint8_t cmd[2] = {RADIO_GET_STATUS, 0x00};
+
+	SX126xRadioLock();
 	dio3IsOutput = false;
 	BoardDisableIrq();
 
 	digitalWrite(LORA_SS, LOW);
 
 	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer(RADIO_GET_STATUS);
-	SPI_LORA.transfer(0x00);
+	SPI_LORA.writeBytes(cmd, 2);
 	SPI_LORA.endTransaction();
 	digitalWrite(LORA_SS, HIGH);
 
-	// Wait for chip to be ready.
-	SX126xWaitOnBusy();
-
 	BoardEnableIrq();
+
+	// Wait for chip to be ready, outside of the critical section as it can
+	// take a few ms
+	SX126xWaitOnBusy();
+	SX126xRadioUnlock();
 }
 
-void SX126xWriteCommand(RadioCommands_t command, uint8_t *buffer, uint16_t size)
+/**@brief Runs one SPI command with a single CS assertion
+ *
+ * \param  header      Opcode, address and NOP bytes sent before the data
+ * \param  headerSize  Size of the header
+ * \param  buffer      Data to write, or buffer receiving the data read
+ * \param  size        Size of the data
+ * \param  read        true to read the data from the radio
+ */
+static void SX126xSpiCommand(const uint8_t *header, uint8_t headerSize, uint8_t *buffer, uint16_t size, bool read)
 {
-	//printf("%s()\r\n",__FUNCTION__);
-	SX126xCheckDeviceReady();
-
 	digitalWrite(LORA_SS, LOW);
 
 	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer((uint8_t)command);
-
-	for (uint16_t i = 0; i < size; i++)
+	SPI_LORA.writeBytes(header, headerSize);
+	if (size > 0)
 	{
-		SPI_LORA.transfer(buffer[i]);
+		if (read)
+		{
+			// The radio expects NOPs while it shifts the data out
+			memset(buffer, 0x00, size);
+			SPI_LORA.transferBytes(buffer, buffer, size);
+		}
+		else
+		{
+			SPI_LORA.writeBytes(buffer, size);
+		}
 	}
-
 	SPI_LORA.endTransaction();
+
 	digitalWrite(LORA_SS, HIGH);
+}
 
-	if (command != RADIO_SET_SLEEP)
+/**@brief Accounts an SPI access in the statistics
+ */
+static void SX126xSpiStatsUpdate(SX126xSpiCall_t call, uint16_t bytes, uint32_t startUs)
+{
+	uint32_t elapsed = micros() - startUs;
+	SX126xSpiCallStats_t *stats = &SpiStats.Call[call];
+
+	stats->Calls++;
+	stats->Bytes += bytes;
+	stats->TotalUs += elapsed;
+	if (elapsed > stats->MaxUs)
 	{
-		SX126xWaitOnBusy();
+		stats->MaxUs = elapsed;
 	}
 }
 
-void SX126xReadCommand(RadioCommands_t command, uint8_t *buffer, uint16_t size)
+void SX126xWriteCommand(RadioCommands_t command, uint8_t *buffer, uint16_t size)
 {
+	uint32_t start;
+	uint8_t header[1] = {(uint8_t)command};
+
+	SX126xRadioLock();
+	// The SPI time, not the wait for another task's access
+	start = micros();
 	SX126xCheckDeviceReady();
 
-	digitalWrite(LORA_SS, LOW);
+	SX126xSpiCommand(header, 1, buffer, size, false);
 
-	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer((uint8_t)command);
-	SPI_LORA.transfer(0x00);
-	for (uint16_t i = 0; i < size; i++)
+	if (command != RADIO_SET_SLEEP)
 	{
-		buffer[i] = SPI_LORA.transfer(0x00);
+		SX126xWaitOnBusy();
 	}
+	SX126xSpiStatsUpdate(SX126X_SPI_WRITE_COMMAND, 1 + size, start);
+	SX126xRadioUnlock();
+}
 
-	SPI_LORA.endTransaction();
-	digitalWrite(LORA_SS, HIGH);
+void SX126xReadCommand(RadioCommands_t command, uint8_t *buffer, uint16_t size)
+{
+	uint32_t start;
+	uint8_t header[2] = {(uint8_t)command, 0x00};
+
+	SX126xRadioLock();
+	start = micros();
+	SX126xCheckDeviceReady();
+
+	SX126xSpiCommand(header, 2, buffer, size, true);
 
 	SX126xWaitOnBusy();
+	SX126xSpiStatsUpdate(SX126X_SPI_READ_COMMAND, 2 + size, start);
+	SX126xRadioUnlock();
 }
 
 void SX126xWriteRegisters(uint16_t address, uint8_t *buffer, uint16_t size)
 {
-	SX126xCheckDeviceReady();
+	uint32_t start;
+	uint8_t header[3] = {RADIO_WRITE_REGISTER, (uint8_t)((address & 0xFF00) >> 8), (uint8_t)(address & 0x00FF)};
 
-	digitalWrite(LORA_SS, LOW);
-
-	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-	SPI_LORA.transfer((address & 0xFF00) >> 8);
-	SPI_LORA.transfer(address & 0x00FF);
-
-	for (uint16_t i = 0; i < size; i++)
-	{
-		SPI_LORA.transfer(buffer[i]);
-	}
+	SX126xRadioLock();
+	start = micros();
+	SX126xCheckDeviceReady();
 
-	SPI_LORA.endTransaction();
-	digitalWrite(LORA_SS, HIGH);
+	SX126xSpiCommand(header, 3, buffer, size, false);
 
 	SX126xWaitOnBusy();
+	SX126xSpiStatsUpdate(SX126X_SPI_WRITE_REGISTERS, 3 + size, start);
+	SX126xRadioUnlock();
 }
 
 void SX126xWriteRegister(uint16_t address, uint8_t value)
@@ -254,23 +429,18 @@ void SX126xWriteRegister(uint16_t address, uint8_t value)
 
 void SX126xReadRegisters(uint16_t address, uint8_t *buffer, uint16_t size)
 {
-	SX126xCheckDeviceReady();
+	uint32_t start;
+	uint8_t header[4] = {RADIO_READ_REGISTER, (uint8_t)((address & 0xFF00) >> 8), (uint8_t)(address & 0x00FF), 0x00};
 
-	digitalWrite(LORA_SS, LOW);
+	SX126xRadioLock();
+	start = micros();
+	SX126xCheckDeviceReady();
 
-	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer(RADIO_READ_REGISTER);
-	SPI_LORA.transfer((address & 0xFF00) >> 8);
-	SPI_LORA.transfer(address & 0x00FF);
-	SPI_LORA.transfer(0x00);
-	for (uint16_t i = 0; i < size; i++)
-	{
-		buffer[i] = SPI_LORA.transfer(0x00);
-	}
-	SPI_LORA.endTransaction();
-	digitalWrite(LORA_SS, HIGH);
+	SX126xSpiCommand(header, 4, buffer, size, true);
 
 	SX126xWaitOnBusy();
+	SX126xSpiStatsUpdate(SX126X_SPI_READ_REGISTERS, 4 + size, start);
+	SX126xRadioUnlock();
 }
 
 uint8_t SX126xReadRegister(uint16_t address)
@@ -282,45 +452,97 @@ uint8_t SX126xReadRegister(uint16_t address)
 
 void SX126xWriteBuffer(uint8_t offset, uint8_t *buffer, uint8_t size)
 {
+	uint32_t start;
+	uint8_t header[2] = {RADIO_WRITE_BUFFER, offset};
+
+	SX126xRadioLock();
+	start = micros();
 	SX126xCheckDeviceReady();
 
-	digitalWrite(LORA_SS, LOW);
-
-	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer(RADIO_WRITE_BUFFER);
-	SPI_LORA.transfer(offset);
-	for (uint16_t i = 0; i < size; i++)
-	{
-		SPI_LORA.transfer(buffer[i]);
-	}
-	SPI_LORA.endTransaction();
-	digitalWrite(LORA_SS, HIGH);
+	SX126xSpiCommand(header, 2, buffer, size, false);
 
 	SX126xWaitOnBusy();
+	SX126xSpiStatsUpdate(SX126X_SPI_WRITE_BUFFER, 2 + size, start);
+	SX126xRadioUnlock();
 }
 
 void SX126xReadBuffer(uint8_t offset, uint8_t *buffer, uint8_t size)
 {
+	uint32_t start;
+	uint8_t header[3] = {RADIO_READ_BUFFER, offset, 0x00};
+
+	SX126xRadioLock();
+	start = micros();
 	SX126xCheckDeviceReady();
 
-	digitalWrite(LORA_SS, LOW);
+	SX126xSpiCommand(header, 3, buffer, size, true);
 
-	SPI_LORA.beginTransaction(spiSettings);
-	SPI_LORA.transfer(RADIO_READ_BUFFER);
-	SPI_LORA.transfer(offset);
-	SPI_LORA.transfer(0x00);
-	for (uint16_t i = 0; i < size; i++)
+	SX126xWaitOnBusy();
+	SX126xSpiStatsUpdate(SX126X_SPI_READ_BUFFER, 3 + size, start);
+	SX126xRadioUnlock();
+}
+
+void SX126xSetSpiClock(uint32_t frequency)
+{
+	if (frequency > SX126X_SPI_CLOCK_MAX_HZ)
 	{
-		buffer[i] = SPI_LORA.transfer(0x00);
+		frequency = SX126X_SPI_CLOCK_MAX_HZ;
 	}
-	SPI_LORA.endTransaction();
-	digitalWrite(LORA_SS, HIGH);
+	spiClock = frequency;
+	spiSettings = SPISettings(frequency, MSBFIRST, SPI_MODE0);
+}
 
-	SX126xWaitOnBusy();
+uint32_t SX126xGetSpiClock(void)
+{
+	return spiClock;
+}
+
+void SX126xGetSpiStats(SX126xSpiStats_t *stats)
+{
+	BoardDisableIrq();
+	*stats = SpiStats;
+	BoardEnableIrq();
+}
+
+void SX126xResetSpiStats(void)
+{
+	BoardDisableIrq();
+	memset(&SpiStats, 0, sizeof(SpiStats));
+	BoardEnableIrq();
+}
+
+void SX126xRxDoneLatencyUpdate(void)
+{
+	uint32_t latency = (uint32_t)((uint64_t)esp_timer_get_time() - SX126xGetDio1IrqTimeUs());
+
+	SpiStats.RxDone++;
+	SpiStats.RxDoneLatencyUs = latency;
+	SpiStats.RxDoneLatencyTotalUs += latency;
+	if (latency > SpiStats.RxDoneLatencyMaxUs)
+	{
+		SpiStats.RxDoneLatencyMaxUs = latency;
+	}
+}
+
+uint64_t SX126xGetDio1IrqTimeUs(void)
+{
+	uint64_t time;
+
+	// 64 bits are not read atomically
+	BoardDisableIrq();
+	time = Dio1IrqTimeUs;
+	BoardEnableIrq();
+	return time;
+}
+
+uint32_t SX126xGetDio1PinState(void)
+{
+	return (digitalRead(LORA_DIO1) == HIGH) ? 1 : 0;
 }
 
 void SX126xSetRfTxPower(int8_t power)
 {
+	LoRaEnergySetTxPower(power);
 	SX126xSetTxParams(power, RADIO_RAMP_40_US);
 }
 
@@ -333,171 +555,26 @@ uint8_t SX126xGetPaSelect(uint32_t channel)
 
 static void SX126xDio3Control(bool state)
 {
-	uint8_t reg_0x0580;
-	uint8_t reg_0x0583;
-	uint8_t reg_0x0584;
-	uint8_t reg_0x0585;
-	uint8_t reg_0x0920;
+	SX126xRegBatch_t batch;
 
+	SX126xRadioLock();
+	SX126xRegBatchInit(&batch);
 	if (!dio3IsOutput)
 	{
-		// Configure DIO3 as output
-
-		// Read 0x0580
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0580 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0580 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0580 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Read 0x0583
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0583 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0583 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0583 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Read 0x0584
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0584 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0584 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0584 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Read 0x0585
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0585 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0585 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0585 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Write 0x0580
-		// SX126xWriteRegister(0x0580, reg_0x0580 | 0x08);
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0580 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0580 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0580 | 0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Write 0x0583
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0583 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0583 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0583 & ~0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Write 0x0584
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0584 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0584 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0584 & ~0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Write 0x0585
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0585 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0585 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0585 & ~0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		// Write 0x0920
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0920 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0920 & 0x00FF);
-		SPI_LORA.transfer(0x06);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
+		// Configure DIO3 as output, 0x0583 to 0x0585 are written at once
+		SX126xRegBatchUpdate(&batch, 0x0580, 0x08, 0x08);
+		SX126xRegBatchUpdate(&batch, 0x0583, 0x08, 0x00);
+		SX126xRegBatchUpdate(&batch, 0x0584, 0x08, 0x00);
+		SX126xRegBatchUpdate(&batch, 0x0585, 0x08, 0x00);
+		SX126xRegBatchWrite(&batch, 0x0920, 0x06);
 
 		dio3IsOutput = true;
 	}
 
-	if (state)
-	{
-		// Set DIO3 High
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0920 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0920 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0920 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0920 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0920 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0920 | 0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-	}
-	else
-	{
-		// Set DIO3 Low
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_READ_REGISTER);
-		SPI_LORA.transfer((0x0920 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0920 & 0x00FF);
-		SPI_LORA.transfer(0x00);
-		reg_0x0920 = SPI_LORA.transfer(0x00);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-
-		SX126xWaitOnBusy();
-		digitalWrite(LORA_SS, LOW);
-		SPI_LORA.beginTransaction(spiSettings);
-		SPI_LORA.transfer(RADIO_WRITE_REGISTER);
-		SPI_LORA.transfer((0x0920 & 0xFF00) >> 8);
-		SPI_LORA.transfer(0x0920 & 0x00FF);
-		SPI_LORA.transfer(reg_0x0920 & ~0x08);
-		SPI_LORA.endTransaction();
-		digitalWrite(LORA_SS, HIGH);
-	}
+	// Set DIO3 High or Low
+	SX126xRegBatchUpdate(&batch, 0x0920, 0x08, state ? 0x08 : 0x00);
+	SX126xRegBatchCommit(&batch);
+	SX126xRadioUnlock();
 }
 
 void SX126xAntSwOn(void)
@@ -563,6 +640,7 @@ RadioOperatingModes_t SX126xGetOperatingMode(void)
 void SX126xSetOperatingMode(RadioOperatingModes_t mode)
 {
 	OperatingMode = mode;
+	LoRaEnergySetRadioMode(mode);
 }
 
 uint32_t SX126xGetBoardTcxoWakeupTime( void )
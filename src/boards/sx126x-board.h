@@ -66,6 +66,75 @@ extern "C"
 #define LOG_LIB(...)
 #endif
 
+/**@brief SPI clock of the radio interface. The SX126x supports up to 16 MHz.
+ */
+#ifndef SX126X_SPI_CLOCK_HZ
+#define SX126X_SPI_CLOCK_HZ 8000000
+#endif
+#define SX126X_SPI_CLOCK_MAX_HZ 16000000
+
+/**@brief BUSY waits shorter than this spin on the pin, longer ones yield the CPU
+ */
+#ifndef SX126X_BUSY_SPIN_US
+#define SX126X_BUSY_SPIN_US 1000
+#endif
+
+/**@brief Longest BUSY wait before the radio is reported as failing
+ */
+#ifndef SX126X_BUSY_TIMEOUT_US
+#define SX126X_BUSY_TIMEOUT_US 100000
+#endif
+
+/**@brief Number of buckets of the BUSY wait histogram
+ */
+#define SX126X_BUSY_HISTOGRAM_SIZE 8
+
+/**@brief BUSY wait statistics
+ *
+ * \remark Histogram[i] counts the waits shorter than 4^(i+1) us, the last
+ *         bucket counts all the longer ones
+ */
+typedef struct
+{
+	uint32_t Histogram[SX126X_BUSY_HISTOGRAM_SIZE]; /**< Waits per duration bucket */
+	uint32_t Timeouts;                              /**< Waits which reached SX126X_BUSY_TIMEOUT_US */
+	uint32_t MaxUs;                                 /**< Longest wait */
+} SX126xBusyStats_t;
+
+/**@brief Radio accesses accounted in the SPI statistics
+ */
+typedef enum
+{
+	SX126X_SPI_WRITE_COMMAND = 0,
+	SX126X_SPI_READ_COMMAND,
+	SX126X_SPI_WRITE_REGISTERS,
+	SX126X_SPI_READ_REGISTERS,
+	SX126X_SPI_WRITE_BUFFER,
+	SX126X_SPI_READ_BUFFER,
+	SX126X_SPI_CALL_MAX
+} SX126xSpiCall_t;
+
+/**@brief Timing of one kind of radio access, BUSY waits included
+ */
+typedef struct
+{
+	uint32_t Calls;   /**< Number of calls */
+	uint32_t Bytes;   /**< Bytes clocked on the bus, opcode and address included */
+	uint32_t TotalUs; /**< Cumulated duration of the calls */
+	uint32_t MaxUs;   /**< Longest call */
+} SX126xSpiCallStats_t;
+
+/**@brief Radio interface statistics
+ */
+typedef struct
+{
+	SX126xSpiCallStats_t Call[SX126X_SPI_CALL_MAX]; /**< Per access kind timing */
+	uint32_t RxDone;                                /**< Number of RxDone latencies accounted */
+	uint32_t RxDoneLatencyUs;                       /**< Last DIO1 IRQ to application callback latency */
+	uint32_t RxDoneLatencyMaxUs;                    /**< Longest DIO1 IRQ to application callback latency */
+	uint32_t RxDoneLatencyTotalUs;                  /**< Cumulated DIO1 IRQ to application callback latency */
+} SX126xSpiStats_t;
+
 /**@brief Initializes the radio I/Os pins interface
  */
 void SX126xIOInit(void);
@@ -80,6 +149,16 @@ void SX126xIoReInit(void);
  */
 void SX126xIoIrqInit(DioIrqHandler dioIrq);
 
+/**@brief Arms DIO1 as a light sleep wake up source ( RtcLightSleep )
+ *
+ * \remark Once disarmed, a DIO1 IRQ raised during the sleep is handed to the
+ *         radio driver as the ISR does, its time is the wake up time less the
+ *         MCU wake up time
+ *
+ * \param  enable true before the sleep, false after it
+ */
+void SX126xIoDio1WakeUp(bool enable);
+
 /**@brief De-initializes the radio I/Os pins interface.
  *
  * \remark Useful when going in MCU low power modes
@@ -90,10 +169,44 @@ void SX126xIoDeInit(void);
  */
 void SX126xReset(void);
 
+/**@brief Takes the radio lock of the tasks sharing the radio
+ *
+ * \remark Recursive. Held by every SPI access and by the IRQ processing, a
+ *         task holds it across a sequence of commands which must not be
+ *         interleaved with another task's ones. Created by SX126xIOInit,
+ *         does nothing before.
+ */
+void SX126xRadioLock(void);
+
+/**@brief Releases the radio lock taken by SX126xRadioLock
+ */
+void SX126xRadioUnlock(void);
+
 /**@brief Blocking loop to wait while the Busy pin in high
+ *
+ * \remark Gives up after SX126X_BUSY_TIMEOUT_US, see SX126xGetBusyTimeoutCount
  */
 void SX126xWaitOnBusy(void);
 
+/**@brief Gets the number of BUSY waits which timed out since the start-up
+ *
+ * \remark Never reset, the radio driver reports the timeouts counted since
+ *         its last report
+ *
+ * \retval count BUSY timeouts
+ */
+uint32_t SX126xGetBusyTimeoutCount(void);
+
+/**@brief Gets the BUSY wait statistics
+ *
+ * \param  stats Copy of the statistics
+ */
+void SX126xGetBusyStats(SX126xBusyStats_t *stats);
+
+/**@brief Resets the BUSY wait statistics
+ */
+void SX126xResetBusyStats(void);
+
 /**@brief Wakes up the radio
  */
 void SX126xWakeup(void);
@@ -183,6 +296,46 @@ void SX126xGetStats(uint16_t *nb_pkt_received, uint16_t *nb_pkt_crc_error, uint1
  */
 void SX126xResetStats(void);
 
+/**@brief Sets the SPI clock of the radio interface
+ *
+ * \param  frequency SPI clock in Hz, limited to SX126X_SPI_CLOCK_MAX_HZ
+ */
+void SX126xSetSpiClock(uint32_t frequency);
+
+/**@brief Gets the SPI clock of the radio interface
+ *
+ * \retval frequency SPI clock in Hz
+ */
+uint32_t SX126xGetSpiClock(void);
+
+/**@brief Gets the radio interface statistics
+ *
+ * \param  stats Copy of the statistics
+ */
+void SX126xGetSpiStats(SX126xSpiStats_t *stats);
+
+/**@brief Resets the radio interface statistics
+ */
+void SX126xResetSpiStats(void);
+
+/**@brief Accounts the latency between the last DIO1 IRQ and now
+ *
+ * \remark Called right before the received data is handed to the application
+ */
+void SX126xRxDoneLatencyUpdate(void);
+
+/**@brief Gets the time of the last DIO1 IRQ
+ *
+ * \retval time Time captured in the DIO1 ISR, RtcGetTimeUs time base [us]
+ */
+uint64_t SX126xGetDio1IrqTimeUs(void);
+
+/**@brief Gets the level of DIO1
+ *
+ * \retval state 1 while an IRQ routed to DIO1 is pending
+ */
+uint32_t SX126xGetDio1PinState(void);
+
 RadioOperatingModes_t SX126xGetOperatingMode(void);
 
 void SX126xSetOperatingMode(RadioOperatingModes_t mode);
@@ -44,7 +44,9 @@
 #include "LoRaMacCommands.h"
 #include "LoRaMacAdr.h"
 #include "LoRaMacSerializer.h"
+#include "LoRaMacRxCalibration.h"
 #include "radio/radio.h"
+#include "boards/rtc-board.h"
 
 #include "LoRaMac.h"
 #include <Arduino.h>
@@ -81,6 +83,17 @@
  */
 #define BACKOFF_DC_24_HOURS                         10000
 
+/*!
+ * All the NVM groups
+ */
+#define LORAMAC_NVM_GROUPS_ALL                      ( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 | \
+                                                      LORAMAC_NVM_NOTIFY_FLAG_CLASS_B )
+
 /*!
  * LoRaMac internal states
  */
@@ -127,10 +140,6 @@ typedef struct sLoRaMacCtx
     * Size of buffer containing the application data.
     */
     uint8_t AppDataSize;
-    /*
-    * Buffer containing the upper layer data.
-    */
-    uint8_t RxPayload[LORAMAC_PHY_MAXPAYLOAD];
     SysTime_t LastTxSysTime;
     /*
     * LoRaMac internal state
@@ -165,6 +174,11 @@ typedef struct sLoRaMacCtx
     uint32_t RxWindow1Delay;
     uint32_t RxWindow2Delay;
     /*
+    * Time of the TX done IRQ the reception windows timers are started from,
+    * the downlinks are expected ReceiveDelayX or JoinAcceptDelayX after it [us]
+    */
+    uint64_t RxWindowsReferenceUs;
+    /*
     * LoRaMac Rx windows configuration
     */
     RxConfigParams_t RxWindow1Config;
@@ -248,6 +262,11 @@ typedef struct sLoRaMacCtx
      * Buffer containing the MAC layer commands
      */
     uint8_t MacCommandsBuffer[LORA_MAC_COMMAND_MAX_LENGTH];
+    /*
+     * NVM groups written since the last CRC check, LORAMAC_NVM_NOTIFY_FLAG_XXX.
+     * Set by LoRaMacNvmSetDirty.
+     */
+    uint16_t NvmDirtyFlags;
 }LoRaMacCtx_t;
 
 /*
@@ -257,6 +276,37 @@ RTC_DATA_ATTR static LoRaMacCtx_t MacCtx;
 
 RTC_DATA_ATTR static LoRaMacNvmData_t Nvm;
 
+/*!
+ * Resume seal magic, "LMRS"
+ */
+#define LORAMAC_RESUME_MAGIC                        0x4C4D5253
+
+/*!
+ * Resume seal, written by LoRaMacSuspend before a deep sleep and checked by
+ * LoRaMacResume on wake up
+ */
+typedef struct sLoRaMacResumeSeal
+{
+    /*
+     * LORAMAC_RESUME_MAGIC when sealed, cleared by LoRaMacResume
+     */
+    uint32_t Magic;
+    /*
+     * Region of the sealed session
+     */
+    uint32_t Region;
+    /*
+     * Random seed of the next wake up, instead of a radio random number
+     */
+    uint32_t Seed;
+    /*
+     * CRC of the seal and of the NVM groups CRCs
+     */
+    uint32_t Crc32;
+}LoRaMacResumeSeal_t;
+
+RTC_DATA_ATTR static LoRaMacResumeSeal_t ResumeSeal;
+
 /*!
  * Defines the LoRaMac radio events status
  */
@@ -273,10 +323,48 @@ typedef union uLoRaMacRadioEvents
     }Events;
 }LoRaMacRadioEvents_t;
 
+#ifndef LORAMAC_RADIO_EVENT_QUEUE_SIZE
+/*!
+ * Radio events the MAC keeps until LoRaMacProcess handles them. Holds every
+ * frame of the radio pool and the TX / timeout events around them.
+ */
+#define LORAMAC_RADIO_EVENT_QUEUE_SIZE              ( RADIO_RX_FRAME_POOL_SIZE + 4 )
+#endif
+
+/*!
+ * Radio event, Type has a single event set
+ */
+typedef struct sLoRaMacRadioEvent
+{
+    LoRaMacRadioEvents_t Type;
+    /*!
+     * Time of the radio IRQ, RtcGetTimeUs time base [us]
+     */
+    uint64_t TimestampUs;
+    /*!
+     * RX done only, radio received frame
+     */
+    uint8_t *Payload;
+    uint16_t Size;
+    int16_t Rssi;
+    int8_t Snr;
+}LoRaMacRadioEvent_t;
+
 /*!
- * LoRaMac radio events status
+ * Radio events queue, from the radio callbacks to LoRaMacProcess.
+ *
+ * \remark The radio callbacks may run in the radio service task ( lora-task.h )
+ *         while LoRaMacProcess runs in the MAC task. Head and Tail are written
+ *         under CRITICAL_SECTION.
  */
-LoRaMacRadioEvents_t LoRaMacRadioEvents = { .Value = 0 };
+typedef struct sLoRaMacRadioEventQueue
+{
+    LoRaMacRadioEvent_t Events[LORAMAC_RADIO_EVENT_QUEUE_SIZE];
+    uint32_t Head;
+    uint32_t Tail;
+}LoRaMacRadioEventQueue_t;
+
+static LoRaMacRadioEventQueue_t LoRaMacRadioEvents;
 
 uint8_t rxtimeoutflag = 0;      // 接收超时标志
 
@@ -644,14 +732,24 @@ static void LoRaMacHandleNvm( LoRaMacNvmData_t* nvmData );
 
 /*!
  * Structure used to store the radio Tx event data
+ *
+ * \remark Filled from the radio events queue by LoRaMacHandleIrqEvents.
  */
 struct
 {
     TimerTime_t CurTime;
+    /*!
+     * Time of the TX done IRQ, RtcGetTimeUs time base [us]
+     */
+    uint64_t TimestampUs;
 }TxDoneParams;
 
 /*!
  * Structure used to store the radio Rx event data
+ *
+ * \remark Payload references the radio received frame. The frame is processed
+ *         and decrypted in place, then released once the indications are
+ *         delivered, see LoRaMacProcess.
  */
 struct
 {
@@ -662,12 +760,30 @@ struct
     int8_t Snr;
 }RxDoneParams;
 
-static void OnRadioTxDone( void )
+/*!
+ * \brief Queues a radio event and notifies the MAC
+ *
+ * \remark A received frame which does not fit is given back to the radio.
+ *
+ * \param [IN] event Radio event
+ */
+static void LoRaMacRadioEventPush( LoRaMacRadioEvent_t *event )
 {
-    TxDoneParams.CurTime = TimerGetCurrentTime( );
-    MacCtx.LastTxSysTime = SysTimeGet( );
+    bool queued = false;
 
-    LoRaMacRadioEvents.Events.TxDone = 1;
+    CRITICAL_SECTION_BEGIN( );
+    if( ( LoRaMacRadioEvents.Head - LoRaMacRadioEvents.Tail ) < LORAMAC_RADIO_EVENT_QUEUE_SIZE )
+    {
+        LoRaMacRadioEvents.Events[LoRaMacRadioEvents.Head % LORAMAC_RADIO_EVENT_QUEUE_SIZE] = *event;
+        LoRaMacRadioEvents.Head++;
+        queued = true;
+    }
+    CRITICAL_SECTION_END( );
+
+    if( queued == false )
+    {
+        Radio.RxFrameRelease( event->Payload );
+    }
 
     if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
     {
@@ -675,51 +791,73 @@ static void OnRadioTxDone( void )
     }
 }
 
-static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+/*!
+ * \brief Takes the oldest radio event queued
+ *
+ * \param [OUT] event Radio event
+ * \retval pending true if an event was queued
+ */
+static bool LoRaMacRadioEventPop( LoRaMacRadioEvent_t *event )
 {
-    RxDoneParams.LastRxDone = TimerGetCurrentTime( );
-    RxDoneParams.Payload = payload;
-    RxDoneParams.Size = size;
-    RxDoneParams.Rssi = rssi;
-    RxDoneParams.Snr = snr;
+    bool pending = false;
 
-    LoRaMacRadioEvents.Events.RxDone = 1;
-
-    if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
+    CRITICAL_SECTION_BEGIN( );
+    if( LoRaMacRadioEvents.Tail != LoRaMacRadioEvents.Head )
     {
-        MacCtx.MacCallbacks->MacProcessNotify( );
+        *event = LoRaMacRadioEvents.Events[LoRaMacRadioEvents.Tail % LORAMAC_RADIO_EVENT_QUEUE_SIZE];
+        LoRaMacRadioEvents.Tail++;
+        pending = true;
     }
+    CRITICAL_SECTION_END( );
+    return pending;
+}
+
+static bool LoRaMacRadioEventPending( void )
+{
+    bool pending;
+
+    CRITICAL_SECTION_BEGIN( );
+    pending = LoRaMacRadioEvents.Tail != LoRaMacRadioEvents.Head;
+    CRITICAL_SECTION_END( );
+    return pending;
+}
+
+static void OnRadioTxDone( void )
+{
+    // The end of the uplink, not the time the event is processed
+    LoRaMacRadioEvent_t event = { .Type.Events.TxDone = 1, .TimestampUs = Radio.GetEventTime( ) };
+
+    LoRaMacRadioEventPush( &event );
+}
+
+static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+    LoRaMacRadioEvent_t event = { .Type.Events.RxDone = 1, .TimestampUs = Radio.GetEventTime( ),
+                                  .Payload = payload, .Size = size, .Rssi = rssi, .Snr = snr };
+
+    LoRaMacRadioEventPush( &event );
 }
 
 static void OnRadioTxTimeout( void )
 {
     //printf("\n\n------<LM> OnRadioTxTimeout------\n\n");
-    LoRaMacRadioEvents.Events.TxTimeout = 1;
+    LoRaMacRadioEvent_t event = { .Type.Events.TxTimeout = 1 };
 
-    if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
-    {
-        MacCtx.MacCallbacks->MacProcessNotify( );
-    }
+    LoRaMacRadioEventPush( &event );
 }
 
 static void OnRadioRxError( void )
 {
-    LoRaMacRadioEvents.Events.RxError = 1;
+    LoRaMacRadioEvent_t event = { .Type.Events.RxError = 1 };
 
-    if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
-    {
-        MacCtx.MacCallbacks->MacProcessNotify( );
-    }
+    LoRaMacRadioEventPush( &event );
 }
 
 static void OnRadioRxTimeout( void )
 {
-    LoRaMacRadioEvents.Events.RxTimeout = 1;
+    LoRaMacRadioEvent_t event = { .Type.Events.RxTimeout = 1 };
 
-    if( ( MacCtx.MacCallbacks != NULL ) && ( MacCtx.MacCallbacks->MacProcessNotify != NULL ) )
-    {
-        MacCtx.MacCallbacks->MacProcessNotify( );
-    }
+    LoRaMacRadioEventPush( &event );
 }
 
 static void UpdateRxSlotIdleState( void )
@@ -746,10 +884,14 @@ static void ProcessRadioTxDone( void )      // 发送完成中断处理程序
     }
 
     // Setup timers     打开两个接收窗口RX1和RX2
+    // The delays are counted from the TX done IRQ, the time the event waited
+    // for the LoRa task is not taken out of the windows
+    MacCtx.RxWindowsReferenceUs = TxDoneParams.TimestampUs;
+    MacCtx.LastTxSysTime = SysTimeGetAt( TxDoneParams.TimestampUs );
     TimerSetValue( &MacCtx.RxWindowTimer1, MacCtx.RxWindow1Delay);
-    TimerStart( &MacCtx.RxWindowTimer1 );
+    TimerStartAt( &MacCtx.RxWindowTimer1, MacCtx.RxWindowsReferenceUs );
     TimerSetValue( &MacCtx.RxWindowTimer2, MacCtx.RxWindow2Delay);
-    TimerStart( &MacCtx.RxWindowTimer2 );
+    TimerStartAt( &MacCtx.RxWindowTimer2, MacCtx.RxWindowsReferenceUs );
 
     // printf("\n------<LM> [ProcessRadioTxDone] Rx1time = %d, Rx2time = %d------\n",MacCtx.RxWindow1Delay,MacCtx.RxWindow2Delay);
 
@@ -758,11 +900,12 @@ static void ProcessRadioTxDone( void )      // 发送完成中断处理程序
         getPhy.Attribute = PHY_ACK_TIMEOUT;
         phyParam = RegionGetPhyParam( Nvm.MacGroup2.Region, &getPhy );
         TimerSetValue( &MacCtx.AckTimeoutTimer, MacCtx.RxWindow2Delay + phyParam.Value );
-        TimerStart( &MacCtx.AckTimeoutTimer );
+        TimerStartAt( &MacCtx.AckTimeoutTimer, MacCtx.RxWindowsReferenceUs );
     }
 
     // Update Aggregated last tx done time                  更新最新的Tx完成时间
     Nvm.MacGroup1.LastTxDoneTime = TxDoneParams.CurTime;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
 
     // Update last tx done time for the current channel     更新一些发送完成后的参数
     txDone.Channel = MacCtx.Channel;
@@ -783,6 +926,53 @@ static void ProcessRadioTxDone( void )      // 发送完成中断处理程序
     }
 }
 
+/*!
+ * \brief Measures the timing error of a downlink received in RX1 or RX2 for
+ *        the RX windows calibration
+ *
+ * \remark Called before a join accept updates the RX delays
+ */
+static void RxCalibrationSample( uint8_t* payload, uint16_t size )
+{
+    RadioRxFrame_t* frame = Radio.RxFrameGet( payload );
+    GetPhyParams_t getPhy;
+    uint32_t sf;
+    uint32_t bw;
+    uint32_t delay;
+    uint32_t timeOnAir;
+
+    if( ( frame == NULL ) ||
+        ( ( MacCtx.RxSlot != RX_SLOT_WIN_1 ) && ( MacCtx.RxSlot != RX_SLOT_WIN_2 ) ) )
+    {
+        return;
+    }
+    getPhy.Datarate = MacCtx.McpsIndication.RxDatarate;
+    getPhy.Attribute = PHY_SF_FROM_DR;
+    sf = RegionGetPhyParam( Nvm.MacGroup2.Region, &getPhy ).Value;
+    getPhy.Attribute = PHY_BW_FROM_DR;
+    bw = RegionGetPhyParam( Nvm.MacGroup2.Region, &getPhy ).Value;
+    if( sf > 12 )
+    {
+        // FSK
+        return;
+    }
+    if( Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE )
+    {
+        delay = ( MacCtx.RxSlot == RX_SLOT_WIN_1 ) ? Nvm.MacGroup2.MacParams.JoinAcceptDelay1 :
+                                                     Nvm.MacGroup2.MacParams.JoinAcceptDelay2;
+    }
+    else
+    {
+        delay = ( MacCtx.RxSlot == RX_SLOT_WIN_1 ) ? Nvm.MacGroup2.MacParams.ReceiveDelay1 :
+                                                     Nvm.MacGroup2.MacParams.ReceiveDelay2;
+    }
+    // Downlinks: 8 symbols preamble, explicit header, no payload CRC
+    timeOnAir = Radio.TimeOnAir( MODEM_LORA, bw, sf, 1, 8, false, size, false );
+
+    LoRaMacRxCalibrationAddSample( ( int32_t )( ( int64_t )( frame->TimestampUs - MacCtx.RxWindowsReferenceUs ) -
+                                                ( int64_t )( timeOnAir + delay ) * 1000 ) );
+}
+
 static void PrepareRxDoneAbort( void )
 {
     MacCtx.MacState |= LORAMAC_RX_ABORT;
@@ -893,7 +1083,10 @@ static void ProcessRadioRxDone( void )
 
             if( LORAMAC_CRYPTO_SUCCESS == macCryptoStatus )
             {
+                RxCalibrationSample( payload, size );
+
                 // Network ID
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
                 Nvm.MacGroup2.NetID = ( uint32_t ) macMsgJoinAccept.NetID[0];
                 Nvm.MacGroup2.NetID |= ( ( uint32_t ) macMsgJoinAccept.NetID[1] << 8 );
                 Nvm.MacGroup2.NetID |= ( ( uint32_t ) macMsgJoinAccept.NetID[2] << 16 );
@@ -960,8 +1153,9 @@ static void ProcessRadioRxDone( void )
             // printf("\n\n---------------ProcessRadioRxDone step4-------------\n\n");
             macMsgData.Buffer = payload;
             macMsgData.BufSize = size;
-            macMsgData.FRMPayload = MacCtx.RxPayload;
-            macMsgData.FRMPayloadSize = LORAMAC_PHY_MAXPAYLOAD;
+            // The frame payload is referenced and decrypted in the received frame
+            macMsgData.FRMPayload = NULL;
+            macMsgData.FRMPayloadSize = 0;
 
             if( LORAMAC_PARSER_SUCCESS != LoRaMacParserData( &macMsgData ) )
             {
@@ -1026,6 +1220,7 @@ static void ProcessRadioRxDone( void )
                     if( ( Nvm.MacGroup2.Version.Fields.Minor == 0 ) && ( macHdr.Bits.MType == FRAME_TYPE_DATA_CONFIRMED_DOWN ) && ( Nvm.MacGroup1.LastRxMic == macMsgData.MIC ) )
                     {
                         Nvm.MacGroup1.SrvAckRequested = true;
+                        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
                     }
                 }
                 else if( macCryptoStatus == LORAMAC_CRYPTO_FAIL_MAX_GAP_FCNT )
@@ -1072,6 +1267,10 @@ static void ProcessRadioRxDone( void )
             }
 // printf("\n\n---------------ProcessRadioRxDone step11-------------\n\n");
             // Frame is valid
+            if( multicast == 0 )
+            {
+                RxCalibrationSample( payload, size );
+            }
             MacCtx.McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
             MacCtx.McpsIndication.Multicast = multicast;
             MacCtx.McpsIndication.FramePending = macMsgData.FHDR.FCtrl.Bits.FPending;
@@ -1083,6 +1282,7 @@ static void ProcessRadioRxDone( void )
             MacCtx.McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
             MacCtx.McpsConfirm.AckReceived = macMsgData.FHDR.FCtrl.Bits.Ack;
 
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
             // Reset ADR ACK Counter only, when RX1 or RX2 slot
             if( ( MacCtx.McpsIndication.RxSlot == RX_SLOT_WIN_1 ) ||
                 ( MacCtx.McpsIndication.RxSlot == RX_SLOT_WIN_2 ) )
@@ -1186,11 +1386,9 @@ static void ProcessRadioRxDone( void )
 
             break;
         case FRAME_TYPE_PROPRIETARY:
-            memcpy1( MacCtx.RxPayload, &payload[pktHeaderLen], size - pktHeaderLen );
-
             MacCtx.McpsIndication.McpsIndication = MCPS_PROPRIETARY;
             MacCtx.McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-            MacCtx.McpsIndication.Buffer = MacCtx.RxPayload;
+            MacCtx.McpsIndication.Buffer = &payload[pktHeaderLen];
             MacCtx.McpsIndication.BufferSize = size - pktHeaderLen;
 // printf("\n\n---------------ProcessRadioRxDone step12 mod McpsInd = 1 -------------\n\n");
             MacCtx.MacFlags.Bits.McpsInd = 1;
@@ -1290,6 +1488,12 @@ static void HandleRadioRxErrorTimeout( LoRaMacEventInfoStatus_t rx1EventInfoStat
         }
         else
         {
+            if( ( MacCtx.RxSlot == RX_SLOT_WIN_2 ) &&
+                ( ( MacCtx.NodeAckRequested == true ) || ( LoRaMacConfirmQueueIsCmdActive( MLME_JOIN ) == true ) ) )
+            {
+                // The acknowledgement or the join accept did not come
+                LoRaMacRxCalibrationMiss( );
+            }
             if( MacCtx.NodeAckRequested == true )
             {
                 MacCtx.McpsConfirm.Status = rx2EventInfoStatus;
@@ -1327,12 +1531,28 @@ static void ProcessRadioRxTimeout( void )
 static void LoRaMacHandleIrqEvents( void )
 {
     //printf("\n------ LoRaMacHandleIrqEvents [START] ---- MacCtx.MacState = %d ------\n", GetMacState());
-    LoRaMacRadioEvents_t events;
+    LoRaMacRadioEvent_t event;
+    LoRaMacRadioEvents_t events = { .Value = 0 };
 
-    CRITICAL_SECTION_BEGIN( );
-    events = LoRaMacRadioEvents;
-    LoRaMacRadioEvents.Value = 0;
-    CRITICAL_SECTION_END( );
+    // One event a pass, the indications of a frame are delivered before the next one
+    if( LoRaMacRadioEventPop( &event ) == true )
+    {
+        events = event.Type;
+        if( events.Events.TxDone == 1 )
+        {
+            TxDoneParams.TimestampUs = event.TimestampUs;
+            TxDoneParams.CurTime = ( TimerTime_t )( event.TimestampUs / 1000 );
+        }
+        if( events.Events.RxDone == 1 )
+        {
+            // The frame moves to RxDoneParams, released by LoRaMacProcess
+            RxDoneParams.LastRxDone = ( TimerTime_t )( event.TimestampUs / 1000 );
+            RxDoneParams.Payload = event.Payload;
+            RxDoneParams.Size = event.Size;
+            RxDoneParams.Rssi = event.Rssi;
+            RxDoneParams.Snr = event.Snr;
+        }
+    }
 
     if( events.Value != 0 )
     {
@@ -1378,6 +1598,19 @@ bool LoRaMacIsBusy( void )
     return true;
 }
 
+bool LoRaMacIsUplinkRunning( void )
+{
+    // A delayed transmission waits for the duty cycle, not for the radio
+    return ( Nvm.MacGroup2.DeviceClass == CLASS_A ) &&
+           ( ( MacCtx.MacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING ) &&
+           ( ( MacCtx.MacState & LORAMAC_TX_DELAYED ) == 0 );
+}
+
+
+void LoRaMacNvmSetDirty( uint16_t notifyFlags )
+{
+    MacCtx.NvmDirtyFlags |= notifyFlags;
+}
 
 static void LoRaMacEnableRequests( LoRaMacRequestHandling_t requestState )
 {
@@ -1587,79 +1820,105 @@ static void LoRaMacHandleNvm( LoRaMacNvmData_t* nvmData )
 {
     uint32_t crc = 0;
     uint16_t notifyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
+    uint16_t dirtyFlags = MacCtx.NvmDirtyFlags;
 
     if( MacCtx.MacState != LORAMAC_IDLE )
     {
         return;
     }
+    MacCtx.NvmDirtyFlags = LORAMAC_NVM_NOTIFY_FLAG_NONE;
 
     // Crypto
-    crc = Crc32( ( uint8_t* ) &nvmData->Crypto, sizeof( nvmData->Crypto ) -
-                                                sizeof( nvmData->Crypto.Crc32 ) );
-    if( crc != nvmData->Crypto.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_CRYPTO ) != 0 )
     {
-        nvmData->Crypto.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_CRYPTO;
+        crc = Crc32( ( uint8_t* ) &nvmData->Crypto, sizeof( nvmData->Crypto ) -
+                                                    sizeof( nvmData->Crypto.Crc32 ) );
+        if( crc != nvmData->Crypto.Crc32 )
+        {
+            nvmData->Crypto.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_CRYPTO;
+        }
     }
 
     // MacGroup1
-    crc = Crc32( ( uint8_t* ) &nvmData->MacGroup1, sizeof( nvmData->MacGroup1 ) -
-                                                   sizeof( nvmData->MacGroup1.Crc32 ) );
-    if( crc != nvmData->MacGroup1.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 ) != 0 )
     {
-        nvmData->MacGroup1.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1;
+        crc = Crc32( ( uint8_t* ) &nvmData->MacGroup1, sizeof( nvmData->MacGroup1 ) -
+                                                       sizeof( nvmData->MacGroup1.Crc32 ) );
+        if( crc != nvmData->MacGroup1.Crc32 )
+        {
+            nvmData->MacGroup1.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1;
+        }
     }
 
     // MacGroup2
-    crc = Crc32( ( uint8_t* ) &nvmData->MacGroup2, sizeof( nvmData->MacGroup2 ) -
-                                                   sizeof( nvmData->MacGroup2.Crc32 ) );
-    if( crc != nvmData->MacGroup2.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 ) != 0 )
     {
-        nvmData->MacGroup2.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2;
+        crc = Crc32( ( uint8_t* ) &nvmData->MacGroup2, sizeof( nvmData->MacGroup2 ) -
+                                                       sizeof( nvmData->MacGroup2.Crc32 ) );
+        if( crc != nvmData->MacGroup2.Crc32 )
+        {
+            nvmData->MacGroup2.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2;
+        }
     }
 
     // Secure Element
-    crc = Crc32( ( uint8_t* ) &nvmData->SecureElement, sizeof( nvmData->SecureElement ) -
-                                                       sizeof( nvmData->SecureElement.Crc32 ) );
-    if( crc != nvmData->SecureElement.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT ) != 0 )
     {
-        nvmData->SecureElement.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT;
+        crc = Crc32( ( uint8_t* ) &nvmData->SecureElement, sizeof( nvmData->SecureElement ) -
+                                                           sizeof( nvmData->SecureElement.Crc32 ) );
+        if( crc != nvmData->SecureElement.Crc32 )
+        {
+            nvmData->SecureElement.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT;
+        }
     }
 
     // Region
-    crc = Crc32( ( uint8_t* ) &nvmData->RegionGroup1, sizeof( nvmData->RegionGroup1 ) -
-                                                sizeof( nvmData->RegionGroup1.Crc32 ) );
-    if( crc != nvmData->RegionGroup1.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 ) != 0 )
     {
-        nvmData->RegionGroup1.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1;
+        crc = Crc32( ( uint8_t* ) &nvmData->RegionGroup1, sizeof( nvmData->RegionGroup1 ) -
+                                                          sizeof( nvmData->RegionGroup1.Crc32 ) );
+        if( crc != nvmData->RegionGroup1.Crc32 )
+        {
+            nvmData->RegionGroup1.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1;
+        }
     }
 
-    crc = Crc32( ( uint8_t* ) &nvmData->RegionGroup2, sizeof( nvmData->RegionGroup2 ) -
-                                                sizeof( nvmData->RegionGroup2.Crc32 ) );
-    if( crc != nvmData->RegionGroup2.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 ) != 0 )
     {
-        nvmData->RegionGroup2.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2;
+        crc = Crc32( ( uint8_t* ) &nvmData->RegionGroup2, sizeof( nvmData->RegionGroup2 ) -
+                                                          sizeof( nvmData->RegionGroup2.Crc32 ) );
+        if( crc != nvmData->RegionGroup2.Crc32 )
+        {
+            nvmData->RegionGroup2.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2;
+        }
     }
 
     // ClassB
-    crc = Crc32( ( uint8_t* ) &nvmData->ClassB, sizeof( nvmData->ClassB ) -
-                                                sizeof( nvmData->ClassB.Crc32 ) );
-    if( crc != nvmData->ClassB.Crc32 )
+    if( ( dirtyFlags & LORAMAC_NVM_NOTIFY_FLAG_CLASS_B ) != 0 )
     {
-        nvmData->ClassB.Crc32 = crc;
-        notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_CLASS_B;
+        crc = Crc32( ( uint8_t* ) &nvmData->ClassB, sizeof( nvmData->ClassB ) -
+                                                    sizeof( nvmData->ClassB.Crc32 ) );
+        if( crc != nvmData->ClassB.Crc32 )
+        {
+            nvmData->ClassB.Crc32 = crc;
+            notifyFlags |= LORAMAC_NVM_NOTIFY_FLAG_CLASS_B;
+        }
     }
 
     CallNvmDataChangeCallback( notifyFlags );
 }
 
 
-void LoRaMacProcess( void )
+/*!
+ * \brief Handles one radio event and the MAC events it raised
+ */
+static void LoRaMacProcessEvents( void )
 {
     //printf("\n------ LoRaMacProcess [START] ---- MacCtx.MacState = %d ------\n", GetMacState());
     // printf("\n\n---------------LoRaMacProcess step1 Start-------------\n\n");
@@ -1700,6 +1959,12 @@ void LoRaMacProcess( void )
         // printf("\n\n---------------LoRaMacProcess step3-------------\n\n");
     }
     LoRaMacHandleIndicationEvents( );
+    // The indication buffer pointed into the received frame, give it back
+    if( RxDoneParams.Payload != NULL )
+    {
+        Radio.RxFrameRelease( RxDoneParams.Payload );
+        RxDoneParams.Payload = NULL;
+    }
     // printf("\n\n---------------LoRaMacProcess step4-------------\n\n");
     if( MacCtx.RxSlot == RX_SLOT_WIN_CLASS_C )
     {
@@ -1710,6 +1975,14 @@ void LoRaMacProcess( void )
     //printf("\n------ LoRaMacProcess [END] ---- MacCtx.MacState = %d ------\n", GetMacState());
 }
 
+void LoRaMacProcess( void )
+{
+    do
+    {
+        LoRaMacProcessEvents( );
+    }while( LoRaMacRadioEventPending( ) == true );
+}
+
 static void OnTxDelayedTimerEvent( void )
 {
     TimerStop( &MacCtx.TxDelayedTimer );
@@ -1835,6 +2108,7 @@ static LoRaMacStatus_t SwitchClass( DeviceClass_t deviceClass )
 {
     LoRaMacStatus_t status = LORAMAC_STATUS_PARAMETER_INVALID;
 
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     switch( Nvm.MacGroup2.DeviceClass )     // 先判断当前模式
     {
         case CLASS_A:
@@ -2010,6 +2284,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                         Nvm.MacGroup1.ChannelsDatarate = linkAdrDatarate;
                         Nvm.MacGroup1.ChannelsTxPower = linkAdrTxPower;
                         Nvm.MacGroup2.MacParams.ChannelsNbTrans = linkAdrNbRep;
+                        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
                     }
 
                     // Add the answers to the buffer
@@ -2026,6 +2301,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
             {
                 Nvm.MacGroup2.MaxDCycle = payload[macIndex++] & 0x0F;
                 Nvm.MacGroup2.AggregatedDCycle = 1 << Nvm.MacGroup2.MaxDCycle;
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
                 LoRaMacCommandsAddCmd( MOTE_MAC_DUTY_CYCLE_ANS, macCmdPayload, 0 );
                 break;
             }
@@ -2053,6 +2329,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     Nvm.MacGroup2.MacParams.Rx2Channel.Frequency = rxParamSetupReq.Frequency;
                     Nvm.MacGroup2.MacParams.RxCChannel.Frequency = rxParamSetupReq.Frequency;
                     Nvm.MacGroup2.MacParams.Rx1DrOffset = rxParamSetupReq.DrOffset;
+                    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
                 }
                 macCmdPayload[0] = status;
                 LoRaMacCommandsAddCmd( MOTE_MAC_RX_PARAM_SETUP_ANS, macCmdPayload, 1 );
@@ -2107,6 +2384,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                 }
                 Nvm.MacGroup2.MacParams.ReceiveDelay1 = delay * 1000;
                 Nvm.MacGroup2.MacParams.ReceiveDelay2 = Nvm.MacGroup2.MacParams.ReceiveDelay1 + 1000;
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
                 LoRaMacCommandsAddCmd( MOTE_MAC_RX_TIMING_SETUP_ANS, macCmdPayload, 0 );
                 // Setup indication to inform the application
                 SetMlmeScheduleUplinkIndication( );
@@ -2144,6 +2422,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     getPhy.UplinkDwellTime = Nvm.MacGroup2.MacParams.UplinkDwellTime;
                     phyParam = RegionGetPhyParam( Nvm.MacGroup2.Region, &getPhy );
                     Nvm.MacGroup1.ChannelsDatarate = MAX( Nvm.MacGroup1.ChannelsDatarate, ( int8_t )phyParam.Value );
+                    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
 
                     // Add command response
                     LoRaMacCommandsAddCmd( MOTE_MAC_TX_PARAM_SETUP_ANS, macCmdPayload, 0 );
@@ -2295,6 +2574,7 @@ LoRaMacStatus_t Send( LoRaMacHeader_t* macHdr, uint8_t fPort, void* fBuffer, uin
     {
         return LORAMAC_STATUS_NO_NETWORK_JOINED;
     }
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
     if( Nvm.MacGroup2.MaxDCycle == 0 )
     {
         Nvm.MacGroup1.AggregatedTimeOff = 0;
@@ -2428,6 +2708,13 @@ static LoRaMacStatus_t CheckForClassBCollision( void )
 
 static void ComputeRxWindowParameters( void )
 {
+    // Max RX error and shift of the windows measured on the last downlinks,
+    // the system max RX error until then
+    uint32_t maxRxError = LoRaMacRxCalibrationGetMaxRxError( Nvm.MacGroup2.MacParams.SystemMaxRxError );
+    // The MCU in light sleep until the windows timers wakes up late, they
+    // expire that much earlier
+    int32_t offset = LoRaMacRxCalibrationGetOffset( ) - ( ( int32_t )RtcGetMcuWakeUpTime( ) + 999 ) / 1000;
+
     // Compute Rx1 windows parameters
     RegionComputeRxWindowParameters( Nvm.MacGroup2.Region,
                                      RegionApplyDrOffset( Nvm.MacGroup2.Region,
@@ -2435,23 +2722,23 @@ static void ComputeRxWindowParameters( void )
                                                           Nvm.MacGroup1.ChannelsDatarate,
                                                           Nvm.MacGroup2.MacParams.Rx1DrOffset ),
                                      Nvm.MacGroup2.MacParams.MinRxSymbols,
-                                     Nvm.MacGroup2.MacParams.SystemMaxRxError,
+                                     maxRxError,
                                      &MacCtx.RxWindow1Config );
     // Compute Rx2 windows parameters
     RegionComputeRxWindowParameters( Nvm.MacGroup2.Region,
                                      Nvm.MacGroup2.MacParams.Rx2Channel.Datarate,
                                      Nvm.MacGroup2.MacParams.MinRxSymbols,
-                                     Nvm.MacGroup2.MacParams.SystemMaxRxError,
+                                     maxRxError,
                                      &MacCtx.RxWindow2Config );
 
     // Default setup, in case the device joined
-    MacCtx.RxWindow1Delay = Nvm.MacGroup2.MacParams.ReceiveDelay1 + MacCtx.RxWindow1Config.WindowOffset;
-    MacCtx.RxWindow2Delay = Nvm.MacGroup2.MacParams.ReceiveDelay2 + MacCtx.RxWindow2Config.WindowOffset;
+    MacCtx.RxWindow1Delay = Nvm.MacGroup2.MacParams.ReceiveDelay1 + MacCtx.RxWindow1Config.WindowOffset + offset;
+    MacCtx.RxWindow2Delay = Nvm.MacGroup2.MacParams.ReceiveDelay2 + MacCtx.RxWindow2Config.WindowOffset + offset;
 
     if( Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE )
     {
-        MacCtx.RxWindow1Delay = Nvm.MacGroup2.MacParams.JoinAcceptDelay1 + MacCtx.RxWindow1Config.WindowOffset;
-        MacCtx.RxWindow2Delay = Nvm.MacGroup2.MacParams.JoinAcceptDelay2 + MacCtx.RxWindow2Config.WindowOffset;
+        MacCtx.RxWindow1Delay = Nvm.MacGroup2.MacParams.JoinAcceptDelay1 + MacCtx.RxWindow1Config.WindowOffset + offset;
+        MacCtx.RxWindow2Delay = Nvm.MacGroup2.MacParams.JoinAcceptDelay2 + MacCtx.RxWindow2Config.WindowOffset + offset;
     }
 }
 
@@ -2535,16 +2822,19 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
     nextChan.LastTxIsJoinRequest = false;
     nextChan.Joined = true;
     nextChan.PktLen = MacCtx.PktBufferLen;
+    nextChan.Repetition = ( MacCtx.ChannelsNbTransCounter >= 1 );
 
     // Setup the parameters based on the join status
     if( Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE )
     {
         nextChan.LastTxIsJoinRequest = true;
         nextChan.Joined = false;
+        nextChan.Repetition = false;
     }
 
     // Select channel
     status = RegionNextChannel( Nvm.MacGroup2.Region, &nextChan, &MacCtx.Channel, &MacCtx.DutyCycleWaitTime, &Nvm.MacGroup1.AggregatedTimeOff );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
     // printf("ScheduleTx--------------channel = %d\n", MacCtx.Channel);
 
     if( status != LORAMAC_STATUS_OK )
@@ -2634,6 +2924,7 @@ static void CalculateBackOff( void )
         // Update aggregated time-off. This must be an assignment and no incremental        更新聚合回退时间。这必须是赋值，不能是增量
         // update as we do only calculate the time-off based on the last transmission       更新，因为我们只根据最后一次传输计算时间间隔
         Nvm.MacGroup1.AggregatedTimeOff = ( MacCtx.TxTimeOnAir * Nvm.MacGroup2.AggregatedDCycle - MacCtx.TxTimeOnAir );         
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
     }
 }
 
@@ -2663,6 +2954,7 @@ static void ResetMacParameters( void )
     LoRaMacClassBCallback_t classBCallbacks;
     LoRaMacClassBParams_t classBParams;
 
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     Nvm.MacGroup2.NetworkActivation = ACTIVATION_TYPE_NONE;
 
     // ADR counter
@@ -2993,6 +3285,7 @@ LoRaMacStatus_t RestoreNvmData( LoRaMacNvmData_t* nvm )
         //printf("\n\n------[return LORA BUSY] in LoRaMacStatus_t RestoreNvmData( LoRaMacNvmData_t* nvm )------\n\n");
         return LORAMAC_STATUS_BUSY;
     }
+    LoRaMacNvmSetDirty( LORAMAC_NVM_GROUPS_ALL );
 
     // Crypto
     crc = Crc32( ( uint8_t* ) &nvm->Crypto, sizeof( nvm->Crypto ) -
@@ -3046,6 +3339,14 @@ LoRaMacStatus_t RestoreNvmData( LoRaMacNvmData_t* nvm )
                  sizeof( Nvm.RegionGroup1 ) );
     }
 
+    crc = Crc32( ( uint8_t* ) &nvm->RegionGroup2, sizeof( nvm->RegionGroup2 ) -
+                                            sizeof( nvm->RegionGroup2.Crc32 ) );
+    if( crc == nvm->RegionGroup2.Crc32 )
+    {
+        memcpy1( ( uint8_t* ) &Nvm.RegionGroup2,( uint8_t* ) &nvm->RegionGroup2,
+                 sizeof( Nvm.RegionGroup2 ) );
+    }
+
     crc = Crc32( ( uint8_t* ) &nvm->ClassB, sizeof( nvm->ClassB ) -
                                             sizeof( nvm->ClassB.Crc32 ) );
     if( crc == nvm->ClassB.Crc32 )
@@ -3163,6 +3464,7 @@ static bool StopRetransmission( void )
         if( Nvm.MacGroup2.AdrCtrlOn == true )
         {
             Nvm.MacGroup1.AdrAckCounter++;
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
         }
     }
 
@@ -3199,6 +3501,7 @@ static void AckTimeoutRetriesProcess( void )
             getPhy.Datarate = Nvm.MacGroup1.ChannelsDatarate;
             phyParam = RegionGetPhyParam( Nvm.MacGroup2.Region, &getPhy );
             Nvm.MacGroup1.ChannelsDatarate = phyParam.Value;
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
         }
     }
 }
@@ -3230,6 +3533,89 @@ static uint8_t IsRequestPending( void )
 }
 
 
+/*!
+ * \brief Binds the region to its NVM groups. The region keeps pointers to
+ *        them, which a deep sleep may clear even when the groups are kept.
+ */
+static void LoRaMacRegionRestoreNvm( void )
+{
+    InitDefaultsParams_t params;
+
+    params.Type = INIT_TYPE_RESTORE_NVM;
+    params.NvmGroup1 = &Nvm.RegionGroup1;
+    params.NvmGroup2 = &Nvm.RegionGroup2;
+    RegionInitDefaults( Nvm.MacGroup2.Region, &params );
+}
+
+/*!
+ * \brief Initializes the MAC timers and the radio driver, kept neither in the
+ *        RTC memory nor across a deep sleep
+ */
+static void LoRaMacInitTimersAndRadio( void )
+{
+    // Initialize timers    初始化计时器
+    TimerInit( &MacCtx.TxDelayedTimer, OnTxDelayedTimerEvent );
+    TimerInit( &MacCtx.RxWindowTimer1, OnRxWindow1TimerEvent );
+    TimerInit( &MacCtx.RxWindowTimer2, OnRxWindow2TimerEvent );
+    TimerInit( &MacCtx.AckTimeoutTimer, OnAckTimeoutTimerEvent );
+
+    // Store the current initialization time    存储当前的初始化时间
+    Nvm.MacGroup2.InitializationTime = SysTimeGetMcuTime( );
+
+    // Initialize Radio driver  初始化天线驱动
+    MacCtx.RadioEvents.TxDone = OnRadioTxDone;
+    MacCtx.RadioEvents.RxDone = OnRadioRxDone;
+    MacCtx.RadioEvents.RxError = OnRadioRxError;
+    MacCtx.RadioEvents.TxTimeout = OnRadioTxTimeout;
+    MacCtx.RadioEvents.RxTimeout = OnRadioRxTimeout;
+    Radio.Init( &MacCtx.RadioEvents );
+}
+
+/*!
+ * \brief Checks the CRC of a NVM group, the CRC is its last field
+ */
+static bool LoRaMacNvmGroupValid( void* group, uint16_t size, uint32_t crc32 )
+{
+    return Crc32( ( uint8_t* )group, size - sizeof( uint32_t ) ) == crc32;
+}
+
+/*!
+ * \brief Computes the CRC of the resume seal
+ */
+static uint32_t LoRaMacResumeSealCrc( void )
+{
+    uint32_t words[] =
+    {
+        ResumeSeal.Magic, ResumeSeal.Region, ResumeSeal.Seed,
+        sizeof( Nvm ), sizeof( MacCtx ),
+        Nvm.Crypto.Crc32, Nvm.MacGroup1.Crc32, Nvm.MacGroup2.Crc32, Nvm.SecureElement.Crc32,
+        Nvm.RegionGroup1.Crc32, Nvm.RegionGroup2.Crc32, Nvm.ClassB.Crc32,
+    };
+
+    return Crc32( ( uint8_t* )words, sizeof( words ) );
+}
+
+/*!
+ * \brief Checks the sealed contexts kept in the RTC memory
+ *
+ * \retval valid false when the seal or a NVM group is corrupted
+ */
+static bool LoRaMacResumeSealValid( LoRaMacRegion_t region )
+{
+    if( ( ResumeSeal.Crc32 != LoRaMacResumeSealCrc( ) ) || ( ResumeSeal.Region != ( uint32_t )region ) ||
+        ( Nvm.MacGroup2.Region != region ) || ( Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE ) )
+    {
+        return false;
+    }
+    return ( LoRaMacNvmGroupValid( &Nvm.Crypto, sizeof( Nvm.Crypto ), Nvm.Crypto.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.MacGroup1, sizeof( Nvm.MacGroup1 ), Nvm.MacGroup1.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.MacGroup2, sizeof( Nvm.MacGroup2 ), Nvm.MacGroup2.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.SecureElement, sizeof( Nvm.SecureElement ), Nvm.SecureElement.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.RegionGroup1, sizeof( Nvm.RegionGroup1 ), Nvm.RegionGroup1.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.RegionGroup2, sizeof( Nvm.RegionGroup2 ), Nvm.RegionGroup2.Crc32 ) == true ) &&
+           ( LoRaMacNvmGroupValid( &Nvm.ClassB, sizeof( Nvm.ClassB ), Nvm.ClassB.Crc32 ) == true );
+}
+
 LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacCallback_t* callbacks, LoRaMacRegion_t region )
 {
     GetPhyParams_t getPhy;
@@ -3382,22 +3768,11 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacC
     // 设置为公共网络
     Nvm.MacGroup2.PublicNetwork = true;
 
-    // Initialize timers    初始化计时器
-    TimerInit( &MacCtx.TxDelayedTimer, OnTxDelayedTimerEvent );
-    TimerInit( &MacCtx.RxWindowTimer1, OnRxWindow1TimerEvent );
-    TimerInit( &MacCtx.RxWindowTimer2, OnRxWindow2TimerEvent );
-    TimerInit( &MacCtx.AckTimeoutTimer, OnAckTimeoutTimerEvent );
+    // The NVM groups of a joined node are kept, the region is bound to them
+    // again
+    LoRaMacRegionRestoreNvm( );
 
-    // Store the current initialization time    存储当前的初始化时间
-    Nvm.MacGroup2.InitializationTime = SysTimeGetMcuTime( );
-
-    // Initialize Radio driver  初始化天线驱动
-    MacCtx.RadioEvents.TxDone = OnRadioTxDone;
-    MacCtx.RadioEvents.RxDone = OnRadioRxDone;
-    MacCtx.RadioEvents.RxError = OnRadioRxError;
-    MacCtx.RadioEvents.TxTimeout = OnRadioTxTimeout;
-    MacCtx.RadioEvents.RxTimeout = OnRadioRxTimeout;
-    Radio.Init( &MacCtx.RadioEvents );
+    LoRaMacInitTimersAndRadio( );
 
     if(Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE)         // 没有入网才初始化以下模块
     {
@@ -3435,6 +3810,79 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacC
 
     LoRaMacEnableRequests( LORAMAC_REQUEST_HANDLING_ON );
 
+    // Contexts restored from the RTC memory are checked again
+    MacCtx.NvmDirtyFlags = LORAMAC_NVM_GROUPS_ALL;
+
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacSuspend( void )
+{
+    ResumeSeal.Magic = 0;
+    if( Nvm.MacGroup2.NetworkActivation == ACTIVATION_TYPE_NONE )
+    {
+        return LORAMAC_STATUS_NO_NETWORK_JOINED;
+    }
+    if( MacCtx.MacState != LORAMAC_IDLE )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    TimerStop( &MacCtx.TxDelayedTimer );
+    TimerStop( &MacCtx.RxWindowTimer1 );
+    TimerStop( &MacCtx.RxWindowTimer2 );
+    TimerStop( &MacCtx.AckTimeoutTimer );
+
+    // Every group CRC up to date, the groups changed are notified for storage
+    LoRaMacNvmSetDirty( LORAMAC_NVM_GROUPS_ALL );
+    LoRaMacHandleNvm( &Nvm );
+
+    ResumeSeal.Magic = LORAMAC_RESUME_MAGIC;
+    ResumeSeal.Region = Nvm.MacGroup2.Region;
+    ResumeSeal.Seed = ( uint32_t )randr( 0, INT32_MAX - 1 );
+    ResumeSeal.Crc32 = LoRaMacResumeSealCrc( );
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacResume( LoRaMacPrimitives_t* primitives, LoRaMacCallback_t* callbacks, LoRaMacRegion_t region )
+{
+    bool valid;
+
+    if( ( primitives == NULL ) || ( callbacks == NULL ) ||
+        ( primitives->MacMcpsConfirm == NULL ) || ( primitives->MacMcpsIndication == NULL ) ||
+        ( primitives->MacMlmeConfirm == NULL ) || ( primitives->MacMlmeIndication == NULL ) )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    if( ResumeSeal.Magic != LORAMAC_RESUME_MAGIC )
+    {
+        // Not suspended, LoRaMacInitialization uses the contexts as they are
+        return LORAMAC_STATUS_NO_NETWORK_JOINED;
+    }
+    valid = LoRaMacResumeSealValid( region );
+    // A seal is used once, the contexts change from the first uplink on
+    ResumeSeal.Magic = 0;
+    if( valid == false )
+    {
+        // LoRaMacInitialization starts over from the defaults
+        Nvm.MacGroup2.NetworkActivation = ACTIVATION_TYPE_NONE;
+        return LORAMAC_STATUS_ERROR;
+    }
+
+    LoRaMacConfirmQueueInit( primitives );
+    MacCtx.MacPrimitives = primitives;
+    MacCtx.MacCallbacks = callbacks;
+    MacCtx.MacFlags.Value = 0;
+
+    LoRaMacRegionRestoreNvm( );
+    LoRaMacInitTimersAndRadio( );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
+
+    srand1( ResumeSeal.Seed );
+    Radio.SetPublicNetwork( Nvm.MacGroup2.PublicNetwork );
+    Radio.Sleep( );
+
+    LoRaMacEnableRequests( LORAMAC_REQUEST_HANDLING_ON );
+    MacCtx.MacState = LORAMAC_IDLE;
     return LORAMAC_STATUS_OK;
 }
 
@@ -3687,6 +4135,8 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t* mibGet )
         case MIB_NVM_CTXS:
         {
             mibGet->Param.Contexts = GetNvmData( );
+            // The caller may write the contexts
+            MacCtx.NvmDirtyFlags |= LORAMAC_NVM_GROUPS_ALL;
             break;
         }
         case MIB_DEFAULT_ANTENNA_GAIN:
@@ -3726,6 +4176,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t* mibSet )
         //printf("\n\n------[return LORA BUSY] in LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t* mibSet )------\n\n");
         return LORAMAC_STATUS_BUSY;
     }
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
 
     // printf("----------------8------------------\n");
 
@@ -4412,6 +4863,7 @@ LoRaMacStatus_t LoRaMacMcChannelSetup( McChannelParams_t *channel )
     }
 
     Nvm.MacGroup2.MulticastChannelList[channel->GroupID].ChannelParams = *channel;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
 
     if( channel->IsRemotelySetup == true )
     {
@@ -4448,6 +4900,7 @@ LoRaMacStatus_t LoRaMacMcChannelSetup( McChannelParams_t *channel )
 
     // Reset multicast channel downlink counter to initial value.
     *Nvm.MacGroup2.MulticastChannelList[channel->GroupID].DownLinkCounter = FCNT_DOWN_INITAL_VALUE;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     return LORAMAC_STATUS_OK;
 }
 
@@ -4471,6 +4924,7 @@ LoRaMacStatus_t LoRaMacMcChannelDelete( AddressIdentifier_t groupID )
     memset1( ( uint8_t* )&channel, 0, sizeof( McChannelParams_t ) );
 
     Nvm.MacGroup2.MulticastChannelList[groupID].ChannelParams = channel;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     return LORAMAC_STATUS_OK;
 }
 
@@ -4544,6 +4998,7 @@ LoRaMacStatus_t LoRaMacMcChannelSetupRxParams( AddressIdentifier_t groupID, McRx
     {
         // Apply parameters
         Nvm.MacGroup2.MulticastChannelList[groupID].ChannelParams.RxParams = *rxParams;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     }
     return LORAMAC_STATUS_OK;
 }
@@ -4593,6 +5048,7 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t* mlmeRequest )
 
             ResetMacParameters( );
 
+            // ResetMacParameters marked the MAC group 1
             Nvm.MacGroup1.ChannelsDatarate = RegionAlternateDr( Nvm.MacGroup2.Region, mlmeRequest->Req.Join.Datarate, ALTERNATE_DR );
 
             queueElement.Status = LORAMAC_EVENT_INFO_STATUS_JOIN_FAIL;
@@ -4803,6 +5259,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t* mcpsRequest )
             if( RegionVerify( Nvm.MacGroup2.Region, &verify, PHY_TX_DR ) == true )
             {
                 Nvm.MacGroup1.ChannelsDatarate = verify.DatarateParams.Datarate;
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP1 );
             }
             else
             {
@@ -4837,6 +5294,7 @@ void LoRaMacTestSetDutyCycleOn( bool enable )
     if( RegionVerify( Nvm.MacGroup2.Region, &verify, PHY_DUTY_CYCLE ) == true )
     {
         Nvm.MacGroup2.DutyCycleOn = enable;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     }
 }
 
@@ -951,6 +951,9 @@ typedef struct sMcpsIndication
     uint8_t FramePending;
     /*!
      * Pointer to the received data stream
+     *
+     * \remark Points into the radio received frame, valid until the
+     *         indication callback returns.
      */
     uint8_t* Buffer;
     /*!
@@ -2434,6 +2437,45 @@ static const uint8_t LoRaMacMaxEirpTable[] = { 8, 10, 12, 13, 14, 16, 18, 20, 21
  */
 LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacCallback_t* callbacks, LoRaMacRegion_t region );
 
+/*!
+ * \brief   Seals the session kept in the RTC memory before a deep sleep      深度睡眠前封存会话
+ *
+ * \details Stops the MAC timers, brings the CRCs of the NVM groups up to date,
+ *          notifying the groups changed, and seals them for LoRaMacResume.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED.
+ */
+LoRaMacStatus_t LoRaMacSuspend( void );
+
+/*!
+ * \brief   Resumes the session sealed by LoRaMacSuspend after a deep sleep    深度睡眠唤醒后恢复会话
+ *
+ * \details Checks the seal and the CRCs of the NVM groups, then binds the
+ *          primitives, the callbacks, the timers and the radio events again
+ *          and starts the MAC, without resetting the MAC parameters nor
+ *          initializing the region, the crypto and the secure element again.
+ *          On a corrupted seal or NVM group the session is forgotten and
+ *          LoRaMacInitialization starts over from the defaults.
+ *
+ * \param   [IN] primitives - Pointer to a structure defining the LoRaMAC
+ *                            event functions. Refer to \ref LoRaMacPrimitives_t.
+ *
+ * \param   [IN] callbacks  - Pointer to a structure defining the LoRaMAC
+ *                            callback functions. Refer to \ref LoRaMacCallback_t.
+ *
+ * \param   [IN] region     - Region of the session.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED when not sealed,
+ *          \ref LORAMAC_STATUS_ERROR when corrupted.
+ */
+LoRaMacStatus_t LoRaMacResume( LoRaMacPrimitives_t* primitives, LoRaMacCallback_t* callbacks, LoRaMacRegion_t region );
+
 /*!
  * \brief   Starts LoRaMAC layer            启动MAC层
  *
@@ -2459,13 +2501,34 @@ LoRaMacStatus_t LoRaMacStop( void );
  */
 bool LoRaMacIsBusy( void );
 
+/*!
+ * \brief Returns a value indicating if a class A uplink is on the air or
+ *        waits for its RX windows. The MAC then waits for the radio events
+ *        and its timers only.                                 判断A类上行是否在发送或等待接收窗口
+ *
+ * \retval isRunning Uplink running.
+ */
+bool LoRaMacIsUplinkRunning( void );
+
 /*!
  * Processes the LoRaMac events.                            处理MAC层事件
  *
- * \remark This function must be called in the main loop.
+ * \remark This function must be called in the main loop. It handles the
+ *         radio events queued in their order until the queue is empty.
  */
 void LoRaMacProcess( void );
 
+/*!
+ * \brief Marks NVM groups as changed. Their CRC is recomputed and they are
+ *        notified through OnNvmDataChange once the MAC is idle again.
+ *
+ * \param [IN] notifyFlags Changed groups, LORAMAC_NVM_NOTIFY_FLAG_XXX bitmap
+ *
+ * \remark Called by the MAC, crypto, region and Class B modules after they
+ *         write their NVM group.
+ */
+void LoRaMacNvmSetDirty( uint16_t notifyFlags );
+
 /*!
  * \brief   Queries the LoRaMAC if it is possible to send the next frame with           查询LoRaMAC是否可以发送具有给定应用程序数据有效负载大小的下一帧。LoRaMAC考虑预定的MAC命令，并报告何时可以发送帧或不发送帧。
  *          a given application data payload size. The LoRaMAC takes scheduled
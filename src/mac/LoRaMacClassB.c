@@ -421,6 +421,7 @@ static void InitClassB( void )
     getPhy.Attribute = PHY_PING_SLOT_CHANNEL_DR;
     phyParam = RegionGetPhyParam( *Ctx.LoRaMacClassBParams.LoRaMacRegion, &getPhy );
     ClassBNvm->PingSlotCtx.Datarate = ( int8_t )( phyParam.Value );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
 
     // Setup default states
     Ctx.BeaconState = BEACON_STATE_ACQUISITION;
@@ -1049,6 +1050,7 @@ static void LoRaMacClassBProcessMulticastSlot( void )
         case PINGSLOT_STATE_CALC_PING_OFFSET:
         {
             // Compute all offsets for every multicast slots
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
             for( uint8_t i = 0; i < 4; i++ )
             {
                 ComputePingOffset( Ctx.BeaconCtx.BeaconTime.Seconds,
@@ -1251,8 +1253,15 @@ bool LoRaMacClassBRxBeacon( uint8_t *payload, uint16_t size )
                 Ctx.BeaconCtx.LastBeaconRx = Ctx.BeaconCtx.BeaconTime;
                 Ctx.BeaconCtx.LastBeaconRx.Seconds += UNIX_GPS_EPOCH_OFFSET;
 
-                // Update system time.
-                SysTimeSet( SysTimeAdd( Ctx.BeaconCtx.LastBeaconRx, timeOnAir ) );
+                // Update system time. The beacon ended at the RX done IRQ, the
+                // time the frame waited to be processed is added.
+                SysTime_t sysTime = SysTimeAdd( Ctx.BeaconCtx.LastBeaconRx, timeOnAir );
+                RadioRxFrame_t* frame = Radio.RxFrameGet( payload );
+                if( frame != NULL )
+                {
+                    sysTime = SysTimeAdd( sysTime, SysTimeSub( SysTimeGet( ), SysTimeGetAt( frame->TimestampUs ) ) );
+                }
+                SysTimeSet( sysTime );
 
                 Ctx.BeaconCtx.Ctrl.BeaconAcquired = 1;
                 Ctx.BeaconCtx.Ctrl.BeaconMode = 1;
@@ -1355,6 +1364,7 @@ void LoRaMacClassBSetPingSlotInfo( uint8_t periodicity )
 #ifdef LORAMAC_CLASSB_ENABLED
     ClassBNvm->PingSlotCtx.PingNb = CalcPingNb( periodicity );
     ClassBNvm->PingSlotCtx.PingPeriod = CalcPingPeriod( ClassBNvm->PingSlotCtx.PingNb );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
 #endif // LORAMAC_CLASSB_ENABLED
 }
 
@@ -1466,6 +1476,7 @@ LoRaMacStatus_t LoRaMacMibClassBSetRequestConfirm( MibRequestConfirm_t *mibSet )
         case MIB_PING_SLOT_DATARATE:
         {
             ClassBNvm->PingSlotCtx.Datarate = mibSet->Param.PingSlotDatarate;
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
             break;
         }
         default:
@@ -1487,6 +1498,7 @@ void LoRaMacClassBPingSlotInfoAns( void )
     {
         LoRaMacConfirmQueueSetStatus( LORAMAC_EVENT_INFO_STATUS_OK, MLME_PING_SLOT_INFO );
         ClassBNvm->PingSlotCtx.Ctrl.Assigned = 1;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
     }
 #endif // LORAMAC_CLASSB_ENABLED
 }
@@ -1529,6 +1541,7 @@ uint8_t LoRaMacClassBPingSlotChannelReq( uint8_t datarate, uint32_t frequency )
             ClassBNvm->PingSlotCtx.Frequency = 0;
         }
         ClassBNvm->PingSlotCtx.Datarate = datarate;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
     }
 
     return status;
@@ -1615,12 +1628,14 @@ bool LoRaMacClassBBeaconFreqReq( uint32_t frequency )
         {
             ClassBNvm->BeaconCtx.Ctrl.CustomFreq = 1;
             ClassBNvm->BeaconCtx.Frequency = frequency;
+            LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
             return true;
         }
     }
     else
     {
         ClassBNvm->BeaconCtx.Ctrl.CustomFreq = 0;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CLASS_B );
         return true;
     }
     return false;
@@ -1689,6 +1704,7 @@ void LoRaMacClassBSetMulticastPeriodicity( MulticastCtx_t* multicastChannel )
     {
         multicastChannel->PingNb = CalcPingNb( multicastChannel->ChannelParams.RxParams.ClassB.Periodicity );
         multicastChannel->PingPeriod = CalcPingPeriod( multicastChannel->PingNb );
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_MAC_GROUP2 );
     }
 #endif // LORAMAC_CLASSB_ENABLED
 }
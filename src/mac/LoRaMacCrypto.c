@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "system/utilities.h"
 #include "secure-element.h"
@@ -40,6 +41,7 @@
 #include "LoRaMacParser.h"
 #include "LoRaMacSerializer.h"
 #include "LoRaMacCrypto.h"
+#include "LoRaMac.h"
 #include <Arduino.h>
 #include "system/crypto/aes.h"
 
@@ -681,6 +683,7 @@ static LoRaMacCryptoStatus_t GetLastFcntDown( FCntIdentifier_t fCntID, uint32_t*
     {
         return LORAMAC_CRYPTO_ERROR_NPE;
     }
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     switch( fCntID )
     {
         case N_FCNT_DOWN:
@@ -758,6 +761,7 @@ static bool CheckFCntDown( FCntIdentifier_t fCntID, uint32_t currentDown )
  */
 static void UpdateFCntDown( FCntIdentifier_t fCntID, uint32_t currentDown )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     switch( fCntID )
     {
         case N_FCNT_DOWN:
@@ -799,6 +803,7 @@ static void UpdateFCntDown( FCntIdentifier_t fCntID, uint32_t currentDown )
  */
 static void ResetFCnts( void )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     CryptoNvm->FCntList.FCntUp = 0;
     CryptoNvm->FCntList.NFCntDown = FCNT_DOWN_INITAL_VALUE;
     CryptoNvm->FCntList.AFCntDown = FCNT_DOWN_INITAL_VALUE;
@@ -842,6 +847,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoInit( LoRaMacCryptoNvmData_t* nvm )
 LoRaMacCryptoStatus_t LoRaMacCryptoSetLrWanVersion( Version_t version )
 {
     CryptoNvm->LrWanVersion = version;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     return LORAMAC_CRYPTO_SUCCESS;
 }
 
@@ -985,6 +991,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoPrepareJoinRequest( LoRaMacMessageJoinRequest
 #else
     CryptoNvm->DevNonce++;
 #endif
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     macMsg->DevNonce = CryptoNvm->DevNonce;
 
 #if( USE_LRWAN_1_1_X_CRYPTO == 1 )
@@ -1055,6 +1062,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoPrepareReJoinType1( LoRaMacMessageReJoinType1
 
     // Increment RJcount1
     CryptoNvm->FCntList.RJcount1++;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
 
     return LORAMAC_CRYPTO_SUCCESS;
 }
@@ -1164,6 +1172,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoHandleJoinAccept( JoinReqIdentifier_t joinReq
 #endif
     {
         CryptoNvm->JoinNonce = currentJoinNonce;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
     }
     else
     {
@@ -1260,6 +1269,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoHandleJoinAccept( JoinReqIdentifier_t joinReq
     CryptoNvm->FCntList.FCntDown = FCNT_DOWN_INITAL_VALUE;
     CryptoNvm->FCntList.NFCntDown = FCNT_DOWN_INITAL_VALUE;
     CryptoNvm->FCntList.AFCntDown = FCNT_DOWN_INITAL_VALUE;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
 
     return LORAMAC_CRYPTO_SUCCESS;
 }
@@ -1356,6 +1366,7 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr,
     }
 
     CryptoNvm->FCntList.FCntUp = fCntUp;
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_CRYPTO );
 
     return LORAMAC_CRYPTO_SUCCESS;
 }
@@ -1543,8 +1554,11 @@ void LoRaMacPayloadEncrypt(const uint8_t *buffer, uint16_t size, const uint8_t *
 	uint8_t bufferIndex = 0;
 	uint16_t ctr = 1;
 
-    aes_context AesContext;
-	memset1(AesContext.ksch, '\0', 240);
+	// Expanded per call: the radio service task decrypts in the RxDone
+	// callback while the application task encrypts, a shared schedule would
+	// mix their keys
+	aes_context AesContext;
+
 	aes_set_key(key, 16, &AesContext);
 
     uint8_t aBlock[] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
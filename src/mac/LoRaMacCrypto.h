@@ -329,6 +329,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoDeriveMcSessionKeyPair( AddressIdentifier_t a
 /*!
  * Computes the LoRaMAC payload encryption
  *
+ * \remark The expanded key of the last call is kept. encBuffer may be buffer.
+ *
  * \param   buffer          - Data buffer
  * \param   size            - Data buffer size
  * \param   key             - AES key to be used
@@ -234,6 +234,9 @@ typedef struct sLoRaMacMessageData
     uint8_t FPort;
     /*!
      * Frame payload may contain MAC commands or data (opt.)
+     *
+     * \remark When 0, the parser points it into Buffer instead of copying
+     *         the payload. The payload is then decrypted in place.
      */
     uint8_t* FRMPayload;
     /*!
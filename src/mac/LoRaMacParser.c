@@ -103,11 +103,19 @@ LoRaMacParserStatus_t LoRaMacParserData( LoRaMacMessageData_t* macMsg )
     if( ( macMsg->BufSize - bufItr - LORAMAC_MIC_FIELD_SIZE ) > 0 )
     {
         macMsg->FPort = macMsg->Buffer[bufItr++];
-
         macMsg->FRMPayloadSize = ( macMsg->BufSize - bufItr - LORAMAC_MIC_FIELD_SIZE );
+    }
+
+    if( macMsg->FRMPayload == 0 )
+    {
+        // Zero copy, the frame payload is referenced in the message buffer
+        macMsg->FRMPayload = &macMsg->Buffer[bufItr];
+    }
+    else if( macMsg->FRMPayload != &macMsg->Buffer[bufItr] )
+    {
         memcpy1( macMsg->FRMPayload, &macMsg->Buffer[bufItr], macMsg->FRMPayloadSize );
-        bufItr = bufItr + macMsg->FRMPayloadSize;
     }
+    bufItr = bufItr + macMsg->FRMPayloadSize;
 
     macMsg->MIC = ( uint32_t ) macMsg->Buffer[( macMsg->BufSize - LORAMAC_MIC_FIELD_SIZE )];
     macMsg->MIC |= ( ( uint32_t ) macMsg->Buffer[( macMsg->BufSize - LORAMAC_MIC_FIELD_SIZE ) + 1] << 8 );
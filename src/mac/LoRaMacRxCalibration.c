@@ -0,0 +1,177 @@
+/*!
+ * \file      LoRaMacRxCalibration.c
+ *
+ * \brief     LoRa MAC RX windows timing calibration
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "system/utilities.h"
+#include "LoRaMacRxCalibration.h"
+#include <Arduino.h>
+
+/*!
+ * Weight of a new sample in the mean error and the deviation, 1 / 2^n
+ */
+#define RX_CALIBRATION_WEIGHT_SHIFT                 2
+
+/*!
+ * The error spread covered by the windows, in mean absolute deviations
+ */
+#define RX_CALIBRATION_DEVIATIONS                   4
+
+/*
+ * LoRaMac RX calibration context
+ */
+typedef struct sLoRaMacRxCalibrationCtx
+{
+    /*!
+     * Set when the wide windows are always used
+     */
+    bool Disabled;
+    /*!
+     * Downlinks measured since the last reset
+     */
+    uint32_t NbSamples;
+    /*!
+     * Consecutive expected downlinks missed
+     */
+    uint8_t NbMisses;
+    /*!
+     * Mean error [us]
+     */
+    int32_t BiasUs;
+    /*!
+     * Mean absolute deviation of the error [us]
+     */
+    uint32_t DeviationUs;
+    /*!
+     * Statistics
+     */
+    LoRaMacRxCalibrationStats_t Stats;
+}LoRaMacRxCalibrationCtx_t;
+
+/*
+ * Module context, kept across deep sleep as the MAC context
+ */
+RTC_DATA_ATTR static LoRaMacRxCalibrationCtx_t RxCalCtx;
+
+static bool IsActive( void )
+{
+    return ( RxCalCtx.Disabled == false ) && ( RxCalCtx.NbSamples >= LORAMAC_RX_CALIBRATION_MIN_SAMPLES );
+}
+
+/*!
+ * \brief Point the windows are centered on. The receiver is ready between the
+ *        planned time and LORAMAC_RX_CALIBRATION_WAKEUP_SLACK_US before it,
+ *        the downlinks therefore come up to the slack late in the windows.
+ *
+ * \retval center Shift of the center of the windows [us]
+ */
+static int32_t CenterUs( void )
+{
+    return RxCalCtx.BiasUs + LORAMAC_RX_CALIBRATION_WAKEUP_SLACK_US / 2;
+}
+
+void LoRaMacRxCalibrationReset( void )
+{
+    RxCalCtx.NbSamples = 0;
+    RxCalCtx.NbMisses = 0;
+    RxCalCtx.BiasUs = 0;
+    RxCalCtx.DeviationUs = 0;
+}
+
+void LoRaMacRxCalibrationEnable( bool enable )
+{
+    RxCalCtx.Disabled = !enable;
+}
+
+void LoRaMacRxCalibrationAddSample( int32_t errorUs )
+{
+    int32_t deviation;
+
+    if( RxCalCtx.NbSamples == 0 )
+    {
+        RxCalCtx.BiasUs = errorUs;
+        RxCalCtx.DeviationUs = 0;
+    }
+    else
+    {
+        RxCalCtx.BiasUs += ( errorUs - RxCalCtx.BiasUs ) / ( 1 << RX_CALIBRATION_WEIGHT_SHIFT );
+        deviation = errorUs - RxCalCtx.BiasUs;
+        if( deviation < 0 )
+        {
+            deviation = -deviation;
+        }
+        RxCalCtx.DeviationUs += ( deviation - ( int32_t )RxCalCtx.DeviationUs ) / ( 1 << RX_CALIBRATION_WEIGHT_SHIFT );
+    }
+    RxCalCtx.NbSamples++;
+    RxCalCtx.NbMisses = 0;
+    RxCalCtx.Stats.Samples++;
+    RxCalCtx.Stats.LastErrorUs = errorUs;
+}
+
+void LoRaMacRxCalibrationMiss( void )
+{
+    RxCalCtx.Stats.Misses++;
+    if( ++RxCalCtx.NbMisses < LORAMAC_RX_CALIBRATION_MAX_MISSES )
+    {
+        return;
+    }
+    if( IsActive( ) == true )
+    {
+        RxCalCtx.Stats.Fallbacks++;
+    }
+    LoRaMacRxCalibrationReset( );
+}
+
+int32_t LoRaMacRxCalibrationGetOffset( void )
+{
+    if( IsActive( ) == false )
+    {
+        return 0;
+    }
+    // Rounded to the nearest millisecond
+    if( CenterUs( ) >= 0 )
+    {
+        return ( CenterUs( ) + 500 ) / 1000;
+    }
+    return -( ( -CenterUs( ) + 500 ) / 1000 );
+}
+
+uint32_t LoRaMacRxCalibrationGetMaxRxError( uint32_t systemMaxRxError )
+{
+    int32_t residualUs;
+    uint32_t marginUs;
+    uint32_t maxRxError;
+
+    if( IsActive( ) == false )
+    {
+        return systemMaxRxError;
+    }
+    // Part of the center the millisecond shift of the windows leaves
+    residualUs = CenterUs( ) - LoRaMacRxCalibrationGetOffset( ) * 1000;
+    if( residualUs < 0 )
+    {
+        residualUs = -residualUs;
+    }
+    marginUs = ( uint32_t )residualUs + RX_CALIBRATION_DEVIATIONS * RxCalCtx.DeviationUs +
+               LORAMAC_RX_CALIBRATION_WAKEUP_SLACK_US / 2 + LORAMAC_RX_CALIBRATION_GUARD_US;
+    maxRxError = MIN( ( marginUs + 999 ) / 1000, systemMaxRxError );
+    RxCalCtx.Stats.MaxRxError = maxRxError;
+    return maxRxError;
+}
+
+void LoRaMacRxCalibrationGetStats( LoRaMacRxCalibrationStats_t* stats )
+{
+    if( stats == NULL )
+    {
+        return;
+    }
+    *stats = RxCalCtx.Stats;
+    stats->BiasUs = RxCalCtx.BiasUs;
+    stats->DeviationUs = RxCalCtx.DeviationUs;
+    stats->Offset = LoRaMacRxCalibrationGetOffset( );
+    stats->Active = IsActive( );
+}
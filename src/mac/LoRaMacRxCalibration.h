@@ -0,0 +1,162 @@
+/*!
+ * \file      LoRaMacRxCalibration.h
+ *
+ * \brief     LoRa MAC RX windows timing calibration
+ *
+ * \remark    The RX1/RX2 windows are opened early and kept open long enough to
+ *            cover the system max RX error ( MIB_SYSTEM_MAX_RX_ERROR ), 10 ms
+ *            by default, whatever the actual timing error of the node is.
+ *            Every downlink received in RX1 or RX2 gives the error between
+ *            its start, from the RX done IRQ time minus its time on air, and
+ *            the start the MAC scheduled the window for. The mean error
+ *            shifts the windows and the spread of the error around it sets
+ *            the max RX error used for the windows, down to the resolution of
+ *            the timers and of the radio wake-up time. Consecutive downlinks
+ *            expected and not received, a join accept or an acknowledgement,
+ *            fall back to the wide windows until the error is measured again.
+ *
+ * \defgroup  LORAMACRXCALIBRATION LoRa MAC RX windows timing calibration
+ * \{
+ */
+#ifndef __LORAMACRXCALIBRATION_H__
+#define __LORAMACRXCALIBRATION_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Downlinks measured before the calibrated windows are used
+ */
+#ifndef LORAMAC_RX_CALIBRATION_MIN_SAMPLES
+#define LORAMAC_RX_CALIBRATION_MIN_SAMPLES          4
+#endif
+
+/*!
+ * Consecutive expected downlinks missed before falling back to the wide
+ * windows
+ */
+#ifndef LORAMAC_RX_CALIBRATION_MAX_MISSES
+#define LORAMAC_RX_CALIBRATION_MAX_MISSES           2
+#endif
+
+/*!
+ * Part of the radio wake-up time the windows are opened ahead for that the
+ * radio may not take, a warm start being shorter than RADIO_WAKEUP_TIME. The
+ * receiver can be ready up to this before the planned time [us]
+ */
+#ifndef LORAMAC_RX_CALIBRATION_WAKEUP_SLACK_US
+#define LORAMAC_RX_CALIBRATION_WAKEUP_SLACK_US      3000
+#endif
+
+/*!
+ * Margin added to the measured spread of the error, covers the millisecond
+ * resolution of the timers and of the time on air [us]
+ */
+#ifndef LORAMAC_RX_CALIBRATION_GUARD_US
+#define LORAMAC_RX_CALIBRATION_GUARD_US             1000
+#endif
+
+/*!
+ * RX windows timing calibration statistics
+ */
+typedef struct sLoRaMacRxCalibrationStats
+{
+    /*!
+     * Downlinks measured
+     */
+    uint32_t Samples;
+    /*!
+     * Expected downlinks not received
+     */
+    uint32_t Misses;
+    /*!
+     * Falls back to the wide windows
+     */
+    uint32_t Fallbacks;
+    /*!
+     * Last measured error, positive when the downlink started late [us]
+     */
+    int32_t LastErrorUs;
+    /*!
+     * Mean error [us]
+     */
+    int32_t BiasUs;
+    /*!
+     * Mean absolute deviation of the error around the mean [us]
+     */
+    uint32_t DeviationUs;
+    /*!
+     * Max RX error the windows were last computed with [ms]
+     */
+    uint32_t MaxRxError;
+    /*!
+     * Shift of the windows [ms]
+     */
+    int32_t Offset;
+    /*!
+     * Set when the calibrated windows are in use
+     */
+    bool Active;
+}LoRaMacRxCalibrationStats_t;
+
+/*!
+ * \brief Forgets the measured error, the wide windows are used until the
+ *        error is measured again
+ */
+void LoRaMacRxCalibrationReset( void );
+
+/*!
+ * \brief Enables or disables the calibrated windows, enabled by default
+ *
+ * \param [IN] enable Set to false to always use the wide windows
+ */
+void LoRaMacRxCalibrationEnable( bool enable );
+
+/*!
+ * \brief Adds the timing error of a downlink received in RX1 or RX2
+ *
+ * \param [IN] errorUs Start of the downlink minus the start the window was
+ *                     scheduled for, positive when late [us]
+ */
+void LoRaMacRxCalibrationAddSample( int32_t errorUs );
+
+/*!
+ * \brief Signals an expected downlink not received in RX1 nor RX2
+ */
+void LoRaMacRxCalibrationMiss( void );
+
+/*!
+ * \brief Gets the max RX error to compute the windows with
+ *
+ * \param [IN] systemMaxRxError System max RX error [ms], the wide windows
+ *
+ * \retval maxRxError Max RX error [ms], at most systemMaxRxError
+ */
+uint32_t LoRaMacRxCalibrationGetMaxRxError( uint32_t systemMaxRxError );
+
+/*!
+ * \brief Gets the shift of the windows
+ *
+ * \retval offset Shift to add to the RX windows delays [ms]
+ */
+int32_t LoRaMacRxCalibrationGetOffset( void );
+
+/*!
+ * \brief Gets the calibration statistics
+ *
+ * \param [OUT] stats Statistics
+ */
+void LoRaMacRxCalibrationGetStats( LoRaMacRxCalibrationStats_t* stats );
+
+/*! \} defgroup LORAMACRXCALIBRATION */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LORAMACRXCALIBRATION_H__
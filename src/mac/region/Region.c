@@ -586,6 +586,7 @@ PhyParam_t RegionGetPhyParam( LoRaMacRegion_t region, GetPhyParams_t* getPhy )
 
 void RegionSetBandTxDone( LoRaMacRegion_t region, SetBandTxDoneParams_t* txDone )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 );
     switch( region )
     {
         AS923_SET_BAND_TX_DONE( );
@@ -607,6 +608,7 @@ void RegionSetBandTxDone( LoRaMacRegion_t region, SetBandTxDoneParams_t* txDone
 
 void RegionInitDefaults( LoRaMacRegion_t region, InitDefaultsParams_t* params )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_INIT_DEFAULTS( );
@@ -649,6 +651,7 @@ bool RegionVerify( LoRaMacRegion_t region, VerifyParams_t* verify, PhyAttribute_
 
 void RegionApplyCFList( LoRaMacRegion_t region, ApplyCFListParams_t* applyCFList )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_APPLY_CF_LIST( );
@@ -670,6 +673,7 @@ void RegionApplyCFList( LoRaMacRegion_t region, ApplyCFListParams_t* applyCFList
 
 bool RegionChanMaskSet( LoRaMacRegion_t region, ChanMaskSetParams_t* chanMaskSet )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_CHAN_MASK_SET( );
@@ -754,6 +758,7 @@ bool RegionTxConfig( LoRaMacRegion_t region, TxConfigParams_t* txConfig, int8_t*
 
 uint8_t RegionLinkAdrReq( LoRaMacRegion_t region, LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 | LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_LINK_ADR_REQ( );
@@ -796,6 +801,7 @@ uint8_t RegionRxParamSetupReq( LoRaMacRegion_t region, RxParamSetupReqParams_t*
 
 int8_t RegionNewChannelReq( LoRaMacRegion_t region, NewChannelReqParams_t* newChannelReq )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_NEW_CHANNEL_REQ( );
@@ -838,6 +844,7 @@ int8_t RegionTxParamSetupReq( LoRaMacRegion_t region, TxParamSetupReqParams_t* t
 
 int8_t RegionDlChannelReq( LoRaMacRegion_t region, DlChannelReqParams_t* dlChannelReq )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_DL_CHANNEL_REQ( );
@@ -859,6 +866,7 @@ int8_t RegionDlChannelReq( LoRaMacRegion_t region, DlChannelReqParams_t* dlChann
 
 int8_t RegionAlternateDr( LoRaMacRegion_t region, int8_t currentDr, AlternateDrType_t type )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 );
     switch( region )
     {
         AS923_ALTERNATE_DR( );
@@ -880,6 +888,7 @@ int8_t RegionAlternateDr( LoRaMacRegion_t region, int8_t currentDr, AlternateDrT
 
 LoRaMacStatus_t RegionNextChannel( LoRaMacRegion_t region, NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP1 );
     switch( region )
     {
         AS923_NEXT_CHANNEL( );
@@ -901,6 +910,7 @@ LoRaMacStatus_t RegionNextChannel( LoRaMacRegion_t region, NextChanParams_t* nex
 
 LoRaMacStatus_t RegionChannelAdd( LoRaMacRegion_t region, ChannelAddParams_t* channelAdd )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_CHANNEL_ADD( );
@@ -922,6 +932,7 @@ LoRaMacStatus_t RegionChannelAdd( LoRaMacRegion_t region, ChannelAddParams_t* ch
 
 bool RegionChannelsRemove( LoRaMacRegion_t region, ChannelRemoveParams_t* channelRemove )
 {
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     switch( region )
     {
         AS923_CHANNEL_REMOVE( );
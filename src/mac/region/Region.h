@@ -341,7 +341,13 @@ typedef enum eInitType
      * Activates the default channels. Leaves all other active channels
      * active.
      */
-    INIT_TYPE_ACTIVATE_DEFAULT_CHANNELS
+    INIT_TYPE_ACTIVATE_DEFAULT_CHANNELS,
+    /*!
+     * Binds the region to the NVM groups without changing them. Called on
+     * every MAC initialization, the groups of a joined node restored from
+     * the RTC memory or from the flash are kept.
+     */
+    INIT_TYPE_RESTORE_NVM
 }InitType_t;
 
 typedef enum eChannelsMask
@@ -793,6 +799,10 @@ typedef struct sNextChanParams
      * Payload length of the next frame
      */
     uint16_t PktLen;
+    /*!
+     * Set to true, if the frame is a NbTrans repetition of the last uplink
+     */
+    bool Repetition;
 }NextChanParams_t;
 
 /*!
@@ -31,6 +31,7 @@
 #include "radio/radio.h"
 #include "RegionCommon.h"
 #include "RegionAU915.h"
+#include <Arduino.h>
 #include "RegionBaseUS.h"
 
 // Definitions
@@ -42,8 +43,8 @@
 /*
  * Non-volatile module context.
  */
-static RegionNvmDataGroup1_t* RegionNvmGroup1;
-static RegionNvmDataGroup2_t* RegionNvmGroup2;
+RTC_DATA_ATTR static RegionNvmDataGroup1_t* RegionNvmGroup1;
+RTC_DATA_ATTR static RegionNvmDataGroup2_t* RegionNvmGroup2;
 
 static bool VerifyRfFreq( uint32_t freq )
 {
@@ -74,7 +75,7 @@ static TimerTime_t GetTimeOnAir( int8_t datarate, uint16_t pktLen )
     int8_t phyDr = DataratesAU915[datarate];
     uint32_t bandwidth = RegionCommonGetBandwidth( datarate, BandwidthsAU915 );
 
-    return Radio.TimeOnAir( MODEM_LORA, bandwidth, phyDr, 1, 8, false, pktLen, true );
+    return RegionCommonGetTimeOnAirLoRa( phyDr, bandwidth, pktLen );
 }
 
 PhyParam_t RegionAU915GetPhyParam( GetPhyParams_t* getPhy )
@@ -378,6 +379,17 @@ void RegionAU915InitDefaults( InitDefaultsParams_t* params )
             RegionCommonChanMaskCopy( RegionNvmGroup1->ChannelsMaskRemaining, RegionNvmGroup2->ChannelsMask, CHANNELS_MASK_SIZE );
             break;
         }
+        case INIT_TYPE_RESTORE_NVM:
+        {
+            if( ( params->NvmGroup1 == NULL ) || ( params->NvmGroup2 == NULL ) )
+            {
+                return;
+            }
+
+            RegionNvmGroup1 = (RegionNvmDataGroup1_t*) params->NvmGroup1;
+            RegionNvmGroup2 = (RegionNvmDataGroup2_t*) params->NvmGroup2;
+            break;
+        }
         case INIT_TYPE_RESET_TO_DEFAULT_CHANNELS:
         {
             // Intentional fallthrough
@@ -809,7 +821,7 @@ LoRaMacStatus_t RegionAU915NextChannel( NextChanParams_t* nextChanParams, uint8_
 {
     uint8_t nbEnabledChannels = 0;
     uint8_t nbRestrictedChannels = 0;
-    uint8_t enabledChannels[AU915_MAX_NB_CHANNELS] = { 0 };
+    uint16_t enabledChannelsMask[CHANNELS_MASK_SIZE];
     RegionCommonIdentifyChannelsParam_t identifyChannelsParam;
     RegionCommonCountNbOfEnabledChannelsParams_t countChannelsParams;
     LoRaMacStatus_t status = LORAMAC_STATUS_NO_CHANNEL_FOUND;
@@ -850,15 +862,24 @@ LoRaMacStatus_t RegionAU915NextChannel( NextChanParams_t* nextChanParams, uint8_
 
     identifyChannelsParam.CountNbOfEnabledChannelsParam = &countChannelsParams;
 
-    status = RegionCommonIdentifyChannels( &identifyChannelsParam, aggregatedTimeOff, enabledChannels,
-                                           &nbEnabledChannels, &nbRestrictedChannels, time );
+#if( REGION_NB_TRANS_REUSE_CHANNEL == 1 )
+    if( ( nextChanParams->Repetition == true ) &&
+        ( RegionCommonChanReusable( &identifyChannelsParam, RegionNvmGroup2->ChannelsMask, *channel, aggregatedTimeOff ) == true ) )
+    { // Repeat the frame on its channel
+        *time = 0;
+        return LORAMAC_STATUS_OK;
+    }
+#endif
+
+    status = RegionCommonIdentifyChannelsMask( &identifyChannelsParam, aggregatedTimeOff, enabledChannelsMask,
+                                               &nbEnabledChannels, &nbRestrictedChannels, time );
 
     if( status == LORAMAC_STATUS_OK )
     {
         if( nextChanParams->Joined == true )
         {
             // Choose randomly on of the remaining channels
-            *channel = enabledChannels[randr( 0, nbEnabledChannels - 1 )];
+            *channel = RegionCommonChanMaskSelect( enabledChannelsMask, CHANNELS_MASK_SIZE, randr( 0, nbEnabledChannels - 1 ) );
         }
         else
         {
@@ -880,12 +901,7 @@ LoRaMacStatus_t RegionAU915NextChannel( NextChanParams_t* nextChanParams, uint8_
             else
             {
                 // Choose the next available channel
-                uint8_t i = 0;
-                while( ( ( RegionNvmGroup1->ChannelsMaskRemaining[4] & CHANNELS_MASK_500KHZ_MASK ) & ( 1 << i ) ) == 0 )
-                {
-                    i++;
-                }
-                *channel = 64 + i;
+                *channel = 64 + __builtin_ctz( RegionNvmGroup1->ChannelsMaskRemaining[4] & CHANNELS_MASK_500KHZ_MASK );
             }
         }
 
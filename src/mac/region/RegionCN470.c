@@ -31,6 +31,7 @@
 #include "radio/radio.h"
 #include "RegionCommon.h"
 #include "RegionCN470.h"
+#include <Arduino.h>
 #include "RegionBaseUS.h"
 
 // Definitions
@@ -39,8 +40,8 @@
 /*
  * Non-volatile module context.
  */
-static RegionNvmDataGroup1_t* RegionNvmGroup1;
-static RegionNvmDataGroup2_t* RegionNvmGroup2;
+RTC_DATA_ATTR static RegionNvmDataGroup1_t* RegionNvmGroup1;
+RTC_DATA_ATTR static RegionNvmDataGroup2_t* RegionNvmGroup2;
 
 // Static functions
 static bool VerifyRfFreq( uint32_t freq )
@@ -72,7 +73,7 @@ static TimerTime_t GetTimeOnAir( int8_t datarate, uint16_t pktLen )
     int8_t phyDr = DataratesCN470[datarate];
     uint32_t bandwidth = RegionCommonGetBandwidth( datarate, BandwidthsCN470 );
 
-    return Radio.TimeOnAir( MODEM_LORA, bandwidth, phyDr, 1, 8, false, pktLen, true );
+    return RegionCommonGetTimeOnAirLoRa( phyDr, bandwidth, pktLen );
 }
 
 PhyParam_t RegionCN470GetPhyParam( GetPhyParams_t* getPhy )
@@ -339,6 +340,17 @@ void RegionCN470InitDefaults( InitDefaultsParams_t* params )
             RegionCommonChanMaskCopy( RegionNvmGroup2->ChannelsMask, RegionNvmGroup2->ChannelsDefaultMask, CHANNELS_MASK_SIZE );
             break;
         }
+        case INIT_TYPE_RESTORE_NVM:
+        {
+            if( ( params->NvmGroup1 == NULL ) || ( params->NvmGroup2 == NULL ) )
+            {
+                return;
+            }
+
+            RegionNvmGroup1 = (RegionNvmDataGroup1_t*) params->NvmGroup1;
+            RegionNvmGroup2 = (RegionNvmDataGroup2_t*) params->NvmGroup2;
+            break;
+        }
         case INIT_TYPE_RESET_TO_DEFAULT_CHANNELS:
         {
             // Intentional fallthrough
@@ -648,7 +660,7 @@ LoRaMacStatus_t RegionCN470NextChannel( NextChanParams_t* nextChanParams, uint8_
 {
     uint8_t nbEnabledChannels = 0;
     uint8_t nbRestrictedChannels = 0;
-    uint8_t enabledChannels[CN470_MAX_NB_CHANNELS] = { 0 };
+    uint16_t enabledChannelsMask[CHANNELS_MASK_SIZE];
     RegionCommonIdentifyChannelsParam_t identifyChannelsParam;
     RegionCommonCountNbOfEnabledChannelsParams_t countChannelsParams;
     LoRaMacStatus_t status = LORAMAC_STATUS_NO_CHANNEL_FOUND;
@@ -662,6 +674,7 @@ LoRaMacStatus_t RegionCN470NextChannel( NextChanParams_t* nextChanParams, uint8_
         RegionNvmGroup2->ChannelsMask[3] = 0xFFFF;
         RegionNvmGroup2->ChannelsMask[4] = 0xFFFF;
         RegionNvmGroup2->ChannelsMask[5] = 0xFFFF;
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     }
 
     // Search how many channels are enabled
@@ -684,13 +697,22 @@ LoRaMacStatus_t RegionCN470NextChannel( NextChanParams_t* nextChanParams, uint8_
 
     identifyChannelsParam.CountNbOfEnabledChannelsParam = &countChannelsParams;
 
-    status = RegionCommonIdentifyChannels( &identifyChannelsParam, aggregatedTimeOff, enabledChannels,
-                                           &nbEnabledChannels, &nbRestrictedChannels, time );
+#if( REGION_NB_TRANS_REUSE_CHANNEL == 1 )
+    if( ( nextChanParams->Repetition == true ) &&
+        ( RegionCommonChanReusable( &identifyChannelsParam, RegionNvmGroup2->ChannelsMask, *channel, aggregatedTimeOff ) == true ) )
+    { // Repeat the frame on its channel
+        *time = 0;
+        return LORAMAC_STATUS_OK;
+    }
+#endif
+
+    status = RegionCommonIdentifyChannelsMask( &identifyChannelsParam, aggregatedTimeOff, enabledChannelsMask,
+                                               &nbEnabledChannels, &nbRestrictedChannels, time );
 
     if( status == LORAMAC_STATUS_OK )
     {
         // We found a valid channel
-        *channel = enabledChannels[randr( 0, nbEnabledChannels - 1 )];
+        *channel = RegionCommonChanMaskSelect( enabledChannelsMask, CHANNELS_MASK_SIZE, randr( 0, nbEnabledChannels - 1 ) );
     }
     return status;
 }
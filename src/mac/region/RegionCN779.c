@@ -31,6 +31,7 @@
 #include "radio/radio.h"
 #include "RegionCommon.h"
 #include "RegionCN779.h"
+#include <Arduino.h>
 
 // Definitions
 #define CHANNELS_MASK_SIZE              1
@@ -38,8 +39,8 @@
 /*
  * Non-volatile module context.
  */
-static RegionNvmDataGroup1_t* RegionNvmGroup1;
-static RegionNvmDataGroup2_t* RegionNvmGroup2;
+RTC_DATA_ATTR static RegionNvmDataGroup1_t* RegionNvmGroup1;
+RTC_DATA_ATTR static RegionNvmDataGroup2_t* RegionNvmGroup2;
 
 // Static functions
 static bool VerifyRfFreq( uint32_t freq )
@@ -69,7 +70,7 @@ static TimerTime_t GetTimeOnAir( int8_t datarate, uint16_t pktLen )
     }
     else
     {
-        timeOnAir = Radio.TimeOnAir( MODEM_LORA, bandwidth, phyDr, 1, 8, false, pktLen, true );
+        timeOnAir = RegionCommonGetTimeOnAirLoRa( phyDr, bandwidth, pktLen );
     }
     return timeOnAir;
 }
@@ -315,6 +316,17 @@ void RegionCN779InitDefaults( InitDefaultsParams_t* params )
             RegionCommonChanMaskCopy( RegionNvmGroup2->ChannelsMask, RegionNvmGroup2->ChannelsDefaultMask, CHANNELS_MASK_SIZE );
             break;
         }
+        case INIT_TYPE_RESTORE_NVM:
+        {
+            if( ( params->NvmGroup1 == NULL ) || ( params->NvmGroup2 == NULL ) )
+            {
+                return;
+            }
+
+            RegionNvmGroup1 = (RegionNvmDataGroup1_t*) params->NvmGroup1;
+            RegionNvmGroup2 = (RegionNvmDataGroup2_t*) params->NvmGroup2;
+            break;
+        }
         case INIT_TYPE_RESET_TO_DEFAULT_CHANNELS:
         {
             // Reset Channels Rx1Frequency to default 0
@@ -785,6 +797,7 @@ LoRaMacStatus_t RegionCN779NextChannel( NextChanParams_t* nextChanParams, uint8_
     if( RegionCommonCountChannels( RegionNvmGroup2->ChannelsMask, 0, 1 ) == 0 )
     { // Reactivate default channels
         RegionNvmGroup2->ChannelsMask[0] |= LC( 1 ) + LC( 2 ) + LC( 3 );
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     }
 
     // Search how many channels are enabled
@@ -819,6 +832,7 @@ LoRaMacStatus_t RegionCN779NextChannel( NextChanParams_t* nextChanParams, uint8_
     {
         // Datarate not supported by any channel, restore defaults
         RegionNvmGroup2->ChannelsMask[0] |= LC( 1 ) + LC( 2 ) + LC( 3 );
+        LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_REGION_GROUP2 );
     }
     return status;
 }
@@ -54,6 +54,35 @@
 #define DUTY_CYCLE_TIME_PERIOD              1800000
 #endif
 
+#ifndef REGION_COMMON_TOA_CACHE_SIZE
+/*!
+ * Entries of the LoRa time on air cache, power of 2
+ */
+#define REGION_COMMON_TOA_CACHE_SIZE        16
+#endif
+
+/*!
+ * Bits of a time on air cache entry holding the value, the 14 bits above
+ * hold the spreading factor, bandwidth and length. SF12 at 125 kHz with 255
+ * bytes takes less than 10 s.
+ */
+#define TOA_CACHE_VALUE_BITS                18
+
+/*!
+ * Number of 16 bits words of a channels mask of a number of channels
+ */
+#define CHANNELS_MASK_WORDS( nbChannels )   ( ( ( nbChannels ) + 15 ) / 16 )
+
+/*!
+ * Words of the largest channels mask, 96 channels of CN470
+ */
+#define CHANNELS_MASK_MAX_WORDS             6
+
+/*!
+ * Times on air of the last LoRa frame sizes, 0 when empty
+ */
+static uint32_t TimeOnAirCache[REGION_COMMON_TOA_CACHE_SIZE];
+
 /*!
  * \brief Returns `N / D` rounded to the smallest integer value greater than or equal to `N / D`
  *
@@ -202,18 +231,20 @@ static uint16_t UpdateTimeCredits( Band_t* band, bool joined, bool dutyCycleEnab
     return dutyCycle;
 }
 
-static uint8_t CountChannels( uint16_t mask, uint8_t nbBits )
+/*!
+ * \brief Stores the channels of a channels mask in ascending order
+ */
+static void ExpandChannelsMask( uint16_t* channelsMask, uint8_t nbWords, uint8_t* channels )
 {
-    uint8_t nbActiveBits = 0;
+    uint8_t nbChannels = 0;
 
-    for( uint8_t j = 0; j < nbBits; j++ )
+    for( uint8_t k = 0; k < nbWords; k++ )
     {
-        if( ( mask & ( 1 << j ) ) == ( 1 << j ) )
+        for( uint16_t mask = channelsMask[k]; mask != 0; mask &= mask - 1 )
         {
-            nbActiveBits++;
+            channels[nbChannels++] = ( k * 16 ) + __builtin_ctz( mask );
         }
     }
-    return nbActiveBits;
 }
 
 bool RegionCommonChanVerifyDr( uint8_t nbChannels, uint16_t* channelsMask, int8_t dr, int8_t minDr, int8_t maxDr, ChannelParams_t* channels )
@@ -276,7 +307,7 @@ uint8_t RegionCommonCountChannels( uint16_t* channelsMask, uint8_t startIdx, uin
 
     for( uint8_t i = startIdx; i < stopIdx; i++ )
     {
-        nbChannels += CountChannels( channelsMask[i], 16 );
+        nbChannels += __builtin_popcount( channelsMask[i] );
     }
 
     return nbChannels;
@@ -335,8 +366,9 @@ TimerTime_t RegionCommonUpdateBandTimeOff( bool joined, Band_t* bands,
 
         // Check if the band is ready for transmission. Its ready,
         // when the duty cycle is off, or the TimeCredits of the band
-        // is higher than the credit costs for the transmission.
-        if( ( bands[i].TimeCredits > creditCosts ) ||
+        // is at least the credit costs for the transmission. Equal credits
+        // give a time to wait of 0 below, the band is ready then.
+        if( ( bands[i].TimeCredits >= creditCosts ) ||
             ( ( dutyCycleEnabled == false ) && ( joined == true ) ) )
         {
             bands[i].ReadyForTransmission = true;
@@ -489,7 +521,50 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
 
 uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidthInHz )
 {
-    return ( 1 << phyDr ) * 1000000 / bandwidthInHz;
+    // The LoRaWAN bandwidths divide 1 s, the symbol time is a shift of the
+    // chip time
+    switch( bandwidthInHz )
+    {
+        case 125000:
+            return ( uint32_t )8 << phyDr;
+        case 250000:
+            return ( uint32_t )4 << phyDr;
+        case 500000:
+            return ( uint32_t )2 << phyDr;
+        default:
+            return ( uint32_t )( ( ( uint64_t )1 << phyDr ) * 1000000 / bandwidthInHz );
+    }
+}
+
+TimerTime_t RegionCommonGetTimeOnAirLoRa( int8_t phyDr, uint32_t bandwidth, uint16_t pktLen )
+{
+    uint32_t key;
+    uint32_t* entry;
+    uint32_t cached;
+    TimerTime_t timeOnAir;
+
+    if( ( phyDr < 5 ) || ( phyDr > 12 ) || ( bandwidth > 2 ) )
+    {
+        return Radio.TimeOnAir( MODEM_LORA, bandwidth, phyDr, 1, 8, false, pktLen, true );
+    }
+
+    // The radio takes an 8 bits length
+    key = ( ( uint32_t )phyDr << 10 ) | ( bandwidth << 8 ) | ( uint8_t )pktLen;
+    entry = &TimeOnAirCache[( key ^ ( key >> 4 ) ^ ( key >> 10 ) ) & ( REGION_COMMON_TOA_CACHE_SIZE - 1 )];
+    cached = *entry;
+    if( ( cached >> TOA_CACHE_VALUE_BITS ) == key )
+    {
+        return cached & ( ( 1UL << TOA_CACHE_VALUE_BITS ) - 1 );
+    }
+
+    timeOnAir = Radio.TimeOnAir( MODEM_LORA, bandwidth, phyDr, 1, 8, false, pktLen, true );
+    if( timeOnAir < ( 1UL << TOA_CACHE_VALUE_BITS ) )
+    {
+        // Key and value in one word, a reader on another task sees either
+        // the old entry or the new one
+        *entry = ( key << TOA_CACHE_VALUE_BITS ) | timeOnAir;
+    }
+    return timeOnAir;
 }
 
 uint32_t RegionCommonComputeSymbolTimeFsk( uint8_t phyDrInKbps )
@@ -542,133 +617,81 @@ void RegionCommonRxBeaconSetup( RegionCommonRxBeaconSetupParams_t* rxBeaconSetup
     Radio.Rx( rxBeaconSetupParams->RxTime );
 }
 
-#include <Arduino.h>
-
-void RegionCommonCountNbOfEnabledChannels(
-    RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
-    uint8_t* enabledChannels, 
-    uint8_t* nbEnabledChannels, 
-    uint8_t* nbRestrictedChannels) 
+void RegionCommonCountNbOfEnabledChannelsMask( RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
+                                               uint16_t* enabledChannelsMask, uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels )
 {
+    RegionCommonCountNbOfEnabledChannelsParams_t* params = countNbOfEnabledChannelsParams;
+    uint8_t nbWords = CHANNELS_MASK_WORDS( params->MaxNbChannels );
     uint8_t nbChannelCount = 0;
     uint8_t nbRestrictedChannelsCount = 0;
-    
-    // 调试标记
-    bool joined = countNbOfEnabledChannelsParams->Joined;
-    printf("\n[ChannelScan] Device Joined: %s", joined ? "YES" : "NO");
-    printf(" | DR: %u | MaxCh: %u", 
-        countNbOfEnabledChannelsParams->Datarate,
-        countNbOfEnabledChannelsParams->MaxNbChannels);
-    
-    // 打印当前信道掩码配置
-    printf("\n[ChannelMask] HEX: ");
-    for (uint8_t k = 0; k < (countNbOfEnabledChannelsParams->MaxNbChannels+15)/16; k++) {
-        printf("%04X ", countNbOfEnabledChannelsParams->ChannelsMask[k]);
-    }
-
-    // 遍历所有信道
-    for (uint8_t i = 0, k = 0; i < countNbOfEnabledChannelsParams->MaxNbChannels; i += 16, k++) 
-    {
-        for (uint8_t j = 0; j < 16; j++) 
+
+    for( uint8_t k = 0; k < nbWords; k++ )
+    {
+        uint16_t candidates = params->ChannelsMask[k];
+        uint16_t enabled = 0;
+
+        if( ( ( k + 1 ) * 16 ) > params->MaxNbChannels )
         {
-            uint8_t channelIndex = i + j;
-            uint16_t channelMask = (1 << j);
-            bool maskEnabled = (countNbOfEnabledChannelsParams->ChannelsMask[k] & channelMask) != 0;
-            
-            // 跳过未使能信道
-            if (!maskEnabled) {
-                continue;
-            }
+            // No channel above the last one of the region
+            candidates &= ( 1 << ( params->MaxNbChannels % 16 ) ) - 1;
+        }
+        if( ( params->Joined == false ) && ( params->JoinChannels != NULL ) )
+        {
+            // Only the join channels for a join request
+            candidates &= params->JoinChannels[k];
+        }
 
-            // 打印当前信道状态
-            printf("\n[CH:%2d] Masked: YES | Freq: %lu Hz", 
-                channelIndex, countNbOfEnabledChannelsParams->Channels[channelIndex].Frequency);
-            
-            // 检查1: 基础频率是否启用
-            if (countNbOfEnabledChannelsParams->Channels[channelIndex].Frequency == 0) {
-                printf(" | REJECTED: Freq=0 (Channel not enabled)");
-                continue;
-            }
+        // Only the channels of the mask are visited, lowest first
+        for( ; candidates != 0; candidates &= candidates - 1 )
+        {
+            uint8_t bit = __builtin_ctz( candidates );
+            ChannelParams_t* channel = &params->Channels[( k * 16 ) + bit];
 
-            // 检查2: 未加入时Join掩码验证
-            if (!joined && countNbOfEnabledChannelsParams->JoinChannels != NULL) 
-            {
-                bool joinAllowed = (countNbOfEnabledChannelsParams->JoinChannels[k] & channelMask) != 0;
-                printf(" | JoinMask: %s", joinAllowed ? "Allowed" : "Blocked");
-                
-                if (!joinAllowed) {
-                    printf(" | REJECTED: JoinMask disallow");
-                    continue;
-                }
+            if( channel->Frequency == 0 )
+            { // Check if the channel is enabled
+                continue;
             }
-
-            // 检查3: DR范围验证
-            DrRange_t drRange = countNbOfEnabledChannelsParams->Channels[channelIndex].DrRange;
-            bool drValid = RegionCommonValueInRange(
-                countNbOfEnabledChannelsParams->Datarate,
-                drRange.Fields.Min, 
-                drRange.Fields.Max
-            );
-            
-            printf(" | DR Range: %d-%d | CurrDR: %d -> %s",
-                drRange.Fields.Min, drRange.Fields.Max,
-                countNbOfEnabledChannelsParams->Datarate,
-                drValid ? "Valid" : "INVALID");
-            
-            if (!drValid) {
-                printf(" | REJECTED: DR mismatch");
+            if( RegionCommonValueInRange( params->Datarate, channel->DrRange.Fields.Min,
+                                          channel->DrRange.Fields.Max ) == 0 )
+            { // Check if the current channel selection supports the given datarate
                 continue;
             }
-
-            // 检查4: 频段可用性
-            uint8_t bandIdx = countNbOfEnabledChannelsParams->Channels[channelIndex].Band;
-            Band_t* band = &countNbOfEnabledChannelsParams->Bands[bandIdx];
-            printf(" | Band: %d | Ready: %s", bandIdx, band->ReadyForTransmission ? "YES" : "NO");
-            
-            if (!band->ReadyForTransmission) {
+            if( params->Bands[channel->Band].ReadyForTransmission == false )
+            { // Check if the band is available for transmission
                 nbRestrictedChannelsCount++;
-                printf(" | RESTRICTED: Band busy");
                 continue;
             }
-
-            // 通过所有检查的信道
-            enabledChannels[nbChannelCount++] = channelIndex;
-            printf(" | ACCEPTED");
+            enabled |= 1 << bit;
         }
+        enabledChannelsMask[k] = enabled;
+        nbChannelCount += __builtin_popcount( enabled );
     }
-    
-    // 输出最终计数
+
     *nbEnabledChannels = nbChannelCount;
     *nbRestrictedChannels = nbRestrictedChannelsCount;
-    
-    printf("\n[ChannelScanResult] Enabled: %d | Restricted: %d", 
-        *nbEnabledChannels, *nbRestrictedChannels);
-        
-    // 详细列出可用信道
-    if (*nbEnabledChannels > 0) {
-        printf(" | IDs: ");
-        for (int i = 0; i < *nbEnabledChannels; i++) {
-            printf("%d ", enabledChannels[i]);
-        }
-    }
-    printf("\n");
 }
 
+void RegionCommonCountNbOfEnabledChannels( RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
+                                           uint8_t* enabledChannels, uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels )
+{
+    uint16_t enabledChannelsMask[CHANNELS_MASK_MAX_WORDS];
+    uint8_t nbWords = CHANNELS_MASK_WORDS( countNbOfEnabledChannelsParams->MaxNbChannels );
 
+    RegionCommonCountNbOfEnabledChannelsMask( countNbOfEnabledChannelsParams, enabledChannelsMask,
+                                              nbEnabledChannels, nbRestrictedChannels );
+    ExpandChannelsMask( enabledChannelsMask, nbWords, enabledChannels );
+}
 
-LoRaMacStatus_t RegionCommonIdentifyChannels( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam,
-                                              TimerTime_t* aggregatedTimeOff, uint8_t* enabledChannels,
-                                              uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels,
-                                              TimerTime_t* nextTxDelay )
+LoRaMacStatus_t RegionCommonIdentifyChannelsMask( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam,
+                                                  TimerTime_t* aggregatedTimeOff, uint16_t* enabledChannelsMask,
+                                                  uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels,
+                                                  TimerTime_t* nextTxDelay )
 {
     TimerTime_t elapsed = TimerGetElapsedTime( identifyChannelsParam->LastAggrTx );
     *nextTxDelay = identifyChannelsParam->AggrTimeOff - elapsed;
     *nbRestrictedChannels = 1;
     *nbEnabledChannels = 0;
 
-    printf("identifyChannelsParam->LastAggrTx = %d\nelapsed = %d\nidentifyChannelsParam->AggrTimeOff = %d\n", identifyChannelsParam->LastAggrTx, 
-    elapsed, identifyChannelsParam->AggrTimeOff);
-
     if( ( identifyChannelsParam->LastAggrTx == 0 ) ||
         ( identifyChannelsParam->AggrTimeOff <= elapsed ) )
     {
@@ -684,10 +707,10 @@ LoRaMacStatus_t RegionCommonIdentifyChannels( RegionCommonIdentifyChannelsParam_
                                                       identifyChannelsParam->ElapsedTimeSinceStartUp,
                                                       identifyChannelsParam->ExpectedTimeOnAir );
 
-        RegionCommonCountNbOfEnabledChannels( identifyChannelsParam->CountNbOfEnabledChannelsParam, enabledChannels,
-                                              nbEnabledChannels, nbRestrictedChannels );
+        RegionCommonCountNbOfEnabledChannelsMask( identifyChannelsParam->CountNbOfEnabledChannelsParam, enabledChannelsMask,
+                                                  nbEnabledChannels, nbRestrictedChannels );
     }
-printf("\nnbEnabledChannels = %d\nnbRestrictedChannels = %d\n", *nbEnabledChannels, *nbRestrictedChannels);
+
     if( *nbEnabledChannels > 0 )
     {
         *nextTxDelay = 0;
@@ -703,6 +726,92 @@ printf("\nnbEnabledChannels = %d\nnbRestrictedChannels = %d\n", *nbEnabledChanne
     }
 }
 
+LoRaMacStatus_t RegionCommonIdentifyChannels( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam,
+                                              TimerTime_t* aggregatedTimeOff, uint8_t* enabledChannels,
+                                              uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels,
+                                              TimerTime_t* nextTxDelay )
+{
+    uint16_t enabledChannelsMask[CHANNELS_MASK_MAX_WORDS];
+    LoRaMacStatus_t status;
+
+    status = RegionCommonIdentifyChannelsMask( identifyChannelsParam, aggregatedTimeOff, enabledChannelsMask,
+                                               nbEnabledChannels, nbRestrictedChannels, nextTxDelay );
+    if( status == LORAMAC_STATUS_OK )
+    {
+        ExpandChannelsMask( enabledChannelsMask,
+                            CHANNELS_MASK_WORDS( identifyChannelsParam->CountNbOfEnabledChannelsParam->MaxNbChannels ),
+                            enabledChannels );
+    }
+    return status;
+}
+
+uint8_t RegionCommonChanMaskSelect( uint16_t* channelsMask, uint8_t nbWords, uint8_t index )
+{
+    for( uint8_t k = 0; k < nbWords; k++ )
+    {
+        uint16_t mask = channelsMask[k];
+        uint8_t nbChannels = __builtin_popcount( mask );
+
+        if( index >= nbChannels )
+        {
+            index -= nbChannels;
+            continue;
+        }
+        // Skip the low byte if the channel is above it, then the channels
+        // below it one by one
+        nbChannels = __builtin_popcount( mask & 0x00FF );
+        if( index >= nbChannels )
+        {
+            index -= nbChannels;
+            mask &= 0xFF00;
+        }
+        for( ; index > 0; index-- )
+        {
+            mask &= mask - 1;
+        }
+        return ( k * 16 ) + __builtin_ctz( mask );
+    }
+    return 0;
+}
+
+bool RegionCommonChanReusable( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam, uint16_t* channelsMask,
+                               uint8_t channel, TimerTime_t* aggregatedTimeOff )
+{
+    RegionCommonCountNbOfEnabledChannelsParams_t* params = identifyChannelsParam->CountNbOfEnabledChannelsParam;
+    ChannelParams_t* chan;
+    Band_t* band;
+
+    if( ( channel >= params->MaxNbChannels ) || ( ( channelsMask[channel / 16] & ( 1 << ( channel % 16 ) ) ) == 0 ) )
+    {
+        return false;
+    }
+    chan = &params->Channels[channel];
+    if( ( chan->Frequency == 0 ) ||
+        ( RegionCommonValueInRange( params->Datarate, chan->DrRange.Fields.Min, chan->DrRange.Fields.Max ) == 0 ) )
+    {
+        return false;
+    }
+    if( ( identifyChannelsParam->LastAggrTx != 0 ) &&
+        ( identifyChannelsParam->AggrTimeOff > TimerGetElapsedTime( identifyChannelsParam->LastAggrTx ) ) )
+    {
+        return false;
+    }
+
+    // Only the band of the channel is brought up to date, the time-offs of
+    // the other bands stay the ones of the last channel selection
+    band = &params->Bands[chan->Band];
+    RegionCommonUpdateBandTimeOff( params->Joined, band, 1, identifyChannelsParam->DutyCycleEnabled,
+                                   identifyChannelsParam->LastTxIsJoinRequest,
+                                   identifyChannelsParam->ElapsedTimeSinceStartUp,
+                                   identifyChannelsParam->ExpectedTimeOnAir );
+    if( band->ReadyForTransmission == false )
+    {
+        return false;
+    }
+    *aggregatedTimeOff = 0;
+    return true;
+}
+
 int8_t RegionCommonGetNextLowerTxDr( RegionCommonGetNextLowerTxDrParams_t *params )
 {
     int8_t drLocal = params->CurrentDr;
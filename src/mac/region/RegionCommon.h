@@ -94,6 +94,17 @@ extern "C"
  */
 #define REGION_COMMON_DEFAULT_ACK_TIMEOUT_RND           1000
 
+/*!
+ * Set to 1 to send the NbTrans repetitions of an unconfirmed uplink on the
+ * channel of its first transmission, when still allowed, instead of a new
+ * random one ( US915, AU915 and CN470 ). The LoRaWAN specification asks for
+ * frequency hopping between the repetitions, enable it only for a network
+ * which does not require it.
+ */
+#ifndef REGION_NB_TRANS_REUSE_CHANNEL
+#define REGION_NB_TRANS_REUSE_CHANNEL                   0
+#endif
+
 /*!
  * Default Rx1 receive datarate offset
  */
@@ -487,6 +498,22 @@ uint8_t RegionCommonLinkAdrReqVerifyParams( RegionCommonLinkAdrReqVerifyParams_t
  */
 uint32_t RegionCommonComputeSymbolTimeLoRa( uint8_t phyDr, uint32_t bandwidthInHz );
 
+/*!
+ * \brief Computes the time on air of a LoRa frame with the modem parameters of
+ *        the LoRaWAN uplinks: coding rate 4/5, 8 symbols preamble, explicit
+ *        header and CRC. The results are cached, Radio.TimeOnAir only runs
+ *        on a miss.
+ *
+ * \param [IN] phyDr Spreading factor.
+ *
+ * \param [IN] bandwidth Bandwidth index, 0: 125 kHz, 1: 250 kHz, 2: 500 kHz.
+ *
+ * \param [IN] pktLen PHY payload length.
+ *
+ * \retval Returns the time on air in milliseconds, the one of Radio.TimeOnAir.
+ */
+TimerTime_t RegionCommonGetTimeOnAirLoRa( int8_t phyDr, uint32_t bandwidth, uint16_t pktLen );
+
 /*!
  * \brief Computes the symbol time for FSK modulation.
  *
@@ -554,6 +581,23 @@ void RegionCommonRxBeaconSetup( RegionCommonRxBeaconSetupParams_t* rxBeaconSetup
 void RegionCommonCountNbOfEnabledChannels( RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
                                            uint8_t* enabledChannels, uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels );
 
+/*!
+ * \brief Counts the number of enabled channels, into a channels mask. Only the
+ *        channels set in the input mask are visited.
+ *
+ * \param [IN] countNbOfEnabledChannelsParams A pointer to the input parameters.
+ *
+ * \param [OUT] enabledChannelsMask A pointer to a channels mask of the size of the
+ *              one of the region. The function sets the available channels in it.
+ *
+ * \param [OUT] nbEnabledChannels The number of available channels found.
+ *
+ * \param [OUT] nbRestrictedChannels It contains the number of channel
+ *                      which are available, but restricted due to duty cycle.
+ */
+void RegionCommonCountNbOfEnabledChannelsMask( RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
+                                               uint16_t* enabledChannelsMask, uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels );
+
 /*!
  * \brief Identifies all channels which are available currently.
  *
@@ -580,6 +624,65 @@ LoRaMacStatus_t RegionCommonIdentifyChannels( RegionCommonIdentifyChannelsParam_
                                               uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels,
                                               TimerTime_t* nextTxDelay );
 
+/*!
+ * \brief Identifies all channels which are available currently, into a
+ *        channels mask. To pick one with \ref RegionCommonChanMaskSelect.
+ *
+ * \param [IN] identifyChannelsParam A pointer to the input parameters.
+ *
+ * \param [OUT] aggregatedTimeOff The new value of the aggregatedTimeOff. The function
+ *                                may resets it to 0.
+ *
+ * \param [OUT] enabledChannelsMask A pointer to a channels mask of the size of the
+ *              one of the region, valid when the function returns LORAMAC_STATUS_OK.
+ *
+ * \param [OUT] nbEnabledChannels The number of available channels found.
+ *
+ * \param [OUT] nbRestrictedChannels It contains the number of channel
+ *                      which are available, but restricted due to duty cycle.
+ *
+ * \param [OUT] nextTxDelay Holds the time which has to be waited for the next possible
+ *                          uplink transmission.
+ *
+ *\retval Status of the operation.
+ */
+LoRaMacStatus_t RegionCommonIdentifyChannelsMask( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam,
+                                                  TimerTime_t* aggregatedTimeOff, uint16_t* enabledChannelsMask,
+                                                  uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels,
+                                                  TimerTime_t* nextTxDelay );
+
+/*!
+ * \brief Returns a channel of a channels mask by its rank, the channel the
+ *        array of \ref RegionCommonIdentifyChannels holds at this index.
+ *
+ * \param [IN] channelsMask The channels mask.
+ *
+ * \param [IN] nbWords Number of 16 bits words of the mask.
+ *
+ * \param [IN] index Rank of the channel, lower than the number of channels of the mask.
+ *
+ * \retval Returns the channel.
+ */
+uint8_t RegionCommonChanMaskSelect( uint16_t* channelsMask, uint8_t nbWords, uint8_t index );
+
+/*!
+ * \brief Verifies if a repetition of the last uplink can use its channel
+ *        again. Only the band of the channel is updated.
+ *
+ * \param [IN] identifyChannelsParam A pointer to the input parameters.
+ *
+ * \param [IN] channelsMask The channels mask the channel must be enabled in.
+ *
+ * \param [IN] channel The channel of the last uplink.
+ *
+ * \param [OUT] aggregatedTimeOff The new value of the aggregatedTimeOff. The function
+ *                                resets it to 0 when it returns true.
+ *
+ * \retval Returns true if the channel is available now.
+ */
+bool RegionCommonChanReusable( RegionCommonIdentifyChannelsParam_t* identifyChannelsParam, uint16_t* channelsMask,
+                               uint8_t channel, TimerTime_t* aggregatedTimeOff );
+
 /*!
  * \brief Selects the next lower datarate.
  *
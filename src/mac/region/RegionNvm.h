@@ -40,6 +40,42 @@ extern "C"
 
 #include "mac/LoRaMacTypes.h"
 
+// Selection of the regions built in. REGION_ALL builds every region into the
+// image, the region is then chosen at run time ( LmHandlerParams_t.Region ).
+// The NVM data below is sized for the largest one.
+#if defined( REGION_ALL )
+    #ifndef REGION_AS923
+    #define REGION_AS923
+    #endif
+    #ifndef REGION_AU915
+    #define REGION_AU915
+    #endif
+    #ifndef REGION_CN470
+    #define REGION_CN470
+    #endif
+    #ifndef REGION_CN779
+    #define REGION_CN779
+    #endif
+    #ifndef REGION_EU433
+    #define REGION_EU433
+    #endif
+    #ifndef REGION_EU868
+    #define REGION_EU868
+    #endif
+    #ifndef REGION_KR920
+    #define REGION_KR920
+    #endif
+    #ifndef REGION_IN865
+    #define REGION_IN865
+    #endif
+    #ifndef REGION_US915
+    #define REGION_US915
+    #endif
+    #ifndef REGION_RU864
+    #define REGION_RU864
+    #endif
+#endif
+
 // Selection of REGION_NVM_MAX_NB_CHANNELS
 #if defined( REGION_CN470 )
     #define REGION_NVM_MAX_NB_CHANNELS                 96
@@ -51,6 +51,47 @@ typedef enum
     RF_CAD,        //!< The radio is doing channel activity detection   正在进行信道活动探测
 }RadioState_t;
 
+/*!
+ * Number of received frame descriptors. A frame stays allocated from the
+ * RxDone event until the receiver releases it.
+ */
+#ifndef RADIO_RX_FRAME_POOL_SIZE
+#define RADIO_RX_FRAME_POOL_SIZE                    4
+#endif
+
+/*!
+ * Number of DIO1 IRQ events the ISR can queue before the radio driver handles
+ * them
+ */
+#ifndef RADIO_IRQ_QUEUE_SIZE
+#define RADIO_IRQ_QUEUE_SIZE                        8
+#endif
+
+/*!
+ * Maximum received frame size
+ */
+#define RADIO_RX_FRAME_MAX_SIZE                     255
+
+/*!
+ * \brief Received frame descriptor     接收帧描述符
+ *
+ * \remark The payload is read from the radio FIFO straight into the
+ *         descriptor. The RxDone callback gets a pointer to Payload, which
+ *         stays valid until the frame is released with Radio.RxFrameRelease.
+ */
+typedef struct RadioRxFrame_s
+{
+    uint8_t Payload[RADIO_RX_FRAME_MAX_SIZE];
+    uint8_t Size;
+    int16_t Rssi;
+    int8_t Snr;
+    /*!
+     * DIO1 IRQ time of the RX done event, RtcGetTimeUs time base [us]
+     */
+    uint64_t TimestampUs;
+    bool InUse;
+}RadioRxFrame_t;
+
 /*!
  * \brief Radio driver callback functions   天线驱动回调函数
  */
@@ -67,6 +108,9 @@ typedef struct
     /*!
      * \brief Rx Done callback prototype.       接收完成回调原型
      *
+     * \remark The payload belongs to a received frame descriptor. The receiver
+     *         gives it back with Radio.RxFrameRelease once it is done with it.
+     *
      * \param [IN] payload Received buffer pointer    接收数据buff头指针
      * \param [IN] size    Received buffer size       接收数据尺寸
      * \param [IN] rssi    RSSI value computed while receiving the frame [dBm]      信号强度
@@ -429,7 +473,30 @@ struct Radio_s
       * \brief Process radio irq after CPU wakeup from deep sleep
      */
 	void (*IrqProcessAfterDeepSleep)(void);
-	
+    /*!
+     * \brief Gets the descriptor of a received frame     获取接收帧描述符
+     *
+     * \param [IN] payload Payload pointer given to the RxDone callback
+     * \retval frame Frame descriptor, NULL if payload is not a received frame
+     */
+    RadioRxFrame_t* ( *RxFrameGet )( uint8_t *payload );
+    /*!
+     * \brief Releases a received frame        释放接收帧
+     *
+     * \param [IN] payload Payload pointer given to the RxDone callback. NULL is ignored.
+     */
+    void ( *RxFrameRelease )( uint8_t *payload );
+    /*!
+     * \brief Gets the time of the event reported by the running RadioEvents_t
+     *        callback    获取当前回调事件的中断时间
+     *
+     * \remark DIO1 IRQ time captured in the ISR for TxDone, RxDone, RxError,
+     *         CadDone and the radio timeouts, expiry time for the timeouts of
+     *         the driver timers. Only valid inside the callbacks.
+     *
+     * \retval time Event time, RtcGetTimeUs time base [us]
+     */
+    uint64_t ( *GetEventTime )( void );
 };
 
 /*!
@@ -444,6 +511,52 @@ extern const struct Radio_s Radio2;
 
 void reInitEvent(RadioEvents_t *events);
 
+/*!
+ * \brief Gets the number of frames dropped because no descriptor was free
+ */
+uint32_t RadioRxFrameGetDropped( void );
+
+/*!
+ * \brief DIO1 IRQ events statistics
+ */
+typedef struct RadioIrqStats_s
+{
+    /*!
+     * DIO1 edges queued by the ISR
+     */
+    uint32_t Events;
+    /*!
+     * DIO1 edges lost because the queue was full, their IRQs are handled with
+     * a later event
+     */
+    uint32_t Dropped;
+    /*!
+     * IRQs raised while DIO1 was still high, handled without an edge of their
+     * own
+     */
+    uint32_t Coalesced;
+    /*!
+     * Edges whose IRQs were already handled with a previous event
+     */
+    uint32_t Empty;
+    /*!
+     * Most events queued at once
+     */
+    uint32_t MaxDepth;
+}RadioIrqStats_t;
+
+/*!
+ * \brief Gets the DIO1 IRQ events statistics
+ *
+ * \param [OUT] stats Statistics
+ */
+void RadioGetIrqStats( RadioIrqStats_t *stats );
+
+/*!
+ * \brief Resets the DIO1 IRQ events statistics
+ */
+void RadioResetIrqStats( void );
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,7 @@
 #include "radio/radio.h"
 #include "boards/sx126x-board.h"
 #include "boards/mcu/board.h"
+#include "boards/rtc-board.h"
 
 /*!
  * \brief Initializes the radio
@@ -370,6 +371,28 @@ void RadioBgIrqProcess(void);
  */
 void RadioIrqProcessAfterDeepSleep(void);
 
+/*!
+ * \brief Gets the descriptor of a received frame
+ *
+ * \param [IN] payload Payload pointer given to the RxDone callback
+ * \retval frame Frame descriptor, NULL if payload is not a received frame
+ */
+RadioRxFrame_t* RadioRxFrameGet( uint8_t *payload );
+
+/*!
+ * \brief Releases a received frame
+ *
+ * \param [IN] payload Payload pointer given to the RxDone callback
+ */
+void RadioRxFrameRelease( uint8_t *payload );
+
+/*!
+ * \brief Gets the time of the event reported by the running callback
+ *
+ * \retval time Event time, RtcGetTimeUs time base [us]
+ */
+uint64_t RadioGetEventTime( void );
+
 /*!
  * Radio driver structure initialization
  */
@@ -406,7 +429,10 @@ const struct Radio_s Radio =
     RadioBgIrqProcess,
     RadioReInit,
     RadioSetCadParams,
-    RadioIrqProcessAfterDeepSleep
+    RadioIrqProcessAfterDeepSleep,
+    RadioRxFrameGet,
+    RadioRxFrameRelease,
+    RadioGetEventTime
 };
 
 const struct Radio_s Radio2 =
@@ -442,7 +468,10 @@ const struct Radio_s Radio2 =
     RadioBgIrqProcess,
     RadioReInit,
     RadioSetCadParams,
-    RadioIrqProcessAfterDeepSleep
+    RadioIrqProcessAfterDeepSleep,
+    RadioRxFrameGet,
+    RadioRxFrameRelease,
+    RadioGetEventTime
 };
 
 /*
@@ -501,16 +530,74 @@ bool RxContinuous = false;
 
 
 PacketStatus_t RadioPktStatus;
-uint8_t RadioRxPayload[255];
+
+/*!
+ * Received frame descriptors
+ */
+static RadioRxFrame_t RadioRxFrames[RADIO_RX_FRAME_POOL_SIZE];
+
+/*!
+ * Frames dropped because all the descriptors were in use
+ */
+static uint32_t RadioRxFramesDropped = 0;
+
+/*!
+ * DIO1 IRQ event
+ */
+typedef struct RadioIrqEvent_s
+{
+    /*!
+     * Time of the DIO1 edge, RtcGetTimeUs time base [us]
+     */
+    uint64_t TimeUs;
+    /*!
+     * IRQ status bits read and cleared for the event
+     */
+    uint16_t IrqMask;
+}RadioIrqEvent_t;
+
+/*!
+ * DIO1 IRQ events queue, single consumer: the driver under the radio lock.
+ * The ISR cannot read the IRQ status over SPI, it queues the time of the edge
+ * and the driver reads the status bits when it handles the event.
+ */
+typedef struct RadioIrqQueue_s
+{
+    uint64_t TimeUs[RADIO_IRQ_QUEUE_SIZE];
+    /*!
+     * Written under BoardDisableIrq
+     */
+    uint32_t Head;
+    /*!
+     * Written by the consumer
+     */
+    uint32_t Tail;
+    RadioIrqStats_t Stats;
+}RadioIrqQueue_t;
 
 #if defined(ESP32)
-bool DRAM_ATTR IrqFired = false;
+static DRAM_ATTR RadioIrqQueue_t RadioIrqQueue;
 #else
-bool IrqFired = false;
+static RadioIrqQueue_t RadioIrqQueue;
 #endif
 
 bool TimerRxTimeout = false;
 bool TimerTxTimeout = false;
+
+/*!
+ * Time of the event being dispatched to the callbacks, of the last DIO1 IRQ
+ * and of the driver timers timeouts [us]
+ */
+static uint64_t RadioEventTimeUs = 0;
+static uint64_t RadioIrqTimeUs = 0;
+static uint64_t RadioRxTimeoutTimeUs = 0;
+static uint64_t RadioTxTimeoutTimeUs = 0;
+
+/*!
+ * BUSY timeouts reported to the MAC, see SX126xGetBusyTimeoutCount
+ */
+static uint32_t RadioBusyTimeoutsReported = 0;
+
 /*
  * SX126x DIO IRQ callback functions prototype
  */
@@ -530,6 +617,17 @@ void RadioOnTxTimeoutIrq( void );
  */
 void RadioOnRxTimeoutIrq( void );
 
+/*!
+ * \brief Drops the DIO1 IRQ events queued
+ */
+static void RadioIrqQueueFlush( void );
+
+/*!
+ * \brief Checks if the LoRa packets have no header, the timeout workaround of
+ *        the receptions only applies to them
+ */
+static bool RadioImplicitHeader( void );
+
 /*
  * Private global variables
  */
@@ -605,12 +703,10 @@ void RadioInit( RadioEvents_t *events )
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, IRQ_RADIO_ALL, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
 
     // Initialize driver timeout timers
-    TxTimeoutTimer.oneShot = true;
-	RxTimeoutTimer.oneShot = true;
     TimerInit( &TxTimeoutTimer, RadioOnTxTimeoutIrq );
     TimerInit( &RxTimeoutTimer, RadioOnRxTimeoutIrq );
 
-    IrqFired = false;
+    RadioIrqQueueFlush( );
 }
 
 void RadioInit2( RadioEvents_t *events )
@@ -626,12 +722,26 @@ void RadioInit2( RadioEvents_t *events )
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, IRQ_RADIO_ALL, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
 
     // Initialize driver timeout timers
-    TxTimeoutTimer.oneShot = true;
-	RxTimeoutTimer.oneShot = true;
     TimerInit( &TxTimeoutTimer, RadioOnTxTimeoutIrq );
     TimerInit( &RxTimeoutTimer, RadioOnRxTimeoutIrq );
 
-    IrqFired = false;
+    RadioIrqQueueFlush( );
+}
+
+/*!
+ * \brief Puts the radio back in standby with the configuration of RadioInit,
+ *        after a command it did not complete. The events and the timers are
+ *        kept.
+ */
+static void RadioRecover( void )
+{
+    SX126xInit( RadioOnDioIrq );
+    SX126xSetStandby( STDBY_RC );
+    SX126xSetRegulatorMode( USE_DCDC );
+
+    SX126xSetBufferBaseAddress( 0x00, 0x00 );
+    SX126xSetTxParams( 0, RADIO_RAMP_200_US );
+    SX126xSetDioIrqParams( IRQ_RADIO_ALL, IRQ_RADIO_ALL, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
 }
 
 void RadioReInit(RadioEvents_t *events)
@@ -640,12 +750,10 @@ void RadioReInit(RadioEvents_t *events)
 	SX126xReInit(RadioOnDioIrq);
 
 	// Initialize driver timeout timers
-	TxTimeoutTimer.oneShot = true;
-	RxTimeoutTimer.oneShot = true;
 	TimerInit(&TxTimeoutTimer, RadioOnTxTimeoutIrq);
 	TimerInit(&RxTimeoutTimer, RadioOnRxTimeoutIrq);
 
-	IrqFired = false;
+	RadioIrqQueueFlush();
 }
 
 void reInitEvent(RadioEvents_t *events){
@@ -653,6 +761,113 @@ void reInitEvent(RadioEvents_t *events){
 	//SX126xReInit(RadioOnDioIrq);
 }
 
+/*!
+ * \brief Takes a free received frame descriptor
+ *
+ * \retval frame Frame descriptor, NULL if all of them are in use
+ */
+static RadioRxFrame_t* RadioRxFrameAlloc( void )
+{
+    RadioRxFrame_t *frame = NULL;
+
+    BoardDisableIrq( );
+    for( uint8_t i = 0; i < RADIO_RX_FRAME_POOL_SIZE; i++ )
+    {
+        if( RadioRxFrames[i].InUse == false )
+        {
+            frame = &RadioRxFrames[i];
+            frame->InUse = true;
+            break;
+        }
+    }
+    if( frame == NULL )
+    {
+        RadioRxFramesDropped++;
+    }
+    BoardEnableIrq( );
+    return frame;
+}
+
+/*!
+ * \brief Reads the received frame from the radio FIFO into a descriptor and
+ *        hands it to the RxDone callback
+ */
+static void RadioRxFrameDeliver( void )
+{
+    RadioRxFrame_t *frame = RadioRxFrameAlloc( );
+
+    if( frame == NULL )
+    {
+        // The frame is left in the radio FIFO
+        if( ( RadioEvents != NULL ) && ( RadioEvents->RxError != NULL ) )
+        {
+            RadioEvents->RxError( );
+        }
+        return;
+    }
+    frame->TimestampUs = RadioIrqTimeUs;
+    SX126xGetPayload( frame->Payload, &frame->Size, RADIO_RX_FRAME_MAX_SIZE );
+    SX126xGetPacketStatus( &RadioPktStatus );
+    frame->Rssi = RadioPktStatus.Params.LoRa.RssiPkt;
+    frame->Snr = RadioPktStatus.Params.LoRa.SnrPkt;
+    if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+    {
+        RadioEvents->RxDone( frame->Payload, frame->Size, frame->Rssi, frame->Snr );
+    }
+    else
+    {
+        RadioRxFrameRelease( frame->Payload );
+    }
+}
+
+RadioRxFrame_t* RadioRxFrameGet( uint8_t *payload )
+{
+    for( uint8_t i = 0; i < RADIO_RX_FRAME_POOL_SIZE; i++ )
+    {
+        if( payload == RadioRxFrames[i].Payload )
+        {
+            return &RadioRxFrames[i];
+        }
+    }
+    return NULL;
+}
+
+uint64_t RadioGetEventTime( void )
+{
+    return RadioEventTimeUs;
+}
+
+void RadioRxFrameRelease( uint8_t *payload )
+{
+    RadioRxFrame_t *frame = RadioRxFrameGet( payload );
+
+    if( frame != NULL )
+    {
+        BoardDisableIrq( );
+        frame->InUse = false;
+        BoardEnableIrq( );
+    }
+}
+
+uint32_t RadioRxFrameGetDropped( void )
+{
+    return RadioRxFramesDropped;
+}
+
+void RadioGetIrqStats( RadioIrqStats_t *stats )
+{
+    BoardDisableIrq( );
+    *stats = RadioIrqQueue.Stats;
+    BoardEnableIrq( );
+}
+
+void RadioResetIrqStats( void )
+{
+    BoardDisableIrq( );
+    memset( &RadioIrqQueue.Stats, 0, sizeof( RadioIrqQueue.Stats ) );
+    BoardEnableIrq( );
+}
+
 RadioState_t RadioGetStatus( void )
 {
     switch( SX126xGetOperatingMode( ) )
@@ -757,6 +972,7 @@ void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
                          bool crcOn, bool freqHopOn, uint8_t hopPeriod,
                          bool iqInverted, bool rxContinuous )
 {
+    SX126xRegBatch_t batch;
 
     RxContinuous = rxContinuous;
     if( rxContinuous == true )
@@ -858,16 +1074,12 @@ void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
             SX126xSetLoRaSymbNumTimeout( symbTimeout );
 
             // WORKAROUND - Optimizing the Inverted IQ Operation, see DS_SX1261-2_V1.2 datasheet chapter 15.4
-            if( SX126x.PacketParams.Params.LoRa.InvertIQ == LORA_IQ_INVERTED )
-            {
-                // RegIqPolaritySetup = @address 0x0736
-                SX126xWriteRegister( 0x0736, SX126xReadRegister( 0x0736 ) & ~( 1 << 2 ) );
-            }
-            else
-            {
-                // RegIqPolaritySetup @address 0x0736
-                SX126xWriteRegister( 0x0736, SX126xReadRegister( 0x0736 ) | ( 1 << 2 ) );
-            }
+            // RegIqPolaritySetup = @address 0x0736, read once and then known
+            // from its shadow copy
+            SX126xRegBatchInit( &batch );
+            SX126xRegBatchUpdate( &batch, 0x0736, 1 << 2,
+                                  ( SX126x.PacketParams.Params.LoRa.InvertIQ == LORA_IQ_INVERTED ) ? 0 : ( 1 << 2 ) );
+            SX126xRegBatchCommit( &batch );
             // WORKAROUND END
 
             // Timeout Max, Timeout handled directly in SetRx function
@@ -883,6 +1095,7 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
                         bool fixLen, bool crcOn, bool freqHopOn,
                         uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
 {
+    SX126xRegBatch_t batch;
 
     switch( modem )
     {
@@ -967,16 +1180,11 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
     }
 
     // WORKAROUND - Modulation Quality with 500 kHz LoRa Bandwidth, see DS_SX1261-2_V1.2 datasheet chapter 15.1
-    if( ( modem == MODEM_LORA ) && ( SX126x.ModulationParams.Params.LoRa.Bandwidth == LORA_BW_500 ) )
-    {
-        // RegTxModulation = @address 0x0889
-        SX126xWriteRegister( 0x0889, SX126xReadRegister( 0x0889 ) & ~( 1 << 2 ) );
-    }
-    else
-    {
-        // RegTxModulation = @address 0x0889
-        SX126xWriteRegister( 0x0889, SX126xReadRegister( 0x0889 ) | ( 1 << 2 ) );
-    }
+    // RegTxModulation = @address 0x0889
+    SX126xRegBatchInit( &batch );
+    SX126xRegBatchUpdate( &batch, 0x0889, 1 << 2,
+                          ( ( modem == MODEM_LORA ) && ( SX126x.ModulationParams.Params.LoRa.Bandwidth == LORA_BW_500 ) ) ? 0 : ( 1 << 2 ) );
+    SX126xRegBatchCommit( &batch );
     // WORKAROUND END
 
     SX126xSetRfTxPower( power );
@@ -1181,11 +1389,34 @@ void RadioStandby( void )
     SX126xSetStandby( STDBY_RC );
 }
 
+static bool RadioImplicitHeader( void )
+{
+    return ( SX126x.PacketParams.PacketType == PACKET_TYPE_LORA ) &&
+           ( SX126x.PacketParams.Params.LoRa.HeaderType == LORA_PACKET_FIXED_LENGTH );
+}
+
+/*!
+ * \brief DIO1 IRQs of the receptions
+ *
+ * \remark DIO1 stays high until the IRQ status is cleared. An edge on the
+ *         preamble or the header would hide the RX done edge and its time when
+ *         the IRQ is not processed before the end of the frame, they are only
+ *         routed to DIO1 for the PreAmpDetect callback.
+ */
+static uint16_t RadioRxDio1Mask( void )
+{
+    if( ( RadioEvents != NULL ) && ( RadioEvents->PreAmpDetect != NULL ) )
+    {
+        return IRQ_RADIO_ALL;
+    }
+    return IRQ_RADIO_ALL & ~( IRQ_PREAMBLE_DETECTED | IRQ_SYNCWORD_VALID | IRQ_HEADER_VALID );
+}
+
 void RadioRx( uint32_t timeout )
 {
     SX126xRXena();
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
-                           IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
+                           RadioRxDio1Mask( ),
                            IRQ_RADIO_NONE,
                            IRQ_RADIO_NONE );
 
@@ -1208,7 +1439,7 @@ void RadioRx( uint32_t timeout )
 void RadioRxBoosted( uint32_t timeout )
 {
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
-                           IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
+                           RadioRxDio1Mask( ),
                            IRQ_RADIO_NONE,
                            IRQ_RADIO_NONE );
 
@@ -1276,6 +1507,7 @@ int16_t RadioRssi( RadioModems_t modem )
 void RadioWrite( uint32_t addr, uint8_t data )
 {
     SX126xWriteRegister( addr, data );
+    SX126xShadowForget( addr, 1 );
 }
 
 uint8_t RadioRead( uint32_t addr )
@@ -1286,6 +1518,7 @@ uint8_t RadioRead( uint32_t addr )
 void RadioWriteBuffer( uint32_t addr, uint8_t *buffer, uint8_t size )
 {
     SX126xWriteRegisters( addr, buffer, size );
+    SX126xShadowForget( addr, size );
 }
 
 void RadioReadBuffer( uint32_t addr, uint8_t *buffer, uint8_t size )
@@ -1312,21 +1545,24 @@ void RadioSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
 
 void RadioSetPublicNetwork( bool enable )
 {
+    SX126xRegBatch_t batch;
+
     RadioPublicNetwork.Current = RadioPublicNetwork.Previous = enable;
 
     RadioSetModem( MODEM_LORA );
+    // Change LoRa modem SyncWord, both bytes in one write
+    SX126xRegBatchInit( &batch );
     if( enable == true )
     {
-        // Change LoRa modem SyncWord
-        SX126xWriteRegister( REG_LR_SYNCWORD, ( LORA_MAC_PUBLIC_SYNCWORD >> 8 ) & 0xFF );
-        SX126xWriteRegister( REG_LR_SYNCWORD + 1, LORA_MAC_PUBLIC_SYNCWORD & 0xFF );
+        SX126xRegBatchWrite( &batch, REG_LR_SYNCWORD, ( LORA_MAC_PUBLIC_SYNCWORD >> 8 ) & 0xFF );
+        SX126xRegBatchWrite( &batch, REG_LR_SYNCWORD + 1, LORA_MAC_PUBLIC_SYNCWORD & 0xFF );
     }
     else
     {
-        // Change LoRa modem SyncWord
-        SX126xWriteRegister( REG_LR_SYNCWORD, ( LORA_MAC_PRIVATE_SYNCWORD >> 8 ) & 0xFF );
-        SX126xWriteRegister( REG_LR_SYNCWORD + 1, LORA_MAC_PRIVATE_SYNCWORD & 0xFF );
+        SX126xRegBatchWrite( &batch, REG_LR_SYNCWORD, ( LORA_MAC_PRIVATE_SYNCWORD >> 8 ) & 0xFF );
+        SX126xRegBatchWrite( &batch, REG_LR_SYNCWORD + 1, LORA_MAC_PRIVATE_SYNCWORD & 0xFF );
     }
+    SX126xRegBatchCommit( &batch );
 }
 
 uint32_t RadioGetWakeupTime( void )
@@ -1345,6 +1581,7 @@ void RadioOnTxTimeoutIrq( void )
 	BoardDisableIrq();
 	TimerTxTimeout = true;
 	BoardEnableIrq();
+	RadioTxTimeoutTimeUs = TxTimeoutTimer.Timestamp;
 	TimerStop(&TxTimeoutTimer);
 }
 
@@ -1357,37 +1594,150 @@ void RadioOnRxTimeoutIrq( void )
 	BoardDisableIrq();
 	TimerRxTimeout = true;
 	BoardEnableIrq();
+	RadioRxTimeoutTimeUs = RxTimeoutTimer.Timestamp;
 	TimerStop(&RxTimeoutTimer);
 	if ((RadioEvents != NULL) && (RadioEvents->RxTimeout != NULL))
 	{
+		RadioEventTimeUs = RadioRxTimeoutTimeUs;
 	 	RadioEvents->RxTimeout();
 	}
 }
 
 /** Semaphore used by SX126x IRQ handler to wake up LoRaWAN task */
 extern SemaphoreHandle_t loraIntSem;
+/** Semaphore of the radio service task, NULL when the LoRa task drains the IRQs ( lora-task.h ) */
+extern SemaphoreHandle_t loraRadioSem;
 static BaseType_t xHigherPriorityTaskWoken = pdTRUE;
 
+/*!
+ * \brief Queues a DIO1 IRQ event
+ *
+ * \param [IN] timeUs Time of the DIO1 edge [us]
+ */
+static void IRAM_ATTR RadioIrqEventPush( uint64_t timeUs )
+{
+    uint32_t head;
+    uint32_t depth;
+
+    BoardDisableIrq( );
+    head = RadioIrqQueue.Head;
+    depth = head - __atomic_load_n( &RadioIrqQueue.Tail, __ATOMIC_ACQUIRE );
+    if( depth < RADIO_IRQ_QUEUE_SIZE )
+    {
+        RadioIrqQueue.TimeUs[head % RADIO_IRQ_QUEUE_SIZE] = timeUs;
+        __atomic_store_n( &RadioIrqQueue.Head, head + 1, __ATOMIC_RELEASE );
+        RadioIrqQueue.Stats.Events++;
+        if( ( depth + 1 ) > RadioIrqQueue.Stats.MaxDepth )
+        {
+            RadioIrqQueue.Stats.MaxDepth = depth + 1;
+        }
+    }
+    else
+    {
+        RadioIrqQueue.Stats.Dropped++;
+    }
+    BoardEnableIrq( );
+}
+
+/*!
+ * \brief Takes the oldest DIO1 IRQ event queued
+ *
+ * \param [OUT] timeUs Time of the DIO1 edge [us]
+ * \retval pending true if an event was queued
+ */
+static bool RadioIrqEventPop( uint64_t *timeUs )
+{
+    uint32_t tail = RadioIrqQueue.Tail;
+
+    if( tail == __atomic_load_n( &RadioIrqQueue.Head, __ATOMIC_ACQUIRE ) )
+    {
+        return false;
+    }
+    *timeUs = RadioIrqQueue.TimeUs[tail % RADIO_IRQ_QUEUE_SIZE];
+    __atomic_store_n( &RadioIrqQueue.Tail, tail + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+static void RadioIrqQueueFlush( void )
+{
+    SX126xRadioLock( );
+    BoardDisableIrq( );
+    __atomic_store_n( &RadioIrqQueue.Tail, RadioIrqQueue.Head, __ATOMIC_RELEASE );
+    BoardEnableIrq( );
+    SX126xRadioUnlock( );
+}
+
+/*!
+ * \brief Reads the IRQ status and clears the bits read only. An IRQ raised
+ *        in between stays set for the next event.
+ *
+ * \retval irqRegs IRQ status bits read
+ */
+static uint16_t RadioIrqStatusTake( void )
+{
+    uint16_t irqRegs = SX126xGetIrqStatus( );
+
+    if( irqRegs != IRQ_RADIO_NONE )
+    {
+        SX126xClearIrqStatus( irqRegs );
+    }
+    return irqRegs;
+}
+
+/*!
+ * \brief Gets the next DIO1 IRQ event to handle, with its IRQ status bits.
+ *        The caller holds the radio lock.
+ *
+ * \param [OUT] event Event to handle
+ * \retval pending true if an event is returned, its IRQ mask can be empty
+ */
+static bool RadioIrqEventNext( RadioIrqEvent_t *event )
+{
+    if( RadioIrqEventPop( &event->TimeUs ) == true )
+    {
+        event->IrqMask = RadioIrqStatusTake( );
+        if( event->IrqMask == IRQ_RADIO_NONE )
+        {
+            BoardDisableIrq( );
+            RadioIrqQueue.Stats.Empty++;
+            BoardEnableIrq( );
+        }
+        return true;
+    }
+    // DIO1 does not rise again for an IRQ raised while it was still high
+    if( SX126xGetDio1PinState( ) != 0 )
+    {
+        event->TimeUs = RtcGetTimeUs( );
+        event->IrqMask = RadioIrqStatusTake( );
+        if( event->IrqMask != IRQ_RADIO_NONE )
+        {
+            BoardDisableIrq( );
+            RadioIrqQueue.Stats.Coalesced++;
+            BoardEnableIrq( );
+            return true;
+        }
+    }
+    return false;
+}
+
 void IRAM_ATTR RadioOnDioIrq( void )    // add IRAM_ATTR mating
 {// mating mod
-	BoardDisableIrq();
-	IrqFired = true;
-	BoardEnableIrq();
+	RadioIrqEventPush(SX126xGetDio1IrqTimeUs());
 	// Wake up LoRa event handler on nRF52 and ESP32
-	xSemaphoreGiveFromISR(loraIntSem, &xHigherPriorityTaskWoken);
+	xSemaphoreGiveFromISR((loraRadioSem != NULL) ? loraRadioSem : loraIntSem, &xHigherPriorityTaskWoken);
 }
 
 void RadioIrqProcess( void )
 {
-    if( IrqFired == true )
+    RadioIrqEvent_t event;
+
+    SX126xRadioLock( );
+    while( RadioIrqEventNext( &event ) == true )
     {
-        CRITICAL_SECTION_BEGIN( );
-        // Clear IRQ flag
-        IrqFired = false;
-        CRITICAL_SECTION_END( );
+        RadioIrqTimeUs = event.TimeUs;
+        RadioEventTimeUs = RadioIrqTimeUs;
 
-        uint16_t irqRegs = SX126xGetIrqStatus( );
-        SX126xClearIrqStatus( irqRegs );
+        uint16_t irqRegs = event.IrqMask;
 
         if( ( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
         {
@@ -1416,8 +1766,6 @@ void RadioIrqProcess( void )
             }
             else
             {
-                uint8_t size;
-
                 TimerStop( &RxTimeoutTimer );
                 if( RxContinuous == false )
                 {
@@ -1425,18 +1773,16 @@ void RadioIrqProcess( void )
                     SX126xSetOperatingMode( MODE_STDBY_RC );
 
                     // WORKAROUND - Implicit Header Mode Timeout Behavior, see DS_SX1261-2_V1.2 datasheet chapter 15.3
-                    // RegRtcControl = @address 0x0902
-                    SX126xWriteRegister( 0x0902, 0x00 );
-                    // RegEventMask = @address 0x0944
-                    SX126xWriteRegister( 0x0944, SX126xReadRegister( 0x0944 ) | ( 1 << 1 ) );
+                    if( RadioImplicitHeader( ) == true )
+                    {
+                        // RegRtcControl = @address 0x0902
+                        SX126xWriteRegister( 0x0902, 0x00 );
+                        // RegEventMask = @address 0x0944
+                        SX126xWriteRegister( 0x0944, SX126xReadRegister( 0x0944 ) | ( 1 << 1 ) );
+                    }
                     // WORKAROUND END
                 }
-                SX126xGetPayload( RadioRxPayload, &size , 255 );
-                SX126xGetPacketStatus( &RadioPktStatus );
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
-                {
-                    RadioEvents->RxDone( RadioRxPayload, size, RadioPktStatus.Params.LoRa.RssiPkt, RadioPktStatus.Params.LoRa.SnrPkt );
-                }
+                RadioRxFrameDeliver( );
             }
         }
 
@@ -1503,22 +1849,52 @@ void RadioIrqProcess( void )
             }
         }
     }
+    SX126xRadioUnlock( );
 }
 
 void RadioBgIrqProcess(void)
 {
+	RadioIrqEvent_t event;
 	bool rx_timeout_handled = false;
 	bool tx_timeout_handled = false;
-	if (IrqFired == true)
+	uint32_t busyTimeouts;
+
+	// The radio service task and the MAC task both get here
+	SX126xRadioLock();
+	// A command did not complete. A transmission or a reception running is
+	// failed with a TX or RX timeout. In the other modes (sleep, standby, FS,
+	// CAD) no MAC operation waits for the radio: it is recovered without an
+	// event, the board already dropped the shadow copies
+	busyTimeouts = SX126xGetBusyTimeoutCount();
+	if (busyTimeouts != RadioBusyTimeoutsReported)
 	{
-		BoardDisableIrq();
-		IrqFired = false;
-		BoardEnableIrq();
-        //获取中断状态
-		uint16_t irqRegs = SX126xGetIrqStatus();
-		//清楚中断状态
+		LOG_LIB("RADIO", "RadioIrqProcess => BUSY timeout");
+		if (SX126xGetOperatingMode() == MODE_TX)
+		{
+			TimerTxTimeout = true;
+			RadioTxTimeoutTimeUs = RtcGetTimeUs();
+		}
+		else if ((SX126xGetOperatingMode() == MODE_RX) || (SX126xGetOperatingMode() == MODE_RX_DC))
+		{
+			TimerRxTimeout = true;
+			RadioRxTimeoutTimeUs = RtcGetTimeUs();
+		}
+		else
+		{
+			RadioRecover();
+			// A radio still hung is reported by the next command of the MAC
+			busyTimeouts = SX126xGetBusyTimeoutCount();
+		}
+	}
+	// One event per DIO1 edge, in order
+	while (RadioIrqEventNext(&event) == true)
+	{
+		// Time of the DIO1 edge, the callbacks get it with Radio.GetEventTime
+		RadioIrqTimeUs = event.TimeUs;
+		RadioEventTimeUs = RadioIrqTimeUs;
+        //获取中断状态，只清除读到的中断
+		uint16_t irqRegs = event.IrqMask;
 		//printf("irqreg=0x%x\r\n",irqRegs);
-		SX126xClearIrqStatus(IRQ_RADIO_ALL);
         //发送完成
 		if ((irqRegs & IRQ_TX_DONE) == IRQ_TX_DONE)
 		{
@@ -1536,8 +1912,6 @@ void RadioBgIrqProcess(void)
         //接受数据完成
 		if ((irqRegs & IRQ_RX_DONE) == IRQ_RX_DONE)
 		{
-			uint8_t size;
-
 			rx_timeout_handled = true;
 			TimerStop(&RxTimeoutTimer);
 			if (RxContinuous == false)
@@ -1546,23 +1920,20 @@ void RadioBgIrqProcess(void)
 				SX126xSetOperatingMode(MODE_STDBY_RC);
 
 				// WORKAROUND - Implicit Header Mode Timeout Behavior, see DS_SX1261-2_V1.2 datasheet chapter 15.3
-				// RegRtcControl = @address 0x0902
-				SX126xWriteRegister(0x0902, 0x00);
-				// RegEventMask = @address 0x0944
-				SX126xWriteRegister(0x0944, SX126xReadRegister(0x0944) | (1 << 1));
+				if (RadioImplicitHeader() == true)
+				{
+					// RegRtcControl = @address 0x0902
+					SX126xWriteRegister(0x0902, 0x00);
+					// RegEventMask = @address 0x0944
+					SX126xWriteRegister(0x0944, SX126xReadRegister(0x0944) | (1 << 1));
+				}
 				// WORKAROUND END
 			}
-			memset(RadioRxPayload, 0, 255);
-
 			if ((irqRegs & IRQ_CRC_ERROR) == IRQ_CRC_ERROR)
 			{
 				LOG_LIB("RADIO", "RadioIrqProcess => IRQ_CRC_ERROR");
 
-				uint8_t size;
-				// Discard buffer
-				memset(RadioRxPayload, 0, 255);
-				SX126xGetPayload(RadioRxPayload, &size, 255);
-				SX126xGetPacketStatus(&RadioPktStatus);
+				// The frame is discarded, it is not read out of the radio FIFO
 				if ((RadioEvents != NULL) && (RadioEvents->RxError))
 				{
 					RadioEvents->RxError();
@@ -1570,13 +1941,7 @@ void RadioBgIrqProcess(void)
 			}
 			else
 			{
-				SX126xGetPayload(RadioRxPayload, &size, 255);
-				SX126xGetPacketStatus(&RadioPktStatus);
-				//printf("size=%d\n",size);
-				if ((RadioEvents != NULL) && (RadioEvents->RxDone != NULL))
-				{
-					RadioEvents->RxDone(RadioRxPayload, size, RadioPktStatus.Params.LoRa.RssiPkt, RadioPktStatus.Params.LoRa.SnrPkt);
-				}
+				RadioRxFrameDeliver();
 			}
 		}
 
@@ -1662,6 +2027,7 @@ void RadioBgIrqProcess(void)
 			TimerStop(&RxTimeoutTimer);
 			if ((RadioEvents != NULL) && (RadioEvents->RxTimeout != NULL))
 			{
+				RadioEventTimeUs = RadioRxTimeoutTimeUs;
 				RadioEvents->RxTimeout();
 			}
 		}
@@ -1674,17 +2040,20 @@ void RadioBgIrqProcess(void)
 			TimerStop(&TxTimeoutTimer);
 			if ((RadioEvents != NULL) && (RadioEvents->TxTimeout != NULL))
 			{
+				RadioEventTimeUs = RadioTxTimeoutTimeUs;
 				RadioEvents->TxTimeout();
 			}
 		}
 	}
+	// Reported, the timeouts of the callbacks commands are reported next time
+	RadioBusyTimeoutsReported = busyTimeouts;
+	SX126xRadioUnlock();
 }
 
 
 void RadioIrqProcessAfterDeepSleep(void)
 {
-	BoardDisableIrq();
-	IrqFired = true;
-	BoardEnableIrq();
+	// The DIO1 edge woke the CPU up, the ISR did not run and its time is unknown
+	RadioIrqEventPush(RtcGetTimeUs());
 	RadioBgIrqProcess();
 }
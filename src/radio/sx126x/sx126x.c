@@ -20,6 +20,7 @@
  *
  * \author    Gregory Cristian ( Semtech )
  */
+#include <Arduino.h>
 #include <string.h>
 #include "system/utilities.h"
 #include "boards/mcu/timer.h"
@@ -27,6 +28,7 @@
 // #include "delay.h"
 #include "sx126x.h"
 #include "boards/sx126x-board.h"
+#include "boards/rtc-board.h"
 
 /*!
  * \brief Internal frequency of the radio
@@ -58,9 +60,10 @@ typedef struct
 }RadioRegisters_t;
 
 /*!
- * \brief Stores the current packet type set in the radio
+ * \brief Stores the current packet type set in the radio. Kept across deep
+ *        sleep, checked against the radio on resume.
  */
-static RadioPacketTypes_t PacketType;
+RTC_DATA_ATTR static RadioPacketTypes_t PacketType;
 
 /*!
  * \brief Stores the current packet header type set in the radio
@@ -73,9 +76,119 @@ static volatile RadioLoRaPacketLengthsMode_t LoRaHeaderType;
 volatile uint32_t FrequencyError = 0;
 
 /*!
- * \brief Hold the status of the Image calibration
+ * \brief Image calibration frequencies of the bands, lowest band first
  */
-static bool ImageCalibrated = false;
+static const struct
+{
+    uint32_t FreqMin;                               // Lowest frequency of the band, excluded [Hz]
+    uint8_t CalFreq[2];
+}ImageCalBands[] =
+{
+    { 0,         { 0x6B, 0x6F } },                  // IMAGE_CAL_BAND_430_440, also below 425 MHz
+    { 460000000, { 0x75, 0x81 } },                  // IMAGE_CAL_BAND_470_510
+    { 770000000, { 0xC1, 0xC5 } },                  // IMAGE_CAL_BAND_779_787
+    { 850000000, { 0xD7, 0xDB } },                  // IMAGE_CAL_BAND_863_870
+    { 900000000, { 0xE1, 0xE9 } },                  // IMAGE_CAL_BAND_902_928
+};
+
+/*!
+ * \brief Band the image is calibrated for and calibration statistics. Kept
+ *        across deep sleep, the radio keeps its calibration in warm start
+ *        sleep mode.
+ */
+RTC_DATA_ATTR static SX126xImageCalStats_t ImageCal;
+
+/*!
+ * \brief Radio resume context, kept across deep sleep
+ */
+typedef struct
+{
+    bool            Disabled;                       // Set to always reset the radio on init
+    bool            Configured;                     // Set from the end of a reset init until the radio is reset or cold started
+    bool            Resumed;                        // Set when the last init resumed the radio
+    bool            TxPending;                      // Set until the first transmission after an init
+    uint64_t        InitUs;                         // Time of the last init [us]
+    uint32_t        ResumeTxCount;
+    uint64_t        ResumeTxTotalUs;
+    uint32_t        ResetTxCount;
+    uint64_t        ResetTxTotalUs;
+    SX126xResumeStats_t Stats;
+}SX126xResumeCtx_t;
+
+RTC_DATA_ATTR static SX126xResumeCtx_t ResumeCtx;
+
+/*!
+ * Largest parameters of a shadowed configuration command
+ */
+#define SX126X_SHADOW_PARAMS_SIZE                   9
+
+/*!
+ * \brief Shadow copy of the parameters of a configuration command
+ */
+typedef struct
+{
+    RadioCommands_t Command;
+    bool            Valid;
+    uint8_t         Size;
+    uint8_t         Params[SX126X_SHADOW_PARAMS_SIZE];
+}SX126xShadowCommand_t;
+
+/*!
+ * \brief Shadow copy of a configuration register
+ */
+typedef struct
+{
+    uint16_t        Addr;
+    bool            Valid;
+    uint8_t         Value;
+}SX126xShadowRegister_t;
+
+/*!
+ * \brief Configuration commands sent again only when their parameters change.
+ *        The radio keeps them in sleep mode with warm start, so does the copy
+ *        across deep sleep.
+ */
+RTC_DATA_ATTR static SX126xShadowCommand_t ShadowCommands[] =
+{
+    { .Command = RADIO_SET_PACKETTYPE },
+    { .Command = RADIO_SET_RFFREQUENCY },
+    { .Command = RADIO_SET_MODULATIONPARAMS },
+    { .Command = RADIO_SET_PACKETPARAMS },
+    { .Command = RADIO_CFG_DIOIRQ },
+    { .Command = RADIO_SET_TXPARAMS },
+    { .Command = RADIO_SET_PACONFIG },
+    { .Command = RADIO_SET_BUFFERBASEADDRESS },
+    { .Command = RADIO_SET_LORASYMBTIMEOUT },
+    { .Command = RADIO_SET_STOPRXTIMERONPREAMBLE },
+    { .Command = RADIO_SET_REGULATORMODE },
+    { .Command = RADIO_SET_RFSWITCHMODE },
+};
+
+/*!
+ * \brief Configuration registers written and read through the register
+ *        batches. Not all of them are retained in sleep mode, they are read
+ *        again after any sleep.
+ */
+static SX126xShadowRegister_t ShadowRegisters[] =
+{
+    { .Addr = REG_LR_SYNCH_TIMEOUT },
+    { .Addr = 0x0736 },                             // RegIqPolaritySetup
+    { .Addr = REG_LR_SYNCWORD },
+    { .Addr = REG_LR_SYNCWORD + 1 },
+    { .Addr = 0x0889 },                             // RegTxModulation
+    { .Addr = 0x08D8 },                             // RegTxClampConfig
+    { .Addr = 0x0580 },                             // DIO3 output control
+    { .Addr = 0x0583 },
+    { .Addr = 0x0584 },
+    { .Addr = 0x0585 },
+    { .Addr = 0x0920 },
+};
+
+/*!
+ * \brief Shadow copy enable and statistics
+ */
+static bool ShadowEnabled = true;
+static SX126xShadowStats_t ShadowStats;
 
 /*!
  * \brief Get the number of PLL steps for a given frequency in Hertz
@@ -86,6 +199,27 @@ static bool ImageCalibrated = false;
  */
 static uint32_t SX126xConvertFreqInHzToPllStep( uint32_t freqInHz );
 
+/*!
+ * \brief Sends a configuration command, unless the radio already got the
+ *        same parameters
+ *
+ * \param [in]  command       Configuration command
+ * \param [in]  buffer        Command parameters
+ * \param [in]  size          Size of the parameters
+ */
+static void SX126xWriteConfigCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size );
+
+/*!
+ * \brief Forgets the shadow copy of the registers, after a sleep
+ */
+static void SX126xShadowInvalidateRegisters( void );
+
+/*!
+ * \brief Forgets the shadow copies of the commands and of the registers, the
+ *        radio keeps its TCXO and calibration settings
+ */
+static void SX126xShadowInvalidateCopies( void );
+
 /*
  * SX126x DIO IRQ callback functions prototype
  */
@@ -110,9 +244,58 @@ void SX126xSetInterruptMode( void );
  */
 void SX126xProcessIrqs( void );
 
+/*!
+ * \brief Resumes the radio left configured, without a reset
+ *
+ * \param [in]  dioIrq        DIO1 IRQ callback
+ *
+ * \retval      resumed       false when the radio must be reset and configured
+ */
+static bool SX126xResume( DioIrqHandler dioIrq )
+{
+    uint8_t packetType;
+
+    ResumeCtx.InitUs = RtcGetTimeUs( );
+    ResumeCtx.TxPending = true;
+    ResumeCtx.Resumed = false;
+    // GFSK is the reset packet type, a reset would go unnoticed
+    if( ( ResumeCtx.Disabled == true ) || ( ResumeCtx.Configured == false ) || ( PacketType == PACKET_TYPE_GFSK ) )
+    {
+        ResumeCtx.Stats.Resets++;
+        return false;
+    }
+
+    SX126xIoIrqInit( dioIrq );
+
+    SX126xWakeup( );
+    SX126xSetStandby( STDBY_RC );
+
+    // A radio reset or powered down meanwhile reads back the reset packet type
+    SX126xReadCommand( RADIO_GET_PACKETTYPE, &packetType, 1 );
+    if( packetType != ( uint8_t )PacketType )
+    {
+        ResumeCtx.Stats.Failures++;
+        ResumeCtx.Stats.Resets++;
+        return false;
+    }
+    SX126xClearIrqStatus( IRQ_RADIO_ALL );
+
+    SX126xSetOperatingMode( MODE_STDBY_RC );
+    ResumeCtx.Resumed = true;
+    ResumeCtx.Stats.Resumes++;
+    return true;
+}
+
 void SX126xInit( DioIrqHandler dioIrq )
 {
+    if( SX126xResume( dioIrq ) == true )
+    {
+        return;
+    }
     SX126xReset( );
+    SX126xShadowInvalidate( );
+    // The radio is back to its reset packet type
+    PacketType = PACKET_TYPE_GFSK;
 
     SX126xIoIrqInit( dioIrq );
 
@@ -131,11 +314,19 @@ void SX126xInit( DioIrqHandler dioIrq )
     SX126xSetDio2AsRfSwitchCtrl(true);      // 需要将下面代码封装到该注释函数，先注释   mating
 
     SX126xSetOperatingMode( MODE_STDBY_RC );
+    ResumeCtx.Configured = true;
 }
 
 void SX126xInit2( DioIrqHandler dioIrq )
 {
+    if( SX126xResume( dioIrq ) == true )
+    {
+        return;
+    }
     SX126xReset( );
+    SX126xShadowInvalidate( );
+    // The radio is back to its reset packet type
+    PacketType = PACKET_TYPE_GFSK;
 
     SX126xIoIrqInit( dioIrq );
 
@@ -154,6 +345,7 @@ void SX126xInit2( DioIrqHandler dioIrq )
     SX126xSetDio2AsRfSwitchCtrl(true);      // 需要将下面代码封装到该注释函数，先注释   mating
 
     SX126xSetOperatingMode( MODE_STDBY_RC );
+    ResumeCtx.Configured = true;
 }
 
 void SX126xReInit(DioIrqHandler dioIrq)
@@ -300,7 +492,11 @@ void SX126xSetSleep( SleepParams_t sleepConfig )
     if( sleepConfig.Fields.WarmStart == 0 )
     {
         // Force image calibration
-        ImageCalibrated = false;
+        SX126xShadowInvalidate( );
+    }
+    else
+    {
+        SX126xShadowInvalidateRegisters( );
     }
     SX126xWriteCommand( RADIO_SET_SLEEP, &value, 1 );
     SX126xSetOperatingMode( MODE_SLEEP );
@@ -330,6 +526,31 @@ void SX126xSetTx( uint32_t timeout )
 {
     uint8_t buf[3];
 
+    ShadowStats.Transmissions++;
+    if( ResumeCtx.TxPending == true )
+    {
+        uint32_t latency = ( uint32_t )( RtcGetTimeUs( ) - ResumeCtx.InitUs );
+
+        ResumeCtx.TxPending = false;
+        if( ResumeCtx.Resumed == true )
+        {
+            ResumeCtx.ResumeTxCount++;
+            ResumeCtx.ResumeTxTotalUs += latency;
+            if( latency > ResumeCtx.Stats.ResumeTxMaxUs )
+            {
+                ResumeCtx.Stats.ResumeTxMaxUs = latency;
+            }
+        }
+        else
+        {
+            ResumeCtx.ResetTxCount++;
+            ResumeCtx.ResetTxTotalUs += latency;
+            if( latency > ResumeCtx.Stats.ResetTxMaxUs )
+            {
+                ResumeCtx.Stats.ResetTxMaxUs = latency;
+            }
+        }
+    }
     SX126xSetOperatingMode( MODE_TX );
 
     buf[0] = ( uint8_t )( ( timeout >> 16 ) & 0xFF );
@@ -398,7 +619,7 @@ void SX126xSetTxInfinitePreamble( void )
 
 void SX126xSetStopRxTimerOnPreambleDetect( bool enable )
 {
-    SX126xWriteCommand( RADIO_SET_STOPRXTIMERONPREAMBLE, ( uint8_t* )&enable, 1 );
+    SX126xWriteConfigCommand( RADIO_SET_STOPRXTIMERONPREAMBLE, ( uint8_t* )&enable, 1 );
 }
 
 void SX126xSetLoRaSymbNumTimeout( uint8_t symbNum )
@@ -416,18 +637,21 @@ void SX126xSetLoRaSymbNumTimeout( uint8_t symbNum )
     }
 
     reg = mant << ( 2 * exp + 1 );
-    SX126xWriteCommand( RADIO_SET_LORASYMBTIMEOUT, &reg, 1 );
+    SX126xWriteConfigCommand( RADIO_SET_LORASYMBTIMEOUT, &reg, 1 );
 
     if( symbNum != 0 )
     {
-        reg = exp + ( mant << 3 );
-        SX126xWriteRegister( REG_LR_SYNCH_TIMEOUT, reg );
+        SX126xRegBatch_t batch;
+
+        SX126xRegBatchInit( &batch );
+        SX126xRegBatchWrite( &batch, REG_LR_SYNCH_TIMEOUT, exp + ( mant << 3 ) );
+        SX126xRegBatchCommit( &batch );
     }
 }
 
 void SX126xSetRegulatorMode( RadioRegulatorMode_t mode )
 {
-    SX126xWriteCommand( RADIO_SET_REGULATORMODE, ( uint8_t* )&mode, 1 );
+    SX126xWriteConfigCommand( RADIO_SET_REGULATORMODE, ( uint8_t* )&mode, 1 );
 }
 
 void SX126xCalibrate( CalibrationParams_t calibParam )
@@ -443,36 +667,41 @@ void SX126xCalibrate( CalibrationParams_t calibParam )
     SX126xWriteCommand( RADIO_CALIBRATE, &value, 1 );
 }
 
-void SX126xCalibrateImage( uint32_t freq )
+RadioImageCalBands_t SX126xGetImageCalBand( uint32_t freq )
 {
-    uint8_t calFreq[2];
+    uint8_t band = sizeof( ImageCalBands ) / sizeof( ImageCalBands[0] );
 
-    if( freq > 900000000 )
+    while( ( band > 1 ) && ( freq <= ImageCalBands[band - 1].FreqMin ) )
     {
-        calFreq[0] = 0xE1;
-        calFreq[1] = 0xE9;
+        band--;
     }
-    else if( freq > 850000000 )
-    {
-        calFreq[0] = 0xD7;
-        calFreq[1] = 0xDB;
-    }
-    else if( freq > 770000000 )
-    {
-        calFreq[0] = 0xC1;
-        calFreq[1] = 0xC5;
-    }
-    else if( freq > 460000000 )
-    {
-        calFreq[0] = 0x75;
-        calFreq[1] = 0x81;
-    }
-    else if( freq > 425000000 )
+    return ( RadioImageCalBands_t )band;
+}
+
+void SX126xCalibrateImage( uint32_t freq )
+{
+    RadioImageCalBands_t band = SX126xGetImageCalBand( freq );
+    uint8_t calFreq[2];
+    uint64_t start;
+    uint32_t elapsed;
+
+    calFreq[0] = ImageCalBands[band - 1].CalFreq[0];
+    calFreq[1] = ImageCalBands[band - 1].CalFreq[1];
+
+    SX126xRadioLock( );
+    start = RtcGetTimeUs( );
+    SX126xWriteCommand( RADIO_CALIBRATEIMAGE, calFreq, 2 );
+    elapsed = ( uint32_t )( RtcGetTimeUs( ) - start );
+
+    ImageCal.Band = band;
+    ImageCal.Calibrations++;
+    ImageCal.LastUs = elapsed;
+    ImageCal.TotalUs += elapsed;
+    if( elapsed > ImageCal.MaxUs )
     {
-        calFreq[0] = 0x6B;
-        calFreq[1] = 0x6F;
+        ImageCal.MaxUs = elapsed;
     }
-    SX126xWriteCommand( RADIO_CALIBRATEIMAGE, calFreq, 2 );
+    SX126xRadioUnlock( );
 }
 
 void SX126xSetPaConfig( uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut )
@@ -483,7 +712,7 @@ void SX126xSetPaConfig( uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, u
     buf[1] = hpMax;
     buf[2] = deviceSel;
     buf[3] = paLut;
-    SX126xWriteCommand( RADIO_SET_PACONFIG, buf, 4 );
+    SX126xWriteConfigCommand( RADIO_SET_PACONFIG, buf, 4 );
 }
 
 void SX126xSetRxTxFallbackMode( uint8_t fallbackMode )
@@ -503,7 +732,7 @@ void SX126xSetDioIrqParams( uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Ma
     buf[5] = ( uint8_t )( dio2Mask & 0x00FF );
     buf[6] = ( uint8_t )( ( dio3Mask >> 8 ) & 0x00FF );
     buf[7] = ( uint8_t )( dio3Mask & 0x00FF );
-    SX126xWriteCommand( RADIO_CFG_DIOIRQ, buf, 8 );
+    SX126xWriteConfigCommand( RADIO_CFG_DIOIRQ, buf, 8 );
 }
 
 uint16_t SX126xGetIrqStatus( void )
@@ -516,7 +745,7 @@ uint16_t SX126xGetIrqStatus( void )
 
 void SX126xSetDio2AsRfSwitchCtrl( uint8_t enable )
 {
-    SX126xWriteCommand( RADIO_SET_RFSWITCHMODE, &enable, 1 );
+    SX126xWriteConfigCommand( RADIO_SET_RFSWITCHMODE, &enable, 1 );
 }
 
 void SX126xSetDio3AsTcxoCtrl( RadioTcxoCtrlVoltage_t tcxoVoltage, uint32_t timeout )
@@ -562,11 +791,17 @@ void SX126xSetRfFrequency( uint32_t frequency )     // mating mod
 {   
     uint8_t buf[4];
 
-    if( ImageCalibrated == false )
+    // The image is calibrated for one band at a time
+    SX126xRadioLock( );
+    if( SX126xGetImageCalBand( frequency ) != ImageCal.Band )
     {
         SX126xCalibrateImage( frequency );
-        ImageCalibrated = true;
     }
+    else
+    {
+        ImageCal.Skipped++;
+    }
+    SX126xRadioUnlock( );
 
     uint32_t freqInPllSteps = SX126xConvertFreqInHzToPllStep( frequency );
 
@@ -574,14 +809,19 @@ void SX126xSetRfFrequency( uint32_t frequency )     // mating mod
     buf[1] = ( uint8_t )( ( freqInPllSteps >> 16 ) & 0xFF );
     buf[2] = ( uint8_t )( ( freqInPllSteps >> 8 ) & 0xFF );
     buf[3] = ( uint8_t )( freqInPllSteps & 0xFF );
-    SX126xWriteCommand( RADIO_SET_RFFREQUENCY, buf, 4 );
+    SX126xWriteConfigCommand( RADIO_SET_RFFREQUENCY, buf, 4 );
 }
 
 void SX126xSetPacketType( RadioPacketTypes_t packetType )
 {
+    // The radio resets the parameters and registers of the other modem
+    if( packetType != PacketType )
+    {
+        SX126xShadowInvalidateCopies( );
+    }
     // Save packet type internally to avoid questioning the radio
     PacketType = packetType;
-    SX126xWriteCommand( RADIO_SET_PACKETTYPE, ( uint8_t* )&packetType, 1 );
+    SX126xWriteConfigCommand( RADIO_SET_PACKETTYPE, ( uint8_t* )&packetType, 1 );
 }
 
 RadioPacketTypes_t SX126xGetPacketType( void )
@@ -616,7 +856,11 @@ void SX126xSetTxParams( int8_t power, RadioRampTimes_t rampTime )
     {
         // WORKAROUND - Better Resistance of the SX1262 Tx to Antenna Mismatch, see DS_SX1261-2_V1.2 datasheet chapter 15.2
         // RegTxClampConfig = @address 0x08D8
-        SX126xWriteRegister( 0x08D8, SX126xReadRegister( 0x08D8 ) | ( 0x0F << 1 ) );
+        SX126xRegBatch_t batch;
+
+        SX126xRegBatchInit( &batch );
+        SX126xRegBatchUpdate( &batch, 0x08D8, 0x0F << 1, 0x0F << 1 );
+        SX126xRegBatchCommit( &batch );
         // WORKAROUND END
 
         SX126xSetPaConfig( 0x04, 0x07, 0x00, 0x01 );
@@ -631,7 +875,7 @@ void SX126xSetTxParams( int8_t power, RadioRampTimes_t rampTime )
     }
     buf[0] = power;
     buf[1] = ( uint8_t )rampTime;
-    SX126xWriteCommand( RADIO_SET_TXPARAMS, buf, 2 );
+    SX126xWriteConfigCommand( RADIO_SET_TXPARAMS, buf, 2 );
 }
 
 void SX126xSetModulationParams( ModulationParams_t *modulationParams )
@@ -661,7 +905,7 @@ void SX126xSetModulationParams( ModulationParams_t *modulationParams )
         buf[5] = ( tempVal >> 16 ) & 0xFF;
         buf[6] = ( tempVal >> 8 ) & 0xFF;
         buf[7] = ( tempVal& 0xFF );
-        SX126xWriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
+        SX126xWriteConfigCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
         break;
     case PACKET_TYPE_LORA:
         n = 4;
@@ -670,7 +914,7 @@ void SX126xSetModulationParams( ModulationParams_t *modulationParams )
         buf[2] = modulationParams->Params.LoRa.CodingRate;
         buf[3] = modulationParams->Params.LoRa.LowDatarateOptimize;
 
-        SX126xWriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
+        SX126xWriteConfigCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
 
         break;
     default:
@@ -735,7 +979,7 @@ void SX126xSetPacketParams( PacketParams_t *packetParams )
     case PACKET_TYPE_NONE:
         return;
     }
-    SX126xWriteCommand( RADIO_SET_PACKETPARAMS, buf, n );
+    SX126xWriteConfigCommand( RADIO_SET_PACKETPARAMS, buf, n );
 }
 
 void SX126xSetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, RadioCadExitModes_t cadExitMode, uint32_t cadTimeout )
@@ -759,7 +1003,7 @@ void SX126xSetBufferBaseAddress( uint8_t txBaseAddress, uint8_t rxBaseAddress )
 
     buf[0] = txBaseAddress;
     buf[1] = rxBaseAddress;
-    SX126xWriteCommand( RADIO_SET_BUFFERBASEADDRESS, buf, 2 );
+    SX126xWriteConfigCommand( RADIO_SET_BUFFERBASEADDRESS, buf, 2 );
 }
 
 RadioStatus_t SX126xGetStatus( void )
@@ -867,6 +1111,283 @@ void SX126xClearIrqStatus( uint16_t irq )
     SX126xWriteCommand( RADIO_CLR_IRQSTATUS, buf, 2 );
 }
 
+static SX126xShadowCommand_t* SX126xShadowCommandGet( RadioCommands_t command )
+{
+    for( uint8_t i = 0; i < ( sizeof( ShadowCommands ) / sizeof( ShadowCommands[0] ) ); i++ )
+    {
+        if( ShadowCommands[i].Command == command )
+        {
+            return &ShadowCommands[i];
+        }
+    }
+    return NULL;
+}
+
+static SX126xShadowRegister_t* SX126xShadowRegisterGet( uint16_t address )
+{
+    for( uint8_t i = 0; i < ( sizeof( ShadowRegisters ) / sizeof( ShadowRegisters[0] ) ); i++ )
+    {
+        if( ShadowRegisters[i].Addr == address )
+        {
+            return &ShadowRegisters[i];
+        }
+    }
+    return NULL;
+}
+
+static void SX126xWriteConfigCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
+{
+    SX126xShadowCommand_t *shadow = SX126xShadowCommandGet( command );
+
+    SX126xRadioLock( );
+    if( ( ShadowEnabled == true ) && ( shadow != NULL ) && ( size <= SX126X_SHADOW_PARAMS_SIZE ) )
+    {
+        if( ( shadow->Valid == true ) && ( shadow->Size == size ) && ( memcmp( shadow->Params, buffer, size ) == 0 ) )
+        {
+            ShadowStats.CommandsSkipped++;
+            SX126xRadioUnlock( );
+            return;
+        }
+        // Stored before sending, a BUSY timeout while sending invalidates it
+        memcpy1( shadow->Params, buffer, size );
+        shadow->Size = size;
+        shadow->Valid = true;
+    }
+    SX126xWriteCommand( command, buffer, size );
+    SX126xRadioUnlock( );
+}
+
+static void SX126xShadowInvalidateRegisters( void )
+{
+    SX126xRadioLock( );
+    for( uint8_t i = 0; i < ( sizeof( ShadowRegisters ) / sizeof( ShadowRegisters[0] ) ); i++ )
+    {
+        ShadowRegisters[i].Valid = false;
+    }
+    SX126xRadioUnlock( );
+}
+
+void SX126xShadowEnable( bool enable )
+{
+    SX126xRadioLock( );
+    ShadowEnabled = enable;
+    SX126xShadowInvalidate( );
+    SX126xRadioUnlock( );
+}
+
+static void SX126xShadowInvalidateCopies( void )
+{
+    SX126xRadioLock( );
+    for( uint8_t i = 0; i < ( sizeof( ShadowCommands ) / sizeof( ShadowCommands[0] ) ); i++ )
+    {
+        ShadowCommands[i].Valid = false;
+    }
+    SX126xShadowInvalidateRegisters( );
+    ImageCal.Band = IMAGE_CAL_BAND_NONE;
+    SX126xRadioUnlock( );
+}
+
+void SX126xShadowInvalidate( void )
+{
+    SX126xRadioLock( );
+    SX126xShadowInvalidateCopies( );
+    ResumeCtx.Configured = false;
+    SX126xRadioUnlock( );
+}
+
+void SX126xShadowForget( uint16_t address, uint16_t size )
+{
+    SX126xRadioLock( );
+    for( uint8_t i = 0; i < ( sizeof( ShadowRegisters ) / sizeof( ShadowRegisters[0] ) ); i++ )
+    {
+        if( ( ShadowRegisters[i].Addr >= address ) && ( ShadowRegisters[i].Addr < ( address + size ) ) )
+        {
+            ShadowRegisters[i].Valid = false;
+        }
+    }
+    SX126xRadioUnlock( );
+}
+
+void SX126xGetShadowStats( SX126xShadowStats_t *stats )
+{
+    SX126xRadioLock( );
+    *stats = ShadowStats;
+    SX126xRadioUnlock( );
+}
+
+void SX126xResetShadowStats( void )
+{
+    SX126xRadioLock( );
+    memset1( ( uint8_t* )&ShadowStats, 0, sizeof( ShadowStats ) );
+    SX126xRadioUnlock( );
+}
+
+void SX126xGetImageCalStats( SX126xImageCalStats_t *stats )
+{
+    SX126xRadioLock( );
+    *stats = ImageCal;
+    SX126xRadioUnlock( );
+}
+
+void SX126xResetImageCalStats( void )
+{
+    RadioImageCalBands_t band;
+
+    SX126xRadioLock( );
+    band = ImageCal.Band;
+    memset1( ( uint8_t* )&ImageCal, 0, sizeof( ImageCal ) );
+    ImageCal.Band = band;
+    SX126xRadioUnlock( );
+}
+
+void SX126xResumeEnable( bool enable )
+{
+    SX126xRadioLock( );
+    ResumeCtx.Disabled = ( enable == false );
+    SX126xRadioUnlock( );
+}
+
+void SX126xGetResumeStats( SX126xResumeStats_t *stats )
+{
+    SX126xRadioLock( );
+    *stats = ResumeCtx.Stats;
+    if( ResumeCtx.ResumeTxCount > 0 )
+    {
+        stats->ResumeTxAvgUs = ( uint32_t )( ResumeCtx.ResumeTxTotalUs / ResumeCtx.ResumeTxCount );
+    }
+    if( ResumeCtx.ResetTxCount > 0 )
+    {
+        stats->ResetTxAvgUs = ( uint32_t )( ResumeCtx.ResetTxTotalUs / ResumeCtx.ResetTxCount );
+    }
+    SX126xRadioUnlock( );
+}
+
+void SX126xResetResumeStats( void )
+{
+    SX126xRadioLock( );
+    memset1( ( uint8_t* )&ResumeCtx.Stats, 0, sizeof( ResumeCtx.Stats ) );
+    ResumeCtx.ResumeTxCount = 0;
+    ResumeCtx.ResumeTxTotalUs = 0;
+    ResumeCtx.ResetTxCount = 0;
+    ResumeCtx.ResetTxTotalUs = 0;
+    SX126xRadioUnlock( );
+}
+
+void SX126xRegBatchInit( SX126xRegBatch_t *batch )
+{
+    batch->Count = 0;
+}
+
+void SX126xRegBatchWrite( SX126xRegBatch_t *batch, uint16_t address, uint8_t value )
+{
+    for( uint8_t i = 0; i < batch->Count; i++ )
+    {
+        if( batch->Address[i] == address )
+        {
+            batch->Value[i] = value;
+            return;
+        }
+    }
+    if( batch->Count == SX126X_REG_BATCH_SIZE )
+    {
+        SX126xRegBatchCommit( batch );
+    }
+    batch->Address[batch->Count] = address;
+    batch->Value[batch->Count] = value;
+    batch->Count++;
+}
+
+void SX126xRegBatchUpdate( SX126xRegBatch_t *batch, uint16_t address, uint8_t mask, uint8_t bits )
+{
+    SX126xShadowRegister_t *shadow = SX126xShadowRegisterGet( address );
+    uint8_t value;
+
+    for( uint8_t i = 0; i < batch->Count; i++ )
+    {
+        if( batch->Address[i] == address )
+        {
+            batch->Value[i] = ( batch->Value[i] & ~mask ) | ( bits & mask );
+            return;
+        }
+    }
+
+    SX126xRadioLock( );
+    if( ( ShadowEnabled == true ) && ( shadow != NULL ) && ( shadow->Valid == true ) )
+    {
+        value = shadow->Value;
+        ShadowStats.RegisterReadsSkipped++;
+    }
+    else
+    {
+        value = SX126xReadRegister( address );
+        if( ( ShadowEnabled == true ) && ( shadow != NULL ) )
+        {
+            shadow->Value = value;
+            shadow->Valid = true;
+        }
+    }
+    SX126xRadioUnlock( );
+    SX126xRegBatchWrite( batch, address, ( value & ~mask ) | ( bits & mask ) );
+}
+
+void SX126xRegBatchCommit( SX126xRegBatch_t *batch )
+{
+    uint16_t address[SX126X_REG_BATCH_SIZE];
+    uint8_t value[SX126X_REG_BATCH_SIZE];
+    uint8_t count = 0;
+    uint8_t first;
+    uint8_t last;
+
+    SX126xRadioLock( );
+    // Drops the writes of the values the registers hold, sorts the others
+    for( uint8_t i = 0; i < batch->Count; i++ )
+    {
+        SX126xShadowRegister_t *shadow = SX126xShadowRegisterGet( batch->Address[i] );
+        uint8_t j = count;
+
+        if( ( ShadowEnabled == true ) && ( shadow != NULL ) && ( shadow->Valid == true ) &&
+            ( shadow->Value == batch->Value[i] ) )
+        {
+            ShadowStats.RegisterWritesSkipped++;
+            continue;
+        }
+        while( ( j > 0 ) && ( address[j - 1] > batch->Address[i] ) )
+        {
+            address[j] = address[j - 1];
+            value[j] = value[j - 1];
+            j--;
+        }
+        address[j] = batch->Address[i];
+        value[j] = batch->Value[i];
+        count++;
+    }
+    batch->Count = 0;
+
+    // One write register command per run of contiguous registers
+    for( first = 0; first < count; first = last )
+    {
+        last = first + 1;
+        while( ( ShadowEnabled == true ) && ( last < count ) && ( address[last] == ( address[last - 1] + 1 ) ) )
+        {
+            ShadowStats.RegisterWritesMerged++;
+            last++;
+        }
+        for( uint8_t i = first; i < last; i++ )
+        {
+            SX126xShadowRegister_t *shadow = SX126xShadowRegisterGet( address[i] );
+
+            // Stored before sending, a BUSY timeout while sending invalidates it
+            if( ( ShadowEnabled == true ) && ( shadow != NULL ) )
+            {
+                shadow->Value = value[i];
+                shadow->Valid = true;
+            }
+        }
+        SX126xWriteRegisters( address[first], &value[first], last - first );
+    }
+    SX126xRadioUnlock( );
+}
+
 static uint32_t SX126xConvertFreqInHzToPllStep( uint32_t freqInHz )
 {
     uint32_t stepsInt;
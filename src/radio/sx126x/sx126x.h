@@ -158,6 +158,13 @@ extern "C"
  */
 #define REG_OCP                                     0x08E7
 
+/*!
+ * Register writes a batch can hold ( SX126xRegBatch_t )
+ */
+#ifndef SX126X_REG_BATCH_SIZE
+#define SX126X_REG_BATCH_SIZE                       8
+#endif
+
 /*!
  * \brief Structure describing the radio status
  */
@@ -642,6 +649,19 @@ typedef union
     uint8_t Value;
 }CalibrationParams_t;
 
+/*!
+ * \brief Bands of the image calibration, SX126xCalibrateImage
+ */
+typedef enum
+{
+    IMAGE_CAL_BAND_NONE                     = 0,    //!< Not calibrated or unknown
+    IMAGE_CAL_BAND_430_440                  = 1,
+    IMAGE_CAL_BAND_470_510                  = 2,
+    IMAGE_CAL_BAND_779_787                  = 3,
+    IMAGE_CAL_BAND_863_870                  = 4,
+    IMAGE_CAL_BAND_902_928                  = 5,
+}RadioImageCalBands_t;
+
 /*!
  * \brief Represents a sleep mode configuration
  */
@@ -720,6 +740,104 @@ typedef struct
     void ( *cadDone )( bool cadFlag );              //!< Pointer to a function run on channel activity detected
 }SX126xCallbacks_t;
 
+/*!
+ * \brief Register writes sent together by SX126xRegBatchCommit
+ *
+ * \remark The writes to contiguous registers are merged in a single write
+ *         register command, the writes of the value a shadowed register
+ *         already holds are skipped.
+ */
+typedef struct SX126xRegBatch_s
+{
+    uint8_t Count;
+    uint16_t Address[SX126X_REG_BATCH_SIZE];
+    uint8_t Value[SX126X_REG_BATCH_SIZE];
+}SX126xRegBatch_t;
+
+/*!
+ * \brief SPI transactions saved by the shadow copy of the configuration
+ */
+typedef struct SX126xShadowStats_s
+{
+    /*!
+     * Configuration commands skipped, same parameters as the last ones sent
+     */
+    uint32_t CommandsSkipped;
+    /*!
+     * Register writes skipped, the register already held the value
+     */
+    uint32_t RegisterWritesSkipped;
+    /*!
+     * Register reads served by the shadow copy
+     */
+    uint32_t RegisterReadsSkipped;
+    /*!
+     * Register writes merged in the write command of the previous register
+     */
+    uint32_t RegisterWritesMerged;
+    /*!
+     * Transmissions started, to report the savings per uplink
+     */
+    uint32_t Transmissions;
+}SX126xShadowStats_t;
+
+/*!
+ * \brief Image calibrations run by SX126xSetRfFrequency
+ */
+typedef struct SX126xImageCalStats_s
+{
+    /*!
+     * Band the image is calibrated for
+     */
+    RadioImageCalBands_t Band;
+    /*!
+     * Image calibrations run
+     */
+    uint32_t Calibrations;
+    /*!
+     * Frequency changes within the calibrated band, not calibrated again
+     */
+    uint32_t Skipped;
+    /*!
+     * Last, longest and cumulated time of the calibrations, BUSY wait
+     * included [us]
+     */
+    uint32_t LastUs;
+    uint32_t MaxUs;
+    uint32_t TotalUs;
+}SX126xImageCalStats_t;
+
+/*!
+ * \brief Radio inits, resumed or reset, and wake to TX start latencies. The
+ *        latency runs from the radio init to the first transmission started
+ *        after it.
+ */
+typedef struct SX126xResumeStats_s
+{
+    /*!
+     * Inits resuming the radio without a reset
+     */
+    uint32_t Resumes;
+    /*!
+     * Inits resetting the radio
+     */
+    uint32_t Resets;
+    /*!
+     * Resumes refused, the radio had lost its configuration, reset instead
+     */
+    uint32_t Failures;
+    /*!
+     * Mean and longest wake to TX start latency after a resume [us]
+     */
+    uint32_t ResumeTxAvgUs;
+    uint32_t ResumeTxMaxUs;
+    /*!
+     * Mean and longest wake to TX start latency after a reset [us]
+     */
+    uint32_t ResetTxAvgUs;
+    uint32_t ResetTxMaxUs;
+}SX126xResumeStats_t;
+
 /*!
  * ============================================================================
  * Public functions prototypes
@@ -728,6 +846,12 @@ typedef struct
  
 /*!
  * \brief Initializes the radio driver
+ *
+ * \remark When the radio was not reset nor cold started since it was last
+ *         configured, in warm start sleep across a deep sleep of the MCU
+ *         for instance, it is resumed instead: no reset, no TCXO setup nor
+ *         calibration, DIO1 attached again. The configuration commands sent
+ *         next are skipped when the shadow copy shows the radio kept them.
  */
 void SX126xInit( DioIrqHandler dioIrq );
 
@@ -917,10 +1041,23 @@ void SX126xCalibrate( CalibrationParams_t calibParam );
 /*!
  * \brief Calibrates the Image rejection depending of the frequency
  *
+ * \remark SX126xSetRfFrequency calibrates the image each time the frequency
+ *         leaves the calibrated band. The calibrated band is kept across deep
+ *         sleep, and forgotten on a radio reset or a cold start.
+ *
  * \param [in]  freq    The operating frequency
  */
 void SX126xCalibrateImage( uint32_t freq );
 
+/*!
+ * \brief Gets the image calibration band of a frequency
+ *
+ * \param [in]  freq    The operating frequency
+ *
+ * \retval      band    Calibration band
+ */
+RadioImageCalBands_t SX126xGetImageCalBand( uint32_t freq );
+
 /*!
  * \brief Activate the extention of the timeout when long preamble is used
  *
@@ -1132,6 +1269,108 @@ void SX126xClearDeviceErrors( void );
  */
 void SX126xClearIrqStatus( uint16_t irq );
 
+/*!
+ * \brief Enables or disables the shadow copy of the configuration, enabled by
+ *        default. Disabled, every configuration command and register access
+ *        goes to the radio.
+ *
+ * \param [in]  enable        Set to false to disable the shadow copy
+ */
+void SX126xShadowEnable( bool enable );
+
+/*!
+ * \brief Forgets the shadow copy of the configuration and the calibrated image
+ *        band, after a reset, a cold start or a command the radio may have
+ *        missed
+ */
+void SX126xShadowInvalidate( void );
+
+/*!
+ * \brief Forgets the shadow copy of registers written without a batch
+ *
+ * \param [in]  address       First register address
+ * \param [in]  size          Number of registers
+ */
+void SX126xShadowForget( uint16_t address, uint16_t size );
+
+/*!
+ * \brief Gets the shadow copy statistics
+ *
+ * \param [out] stats         Statistics
+ */
+void SX126xGetShadowStats( SX126xShadowStats_t *stats );
+
+/*!
+ * \brief Resets the shadow copy statistics
+ */
+void SX126xResetShadowStats( void );
+
+/*!
+ * \brief Starts an empty register writes batch
+ *
+ * \param [out] batch         Batch
+ */
+void SX126xRegBatchInit( SX126xRegBatch_t *batch );
+
+/*!
+ * \brief Adds a register write to a batch
+ *
+ * \param [in]  batch         Batch
+ * \param [in]  address       Register address
+ * \param [in]  value         Register value
+ */
+void SX126xRegBatchWrite( SX126xRegBatch_t *batch, uint16_t address, uint8_t value );
+
+/*!
+ * \brief Adds a read-modify-write of a register to a batch. The register is
+ *        read only when its value is neither in the batch nor shadowed.
+ *
+ * \param [in]  batch         Batch
+ * \param [in]  address       Register address
+ * \param [in]  mask          Bits to change
+ * \param [in]  bits          New value of the bits to change
+ */
+void SX126xRegBatchUpdate( SX126xRegBatch_t *batch, uint16_t address, uint8_t mask, uint8_t bits );
+
+/*!
+ * \brief Sends the register writes of a batch and empties it
+ *
+ * \param [in]  batch         Batch
+ */
+void SX126xRegBatchCommit( SX126xRegBatch_t *batch );
+
+/*!
+ * \brief Gets the image calibration statistics
+ *
+ * \param [out] stats         Statistics
+ */
+void SX126xGetImageCalStats( SX126xImageCalStats_t *stats );
+
+/*!
+ * \brief Resets the image calibration statistics, the calibrated band is kept
+ */
+void SX126xResetImageCalStats( void );
+
+/*!
+ * \brief Enables or disables the resume of the radio by SX126xInit, enabled
+ *        by default
+ *
+ * \param [in]  enable        Set to false to always reset the radio
+ */
+void SX126xResumeEnable( bool enable );
+
+/*!
+ * \brief Gets the radio inits statistics
+ *
+ * \param [out] stats         Statistics
+ */
+void SX126xGetResumeStats( SX126xResumeStats_t *stats );
+
+/*!
+ * \brief Resets the radio inits statistics
+ */
+void SX126xResetResumeStats( void );
+
 #ifdef __cplusplus
 }
 #endif
@@ -64,6 +64,12 @@
 
 #include "aes.h"
 
+/* the byte oriented rounds are not used by the T-table pre-keyed encryption */
+#if ( AES_TTABLE == 0 ) || defined( AES_ENC_128_OTFK ) || defined( AES_DEC_128_OTFK ) \
+                        || defined( AES_ENC_256_OTFK ) || defined( AES_DEC_256_OTFK )
+#  define AES_BYTE_ROUNDS
+#endif
+
 //#if defined( HAVE_UINT_32T )
 //  typedef unsigned long uint32_t;
 //#endif
@@ -197,9 +203,28 @@ static const uint8_t sbox[256]  =  sb_data(f1);
 static const uint8_t isbox[256] = isb_data(f1);
 #endif
 
+#if ( AES_TTABLE == 1 )
+
+/*  Forward round tables: the MixColumns column of the S-box output of a
+    byte in row 0, 1, 2 and 3. The words are little endian, row 0 in the
+    low byte.
+*/
+#define te0(x)  ( (uint32_t)f2(x) | ((uint32_t)(x) << 8) | ((uint32_t)(x) << 16) | ((uint32_t)f3(x) << 24) )
+#define te1(x)  ( (uint32_t)f3(x) | ((uint32_t)f2(x) << 8) | ((uint32_t)(x) << 16) | ((uint32_t)(x) << 24) )
+#define te2(x)  ( (uint32_t)(x) | ((uint32_t)f3(x) << 8) | ((uint32_t)f2(x) << 16) | ((uint32_t)(x) << 24) )
+#define te3(x)  ( (uint32_t)(x) | ((uint32_t)(x) << 8) | ((uint32_t)f3(x) << 16) | ((uint32_t)f2(x) << 24) )
+
+static const uint32_t t_fn[4][256] = { sb_data(te0), sb_data(te1), sb_data(te2), sb_data(te3) };
+
+#endif
+
+#if defined( AES_BYTE_ROUNDS )
+
 static const uint8_t gfm2_sbox[256] = sb_data(f2);
 static const uint8_t gfm3_sbox[256] = sb_data(f3);
 
+#endif
+
 #if defined( AES_DEC_PREKEYED )
 static const uint8_t gfmul_9[256] = mm_data(f9);
 static const uint8_t gfmul_b[256] = mm_data(fb);
@@ -221,6 +246,10 @@ static const uint8_t gfmul_e[256] = mm_data(fe);
 #endif
 #else
 
+#if ( AES_TTABLE == 1 )
+#  error "AES_TTABLE needs USE_TABLES"
+#endif
+
 /* this is the high bit of x right shifted by 1 */
 /* position. Since the starting polynomial has  */
 /* 9 bits (0x11b), this right shift keeps the   */
@@ -339,6 +368,8 @@ static void copy_block( void *d, const void *s )
 #endif
 }
 
+#if defined( AES_BYTE_ROUNDS )
+
 static void copy_block_nn( uint8_t * d, const uint8_t *s, uint8_t nn )
 {
     while( nn-- )
@@ -346,6 +377,8 @@ static void copy_block_nn( uint8_t * d, const uint8_t *s, uint8_t nn )
         *d++ = *s++;
 }
 
+#endif
+
 static void xor_block( void *d, const void *s )
 {
 #if defined( HAVE_UINT_32T )
@@ -373,6 +406,8 @@ static void xor_block( void *d, const void *s )
 #endif
 }
 
+#if defined( AES_BYTE_ROUNDS )
+
 static void copy_and_key( void *d, const void *s, const void *k )
 {
 #if defined( HAVE_UINT_32T )
@@ -473,6 +508,8 @@ static void inv_shift_sub_rows( uint8_t st[N_BLOCK] )
     dt[15] = gfm3_sb(st[12]) ^ s_box(st[1]) ^ s_box(st[6]) ^ gfm2_sb(st[11]);
   }
 
+#endif
+
 #if defined( AES_DEC_PREKEYED )
 
 #if defined( VERSION_1 )
@@ -506,7 +543,106 @@ static void inv_shift_sub_rows( uint8_t st[N_BLOCK] )
 
 #endif
 
-#if defined( AES_ENC_PREKEYED ) || defined( AES_DEC_PREKEYED )
+#if ( AES_TTABLE == 1 ) && defined( AES_ENC_PREKEYED )
+
+static uint32_t word_in( const uint8_t *b )
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static void word_out( uint8_t *b, uint32_t w )
+{
+    b[0] = (uint8_t)w;
+    b[1] = (uint8_t)(w >> 8);
+    b[2] = (uint8_t)(w >> 16);
+    b[3] = (uint8_t)(w >> 24);
+}
+
+static uint32_t sub_word( uint32_t w )
+{
+    return (uint32_t)s_box(w & 0xff) | ((uint32_t)s_box((w >> 8) & 0xff) << 8)
+         | ((uint32_t)s_box((w >> 16) & 0xff) << 16) | ((uint32_t)s_box(w >> 24) << 24);
+}
+
+/*  Set the cipher key for the pre-keyed version, 32-bit words */
+
+return_type aes_set_key( const uint8_t key[], length_type keylen, aes_context ctx[1] )
+{
+    uint8_t nk, nw, i;
+    uint32_t rc = 1, tt;
+
+    switch( keylen )
+    {
+    case 16:
+    case 24:
+    case 32:
+        break;
+    default:
+        ctx->rnd = 0;
+        return ( uint8_t )-1;
+    }
+    nk = keylen >> 2;
+    nw = keylen + 28;
+    ctx->rnd = nk + 6;
+    for( i = 0; i < nk; ++i )
+        ctx->ksch[i] = word_in( key + 4 * i );
+    for( ; i < nw; ++i )
+    {
+        tt = ctx->ksch[i - 1];
+        if( i % nk == 0 )
+        {
+            tt = sub_word( (tt >> 8) | (tt << 24) ) ^ rc;
+            rc = f2(rc);
+        }
+        else if( nk > 6 && i % nk == 4 )
+            tt = sub_word( tt );
+        ctx->ksch[i] = ctx->ksch[i - nk] ^ tt;
+    }
+    return 0;
+}
+
+/*  One round on the columns s0..s3, s0 being the output column */
+
+#define fwd_rnd(s0, s1, s2, s3, k)  ( t_fn[0][(s0) & 0xff] ^ t_fn[1][((s1) >> 8) & 0xff] \
+                                    ^ t_fn[2][((s2) >> 16) & 0xff] ^ t_fn[3][(s3) >> 24] ^ (k) )
+
+#define fwd_lrnd(s0, s1, s2, s3, k) ( ( (uint32_t)s_box((s0) & 0xff) | ((uint32_t)s_box(((s1) >> 8) & 0xff) << 8) \
+                                    | ((uint32_t)s_box(((s2) >> 16) & 0xff) << 16) | ((uint32_t)s_box((s3) >> 24) << 24) ) ^ (k) )
+
+/*  Encrypt a single block of 16 bytes, in and out may be the same buffer */
+
+return_type lora_aes_encrypt( const uint8_t in[N_BLOCK], uint8_t  out[N_BLOCK], const aes_context ctx[1] )
+{
+    const uint32_t *k = ctx->ksch;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    uint8_t r;
+
+    if( ctx->rnd == 0 )
+        return ( uint8_t )-1;
+
+    s0 = word_in( in      ) ^ k[0];
+    s1 = word_in( in +  4 ) ^ k[1];
+    s2 = word_in( in +  8 ) ^ k[2];
+    s3 = word_in( in + 12 ) ^ k[3];
+
+    for( r = 1 ; r < ctx->rnd ; ++r )
+    {
+        k += N_COL;
+        t0 = fwd_rnd( s0, s1, s2, s3, k[0] );
+        t1 = fwd_rnd( s1, s2, s3, s0, k[1] );
+        t2 = fwd_rnd( s2, s3, s0, s1, k[2] );
+        t3 = fwd_rnd( s3, s0, s1, s2, k[3] );
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+    k += N_COL;
+    word_out( out     , fwd_lrnd( s0, s1, s2, s3, k[0] ) );
+    word_out( out +  4, fwd_lrnd( s1, s2, s3, s0, k[1] ) );
+    word_out( out +  8, fwd_lrnd( s2, s3, s0, s1, k[2] ) );
+    word_out( out + 12, fwd_lrnd( s3, s0, s1, s2, k[3] ) );
+    return 0;
+}
+
+#elif defined( AES_ENC_PREKEYED ) || defined( AES_DEC_PREKEYED )
 
 /*  Set the cipher key for the pre-keyed version */
 
@@ -561,7 +697,7 @@ return_type aes_set_key( const uint8_t key[], length_type keylen, aes_context ct
 
 #endif
 
-#if defined( AES_ENC_PREKEYED )
+#if ( AES_TTABLE == 0 ) && defined( AES_ENC_PREKEYED )
 
 /*  Encrypt a single block of 16 bytes */
 
@@ -592,6 +728,10 @@ return_type lora_aes_encrypt( const uint8_t in[N_BLOCK], uint8_t  out[N_BLOCK],
     return 0;
 }
 
+#endif
+
+#if defined( AES_ENC_PREKEYED )
+
 /* CBC encrypt a number of blocks (input and return an IV) */
 
 return_type aes_cbc_encrypt( const uint8_t *in, uint8_t *out,
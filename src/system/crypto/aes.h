@@ -56,6 +56,18 @@ extern "C" {
 #  define AES_DEC_256_OTFK  /* AES decryption with 'on the fly' 256 bit keying */
 #endif
 
+/*  AES_TTABLE 1 selects the 32-bit T-table implementation of the pre-keyed
+    encryption (4 KB of tables), 0 the byte oriented one. The T-table key
+    schedule is only usable for encryption.
+*/
+#if !defined( AES_TTABLE )
+#  define AES_TTABLE            1
+#endif
+
+#if ( AES_TTABLE == 1 ) && defined( AES_DEC_PREKEYED )
+#  error "AES_TTABLE only implements the pre-keyed encryption"
+#endif
+
 #define N_ROW                   4
 #define N_COL                   4
 #define N_BLOCK   (N_ROW * N_COL)
@@ -70,7 +82,12 @@ typedef uint8_t return_type;
 typedef uint8_t length_type;
 
 typedef struct
-{   uint8_t ksch[(N_MAX_ROUNDS + 1) * N_BLOCK];
+{
+#if ( AES_TTABLE == 1 )
+    uint32_t ksch[(N_MAX_ROUNDS + 1) * N_COL];  /* one little endian word per column */
+#else
+    uint8_t ksch[(N_MAX_ROUNDS + 1) * N_BLOCK];
+#endif
     uint8_t rnd;
 } aes_context;
 
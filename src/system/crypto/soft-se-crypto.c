@@ -0,0 +1,154 @@
+/*!
+ * \file      soft-se-crypto.c
+ *
+ * \brief     Secure Element software crypto backend
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *                ______                              _
+ *               / _____)             _              | |
+ *              ( (____  _____ ____ _| |_ _____  ____| |__
+ *               \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ *               _____) ) ____| | | || |_| ____( (___| | | |
+ *              (______/|_____)_|_|_| \__)_____)\____)_| |_|
+ *              (C)2020 Semtech
+ *
+ *               ___ _____ _   ___ _  _____ ___  ___  ___ ___
+ *              / __|_   _/_\ / __| |/ / __/ _ \| _ \/ __| __|
+ *              \__ \ | |/ _ \ (__| ' <| _| (_) |   / (__| _|
+ *              |___/ |_/_/ \_\___|_|\_\_| \___/|_|_\\___|___|
+ *              embedded.connectivity.solutions===============
+ *
+ * \endcode
+ *
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "system/utilities.h"
+#include "aes.h"
+#include "cmac.h"
+
+#include "soft-se-hal.h"
+
+/*!
+ * Number of expanded AES key schedules kept
+ */
+#ifndef SOFT_SE_KEY_CACHE_SIZE
+#define SOFT_SE_KEY_CACHE_SIZE                      4
+#endif
+
+/*!
+ * Expanded AES key schedule of a key
+ */
+typedef struct sKeyScheduleCache
+{
+    /*!
+     * Key identifier
+     */
+    KeyIdentifier_t KeyID;
+    /*!
+     * Key value the schedule was expanded from
+     */
+    uint8_t KeyValue[SE_KEY_SIZE];
+    /*!
+     * Use counter value at the last use, 0 when the entry is empty
+     */
+    uint32_t LastUse;
+    /*!
+     * Expanded key
+     */
+    aes_context AesContext;
+}KeyScheduleCache_t;
+
+/*
+ * Key schedules of the last used keys. Kept in RAM, it is rebuilt after a
+ * deep sleep.
+ */
+static KeyScheduleCache_t KeyScheduleCache[SOFT_SE_KEY_CACHE_SIZE];
+
+/*
+ * Key schedule cache use counter
+ */
+static uint32_t KeyScheduleCacheUse = 0;
+
+/*
+ * Gets the expanded AES key schedule of a key. The key value is compared to
+ * the cached one, so keys changed by any mean (SetKey, NVM restore) are
+ * expanded again.
+ *
+ * \param[IN]  keyItem        - Key item
+ * \retval                    - Expanded key
+ */
+static const aes_context* GetKeySchedule( Key_t* keyItem )
+{
+    KeyScheduleCache_t* entry = &KeyScheduleCache[0];
+
+    KeyScheduleCacheUse++;
+    for( uint8_t i = 0; i < SOFT_SE_KEY_CACHE_SIZE; i++ )
+    {
+        if( ( KeyScheduleCache[i].LastUse != 0 ) && ( KeyScheduleCache[i].KeyID == keyItem->KeyID ) )
+        {
+            entry = &KeyScheduleCache[i];
+            if( memcmp( entry->KeyValue, keyItem->KeyValue, SE_KEY_SIZE ) == 0 )
+            {
+                entry->LastUse = KeyScheduleCacheUse;
+                return &entry->AesContext;
+            }
+            break;
+        }
+        // Least recently used entry, empty ones first
+        if( KeyScheduleCache[i].LastUse < entry->LastUse )
+        {
+            entry = &KeyScheduleCache[i];
+        }
+    }
+
+    aes_set_key( keyItem->KeyValue, SE_KEY_SIZE, &entry->AesContext );
+    memcpy1( entry->KeyValue, keyItem->KeyValue, SE_KEY_SIZE );
+    entry->KeyID = keyItem->KeyID;
+    entry->LastUse = KeyScheduleCacheUse;
+    return &entry->AesContext;
+}
+
+static SecureElementStatus_t SoftwareAesEncrypt( Key_t* key, const uint8_t* buffer, uint16_t size, uint8_t* encBuffer )
+{
+    const aes_context* aesContext = GetKeySchedule( key );
+    uint16_t block = 0;
+
+    while( size != 0 )
+    {
+        lora_aes_encrypt( &buffer[block], &encBuffer[block], aesContext );
+        block = block + 16;
+        size  = size - 16;
+    }
+    return SECURE_ELEMENT_SUCCESS;
+}
+
+static SecureElementStatus_t SoftwareAesCmac( Key_t* key, const uint8_t* micBxBuffer, const uint8_t* buffer, uint16_t size,
+                                              uint8_t* cmac )
+{
+    AES_CMAC_CTX aesCmacCtx[1];
+
+    AES_CMAC_Init( aesCmacCtx );
+    AES_CMAC_SetKeySchedule( aesCmacCtx, GetKeySchedule( key ) );
+
+    if( micBxBuffer != NULL )
+    {
+        AES_CMAC_Update( aesCmacCtx, micBxBuffer, 16 );
+    }
+
+    AES_CMAC_Update( aesCmacCtx, buffer, size );
+
+    AES_CMAC_Final( cmac, aesCmacCtx );
+    return SECURE_ELEMENT_SUCCESS;
+}
+
+const SoftSeCryptoBackend_t SoftSeCryptoSoftware =
+{
+    .Name = "software",
+    .AesEncrypt = SoftwareAesEncrypt,
+    .AesCmac = SoftwareAesCmac,
+};
@@ -1,5 +1,5 @@
 /*!
- * \file      soft-se-hal.h
+ * \file      soft-se-hal.c
  *
  * \brief     Secure Element hardware abstraction layer implementation
  *
@@ -28,6 +28,17 @@
 
 #include "soft-se-hal.h"
 
+#if defined( ESP32 ) && !defined( SOFT_SE_CRYPTO_SOFTWARE )
+#define SOFT_SE_CRYPTO_DEFAULT                      SoftSeCryptoEsp32
+#else
+#define SOFT_SE_CRYPTO_DEFAULT                      SoftSeCryptoSoftware
+#endif
+
+/*!
+ * Crypto backend in use
+ */
+static const SoftSeCryptoBackend_t* CryptoBackend = &SOFT_SE_CRYPTO_DEFAULT;
+
 void SoftSeHalGetUniqueId( uint8_t *id )
 {
     BoardGetUniqueId( id );
@@ -37,3 +48,13 @@ uint32_t SoftSeHalGetRandomNumber( void )
 {
     return Radio.Random( );
 }
+
+void SoftSeHalSetCryptoBackend( const SoftSeCryptoBackend_t* backend )
+{
+    CryptoBackend = ( backend != NULL ) ? backend : &SOFT_SE_CRYPTO_DEFAULT;
+}
+
+const SoftSeCryptoBackend_t* SoftSeHalGetCryptoBackend( void )
+{
+    return CryptoBackend;
+}
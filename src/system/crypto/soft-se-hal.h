@@ -33,6 +33,57 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "mac/secure-element.h"
+#include "mac/secure-element-nvm.h"
+
+/*!
+ * \brief AES-128 primitives used by the soft secure element
+ *
+ * \remark The software implementation is always available. Hardware
+ *         implementations fall back to it when the accelerator fails.
+ */
+typedef struct sSoftSeCryptoBackend
+{
+    /*!
+     * Backend name
+     */
+    const char* Name;
+    /*!
+     * \brief Encrypts a buffer in ECB mode
+     *
+     * \param [IN]  key       Key item
+     * \param [IN]  buffer    Data buffer
+     * \param [IN]  size      Data buffer size, multiple of 16
+     * \param [OUT] encBuffer Encrypted buffer, may be buffer
+     * \retval status Operation status
+     */
+    SecureElementStatus_t ( *AesEncrypt )( Key_t* key, const uint8_t* buffer, uint16_t size, uint8_t* encBuffer );
+    /*!
+     * \brief Computes the AES-CMAC of micBxBuffer followed by buffer
+     *
+     * \param [IN]  key         Key item
+     * \param [IN]  micBxBuffer 16 bytes initial block, NULL if not used
+     * \param [IN]  buffer      Data buffer
+     * \param [IN]  size        Data buffer size
+     * \param [OUT] cmac        16 bytes CMAC
+     * \retval status Operation status
+     */
+    SecureElementStatus_t ( *AesCmac )( Key_t* key, const uint8_t* micBxBuffer, const uint8_t* buffer, uint16_t size,
+                                        uint8_t* cmac );
+}SoftSeCryptoBackend_t;
+
+/*!
+ * Software backend, T-table or byte oriented AES ( AES_TTABLE )
+ */
+extern const SoftSeCryptoBackend_t SoftSeCryptoSoftware;
+
+#if defined( ESP32 )
+/*!
+ * ESP32 AES accelerator backend
+ */
+extern const SoftSeCryptoBackend_t SoftSeCryptoEsp32;
+#endif
+
 /*!
  * \brief Get a 64 bits unique ID
  *
@@ -49,6 +100,24 @@ void SoftSeHalGetUniqueId( uint8_t *id );
  */
 uint32_t SoftSeHalGetRandomNumber( void );
 
+/*!
+ * \brief Selects the crypto backend of the soft secure element
+ *
+ * \remark The default is the accelerator on ESP32, unless
+ *         SOFT_SE_CRYPTO_SOFTWARE is defined, and the software backend
+ *         elsewhere. The selection is not kept across deep sleep.
+ *
+ * \param [IN] backend Crypto backend, NULL selects the default one
+ */
+void SoftSeHalSetCryptoBackend( const SoftSeCryptoBackend_t* backend );
+
+/*!
+ * \brief Gets the crypto backend of the soft secure element
+ *
+ * \retval backend Crypto backend in use
+ */
+const SoftSeCryptoBackend_t* SoftSeHalGetCryptoBackend( void );
+
 #ifdef __cplusplus
 }
 #endif
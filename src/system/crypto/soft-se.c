@@ -27,13 +27,12 @@
 #include <stdint.h>
 
 #include "system/utilities.h"
-#include "aes.h"
-#include "cmac.h"
 
 #include "mac/LoRaMacHeaderTypes.h"
 
 #include "mac/secure-element.h"
 #include "mac/secure-element-nvm.h"
+#include "mac/LoRaMac.h"
 #include "se-identity.h"
 #include "soft-se-hal.h"
 #include <Arduino.h>
@@ -85,9 +84,6 @@ static SecureElementStatus_t ComputeCmac( uint8_t* micBxBuffer, uint8_t* buffer,
     }
 
     uint8_t Cmac[16];
-    AES_CMAC_CTX aesCmacCtx[1];
-
-    AES_CMAC_Init( aesCmacCtx );
 
     Key_t*                keyItem;
     SecureElementStatus_t retval = GetKeyByID( keyID, &keyItem );
@@ -102,17 +98,12 @@ static SecureElementStatus_t ComputeCmac( uint8_t* micBxBuffer, uint8_t* buffer,
 
     if( retval == SECURE_ELEMENT_SUCCESS )
     {
-        AES_CMAC_SetKey( aesCmacCtx, keyItem->KeyValue );
-
-        if( micBxBuffer != NULL )
+        retval = SoftSeHalGetCryptoBackend( )->AesCmac( keyItem, micBxBuffer, buffer, size, Cmac );
+        if( retval != SECURE_ELEMENT_SUCCESS )
         {
-            AES_CMAC_Update( aesCmacCtx, micBxBuffer, 16 );
+            return retval;
         }
 
-        AES_CMAC_Update( aesCmacCtx, buffer, size );
-
-        AES_CMAC_Final( Cmac, aesCmacCtx );
-
         // Bring into the required format
         *cmac = ( uint32_t )( ( uint32_t ) Cmac[3] << 24 | ( uint32_t ) Cmac[2] << 16 | ( uint32_t ) Cmac[1] << 8 |
                               ( uint32_t ) Cmac[0] );
@@ -190,11 +181,13 @@ SecureElementStatus_t SecureElementSetKey( KeyIdentifier_t keyID, uint8_t* key )
                 retval = SecureElementAesEncrypt( key, 16, MC_KE_KEY, decryptedKey );
 
                 memcpy1( SeNvm->KeyList[i].KeyValue, decryptedKey, SE_KEY_SIZE );
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT );
                 return retval;
             }
             else
             {
                 memcpy1( SeNvm->KeyList[i].KeyValue, key, SE_KEY_SIZE );
+                LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT );
                 return SECURE_ELEMENT_SUCCESS;
             }
         }
@@ -257,24 +250,12 @@ SecureElementStatus_t SecureElementAesEncrypt( uint8_t* buffer, uint16_t size, K
         return SECURE_ELEMENT_ERROR_BUF_SIZE;
     }
 // printf("-----------SecureElementAesEncrypt 1  step------------\n");
-    aes_context aesContext;
-    memset1( aesContext.ksch, '\0', 240 );
-
     Key_t*                pItem;
     SecureElementStatus_t retval = GetKeyByID( keyID, &pItem );
 
     if( retval == SECURE_ELEMENT_SUCCESS )
     {
-        aes_set_key( pItem->KeyValue, 16, &aesContext );
-
-        uint8_t block = 0;
-
-        while( size != 0 )
-        {
-            lora_aes_encrypt( &buffer[block], &encBuffer[block], &aesContext );
-            block = block + 16;
-            size  = size - 16;
-        }
+        retval = SoftSeHalGetCryptoBackend( )->AesEncrypt( pItem, buffer, size, encBuffer );
     }
     return retval;
 }
@@ -445,6 +426,7 @@ SecureElementStatus_t SecureElementSetDevEui( uint8_t* devEui )
 
 
     memcpy1( SeNvm->DevEui, devEui, SE_EUI_SIZE );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT );
     // printf("---------------- ------------------\n");
     return SECURE_ELEMENT_SUCCESS;
 }
@@ -461,6 +443,7 @@ SecureElementStatus_t SecureElementSetJoinEui( uint8_t* joinEui )
         return SECURE_ELEMENT_ERROR_NPE;
     }
     memcpy1( SeNvm->JoinEui, joinEui, SE_EUI_SIZE );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT );
     return SECURE_ELEMENT_SUCCESS;
 }
 
@@ -477,6 +460,7 @@ SecureElementStatus_t SecureElementSetPin( uint8_t* pin )
     }
 
     memcpy1( SeNvm->Pin, pin, SE_PIN_SIZE );
+    LoRaMacNvmSetDirty( LORAMAC_NVM_NOTIFY_FLAG_SECURE_ELEMENT );
     return SECURE_ELEMENT_SUCCESS;
 }
 
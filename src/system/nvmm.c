@@ -0,0 +1,555 @@
+/*!
+ * \file      nvmm.c
+ *
+ * \brief     Non-volatile memory management: journaled, wear levelled log of
+ *            an image kept in RAM
+ *
+ * \remark    Block layout:
+ *
+ *            | header | record | record | ... | 0xFF ... |
+ *
+ *            Records are 4 bytes aligned. A record header is followed by its
+ *            data and protected, data included, by a CRC32. The first records
+ *            of a block hold the full image, the next ones the bytes changed
+ *            by each transaction. A commit record carries the CRC32 of the
+ *            image once the transaction is applied.
+ *
+ *            Mounting replays the block with the highest sequence number that
+ *            holds a commit, up to its last commit. Anything written after it
+ *            (power cut in a transaction or in a record) is dropped and the
+ *            next commit compacts the image into a new block.
+ */
+#include <stddef.h>
+#include <string.h>
+#include "system/utilities.h"
+#include "system/nvmm.h"
+
+/*!
+ * Block header magic, "LNVM"
+ */
+#define NVMM_MAGIC                                  0x4D564E4C
+
+#define NVMM_RECORD_DATA                            0x5A
+#define NVMM_RECORD_COMMIT                          0xC3
+
+/*!
+ * Unchanged bytes between two changed runs below which the runs are written
+ * as one record
+ */
+#define NVMM_MERGE_GAP                              sizeof( NvmmRecord_t )
+
+/*!
+ * Blocks used at most, one bit each while mounting
+ */
+#define NVMM_BLOCKS_MAX                             32
+
+/*!
+ * Chunk read from the flash to check the records
+ */
+#define NVMM_READ_CHUNK                             64
+
+#define NVMM_ALIGN4( size )                         ( ( ( size ) + 3 ) & ~3 )
+
+typedef struct NvmmBlockHeader_s
+{
+    uint32_t Magic;
+    uint32_t Sequence;
+    uint16_t ImageSize;
+    uint16_t Reserved;
+    /*!
+     * CRC32 of the fields above
+     */
+    uint32_t Crc;
+}NvmmBlockHeader_t;
+
+typedef struct NvmmRecord_s
+{
+    uint16_t Offset;
+    /*!
+     * Data size, the data is padded to 4 bytes
+     */
+    uint16_t Size;
+    uint8_t Type;
+    /*!
+     * ~Type
+     */
+    uint8_t TypeCheck;
+    uint16_t Reserved;
+    /*!
+     * CRC32 of the fields above and of the data
+     */
+    uint32_t Crc;
+}NvmmRecord_t;
+
+/*!
+ * Record size without the Crc field
+ */
+#define NVMM_RECORD_CRC_OFFSET                      8
+
+static struct
+{
+    uint8_t* Image;
+    uint16_t ImageSize;
+    bool Mounted;
+    /*!
+     * Number of blocks in the storage area
+     */
+    uint32_t NbBlocks;
+    /*!
+     * Current block, -1 when the log is empty
+     */
+    int32_t Block;
+    uint32_t Sequence;
+    /*!
+     * Offset of the next record in the current block
+     */
+    uint32_t WritePos;
+    /*!
+     * Data written since the last commit
+     */
+    bool TxnPending;
+    /*!
+     * The next commit writes a snapshot into the next block
+     */
+    bool CompactionNeeded;
+    NvmmStats_t Stats;
+}Nvmm;
+
+static uint32_t NvmmBlockAddr( int32_t block )
+{
+    return ( uint32_t )block * NVMM_BLOCK_SIZE;
+}
+
+static uint32_t NvmmRecordCrc( NvmmRecord_t* record, const uint8_t* data )
+{
+    uint32_t crc = Crc32Update( Crc32Init( ), ( uint8_t* )record, NVMM_RECORD_CRC_OFFSET );
+
+    if( data != NULL )
+    {
+        crc = Crc32Update( crc, ( uint8_t* )data, record->Size );
+    }
+    return Crc32Finalize( crc );
+}
+
+/*!
+ * \brief Reads and checks the record at the given position
+ *
+ * \param [IN]  addr   Record address
+ * \param [IN]  end    Block end address
+ * \param [OUT] record Record header
+ * \retval status false at the end of the log or on a torn record
+ */
+static bool NvmmReadRecord( uint32_t addr, uint32_t end, NvmmRecord_t* record )
+{
+    uint8_t chunk[NVMM_READ_CHUNK];
+    uint32_t crc;
+
+    if( ( ( addr + sizeof( NvmmRecord_t ) ) > end ) ||
+        ( FlashMcuRead( addr, ( uint8_t* )record, sizeof( NvmmRecord_t ) ) == false ) )
+    {
+        return false;
+    }
+    if( ( ( record->Type ^ record->TypeCheck ) != 0xFF ) ||
+        ( ( record->Type != NVMM_RECORD_DATA ) && ( record->Type != NVMM_RECORD_COMMIT ) ) ||
+        ( ( addr + sizeof( NvmmRecord_t ) + NVMM_ALIGN4( record->Size ) ) > end ) )
+    {
+        return false;
+    }
+    if( ( record->Type == NVMM_RECORD_DATA ) && ( ( record->Offset + record->Size ) > Nvmm.ImageSize ) )
+    {
+        return false;
+    }
+    if( ( record->Type == NVMM_RECORD_COMMIT ) && ( record->Size != sizeof( uint32_t ) ) )
+    {
+        return false;
+    }
+
+    crc = Crc32Update( Crc32Init( ), ( uint8_t* )record, NVMM_RECORD_CRC_OFFSET );
+    addr += sizeof( NvmmRecord_t );
+    for( uint16_t done = 0; done < record->Size; )
+    {
+        uint16_t len = ( ( record->Size - done ) > NVMM_READ_CHUNK ) ? NVMM_READ_CHUNK : record->Size - done;
+
+        if( FlashMcuRead( addr + done, chunk, len ) == false )
+        {
+            return false;
+        }
+        crc = Crc32Update( crc, chunk, len );
+        done += len;
+    }
+    return Crc32Finalize( crc ) == record->Crc;
+}
+
+/*!
+ * \brief Checks that a block area has not been programmed
+ */
+static bool NvmmIsErased( uint32_t addr, uint32_t end )
+{
+    uint8_t chunk[NVMM_READ_CHUNK];
+
+    while( addr < end )
+    {
+        uint32_t len = ( ( end - addr ) > NVMM_READ_CHUNK ) ? NVMM_READ_CHUNK : end - addr;
+
+        if( FlashMcuRead( addr, chunk, len ) == false )
+        {
+            return false;
+        }
+        for( uint32_t i = 0; i < len; i++ )
+        {
+            if( chunk[i] != 0xFF )
+            {
+                return false;
+            }
+        }
+        addr += len;
+    }
+    return true;
+}
+
+/*!
+ * \brief Reads the header of a block
+ *
+ * \retval status true if the block belongs to a log of the current image size
+ */
+static bool NvmmReadBlockHeader( int32_t block, NvmmBlockHeader_t* header )
+{
+    if( FlashMcuRead( NvmmBlockAddr( block ), ( uint8_t* )header, sizeof( NvmmBlockHeader_t ) ) == false )
+    {
+        return false;
+    }
+    return ( header->Magic == NVMM_MAGIC ) && ( header->ImageSize == Nvmm.ImageSize ) &&
+           ( header->Crc == Crc32( ( uint8_t* )header, offsetof( NvmmBlockHeader_t, Crc ) ) );
+}
+
+/*!
+ * \brief Finds the end of the last commit of a block
+ *
+ * \retval end Offset following the last commit record, 0 if there is none
+ */
+static uint32_t NvmmScanBlock( int32_t block )
+{
+    uint32_t base = NvmmBlockAddr( block );
+    uint32_t end = base + NVMM_BLOCK_SIZE;
+    uint32_t addr = base + sizeof( NvmmBlockHeader_t );
+    uint32_t commitEnd = 0;
+    NvmmRecord_t record;
+
+    while( NvmmReadRecord( addr, end, &record ) == true )
+    {
+        addr += sizeof( NvmmRecord_t ) + NVMM_ALIGN4( record.Size );
+        if( record.Type == NVMM_RECORD_COMMIT )
+        {
+            commitEnd = addr - base;
+        }
+    }
+    return commitEnd;
+}
+
+/*!
+ * \brief Applies the data records of a block to the image, up to commitEnd
+ *
+ * \retval status false if the image does not match the last commit
+ */
+static bool NvmmReplayBlock( int32_t block, uint32_t commitEnd )
+{
+    uint32_t base = NvmmBlockAddr( block );
+    uint32_t addr = base + sizeof( NvmmBlockHeader_t );
+    uint32_t imageCrc = 0;
+    NvmmRecord_t record;
+
+    while( addr < ( base + commitEnd ) )
+    {
+        if( FlashMcuRead( addr, ( uint8_t* )&record, sizeof( NvmmRecord_t ) ) == false )
+        {
+            return false;
+        }
+        addr += sizeof( NvmmRecord_t );
+        if( record.Type == NVMM_RECORD_DATA )
+        {
+            if( FlashMcuRead( addr, &Nvmm.Image[record.Offset], record.Size ) == false )
+            {
+                return false;
+            }
+        }
+        else if( FlashMcuRead( addr, ( uint8_t* )&imageCrc, sizeof( imageCrc ) ) == false )
+        {
+            return false;
+        }
+        addr += NVMM_ALIGN4( record.Size );
+    }
+    return imageCrc == Crc32( Nvmm.Image, Nvmm.ImageSize );
+}
+
+static bool NvmmMount( void )
+{
+    uint32_t tried = 0;
+
+    Nvmm.NbBlocks = FlashMcuGetSize( ) / NVMM_BLOCK_SIZE;
+    if( Nvmm.NbBlocks > NVMM_BLOCKS_MAX )
+    {
+        Nvmm.NbBlocks = NVMM_BLOCKS_MAX;
+    }
+    if( ( Nvmm.NbBlocks < 2 ) ||
+        ( ( sizeof( NvmmBlockHeader_t ) + 2 * sizeof( NvmmRecord_t ) + NVMM_ALIGN4( Nvmm.ImageSize ) +
+            sizeof( uint32_t ) ) > ( NVMM_BLOCK_SIZE / 2 ) ) )
+    {
+        return false;
+    }
+
+    Nvmm.Block = -1;
+    Nvmm.Sequence = 0;
+    Nvmm.TxnPending = false;
+    Nvmm.CompactionNeeded = true;
+    memset1( Nvmm.Image, 0, Nvmm.ImageSize );
+
+    // Newest block first, an older one is used when the newest has no commit
+    // (power cut while compacting) or does not replay
+    for( ;; )
+    {
+        NvmmBlockHeader_t header;
+        int32_t candidate = -1;
+        uint32_t candidateSeq = 0;
+        uint32_t commitEnd;
+
+        for( uint32_t b = 0; b < Nvmm.NbBlocks; b++ )
+        {
+            if( ( ( tried & ( 1UL << b ) ) == 0 ) && ( NvmmReadBlockHeader( b, &header ) == true ) &&
+                ( ( candidate < 0 ) || ( header.Sequence > candidateSeq ) ) )
+            {
+                candidate = b;
+                candidateSeq = header.Sequence;
+            }
+        }
+        if( candidate < 0 )
+        {
+            break;
+        }
+        tried |= 1UL << candidate;
+
+        commitEnd = NvmmScanBlock( candidate );
+        if( ( commitEnd != 0 ) && ( NvmmReplayBlock( candidate, commitEnd ) == true ) )
+        {
+            Nvmm.Block = candidate;
+            Nvmm.Sequence = candidateSeq;
+            Nvmm.WritePos = commitEnd;
+            // Records can only be appended after the last commit
+            Nvmm.CompactionNeeded = NvmmIsErased( NvmmBlockAddr( candidate ) + commitEnd,
+                                                  NvmmBlockAddr( candidate ) + NVMM_BLOCK_SIZE ) == false;
+            return true;
+        }
+        memset1( Nvmm.Image, 0, Nvmm.ImageSize );
+    }
+    return true;
+}
+
+/*!
+ * \brief Appends a record to the current block
+ *
+ * \param [IN] type   Record type
+ * \param [IN] offset Offset of the data in the image
+ * \param [IN] data   Record data
+ * \param [IN] size   Data size
+ * \param [IN] reserve Room to keep at the end of the block, for the commit
+ * \retval status false if the record does not fit or could not be written
+ */
+static bool NvmmAppend( uint8_t type, uint16_t offset, const uint8_t* data, uint16_t size, uint32_t reserve )
+{
+    uint32_t addr = NvmmBlockAddr( Nvmm.Block ) + Nvmm.WritePos;
+    NvmmRecord_t record;
+
+    if( ( Nvmm.Block < 0 ) ||
+        ( ( Nvmm.WritePos + sizeof( NvmmRecord_t ) + NVMM_ALIGN4( size ) + reserve ) > NVMM_BLOCK_SIZE ) )
+    {
+        return false;
+    }
+    record.Offset = offset;
+    record.Size = size;
+    record.Type = type;
+    record.TypeCheck = ( uint8_t )~type;
+    record.Reserved = 0xFFFF;
+    record.Crc = NvmmRecordCrc( &record, data );
+
+    // The data goes first, the record is only valid once its header is written
+    Nvmm.WritePos += sizeof( NvmmRecord_t ) + NVMM_ALIGN4( size );
+    Nvmm.Stats.FlashBytes += sizeof( NvmmRecord_t ) + size;
+    if( ( FlashMcuWrite( addr + sizeof( NvmmRecord_t ), data, size ) == false ) ||
+        ( FlashMcuWrite( addr, ( uint8_t* )&record, sizeof( NvmmRecord_t ) ) == false ) )
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool NvmmAppendCommit( void )
+{
+    uint32_t imageCrc = Crc32( Nvmm.Image, Nvmm.ImageSize );
+
+    return NvmmAppend( NVMM_RECORD_COMMIT, 0, ( uint8_t* )&imageCrc, sizeof( imageCrc ), 0 );
+}
+
+/*!
+ * \brief Writes the image into the next block of the ring. The current block
+ *        stays valid until the commit of the new one is written.
+ */
+static bool NvmmCompact( void )
+{
+    int32_t block = ( Nvmm.Block + 1 ) % ( int32_t )Nvmm.NbBlocks;
+    int32_t previousBlock = Nvmm.Block;
+    NvmmBlockHeader_t header;
+
+    for( uint32_t addr = 0; addr < NVMM_BLOCK_SIZE; addr += FLASH_MCU_SECTOR_SIZE )
+    {
+        Nvmm.Stats.Erases++;
+        if( FlashMcuEraseSector( NvmmBlockAddr( block ) + addr ) == false )
+        {
+            return false;
+        }
+    }
+    header.Magic = NVMM_MAGIC;
+    header.Sequence = Nvmm.Sequence + 1;
+    header.ImageSize = Nvmm.ImageSize;
+    header.Reserved = 0xFFFF;
+    header.Crc = Crc32( ( uint8_t* )&header, offsetof( NvmmBlockHeader_t, Crc ) );
+    Nvmm.Stats.FlashBytes += sizeof( header );
+    if( FlashMcuWrite( NvmmBlockAddr( block ), ( uint8_t* )&header, sizeof( header ) ) == false )
+    {
+        return false;
+    }
+
+    Nvmm.Block = block;
+    Nvmm.WritePos = sizeof( header );
+    if( ( NvmmAppend( NVMM_RECORD_DATA, 0, Nvmm.Image, Nvmm.ImageSize, 0 ) == false ) ||
+        ( NvmmAppendCommit( ) == false ) )
+    {
+        Nvmm.Block = previousBlock;
+        return false;
+    }
+    Nvmm.Sequence = header.Sequence;
+    Nvmm.Stats.Compactions++;
+    return true;
+}
+
+bool NvmmInit( uint8_t* image, uint16_t size )
+{
+    Nvmm.Image = image;
+    Nvmm.ImageSize = size;
+    Nvmm.Mounted = ( FlashMcuInit( ) == true ) && ( NvmmMount( ) == true );
+    return Nvmm.Mounted;
+}
+
+uint16_t NvmmWrite( uint8_t* src, uint16_t size, uint16_t offset )
+{
+    uint16_t changed = 0;
+    uint16_t i = 0;
+
+    if( ( Nvmm.Mounted == false ) || ( ( offset + size ) > Nvmm.ImageSize ) )
+    {
+        return 0;
+    }
+
+    while( i < size )
+    {
+        uint16_t start;
+        uint16_t end;
+
+        if( src[i] == Nvmm.Image[offset + i] )
+        {
+            i++;
+            continue;
+        }
+        // Changed run, extended over the short unchanged gaps
+        start = i;
+        end = i + 1;
+        for( uint16_t j = end; ( j < size ) && ( ( size_t )( j - end ) < NVMM_MERGE_GAP ); j++ )
+        {
+            if( src[j] != Nvmm.Image[offset + j] )
+            {
+                end = j + 1;
+            }
+        }
+
+        if( ( Nvmm.CompactionNeeded == false ) &&
+            ( NvmmAppend( NVMM_RECORD_DATA, offset + start, &src[start], end - start,
+                          sizeof( NvmmRecord_t ) + sizeof( uint32_t ) ) == false ) )
+        {
+            // The image goes into a new block at commit time
+            Nvmm.CompactionNeeded = true;
+        }
+        memcpy1( &Nvmm.Image[offset + start], &src[start], end - start );
+        changed += end - start;
+        i = end;
+    }
+    if( changed != 0 )
+    {
+        Nvmm.TxnPending = true;
+        Nvmm.Stats.DataBytes += changed;
+    }
+    return changed;
+}
+
+bool NvmmCommit( void )
+{
+    if( Nvmm.Mounted == false )
+    {
+        return false;
+    }
+    if( Nvmm.TxnPending == false )
+    {
+        return true;
+    }
+    if( ( Nvmm.CompactionNeeded == true ) || ( NvmmAppendCommit( ) == false ) )
+    {
+        Nvmm.CompactionNeeded = true;
+        if( NvmmCompact( ) == false )
+        {
+            return false;
+        }
+        Nvmm.CompactionNeeded = false;
+    }
+    Nvmm.TxnPending = false;
+    Nvmm.Stats.Commits++;
+    return true;
+}
+
+uint16_t NvmmRead( uint8_t* dest, uint16_t size, uint16_t offset )
+{
+    if( ( Nvmm.Mounted == false ) || ( ( offset + size ) > Nvmm.ImageSize ) )
+    {
+        return 0;
+    }
+    memcpy1( dest, &Nvmm.Image[offset], size );
+    return size;
+}
+
+bool NvmmCrc32Check( uint16_t size, uint16_t offset )
+{
+    uint32_t crc;
+
+    if( ( Nvmm.Mounted == false ) || ( size < sizeof( crc ) ) || ( ( offset + size ) > Nvmm.ImageSize ) )
+    {
+        return false;
+    }
+    memcpy1( ( uint8_t* )&crc, &Nvmm.Image[offset + size - sizeof( crc )], sizeof( crc ) );
+    return crc == Crc32( &Nvmm.Image[offset], size - sizeof( crc ) );
+}
+
+bool NvmmReset( uint16_t size, uint16_t offset )
+{
+    uint32_t crc;
+
+    if( ( Nvmm.Mounted == false ) || ( size < sizeof( crc ) ) || ( ( offset + size ) > Nvmm.ImageSize ) )
+    {
+        return false;
+    }
+    offset += size - sizeof( crc );
+    memcpy1( ( uint8_t* )&crc, &Nvmm.Image[offset], sizeof( crc ) );
+    crc++;
+    NvmmWrite( ( uint8_t* )&crc, sizeof( crc ), offset );
+    return true;
+}
+
+void NvmmGetStats( NvmmStats_t* stats )
+{
+    *stats = Nvmm.Stats;
+}
@@ -0,0 +1,131 @@
+/*!
+ * \file      nvmm.h
+ *
+ * \brief     Non-volatile memory management: journaled, wear levelled log of
+ *            an image kept in RAM
+ *
+ * \remark    The storage area (flash_board.h) is split in blocks used as a
+ *            ring. A block starts with a full snapshot of the image followed
+ *            by delta records, each transaction being closed by a commit
+ *            record. When a block is full the image is compacted into the next
+ *            block of the ring, the previous one is only erased once the
+ *            ring wraps around. Power cuts at any point leave the image of the
+ *            last commit.
+ */
+#ifndef __NVMM_H__
+#define __NVMM_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "boards/mcu/flash_board.h"
+
+/*!
+ * Size of a log block, multiple of FLASH_MCU_SECTOR_SIZE
+ */
+#ifndef NVMM_BLOCK_SIZE
+#define NVMM_BLOCK_SIZE                             ( 2 * FLASH_MCU_SECTOR_SIZE )
+#endif
+
+/*!
+ * Log statistics
+ */
+typedef struct NvmmStats_s
+{
+    /*!
+     * Committed transactions
+     */
+    uint32_t Commits;
+    /*!
+     * Snapshots written into a new block
+     */
+    uint32_t Compactions;
+    /*!
+     * Image bytes changed by the transactions
+     */
+    uint32_t DataBytes;
+    /*!
+     * Bytes programmed, records overhead and snapshots included
+     */
+    uint32_t FlashBytes;
+    /*!
+     * Sectors erased
+     */
+    uint32_t Erases;
+}NvmmStats_t;
+
+/*!
+ * \brief Mounts the log and rebuilds the image of the last commit
+ *
+ * \param [IN] image Image buffer, updated by NvmmWrite and filled with zeros
+ *                   when the log is empty
+ * \param [IN] size  Image size
+ * \retval status false when there is no storage area
+ */
+bool NvmmInit( uint8_t* image, uint16_t size );
+
+/*!
+ * \brief Writes data into the image. Only the bytes which differ from the
+ *        image are appended to the log. They are not restored after a power
+ *        cut until NvmmCommit succeeds.
+ *
+ * \param [IN] src    Source data
+ * \param [IN] size   Data size
+ * \param [IN] offset Offset in the image
+ * \retval size Number of bytes which changed
+ */
+uint16_t NvmmWrite( uint8_t* src, uint16_t size, uint16_t offset );
+
+/*!
+ * \brief Commits the data written since the last commit
+ *
+ * \retval status false if the log could not be written, the data is then
+ *                committed by the next successful call
+ */
+bool NvmmCommit( void );
+
+/*!
+ * \brief Reads data from the image
+ *
+ * \param [OUT] dest   Destination buffer
+ * \param [IN]  size   Data size
+ * \param [IN]  offset Offset in the image
+ * \retval size Number of bytes read
+ */
+uint16_t NvmmRead( uint8_t* dest, uint16_t size, uint16_t offset );
+
+/*!
+ * \brief Checks the CRC32 stored in the last 4 bytes of an image area
+ *
+ * \param [IN] size   Area size, CRC included
+ * \param [IN] offset Offset of the area in the image
+ * \retval status true if the CRC matches
+ */
+bool NvmmCrc32Check( uint16_t size, uint16_t offset );
+
+/*!
+ * \brief Invalidates the CRC32 stored in the last 4 bytes of an image area.
+ *        Committed by the next NvmmCommit.
+ *
+ * \param [IN] size   Area size, CRC included
+ * \param [IN] offset Offset of the area in the image
+ * \retval status Operation status
+ */
+bool NvmmReset( uint16_t size, uint16_t offset );
+
+/*!
+ * \brief Gets the log statistics since start-up
+ *
+ * \param [OUT] stats Log statistics
+ */
+void NvmmGetStats( NvmmStats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __NVMM_H__
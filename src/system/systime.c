@@ -133,6 +133,15 @@ SysTime_t SysTimeGet( void )
     return sysTime;
 }
 
+SysTime_t SysTimeGetAt( uint64_t timeUs )
+{
+    uint64_t now = RtcGetTimeUs( );
+    uint64_t elapsedMs = ( now > timeUs ) ? ( now - timeUs + 500 ) / 1000 : 0;
+    SysTime_t elapsed = { .Seconds = ( uint32_t )( elapsedMs / 1000 ), .SubSeconds = ( int16_t )( elapsedMs % 1000 ) };
+
+    return SysTimeSub( SysTimeGet( ), elapsed );
+}
+
 SysTime_t SysTimeGetMcuTime( void )
 {
     SysTime_t calendarTime = { .Seconds = 0, .SubSeconds = 0 };
@@ -120,6 +120,15 @@ void SysTimeSet( SysTime_t sysTime );
  */
 SysTime_t SysTimeGet( void );
 
+/*!
+ * \brief Gets the system time at a past instant, e.g. the time of a radio IRQ
+ *
+ * \param [IN] timeUs Past instant, RtcGetTimeUs time base [us]
+ *
+ * \retval sysTime    Seconds/sub-seconds since UNIX epoch origin at timeUs
+ */
+SysTime_t SysTimeGetAt( uint64_t timeUs );
+
 /*!
  * \brief Gets current MCU system time
  *
@@ -140,6 +140,30 @@ int8_t Nibble2HexChar(uint8_t a);
 /** Leaves the maximum of the two 32-bit arguments */
 /*lint -emacro(506, T_MAX) */ /* Suppress "Constant value Boolean */
 #define T_MAX(a, b) ((a) < (b) ? (b) : (a))
+/*!
+ * CRC32 computed by the ESP ROM routine (1) or by the table driven one (0).
+ * The ROM tables cost no flash nor RAM.
+ */
+#if !defined( CRC32_ROM )
+#if defined( ESP32 )
+#define CRC32_ROM                                   1
+#else
+#define CRC32_ROM                                   0
+#endif
+#endif
+
+/*!
+ * Bytes processed per step by the table driven CRC32, 4 or 8. Slice by 8
+ * uses 8 KB of tables, slice by 4 4 KB.
+ */
+#if !defined( CRC32_SLICES )
+#define CRC32_SLICES                                8
+#endif
+
+#if ( CRC32_SLICES != 4 ) && ( CRC32_SLICES != 8 )
+#error "CRC32_SLICES must be 4 or 8"
+#endif
+
 /*!
  * \brief Computes a CCITT 32 bits CRC
  *